@@ -77,6 +77,7 @@ int cache_config_agg_write_backlog = AGG_SIZE * 2;
 int cache_config_enable_checksum = 0;
 int cache_config_alt_rewrite_max_size = 4096;
 int cache_config_read_while_writer = 0;
+int cache_config_read_while_writer_max_wait = 0;
 char cache_system_config_directory[PATH_NAME_MAX + 1];
 int cache_config_mutex_retry_delay = 2;
 #ifdef HTTP_CACHE
@@ -2727,6 +2728,8 @@ register_cache_stats(RecRawStatBlock *rsb, const char *prefix)
   REG_INT("frags_per_doc.3+", cache_three_plus_plus_fragment_document_count_stat);
   REG_INT("read_busy.success", cache_read_busy_success_stat);
   REG_INT("read_busy.failure", cache_read_busy_failure_stat);
+  REG_INT("read_busy.waits", cache_read_busy_waits_stat);
+  REG_INT("read_busy.timeouts", cache_read_busy_timeouts_stat);
   REG_INT("write_bytes_stat", cache_write_bytes_stat);
   REG_INT("vector_marshals", cache_hdr_vector_marshal_stat);
   REG_INT("hdr_marshals", cache_hdr_marshal_stat);
@@ -2839,6 +2842,10 @@ ink_cache_init(ModuleVersion v)
   REC_RegisterConfigUpdateFunc("proxy.config.cache.enable_read_while_writer", update_cache_config, NULL);
   Debug("cache_init", "proxy.config.cache.enable_read_while_writer = %d", cache_config_read_while_writer);
 
+  REC_EstablishStaticConfigInt32(cache_config_read_while_writer_max_wait,
+                                 "proxy.config.cache.read_while_writer.max_wait");
+  Debug("cache_init", "proxy.config.cache.read_while_writer.max_wait = %dms", cache_config_read_while_writer_max_wait);
+
   register_cache_stats(cache_rsb, "proxy.process.cache");
 
   const char *err = NULL;
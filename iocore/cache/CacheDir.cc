@@ -113,8 +113,11 @@ OpenDir::signal_readers(int event, Event *e)
   while ((c = delayed_readers.dequeue())) {
     CACHE_TRY_LOCK(lock, c->mutex, t);
     if (lock) {
+      // Replace the fallback timeout of the reader with an immediate
+      // event, the reader itself is not reentered from here.
       c->f.open_read_timeout = 0;
-      c->handleEvent(EVENT_IMMEDIATE, 0);
+      c->cancel_trigger();
+      c->trigger = t->schedule_imm_local(c, EVENT_INTERVAL);
       continue;
     }
     newly_delayed_readers.push(c);
@@ -135,12 +138,12 @@ OpenDir::close_write(CacheVC *cont)
   ink_assert(cont->vol->mutex->thread_holding == this_ethread());
   cont->od->writers.remove(cont);
   cont->od->num_writers--;
+  // The readers may have been waiting for this writer in particular.
+  wake_readers(cont->od);
   if (!cont->od->writers.head) {
     unsigned int h = cont->first_key.word(0);
     int b = h % OPEN_DIR_BUCKETS;
     bucket[b].remove(cont->od);
-    delayed_readers.append(cont->od->readers);
-    signal_readers(0, 0);
     cont->od->vector.clear();
     THREAD_FREE(cont->od, openDirEntryAllocator, cont->mutex->thread_holding);
   }
@@ -159,11 +162,42 @@ OpenDir::open_read(INK_MD5 *key)
   return NULL;
 }
 
+void
+OpenDir::wake_readers(OpenDirEntry *od)
+{
+  CacheVC *c = NULL;
+
+  if (!od->readers.head)
+    return;
+  while ((c = od->readers.pop())) {
+    c->wait_od = NULL;
+    delayed_readers.enqueue(c);
+  }
+  signal_readers(0, 0);
+}
+
+void
+OpenDir::stop_waiting(CacheVC *c)
+{
+  ink_assert(c->vol->mutex->thread_holding == this_ethread());
+  if (!c->f.open_read_timeout)
+    return;
+  if (c->wait_od)
+    c->wait_od->readers.remove(c);
+  else
+    delayed_readers.remove(c);
+  c->wait_od = NULL;
+  c->f.open_read_timeout = 0;
+}
+
+// Park a reader until a writer of this entry inserts a fragment or
+// closes, or until @a msec have passed.
 int
 OpenDirEntry::wait(CacheVC *cont, int msec)
 {
   ink_assert(cont->vol->mutex->thread_holding == this_ethread());
   cont->f.open_read_timeout = 1;
+  cont->wait_od = this;
   ink_assert(!cont->trigger);
   cont->trigger = cont->vol->mutex->thread_holding->schedule_in_local(cont, HRTIME_MSECONDS(msec));
   readers.push(cont);
@@ -1447,3 +1481,64 @@ EXCLUSIVE_REGRESSION_TEST(Cache_dir) (RegressionTest *t, int atype, int *status)
   vol_dir_clear(d);
   *status = ret;
 }
+
+// Readers parked on a writer: woken up by the writer, or taken off the
+// entry when their fallback timeout fires.
+EXCLUSIVE_REGRESSION_TEST(Cache_dir_wait_for_writer) (RegressionTest *t, int atype, int *status) {
+  NOWARN_UNUSED(atype);
+  int ret = REGRESSION_TEST_PASSED;
+
+  if ((CacheProcessor::IsCacheEnabled() != CACHE_INITIALIZED) || gnvol < 1) {
+    rprintf(t, "cache not ready/configured");
+    *status = REGRESSION_TEST_FAILED;
+    return;
+  }
+  Vol *d = gvol[0];
+  EThread *thread = this_ethread();
+  MUTEX_TRY_LOCK(lock, d->mutex, thread);
+  ink_release_assert(lock);
+
+  Continuation cont(d->mutex);
+  OpenDirEntry *od = THREAD_ALLOC(openDirEntryAllocator, thread);
+  CacheVC *c = new_CacheVC(&cont);
+  c->vol = d;
+
+  // woken up by the writer: off the entry, resumed immediately
+  rprintf(t, "wake test\n");
+  od->wait(c, 1000);
+  if (od->readers.head != c || c->wait_od != od || !c->f.open_read_timeout || !c->trigger)
+    ret = REGRESSION_TEST_FAILED;
+  d->open_dir.wake_readers(od);
+  if (od->readers.head || c->wait_od || c->f.open_read_timeout || !c->trigger || c->trigger->timeout_at != 0)
+    ret = REGRESSION_TEST_FAILED;
+  c->cancel_trigger();
+
+  // fallback timeout: the reader takes itself off the entry
+  rprintf(t, "timeout test\n");
+  od->wait(c, 10);
+  if (od->readers.head != c || !c->trigger || c->trigger->timeout_at == 0)
+    ret = REGRESSION_TEST_FAILED;
+  c->cancel_trigger();
+  if (c->stop_waiting_for_writer() < 0 || od->readers.head || c->wait_od || c->f.open_read_timeout)
+    ret = REGRESSION_TEST_FAILED;
+  // a reader that is not parked any more is left alone
+  d->open_dir.wake_readers(od);
+  if (c->trigger)
+    ret = REGRESSION_TEST_FAILED;
+
+  // the wait for a writer to get going is bounded by read_while_writer.max_wait
+  rprintf(t, "max wait test\n");
+  int max_wait = cache_config_read_while_writer_max_wait;
+  cache_config_read_while_writer_max_wait = 0;
+  if (writer_wait_expired(ink_get_hrtime() - HRTIME_SECONDS(60)))
+    ret = REGRESSION_TEST_FAILED;
+  cache_config_read_while_writer_max_wait = 100;
+  if (writer_wait_expired(ink_get_hrtime()) || !writer_wait_expired(ink_get_hrtime() - HRTIME_MSECONDS(200)))
+    ret = REGRESSION_TEST_FAILED;
+  cache_config_read_while_writer_max_wait = max_wait;
+
+  c->vol = NULL;
+  free_CacheVC(c);
+  THREAD_FREE(od, openDirEntryAllocator, thread);
+  *status = ret;
+}
@@ -291,6 +291,8 @@ CacheVC::openReadFromWriter(int event, Event * e)
     f.read_from_writer_called = 1;
   }
   cancel_trigger();
+  if (stop_waiting_for_writer() < 0)
+    VC_SCHED_LOCK_RETRY();
   intptr_t err = ECACHE_DOC_BUSY;
   DDebug("cache_read_agg", "%p: key: %X In openReadFromWriter", this, first_key.word(1));
 #ifndef READ_WHILE_WRITER
@@ -323,9 +325,17 @@ CacheVC::openReadFromWriter(int event, Event * e)
       return openReadStartHead(event, e);
     } else if (ret == EVENT_CONT) {
       ink_assert(!write_vc);
-      VC_SCHED_WRITER_RETRY();
-    } else
+      if (writer_wait_expired(start_time)) {
+        MUTEX_RELEASE(lock);
+        CACHE_INCREMENT_DYN_STAT(cache_read_busy_timeouts_stat);
+        return openReadFromWriterFailure(CACHE_EVENT_OPEN_READ_FAILED, (Event *) - err);
+      }
+      VC_WAIT_FOR_WRITER(vol->open_read(&first_key));
+    } else {
       ink_assert(write_vc);
+      // counted once per writer the reader attaches to, not per wait
+      CACHE_INCREMENT_DYN_STAT(cache_read_busy_waits_stat);
+    }
   } else {
     if (writer_done()) {
       MUTEX_RELEASE(lock);
@@ -359,7 +369,12 @@ CacheVC::openReadFromWriter(int event, Event * e)
     DDebug("cache_read_agg",
           "%p: key: %X writer: closed:%d, fragment:%d, retry: %d",
           this, first_key.word(1), write_vc->closed, write_vc->fragment, writer_lock_retry);
-    VC_SCHED_WRITER_RETRY();
+    if (writer_wait_expired(start_time)) {
+      MUTEX_RELEASE(lock);
+      CACHE_INCREMENT_DYN_STAT(cache_read_busy_timeouts_stat);
+      return openReadFromWriterFailure(CACHE_EVENT_OPEN_READ_FAILED, (Event *) - err);
+    }
+    VC_WAIT_FOR_WRITER(vol->open_read(&first_key));
   }
 
   CACHE_TRY_LOCK(writer_lock, write_vc->mutex, mutex->thread_holding);
@@ -519,6 +534,7 @@ CacheVC::openReadClose(int event, Event * e)
   CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
   if (!lock)
     VC_SCHED_LOCK_RETRY();
+  vol->open_dir.stop_waiting(this);
 #ifdef HIT_EVACUATE
   if (f.hit_evacuate && dir_valid(vol, &first_dir) && closed > 0) {
     if (f.single_fragment)
@@ -546,6 +562,7 @@ CacheVC::openReadReadDone(int event, Event * e)
     CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
     if (!lock)
       VC_SCHED_LOCK_RETRY();
+    vol->open_dir.stop_waiting(this);
     if (event == AIO_EVENT_DONE && !io.ok()) {
       dir_delete(&earliest_key, vol, &earliest_dir);
       goto Lerror;
@@ -587,8 +604,8 @@ CacheVC::openReadReadDone(int event, Event * e)
               this, first_key.word(1), (int)vio.ndone);
         goto Lerror;
       }
-      DDebug("cache_read_agg", "%p: key: %X ReadRead retrying: %d", this, first_key.word(1), (int)vio.ndone);
-      VC_SCHED_WRITER_RETRY(); // wait for writer
+      DDebug("cache_read_agg", "%p: key: %X ReadRead waiting: %d", this, first_key.word(1), (int)vio.ndone);
+      VC_WAIT_FOR_WRITER(vol->open_read(&first_key));
     }
     // fall through for truncated documents
   }
@@ -615,6 +632,8 @@ CacheVC::openReadMain(int event, Event * e)
   NOWARN_UNUSED(event);
 
   cancel_trigger();
+  if (stop_waiting_for_writer() < 0)
+    VC_SCHED_LOCK_RETRY();
   Doc *doc = (Doc *) buf->data();
   int64_t ntodo = vio.ntodo();
   int64_t bytes = doc->len - doc_pos;
@@ -753,9 +772,9 @@ Lread: {
               this, first_key.word(1), (int)vio.ndone);
         goto Lerror;
       }
-      DDebug("cache_read_agg", "%p: key: %X ReadMain retrying: %d", this, first_key.word(1), (int)vio.ndone);
+      DDebug("cache_read_agg", "%p: key: %X ReadMain waiting: %d", this, first_key.word(1), (int)vio.ndone);
       SET_HANDLER(&CacheVC::openReadMain);
-      VC_SCHED_WRITER_RETRY();
+      VC_WAIT_FOR_WRITER(vol->open_read(&first_key));
     }
     if (is_action_tag_set("cache"))
       ink_release_assert(false);
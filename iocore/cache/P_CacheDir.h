@@ -223,7 +223,7 @@ LINK_FORWARD_DECLARATION(CacheVC, opendir_link) // forward declaration
 struct OpenDirEntry
 {
   DLL<CacheVC, Link_CacheVC_opendir_link> writers;       // list of all the current writers
-  DLL<CacheVC, Link_CacheVC_opendir_link> readers;         // list of all the current readers - not used
+  DLL<CacheVC, Link_CacheVC_opendir_link> readers;         // readers waiting for the writers to make progress
   CacheHTTPInfoVector vector;   // Vector for the http document. Each writer
                                 // maintains a pointer to this vector and
                                 // writes it down to disk.
@@ -256,6 +256,8 @@ struct OpenDir: public Continuation
   int open_write(CacheVC *c, int allow_if_writers, int max_writers);
   int close_write(CacheVC *c);
   OpenDirEntry *open_read(INK_MD5 *key);
+  void wake_readers(OpenDirEntry *od);
+  void stop_waiting(CacheVC *c);
   int signal_readers(int event, Event *e);
 
   OpenDir();
@@ -58,8 +58,8 @@ struct EvacuationBlock;
 #endif
 
 #define AIO_SOFT_FAILURE                -100000
-// retry read from writer delay
-#define WRITER_RETRY_DELAY  HRTIME_MSECONDS(50)
+// fallback for a reader waiting on a writer (msec)
+#define WRITER_WAIT_TIMEOUT  500
 
 #define CACHE_READY(_x) (CacheProcessor::cache_ready & (1 << (_x)))
 
@@ -95,19 +95,15 @@ struct EvacuationBlock;
 #define CONT_SCHED_LOCK_RETRY(_c) \
   _c->mutex->thread_holding->schedule_in_local(_c, HRTIME_MSECONDS(cache_config_mutex_retry_delay))
 
-#define VC_SCHED_WRITER_RETRY() \
+// Park the reader on the OpenDirEntry of the writer, it is woken up when
+// the writer inserts a fragment or closes. The timeout is only a fallback.
+#define VC_WAIT_FOR_WRITER(_od) \
   do { \
-    ink_assert(!trigger); \
     writer_lock_retry++; \
-    ink_hrtime _t = WRITER_RETRY_DELAY; \
-    if (writer_lock_retry > 2) \
-      _t = WRITER_RETRY_DELAY * 2; \
-    else if (writer_lock_retry > 5) \
-      _t = WRITER_RETRY_DELAY * 10; \
-    else if (writer_lock_retry > 10) \
-      _t = WRITER_RETRY_DELAY * 100; \
-    trigger = mutex->thread_holding->schedule_in_local(this, _t); \
-    return EVENT_CONT; \
+    int _msec = WRITER_WAIT_TIMEOUT; \
+    if (cache_config_read_while_writer_max_wait > 0 && cache_config_read_while_writer_max_wait < _msec) \
+      _msec = cache_config_read_while_writer_max_wait; \
+    return (_od)->wait(this, _msec); \
   } while (0)
 
 
@@ -152,6 +148,8 @@ enum
   cache_three_plus_plus_fragment_document_count_stat,
   cache_read_busy_success_stat,
   cache_read_busy_failure_stat,
+  cache_read_busy_waits_stat,
+  cache_read_busy_timeouts_stat,
   cache_gc_bytes_evacuated_stat,
   cache_gc_frags_evacuated_stat,
   cache_write_bytes_stat,
@@ -217,6 +215,7 @@ extern int cache_config_agg_write_backlog;
 extern int cache_config_enable_checksum;
 extern int cache_config_alt_rewrite_max_size;
 extern int cache_config_read_while_writer;
+extern int cache_config_read_while_writer_max_wait;
 extern char cache_system_config_directory[PATH_NAME_MAX + 1];
 extern int cache_clustering_enabled;
 extern int cache_config_agg_write_backlog;
@@ -280,6 +279,7 @@ struct CacheVC: public CacheVConnection
   }
 
   bool writer_done();
+  int stop_waiting_for_writer();
   int calluser(int event);
   int callcont(int event);
   int die();
@@ -458,6 +458,7 @@ struct CacheVC: public CacheVConnection
   int header_to_write_len;
   void *header_to_write;
   short writer_lock_retry;
+  OpenDirEntry *wait_od;          // writer entry the reader is waiting on
 
   union
   {
@@ -475,7 +476,7 @@ struct CacheVC: public CacheVConnection
       unsigned int update:1;
       unsigned int remove:1;
       unsigned int remove_aborted_writers:1;
-      unsigned int open_read_timeout:1; // UNUSED
+      unsigned int open_read_timeout:1; // waiting for a writer, see OpenDirEntry::wait
       unsigned int data_done:1;
       unsigned int read_from_writer_called:1;
       unsigned int not_from_ram_cache:1;        // entire object was from ram cache
@@ -746,6 +747,28 @@ CacheVC::writer_done()
   return false;
 }
 
+// A reader that has waited longer than this for a writer to get going gives up.
+TS_INLINE bool
+writer_wait_expired(ink_hrtime start_time)
+{
+  return cache_config_read_while_writer_max_wait > 0 &&
+    ink_get_hrtime() - start_time > HRTIME_MSECONDS(cache_config_read_while_writer_max_wait);
+}
+
+// Take the reader off the list it was parked on, before it does anything
+// else. Returns -1 if the volume lock was missed.
+TS_INLINE int
+CacheVC::stop_waiting_for_writer()
+{
+  if (!f.open_read_timeout)
+    return 0;
+  CACHE_TRY_LOCK(lock, vol->mutex, mutex->thread_holding);
+  if (!lock)
+    return -1;
+  vol->open_dir.stop_waiting(this);
+  return 0;
+}
+
 TS_INLINE int
 Vol::close_write(CacheVC *cont)
 {
@@ -47,6 +47,8 @@ int dns_failover_period = DEFAULT_FAILOVER_PERIOD;
 int dns_failover_try_period = DEFAULT_FAILOVER_TRY_PERIOD;
 int dns_max_dns_in_flight = MAX_DNS_IN_FLIGHT;
 int dns_validate_qname = 0;
+int dns_edns_payload_size = 0;
+int dns_tcp_fallback = 1;
 unsigned int dns_handler_initialized = 0;
 int dns_ns_rr = 0;
 int dns_ns_rr_init_down = 1;
@@ -105,6 +107,8 @@ ink_get16(const uint8_t *src) {
 }
 
 void HostEnt::free() {
+  ats_free(tcp_buf);
+  tcp_buf = NULL;
   dnsBufAllocator.free(this);
 }
 
@@ -175,6 +179,8 @@ DNSProcessor::start(int) {
   REC_EstablishStaticConfigInt32(dns_failover_period, "proxy.config.dns.failover_period");
   REC_EstablishStaticConfigInt32(dns_max_dns_in_flight, "proxy.config.dns.max_dns_in_flight");
   REC_EstablishStaticConfigInt32(dns_validate_qname, "proxy.config.dns.validate_query_name");
+  REC_EstablishStaticConfigInt32(dns_edns_payload_size, "proxy.config.dns.edns.payload_size");
+  REC_EstablishStaticConfigInt32(dns_tcp_fallback, "proxy.config.dns.tcp_fallback");
   REC_EstablishStaticConfigInt32(dns_ns_rr, "proxy.config.dns.round_robin_nameservers");
   REC_ReadConfigStringAlloc(dns_ns_list, "proxy.config.dns.nameservers");
   REC_ReadConfigStringAlloc(dns_local_ipv4, "proxy.config.dns.local_ipv4");
@@ -351,6 +357,7 @@ DNSEntry::init(const char *x, int len, int qtype_arg, Continuation* acont,
 {
   qtype = qtype_arg;
   host_res_style = opt.host_res_style;
+  report_negative = opt.report_negative;
   if (is_addr_query(qtype)) {
       // adjust things based on family preference.
       if (HOST_RES_IPV4 == host_res_style ||
@@ -455,6 +462,107 @@ DNSHandler::open_con(sockaddr const* target, bool failed, int icon)
   }
 }
 
+/**
+  Open the TCP connection to a nameserver. It is used for the queries that
+  got a truncated response over UDP, and kept open for the next ones until
+  the nameserver closes it.
+
+*/
+bool
+DNSHandler::open_tcp_con(int icon)
+{
+  ProxyMutex *mutex = this->mutex;
+  PollDescriptor *pd = get_PollDescriptor(dnsProcessor.thread);
+  DNSConnection & c = tcp_con[icon];
+  ip_port_text_buffer ip_text;
+
+  if (!ats_is_ip(&con[icon].ip.sa))
+    return false;
+
+  Debug("dns", "open_tcp_con: opening connection %s", ats_ip_nptop(&con[icon].ip.sa, ip_text, sizeof ip_text));
+  if (c.connect(
+      &con[icon].ip.sa, DNSConnection::Options()
+        .setNonBlockingConnect(true)
+        .setNonBlockingIo(true)
+        .setUseTcp(true)
+        .setBindRandomPort(false)
+        .setLocalIpv6(&local_ipv6.sa)
+        .setLocalIpv4(&local_ipv4.sa)
+    ) < 0) {
+    Debug("dns", "opening TCP connection %s FAILED for %d", ip_text, icon);
+    return false;
+  }
+  // Write readiness tells when the connect is done and when queued queries can go out.
+  if (c.eio.start(pd, &c, EVENTIO_READ | EVENTIO_WRITE) < 0) {
+    Error("[iocore_dns] open_tcp_con: Failed to add %d server to epoll list\n", icon);
+    c.close();
+    return false;
+  }
+
+  c.num = icon;
+  c.tcp = true;
+  c.tcp_rlen = c.tcp_wlen = 0;
+  if (!c.tcp_rbuf) {
+    c.tcp_rbuf = (char *) ats_malloc(DNS_TCP_BUFFER_SIZE);
+    c.tcp_wbuf = (char *) ats_malloc(DNS_TCP_BUFFER_SIZE);
+  }
+  DNS_INCREMENT_DYN_STAT(dns_tcp_connections_stat);
+  return true;
+}
+
+void
+DNSHandler::close_tcp_con(int icon)
+{
+  DNSConnection & c = tcp_con[icon];
+
+  if (c.fd != NO_FD) {
+    Debug("dns", "closing TCP connection for %d", icon);
+    c.eio.stop();
+    c.close();
+  }
+  c.tcp_rlen = c.tcp_wlen = 0;
+}
+
+/** Queue a query on the TCP connection to a nameserver, opening it if needed. */
+bool
+DNSHandler::write_tcp(int icon, char const* query, int len)
+{
+  DNSConnection & c = tcp_con[icon];
+
+  if (c.fd == NO_FD && !open_tcp_con(icon))
+    return false;
+  if (c.tcp_wlen + 2 + len > DNS_TCP_BUFFER_SIZE)
+    return false;
+
+  c.tcp_wbuf[c.tcp_wlen++] = (len >> 8) & 0xFF;
+  c.tcp_wbuf[c.tcp_wlen++] = len & 0xFF;
+  memcpy(c.tcp_wbuf + c.tcp_wlen, query, len);
+  c.tcp_wlen += len;
+  flush_tcp(icon);
+  return c.fd != NO_FD;
+}
+
+/** Write what is queued on a TCP connection. Called again when the connection is ready for writing. */
+void
+DNSHandler::flush_tcp(int icon)
+{
+  DNSConnection & c = tcp_con[icon];
+
+  if (c.fd == NO_FD || !c.tcp_wlen)
+    return;
+
+  int s = socketManager.write(c.fd, c.tcp_wbuf, c.tcp_wlen);
+  if (s == -EAGAIN || s == -ENOTCONN || s == -EINPROGRESS)
+    return;
+  if (s < 0) {
+    Debug("dns", "TCP write failed for %d: %d", icon, s);
+    close_tcp_con(icon);
+    return;
+  }
+  memmove(c.tcp_wbuf, c.tcp_wbuf + s, c.tcp_wlen - s);
+  c.tcp_wlen -= s;
+}
+
 void
 DNSHandler::validate_ip() {
   if (!ip.isValid()) {
@@ -547,6 +655,26 @@ _ink_res_mkquery(ink_res_state res, char *qname, int qtype, char *buffer)
   return r;
 }
 
+/** Add an OPT record to a query, to advertise the UDP payload size we accept (RFC 6891). */
+static inline int
+_ink_res_add_edns(char *buffer, int len, int payload_size)
+{
+  unsigned char *p = (unsigned char *) buffer + len;
+
+  if (len + 11 > MAX_DNS_PACKET_LEN)
+    return len;
+  if (payload_size > MAX_DNS_PACKET_LEN)
+    payload_size = MAX_DNS_PACKET_LEN;
+
+  *p++ = 0;                     // root name
+  NS_PUT16(41, p);              // type OPT
+  NS_PUT16(payload_size, p);    // class is the payload size
+  NS_PUT32(0, p);               // extended rcode, version and flags
+  NS_PUT16(0, p);               // no options
+  reinterpret_cast<HEADER *>(buffer)->arcount = htons(1);
+  return len + 11;
+}
+
 void
 DNSHandler::recover()
 {
@@ -735,6 +863,12 @@ DNSHandler::recv_dns(int event, Event *e)
   ip_text_buffer ipbuff1, ipbuff2;
 
   while ((dnsc = (DNSConnection *) triggered.dequeue())) {
+    if (dnsc->tcp) {
+      flush_tcp(dnsc->num);
+      if (dnsc->fd != NO_FD)
+        recv_tcp(dnsc);
+      continue;
+    }
     while (1) {
       IpEndpoint from_ip;
       socklen_t from_length = sizeof(from_ip);
@@ -798,6 +932,52 @@ DNSHandler::recv_dns(int event, Event *e)
   }
 }
 
+/** Read the responses on a TCP connection, each one prefixed with its length (RFC 1035 4.2.2). */
+void
+DNSHandler::recv_tcp(DNSConnection *dnsc)
+{
+  while (1) {
+    int res = socketManager.read(dnsc->fd, dnsc->tcp_rbuf + dnsc->tcp_rlen, DNS_TCP_BUFFER_SIZE - dnsc->tcp_rlen);
+
+    if (res == -EAGAIN)
+      break;
+    if (res <= 0) {
+      Debug("dns", "TCP connection %d closed: %d", dnsc->num, res);
+      close_tcp_con(dnsc->num);
+      break;
+    }
+    dnsc->tcp_rlen += res;
+
+    int off = 0;
+    while (dnsc->tcp_rlen - off >= 2) {
+      int mlen = ink_get16((uint8_t *) dnsc->tcp_rbuf + off);
+      if (dnsc->tcp_rlen - off - 2 < mlen)
+        break;
+      if (mlen >= HFIXEDSZ) {
+        if (!hostent_cache)
+          hostent_cache = dnsBufAllocator.alloc();
+        HostEnt *buf = hostent_cache;
+        hostent_cache = 0;
+
+        // The length prefix allows up to 64KB, more than fits in the buffer used over UDP.
+        if (mlen > MAX_DNS_PACKET_LEN)
+          buf->tcp_buf = (char *) ats_malloc(mlen);
+        memcpy(buf->packet(), dnsc->tcp_rbuf + off + 2, mlen);
+        buf->packet_size = mlen;
+        Debug("dns", "received TCP packet size = %d", mlen);
+        Ptr<HostEnt> protect_hostent = make_ptr(buf);
+        if (dns_process(this, buf, mlen)) {
+          if (dnsc->num == name_server)
+            received_one(name_server);
+        }
+      }
+      off += 2 + mlen;
+    }
+    memmove(dnsc->tcp_rbuf, dnsc->tcp_rbuf + off, dnsc->tcp_rlen - off);
+    dnsc->tcp_rlen -= off;
+  }
+}
+
 /** Main event for the DNSHandler. Attempt to read from and write to named. */
 int
 DNSHandler::mainEvent(int event, Event *e)
@@ -840,6 +1020,11 @@ DNSHandler::mainEvent(int event, Event *e)
       try_primary_named(true);
   }
 
+  for (int i = 0; i < MAX_NAMED; i++) {
+    if (tcp_con[i].tcp_wlen)
+      flush_tcp(i);
+  }
+
   if (entries.head)
     write_dns(this);
 
@@ -971,6 +1156,8 @@ write_dns_event(DNSHandler *h, DNSEntry *e)
     dns_result(h, e, NULL, false);
     return true;
   }
+  if (dns_edns_payload_size > 0 && !e->use_tcp && !e->no_edns)
+    r = _ink_res_add_edns(blob._b, r, dns_edns_payload_size);
 
   uint16_t i = h->get_query_id();
   blob._h.id = htons(i);
@@ -981,7 +1168,12 @@ write_dns_event(DNSHandler *h, DNSEntry *e)
   e->id[dns_retries - e->retries] = i;
   Debug("dns", "send query (qtype=%d) for %s to fd %d", e->qtype, e->qname, h->con[h->name_server].fd);
 
-  int s = socketManager.send(h->con[h->name_server].fd, blob._b, r, 0);
+  // If the TCP connection can't be opened, the truncated response over UDP will do.
+  int s;
+  if (e->use_tcp && h->write_tcp(h->name_server, blob._b, r))
+    s = r;
+  else
+    s = socketManager.send(h->con[h->name_server].fd, blob._b, r, 0);
   if (s != r) {
     Debug("dns", "send() failed: qname = %s, %d != %d, nameserver= %d", e->qname, s, r, h->name_server);
     // changed if condition from 'r < 0' to 's < 0' - 8/2001 pas
@@ -1112,7 +1304,7 @@ dns_result(DNSHandler *h, DNSEntry *e, HostEnt *ent, bool retry) {
   ProxyMutex *mutex = h->mutex;
   bool cancelled = (e->action.cancelled ? true : false);
 
-  if (!ent && !cancelled) {
+  if ((!ent || (ent != BAD_DNS_RESULT && ent->negative)) && !cancelled) {
     // try to retry operation
     if (retry && e->retries) {
       Debug("dns", "doing retry for %s", e->qname);
@@ -1172,7 +1364,7 @@ dns_result(DNSHandler *h, DNSEntry *e, HostEnt *ent, bool retry) {
   if (ent == BAD_DNS_RESULT)
     ent = NULL;
   if (!cancelled) {
-    if (!ent) {
+    if (!ent || ent->negative) {
       DNS_SUM_DYN_STAT(dns_fail_time_stat, ink_get_hrtime() - e->submit_time);
     } else {
       DNS_SUM_DYN_STAT(dns_success_time_stat, ink_get_hrtime() - e->submit_time);
@@ -1185,13 +1377,17 @@ dns_result(DNSHandler *h, DNSEntry *e, HostEnt *ent, bool retry) {
       ip_text_buffer buff;
       char const* ptr = "<none>";
       char const* result = "FAIL";
-      if (ent) {
+      if (ent && ent->negative) {
+        result = "NEGATIVE";
+      } else if (ent) {
         result = "SUCCESS";
         ptr = inet_ntop(e->qtype == T_AAAA ? AF_INET6 : AF_INET, ent->ent.h_addr_list[0], buff, sizeof(buff));
       }
       Debug("dns", "%s result for %s = %s retry %d", result, e->qname, ptr, retry);
     } else {
-      if (ent) {
+      if (ent && ent->negative) {
+        Debug("dns", "NEGATIVE result for %s ttl %u retry %d", e->qname, ent->ttl, retry);
+      } else if (ent) {
         Debug("dns", "SUCCESS result for %s = %s af=%d retry %d", e->qname, ent->ent.h_name, ent->ent.h_addrtype, retry);
       } else {
         Debug("dns", "FAIL result for %s = <not found> retry %d", e->qname, retry);
@@ -1199,7 +1395,7 @@ dns_result(DNSHandler *h, DNSEntry *e, HostEnt *ent, bool retry) {
     }
   }
 
-  if (ent) {
+  if (ent && !ent->negative) {
     DNS_INCREMENT_DYN_STAT(dns_lookup_success_stat);
   } else {
     DNS_INCREMENT_DYN_STAT(dns_lookup_fail_stat);
@@ -1279,8 +1475,12 @@ DNSEntry::postEvent(int event, Event *e)
   NOWARN_UNUSED(event);
   NOWARN_UNUSED(e);
   if (!action.cancelled) {
+    HostEnt *ent = result_ent;
+    // A duplicate of the query may not want the negative answer.
+    if (ent && ent->negative && !report_negative)
+      ent = NULL;
     Debug("dns", "called back continuation for %s", qname);
-    action.continuation->handleEvent(DNS_EVENT_LOOKUP, result_ent);
+    action.continuation->handleEvent(DNS_EVENT_LOOKUP, ent);
   }
   result_ent = NULL;
   action.mutex = NULL;
@@ -1289,15 +1489,82 @@ DNSEntry::postEvent(int event, Event *e)
   return EVENT_DONE;
 }
 
+/**
+  Fill @a buf as the answer that the name or the record does not exist.
+  The TTL is the one of the SOA record in the authority section, or its
+  minimum field if that is lower (RFC 2308 section 5), and 0 if there is
+  no SOA record. The owner of the SOA record, the zone the name would be
+  in, is put in @c h_name.
+
+*/
+static bool
+dns_negative_answer(HostEnt *buf, HEADER *h, int len)
+{
+  u_char *cp = ((u_char *) h) + HFIXEDSZ;
+  u_char *eom = (u_char *) h + len;
+  int qdcount = ntohs(h->qdcount);
+  int ancount = ntohs(h->ancount);
+  int nscount = ntohs(h->nscount);
+  int n;
+
+  buf->negative = true;
+  buf->ttl = 0;
+  buf->ent.h_name = NULL;
+  buf->ent.h_addrtype = AF_UNSPEC;
+  buf->h_addr_ptrs[0] = NULL;
+  buf->ent.h_addr_list = (char **) buf->h_addr_ptrs;
+
+  while (qdcount-- > 0) {
+    if ((n = dn_skipname(cp, eom)) < 0 || cp + n + QFIXEDSZ > eom)
+      return true;
+    cp += n + QFIXEDSZ;
+  }
+  // skip the CNAME chain that led to the missing name
+  for (int i = 0; i < ancount + nscount; i++) {
+    uint16_t type, rdlen;
+    uint32_t ttl;
+    u_char *owner = cp;
+
+    if ((n = dn_skipname(cp, eom)) < 0 || cp + n + RRFIXEDSZ > eom)
+      return true;
+    cp += n;
+    NS_GET16(type, cp);
+    cp += NS_INT16SZ;
+    NS_GET32(ttl, cp);
+    NS_GET16(rdlen, cp);
+    if (cp + rdlen > eom)
+      return true;
+    if (T_SOA == type && i >= ancount) {
+      u_char *rp = cp;
+      uint32_t minimum;
+
+      if ((n = dn_skipname(rp, eom)) < 0)
+        return true;
+      rp += n;
+      if ((n = dn_skipname(rp, eom)) < 0 || rp + n + 5 * NS_INT32SZ > eom)
+        return true;
+      rp += n + 4 * NS_INT32SZ;
+      NS_GET32(minimum, rp);
+      buf->ttl = ttl < minimum ? ttl : minimum;
+      if (ink_dn_expand((u_char *) h, eom, owner, buf->hostbuf, sizeof(buf->hostbuf)) >= 0)
+        buf->ent.h_name = (char *) buf->hostbuf;
+      return true;
+    }
+    cp += rdlen;
+  }
+  return true;
+}
+
 /** Decode the reply from "named". */
 static bool
 dns_process(DNSHandler *handler, HostEnt *buf, int len)
 {
   ProxyMutex *mutex = handler->mutex;
-  HEADER *h = (HEADER *) (buf->buf);
+  HEADER *h = (HEADER *) (buf->packet());
   DNSEntry *e = get_dns(handler, (uint16_t) ntohs(h->id));
   bool retry = false;
   bool server_ok = true;
+  bool negative = false;
   uint32_t temp_ttl = 0;
 
   //
@@ -1316,6 +1583,27 @@ dns_process(DNSHandler *handler, HostEnt *buf, int len)
 
   DNS_SUM_DYN_STAT(dns_response_time_stat, ink_get_hrtime() - e->send_time);
 
+  // Ask again over TCP if the response did not fit in a datagram.
+  if (h->tc) {
+    DNS_INCREMENT_DYN_STAT(dns_truncated_responses_stat);
+    if (dns_tcp_fallback && !e->use_tcp) {
+      Debug("dns", "truncated response for %s, retrying over TCP", e->qname);
+      DNS_INCREMENT_DYN_STAT(dns_tcp_fallbacks_stat);
+      e->use_tcp = true;
+      write_dns(handler);
+      return true;
+    }
+  }
+
+  // Nameservers that don't know EDNS may reject the OPT record, ask them once more without it.
+  if (h->rcode == FORMERR && dns_edns_payload_size > 0 && !e->use_tcp && !e->no_edns) {
+    Debug("dns", "FORMERR for %s, retrying without EDNS", e->qname);
+    DNS_INCREMENT_DYN_STAT(dns_edns_fallbacks_stat);
+    e->no_edns = true;
+    write_dns(handler);
+    return true;
+  }
+
   if (h->rcode != NOERROR || !h->ancount) {
     Debug("dns", "received rcode = %d", h->rcode);
     switch (h->rcode) {
@@ -1332,8 +1620,12 @@ dns_process(DNSHandler *handler, HostEnt *buf, int len)
       Debug("dns", "DNS error %d for [%s]", h->rcode, e->qname);
       server_ok = false;        // could be server problems
       goto Lerror;
-    case NOERROR:
+    case NOERROR:              // no records of this type
     case NXDOMAIN:
+      if (e->report_negative)
+        negative = dns_negative_answer(buf, h, len);
+      Debug("dns", "DNS error %d for [%s]", h->rcode, e->qname);
+      goto Lerror;
     case 6:                    // YXDOMAIN
     case 7:                    // YXRRSET
     case 8:                    // NOTAUTH
@@ -1437,7 +1729,7 @@ dns_process(DNSHandler *handler, HostEnt *buf, int len)
     /* added for SRV support [ebalsa]
        this skips the query section (qdcount)
      */
-    unsigned char *here = (unsigned char *) buf->buf + HFIXEDSZ;
+    unsigned char *here = (unsigned char *) buf->packet() + HFIXEDSZ;
     if (e->qtype == T_SRV) {
       for (int ctr = ntohs(h->qdcount); ctr > 0; ctr--) {
         int strlen = dn_skipname(here, eom);
@@ -1607,7 +1899,7 @@ dns_process(DNSHandler *handler, HostEnt *buf, int len)
   }
 Lerror:;
   DNS_INCREMENT_DYN_STAT(dns_lookup_fail_stat);
-  dns_result(handler, e, NULL, retry);
+  dns_result(handler, e, negative ? buf : NULL, retry);
   return server_ok;
 }
 
@@ -1668,6 +1960,22 @@ ink_dns_init(ModuleVersion v)
                      "proxy.process.dns.in_flight",
                      RECD_INT, RECP_NON_PERSISTENT, (int) dns_in_flight_stat, RecRawStatSyncSum);
 
+  RecRegisterRawStat(dns_rsb, RECT_PROCESS,
+                     "proxy.process.dns.truncated_responses",
+                     RECD_INT, RECP_NULL, (int) dns_truncated_responses_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(dns_rsb, RECT_PROCESS,
+                     "proxy.process.dns.tcp_fallbacks",
+                     RECD_INT, RECP_NULL, (int) dns_tcp_fallbacks_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(dns_rsb, RECT_PROCESS,
+                     "proxy.process.dns.tcp_connections",
+                     RECD_INT, RECP_NULL, (int) dns_tcp_connections_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(dns_rsb, RECT_PROCESS,
+                     "proxy.process.dns.edns_fallbacks",
+                     RECD_INT, RECP_NULL, (int) dns_edns_fallbacks_stat, RecRawStatSyncSum);
+
 }
 
 
@@ -48,7 +48,8 @@ DNSConnection::Options const DNSConnection::DEFAULT_OPTIONS;
 //
 
 DNSConnection::DNSConnection():
-  fd(NO_FD), num(0), generator((uint32_t)((uintptr_t)time(NULL) ^ (uintptr_t) this)), handler(NULL)
+  fd(NO_FD), num(0), generator((uint32_t)((uintptr_t)time(NULL) ^ (uintptr_t) this)), handler(NULL),
+  tcp(false), tcp_rbuf(NULL), tcp_rlen(0), tcp_wbuf(NULL), tcp_wlen(0)
 {
   memset(&ip, 0, sizeof(ip));
 }
@@ -56,6 +57,8 @@ DNSConnection::DNSConnection():
 DNSConnection::~DNSConnection()
 {
   close();
+  ats_free(tcp_rbuf);
+  ats_free(tcp_wbuf);
 }
 
 int
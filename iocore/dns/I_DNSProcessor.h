@@ -43,14 +43,19 @@
 struct HostEnt : RefCountObj {
   struct hostent ent;
   uint32_t ttl;
+  bool negative; ///< The name or the record does not exist, @a ttl and @c ent.h_name (the zone) are from the SOA.
   int packet_size;
   char buf[MAX_DNS_PACKET_LEN];
+  char *tcp_buf; ///< The answer instead of @a buf, if it came over TCP and is larger.
   u_char *host_aliases[DNS_MAX_ALIASES];
   u_char *h_addr_ptrs[DNS_MAX_ADDRS + 1];
   u_char hostbuf[DNS_HOSTBUF_SIZE];
 
   SRVHosts srv_hosts;
 
+  /// The answer as it was received.
+  char *packet() { return tcp_buf ? tcp_buf : buf; }
+
   virtual void free();
 
   HostEnt() { 
@@ -81,6 +86,10 @@ struct DNSProcessor: public Processor
     /// Host resolution style.
     /// Default: IPv4, IPv6 ( @c HOST_RES_IPV4 )
     HostResStyle host_res_style;
+    /// Return the answers that say a name does not exist as a
+    /// @c HostEnt with @a negative set, instead of @c NULL.
+    /// Default: @c false
+    bool report_negative;
 
     /// Default constructor.
     Options();
@@ -97,6 +106,10 @@ struct DNSProcessor: public Processor
     /// @return This object.
     self& setHostResStyle(HostResStyle style);
 
+    /// Set @a report_negative option.
+    /// @return This object.
+    self& setReportNegative(bool flag);
+
     /// Reset to default constructed values.
     /// @return This object.
     self& reset();
@@ -105,6 +118,7 @@ struct DNSProcessor: public Processor
   // DNS lookup
   //   calls: cont->handleEvent( DNS_EVENT_LOOKUP, HostEnt *ent) on success
   //          cont->handleEvent( DNS_EVENT_LOOKUP, NULL) on failure
+  //          (or a HostEnt with negative set, see Options::report_negative)
   // NOTE: the HostEnt *block is freed when the function returns
   //
 
@@ -184,6 +198,7 @@ inline DNSProcessor::Options::Options()
                     : handler(0)
                     , timeout(0)
                     , host_res_style(HOST_RES_IPV4)
+                    , report_negative(false)
 {
 }
 
@@ -208,6 +223,13 @@ DNSProcessor::Options::setHostResStyle(HostResStyle style)
   return *this;
 }
 
+inline DNSProcessor::Options&
+DNSProcessor::Options::setReportNegative(bool flag)
+{
+  report_negative = flag;
+  return *this;
+}
+
 inline DNSProcessor::Options&
 DNSProcessor::Options::reset()
 {
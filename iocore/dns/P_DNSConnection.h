@@ -99,6 +99,14 @@ struct DNSConnection {
   InkRand generator;
   DNSHandler* handler;
 
+  /// TCP connections keep the partial messages in each direction, each
+  /// message prefixed with its length.
+  bool tcp;
+  char *tcp_rbuf;
+  int tcp_rlen;
+  char *tcp_wbuf;
+  int tcp_wlen;
+
   int connect(sockaddr const* addr, Options const& opt = DEFAULT_OPTIONS);
 /*
               bool non_blocking_connect = NON_BLOCKING_CONNECT,
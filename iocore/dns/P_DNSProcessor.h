@@ -57,6 +57,8 @@ extern int dns_failover_number;
 extern int dns_failover_period;
 extern int dns_failover_try_period;
 extern int dns_max_dns_in_flight;
+extern int dns_edns_payload_size;
+extern int dns_tcp_fallback;
 extern unsigned int dns_sequence_number;
 
 //
@@ -70,6 +72,8 @@ extern unsigned int dns_sequence_number;
 #define DNS_PRIMARY_REOPEN_PERIOD           HRTIME_SECONDS(60)
 #define BAD_DNS_RESULT                      ((HostEnt*)(uintptr_t)-1)
 #define DEFAULT_NUM_TRY_SERVER              8
+// a message on a TCP connection is at most 64k, plus its length
+#define DNS_TCP_BUFFER_SIZE                 (65535 + 2)
 
 // these are from nameser.h
 #ifndef HFIXEDSZ
@@ -102,6 +106,10 @@ enum DNS_Stats
   dns_max_retries_exceeded_stat,
   dns_sequence_number_stat,
   dns_in_flight_stat,
+  dns_truncated_responses_stat,
+  dns_tcp_fallbacks_stat,
+  dns_tcp_connections_stat,
+  dns_edns_fallbacks_stat,
   DNS_Stat_Count
 };
 
@@ -165,6 +173,9 @@ struct DNSEntry: public Continuation
   bool written_flag;
   bool once_written_flag;
   bool last;
+  bool use_tcp; ///< Query again over TCP after a truncated response.
+  bool no_edns; ///< Query again without the OPT record after a FORMERR.
+  bool report_negative; ///< Pass negative answers on, see DNSProcessor::Options.
   LINK(DNSEntry, dup_link);
   Que(DNSEntry, dup_link) dups;
 
@@ -180,7 +191,8 @@ struct DNSEntry: public Continuation
        host_res_style(HOST_RES_NONE),
        retries(DEFAULT_DNS_RETRIES),
        which_ns(NO_NAMESERVER_SELECTED), submit_time(0), send_time(0), qname_len(0), domains(0),
-       timeout(0), result_ent(0), dnsH(0), written_flag(false), once_written_flag(false), last(false)
+       timeout(0), result_ent(0), dnsH(0), written_flag(false), once_written_flag(false), last(false), use_tcp(false),
+       no_edns(false), report_negative(false)
   {
     for (int i = 0; i < MAX_DNS_RETRIES; i++)
       id[i] = -1;
@@ -207,6 +219,7 @@ struct DNSHandler: public Continuation
   int ifd[MAX_NAMED];
   int n_con;
   DNSConnection con[MAX_NAMED];
+  DNSConnection tcp_con[MAX_NAMED]; ///< Opened on the first truncated response from each nameserver.
   int options;
   Queue<DNSEntry> entries;
   Queue<DNSConnection> triggered;
@@ -260,11 +273,16 @@ struct DNSHandler: public Continuation
   }
 
   void recv_dns(int event, Event *e);
+  void recv_tcp(DNSConnection *dnsc);
   int startEvent(int event, Event *e);
   int startEvent_sdns(int event, Event *e);
   int mainEvent(int event, Event *e);
 
   void open_con(sockaddr const* addr, bool failed = false, int icon = 0);
+  bool open_tcp_con(int icon);
+  void close_tcp_con(int icon);
+  bool write_tcp(int icon, char const* query, int len);
+  void flush_tcp(int icon);
   void failover();
   void rr_failure(int ndx);
   void recover();
@@ -306,6 +324,7 @@ TS_INLINE DNSHandler::DNSHandler()
     crossed_failover_number[i] = 0;
     ns_down[i] = 1;
     con[i].handler = this;
+    tcp_con[i].handler = this;
   }
   memset(&qid_in_flight, 0, sizeof(qid_in_flight));  
   SET_HANDLER(&DNSHandler::startEvent);
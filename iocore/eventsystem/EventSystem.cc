@@ -43,5 +43,14 @@ ink_event_system_init(ModuleVersion v)
     default_small_iobuffer_size = max_iobuffer_size;
   if (default_large_iobuffer_size > max_iobuffer_size)
     default_large_iobuffer_size = max_iobuffer_size;
+
+  int config_max_tunnel_iobuffer_size = 0;
+  REC_ReadConfigInteger(config_max_tunnel_iobuffer_size, "proxy.config.io.max_tunnel_buffer_size");
+  max_tunnel_iobuffer_size = max_iobuffer_size;
+  if (config_max_tunnel_iobuffer_size > 0)
+    max_tunnel_iobuffer_size = buffer_size_to_index(config_max_tunnel_iobuffer_size, DEFAULT_BUFFER_SIZES - 1);
+  if (max_tunnel_iobuffer_size < max_iobuffer_size)
+    max_tunnel_iobuffer_size = max_iobuffer_size;
+  REC_ReadConfigInteger(iobuffer_usage_histograms, "proxy.config.io.buffer_usage_histograms");
   init_buffer_allocators();
 }
@@ -37,6 +37,8 @@ inkcoreapi ClassAllocator<IOBufferBlock> ioBlockAllocator("ioBlockAllocator", DE
 int64_t default_large_iobuffer_size = DEFAULT_LARGE_BUFFER_SIZE;
 int64_t default_small_iobuffer_size = DEFAULT_SMALL_BUFFER_SIZE;
 int64_t max_iobuffer_size = DEFAULT_BUFFER_SIZES - 1;
+int64_t max_tunnel_iobuffer_size = DEFAULT_BUFFER_SIZES - 1;
+int iobuffer_usage_histograms = 0;
 
 //
 // Initialization
@@ -52,6 +54,9 @@ init_buffer_allocators()
     int n = i <= default_large_iobuffer_size ? DEFAULT_BUFFER_NUMBER : DEFAULT_HUGE_BUFFER_NUMBER;
     if (s < a)
       a = s;
+    // keep the chunks of the 64K - 2M size classes reasonable
+    if (s * n > DEFAULT_MAX_BUFFER_CHUNK)
+      n = s < DEFAULT_MAX_BUFFER_CHUNK ? DEFAULT_MAX_BUFFER_CHUNK / s : 1;
 
     name = NEW(new char[64]);
     snprintf(name, 64, "ioBufAllocator[%d]", i);
@@ -59,6 +64,86 @@ init_buffer_allocators()
   }
 }
 
+//
+// Buffer usage histograms
+//
+#define IOBUFFER_USAGE_SITES 256
+
+struct IOBufferUsage
+{
+  const char *location;
+  // blocks[i][j]: blocks of size index i released holding no more than BUFFER_SIZE_FOR_INDEX(j) bytes
+  volatile int64_t blocks[DEFAULT_BUFFER_SIZES][DEFAULT_BUFFER_SIZES];
+  volatile int64_t used_bytes[DEFAULT_BUFFER_SIZES];
+};
+
+static IOBufferUsage *volatile iobuffer_usage[IOBUFFER_USAGE_SITES];
+static IOBufferUsage iobuffer_usage_overflow = { "memory/IOBuffer/OTHER-LOCATIONS", {{0}}, {0} };
+
+static IOBufferUsage *
+iobuffer_usage_site(const char *location)
+{
+  // locations are RES_PATH string literals, so the pointer identifies the site
+  unsigned h = (unsigned) (((uintptr_t) location) >> 3);
+
+  for (int i = 0; i < IOBUFFER_USAGE_SITES; i++) {
+    IOBufferUsage *volatile *slot = &iobuffer_usage[(h + i) % IOBUFFER_USAGE_SITES];
+    IOBufferUsage *u = *slot;
+    if (!u) {
+      IOBufferUsage *n = (IOBufferUsage *)ats_malloc(sizeof(IOBufferUsage));
+      memset(n, 0, sizeof(IOBufferUsage));
+      n->location = location;
+      if (ink_atomic_cas((void *volatile *) slot, (void *) NULL, (void *) n))
+        return n;
+      ats_free(n);
+      u = *slot;
+    }
+    if (u->location == location)
+      return u;
+  }
+  return &iobuffer_usage_overflow;
+}
+
+void
+iobuffer_usage_record(const char *location, int64_t size_index, int64_t used)
+{
+  if (!BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(size_index))
+    return;
+  if (!location)
+    location = "memory/IOBuffer/UNKNOWN-LOCATION";
+
+  IOBufferUsage *u = iobuffer_usage_site(location);
+  ink_atomic_increment(&u->blocks[size_index][buffer_size_to_index(used, size_index)], (int64_t) 1);
+  ink_atomic_increment(&u->used_bytes[size_index], used);
+}
+
+void
+iobuffer_usage_dump(FILE * fp)
+{
+  if (fp == NULL)
+    fp = stderr;
+
+  fprintf(fp, " block size |   blocks   | avg used | blocks holding <= 128, 256, 512, ... bytes | location\n");
+  fprintf(fp, "------------|------------|----------|---------------------------------------------|----------------------------------\n");
+  for (int s = 0; s <= IOBUFFER_USAGE_SITES; s++) {
+    IOBufferUsage *u = s < IOBUFFER_USAGE_SITES ? iobuffer_usage[s] : &iobuffer_usage_overflow;
+    if (!u)
+      continue;
+    for (int i = 0; i < DEFAULT_BUFFER_SIZES; i++) {
+      int64_t n = 0;
+      for (int j = 0; j <= i; j++)
+        n += u->blocks[i][j];
+      if (!n)
+        continue;
+      fprintf(fp, " %10" PRId64 " | %10" PRId64 " | %7" PRId64 "%% |", (int64_t) BUFFER_SIZE_FOR_INDEX(i), n,
+              u->used_bytes[i] * 100 / (n * BUFFER_SIZE_FOR_INDEX(i)));
+      for (int j = 0; j <= i; j++)
+        fprintf(fp, " %" PRId64, u->blocks[i][j]);
+      fprintf(fp, " | %s\n", u->location);
+    }
+  }
+}
+
 int64_t
 MIOBuffer::remove_append(IOBufferReader * r)
 {
@@ -42,6 +42,9 @@
 /** Maximum number of accept events per thread. */
 #define MAX_ACCEPT_EVENTS 20
 
+/** Maximum number of shared events an idle thread runs per loop. */
+#define MAX_STOLEN_EVENTS 8
+
 struct DiskHandler;
 struct EventIO;
 
@@ -315,6 +318,8 @@ public:
   int main_accept_index;
 
   int id;
+  /** NUMA node the thread is bound to through its cpu affinity, -1 if none. */
+  int numa_node;
   unsigned int event_types;
   bool is_event_type(EventType et);
   void set_event_type(EventType et);
@@ -325,6 +330,7 @@ public:
 
   void execute();
   void process_event(Event *e, int calling_code);
+  int steal_events(int max_events);
   void free_event(Event *e);
   void (*signal_hook)(EThread *);
 
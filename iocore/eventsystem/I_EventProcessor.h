@@ -151,6 +151,34 @@ public:
   */
   Event *schedule_imm_signal(Continuation * c,
                       EventType event_type = ET_CALL, int callback_event = EVENT_IMMEDIATE, void *cookie = NULL);
+  /**
+    Schedules a CPU bound continuation on a thread group to receive an
+    event as soon as possible. Unlike schedule_imm, the event is not
+    pinned to a thread: it is placed on a queue shared by the group,
+    a sleeping thread of the group is woken up and whichever thread
+    gets to it first runs it.
+
+    Only the groups marked stealable, which do no NetVConnection I/O
+    (ET_TASK when proxy.config.exec_thread.work_stealing is set), use
+    the shared queue, and only for continuations with a mutex of their
+    own. The continuation must not share its mutex with a state
+    machine or do any I/O on a NetVConnection. In every other case
+    this is the same as schedule_imm. Transforms are not scheduled
+    this way, they share their VIOs with the state machine.
+
+    @param c Continuation to be called back as soon as possible.
+    @param event_type thread group id (or event type) specifying the
+      group of threads that may run the callback.
+    @param callback_event code to be passed back to the continuation's
+      handler. See the Remarks section.
+    @param cookie user-defined value or pointer to be passed back in
+      the Event's object cookie field.
+    @return reference to an Event object representing the scheduling
+      of this callback.
+
+  */
+  Event *schedule_imm_stealable(Continuation * c,
+                      EventType event_type = ET_CALL, int callback_event = EVENT_IMMEDIATE, void *cookie = NULL);
   /**
     Schedules the continuation on a specific thread group to receive an
     event at the given timeout. Requests the EventProcessor to schedule
@@ -300,6 +328,34 @@ public:
   */
   int n_thread_groups;
 
+  /**
+    Events scheduled with schedule_imm_stealable, organized by thread
+    group. Any thread of the group may dequeue and run them.
+
+  */
+  InkAtomicList steal_queue[MAX_EVENT_TYPES];
+
+  /** Set from proxy.config.exec_thread.work_stealing. */
+  bool work_stealing;
+
+  /** The thread groups schedule_imm_stealable shares events in. */
+  bool stealable[MAX_EVENT_TYPES];
+
+  void wake_stealer(EventType et);
+
+  /**
+    Set from proxy.config.exec_thread.numa_memory. ET_NET threads bound
+    to a NUMA node by proxy.config.exec_thread.affinity allocate their
+    memory, including freelist chunks, from that node.
+
+  */
+  bool numa_memory;
+
+  /** The ET_NET threads on each NUMA node, see assign_thread_on_node. */
+  EThread **threads_on_node[INK_MAX_NUMA_NODES];
+  int n_threads_on_node[INK_MAX_NUMA_NODES];
+  unsigned int next_thread_for_node[INK_MAX_NUMA_NODES];
+
 private:
   // prevent unauthorized copies (Not implemented)
     EventProcessor(const EventProcessor &);
@@ -313,6 +369,7 @@ public:
 
   Event * schedule(Event * e, EventType etype, bool fast_signal = false);
   EThread *assign_thread(EventType etype);
+  EThread *assign_thread_on_node(int node);
 
   EThread *dthreads[MAX_EVENT_THREADS];
   int n_dthreads;               // No. of dedicated threads
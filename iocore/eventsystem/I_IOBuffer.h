@@ -51,8 +51,10 @@ class VIO;
 //#define WRITE_AND_TRANSFER
 
 inkcoreapi extern int64_t max_iobuffer_size;
+inkcoreapi extern int64_t max_tunnel_iobuffer_size; // for tunnels of objects of known size
 extern int64_t default_small_iobuffer_size;
 extern int64_t default_large_iobuffer_size; // matched to size of OS buffers
+inkcoreapi extern int iobuffer_usage_histograms;
 
 #if !defined(TRACK_BUFFER_USER)
 #define TRACK_BUFFER_USER 1
@@ -69,6 +71,7 @@ enum AllocType
 #define DEFAULT_BUFFER_NUMBER        128
 #endif
 #define DEFAULT_HUGE_BUFFER_NUMBER   32
+#define DEFAULT_MAX_BUFFER_CHUNK     (2 * 1024 * 1024)
 #define MAX_MIOBUFFER_READERS        5
 #define DEFAULT_BUFFER_ALIGNMENT     8192       // should be disk/page size
 #define DEFAULT_BUFFER_BASE_SIZE     128
@@ -79,6 +82,7 @@ enum AllocType
 #else
 #define DEFAULT_HUGE_BUFFER_NUMBER   32
 #endif
+#define DEFAULT_MAX_BUFFER_CHUNK     (2 * 1024 * 1024)
 #define MAX_MIOBUFFER_READERS        3
 #define DEFAULT_BUFFER_BASE_SIZE     128
 #define DEFAULT_BUFFER_ALIGNMENT     8  // should be disk/page size
@@ -138,6 +142,16 @@ inkcoreapi extern Allocator ioBufAllocator[DEFAULT_BUFFER_SIZES];
 
 void init_buffer_allocators();
 
+/**
+  Per use site histograms of how much of each IOBuffer block was
+  actually filled by the time it is released, i.e. the internal
+  fragmentation of the size class picked for it. Only collected
+  when iobuffer_usage_histograms is set.
+
+*/
+void iobuffer_usage_record(const char *location, int64_t size_index, int64_t used);
+void iobuffer_usage_dump(FILE * fp);
+
 /**
   A reference counted wrapper around fast allocated or malloced memory.
   The IOBufferData class provides two basic services around a portion
@@ -45,9 +45,10 @@ struct ProtectedQueue
   void enqueue_local(Event * e);        // Safe when called from the same thread
   void remove(Event * e);
   Event *dequeue_local();
-  void dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool sleep);
+  void dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool sleep, InkAtomicList **shared = NULL, int n_shared = 0);
 
   InkAtomicList al;
+  volatile int sleeping;        // waiting in dequeue_timed()
   ink_mutex lock;
   ink_cond might_have_data;
   Que(Event, link) localQueue;
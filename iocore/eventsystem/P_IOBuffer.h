@@ -46,6 +46,16 @@ buffer_size_to_index(int64_t size, int64_t max = max_iobuffer_size)
   return r;
 }
 
+// Tunnels moving an object of known size may use the size classes up to
+// max_tunnel_iobuffer_size, so that e.g. a 1M object fills a single block.
+TS_INLINE int64_t
+tunnel_buffer_size_to_index(int64_t size)
+{
+  if (size < 0 || size == INT64_MAX)
+    return buffer_size_to_index(size);
+  return buffer_size_to_index(size, max_tunnel_iobuffer_size);
+}
+
 TS_INLINE int64_t
 iobuffer_size_to_index(int64_t size, int64_t max)
 {
@@ -423,6 +433,12 @@ IOBufferBlock::alloc(int64_t i)
 TS_INLINE void
 IOBufferBlock::clear()
 {
+  if (iobuffer_usage_histograms && data && data->refcount() == 1)
+#ifdef TRACK_BUFFER_USER
+    iobuffer_usage_record(_location, data->_size_index, _end - buf());
+#else
+    iobuffer_usage_record(NULL, data->_size_index, _end - buf());
+#endif
   data = NULL;
   IOBufferBlock *p = next;
   while (p) {
@@ -35,6 +35,7 @@
 
 TS_INLINE
 ProtectedQueue::ProtectedQueue()
+  : sleeping(0)
 {
   Event e;
   ink_mutex_init(&lock, "ProtectedQueue");
@@ -32,6 +32,8 @@ TS_INLINE
 EventProcessor::EventProcessor():
 n_ethreads(0),
 n_thread_groups(0),
+work_stealing(false),
+numa_memory(false),
 n_dthreads(0),
 thread_data_used(0)
 {
@@ -39,6 +41,14 @@ thread_data_used(0)
   memset(dthreads, 0, sizeof(dthreads));
   memset(n_threads_for_type, 0, sizeof(n_threads_for_type));
   memset(next_thread_for_type, 0, sizeof(next_thread_for_type));
+  memset(stealable, 0, sizeof(stealable));
+  memset(threads_on_node, 0, sizeof(threads_on_node));
+  memset(n_threads_on_node, 0, sizeof(n_threads_on_node));
+  memset(next_thread_for_node, 0, sizeof(next_thread_for_node));
+
+  Event e;
+  for (int i = 0; i < MAX_EVENT_TYPES; i++)
+    ink_atomiclist_init(&steal_queue[i], "StealQueue", (char *) &e.link.next - (char *) &e);
 }
 
 TS_INLINE off_t
@@ -71,6 +81,15 @@ EventProcessor::assign_thread(EventType etype)
   return (eventthread[etype][next]);
 }
 
+// Pick an ET_NET thread on the given NUMA node, NULL if there is none.
+TS_INLINE EThread *
+EventProcessor::assign_thread_on_node(int node)
+{
+  if (node < 0 || node >= INK_MAX_NUMA_NODES || !n_threads_on_node[node])
+    return NULL;
+  return threads_on_node[node][next_thread_for_node[node]++ % n_threads_on_node[node]];
+}
+
 TS_INLINE Event *
 EventProcessor::schedule(Event * e, EventType etype, bool fast_signal)
 {
@@ -113,6 +132,28 @@ EventProcessor::schedule_imm(Continuation * cont, EventType et, int callback_eve
   return schedule(e->init(cont, 0, 0), et);
 }
 
+TS_INLINE Event *
+EventProcessor::schedule_imm_stealable(Continuation * cont, EventType et, int callback_event, void *cookie)
+{
+  ink_assert(et < MAX_EVENT_TYPES);
+  // Without a mutex of its own the event would be tied to a thread.
+  if (!stealable[et] || !cont->mutex)
+    return schedule_imm(cont, et, callback_event, cookie);
+
+  Event *e = eventAllocator.alloc();
+
+  e->callback_event = callback_event;
+  e->cookie = cookie;
+  e->init(cont, 0, 0);
+  // The event belongs to whichever thread of the group dequeues it first.
+  e->ethread = assign_thread(et);
+  e->mutex = cont->mutex;
+  e->in_the_prot_queue = 1;
+  ink_atomiclist_push(&steal_queue[et], e);
+  wake_stealer(et);
+  return e;
+}
+
 TS_INLINE Event *
 EventProcessor::schedule_at(Continuation * cont, ink_hrtime t, EventType et, int callback_event, void *cookie)
 {
@@ -137,16 +137,27 @@ flush_signals(EThread * thr)
   thr->n_ethreads_to_be_signalled = 0;
 }
 
+// shared is a queue the thread also takes events from, such as the
+// steal queue of its group. Whoever pushes onto it checks sleeping
+// after the push and signals, so it is checked after sleeping is set.
 void
-ProtectedQueue::dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool sleep)
+ProtectedQueue::dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool sleep, InkAtomicList **shared, int n_shared)
 {
   (void) cur_time;
   Event *e;
   if (sleep) {
     ink_mutex_acquire(&lock);
     if (INK_ATOMICLIST_EMPTY(al)) {
-      timespec ts = ink_based_hrtime_to_timespec(timeout);
-      ink_cond_timedwait(&might_have_data, &lock, &ts);
+      ink_atomic_swap(&sleeping, 1);
+      // Don't sleep while any of the shared queues we steal from has events.
+      int i = 0;
+      while (i < n_shared && INK_ATOMICLIST_EMPTY((*shared[i])))
+        i++;
+      if (i == n_shared) {
+        timespec ts = ink_based_hrtime_to_timespec(timeout);
+        ink_cond_timedwait(&might_have_data, &lock, &ts);
+      }
+      sleeping = 0;
     }
     ink_mutex_release(&lock);
   }
@@ -30,7 +30,10 @@ TasksProcessor tasksProcessor;
 int
 TasksProcessor::start(int task_threads)
 {
-  if (task_threads > 0)
+  if (task_threads > 0) {
     ET_TASK = eventProcessor.spawn_event_threads(task_threads, "ET_TASK");
+    // Task threads have no I/O of their own to stay close to.
+    eventProcessor.stealable[ET_TASK] = eventProcessor.work_stealing;
+  }
   return 0;
 }
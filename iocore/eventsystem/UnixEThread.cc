@@ -44,7 +44,7 @@ EThread::EThread()
    ethreads_to_be_signalled(NULL),
    n_ethreads_to_be_signalled(0),
    main_accept_index(-1),
-   id(NO_ETHREAD_ID), event_types(0),
+   id(NO_ETHREAD_ID), numa_node(-1), event_types(0),
    signal_hook(0),
    tt(REGULAR), eventsem(NULL)
 {
@@ -57,6 +57,7 @@ EThread::EThread(ThreadType att, int anid)
     n_ethreads_to_be_signalled(0),
     main_accept_index(-1),
     id(anid),
+    numa_node(-1),
     event_types(0),
     signal_hook(0),
     tt(att),
@@ -92,7 +93,7 @@ EThread::EThread(ThreadType att, Event * e, ink_sem * sem)
    ethreads_to_be_signalled(NULL),
    n_ethreads_to_be_signalled(0),
    main_accept_index(-1),
-   id(NO_ETHREAD_ID), event_types(0),
+   id(NO_ETHREAD_ID), numa_node(-1), event_types(0),
    signal_hook(0),
    tt(att), oneevent(e), eventsem(sem)
 {
@@ -159,6 +160,35 @@ EThread::process_event(Event * e, int calling_code)
   }
 }
 
+//
+// Run up to max_events of the events scheduled with
+// EventProcessor::schedule_imm_stealable on one of our thread groups.
+//
+int
+EThread::steal_events(int max_events)
+{
+  int n = 0;
+
+  for (int et = 0; et < eventProcessor.n_thread_groups && n < max_events; et++) {
+    if (!eventProcessor.stealable[et] || !is_event_type((EventType) et))
+      continue;
+    Event *e;
+    while (n < max_events && (e = (Event *) ink_atomiclist_pop(&eventProcessor.steal_queue[et]))) {
+      e->in_the_prot_queue = 0;
+      if (e->cancelled) {
+        free_event(e);
+        continue;
+      }
+      if (e->ethread != this)
+        Debug("iocore_thread", "thread %d stole event %p of thread %d", id, e, e->ethread->id);
+      e->ethread = this;
+      process_event(e, e->callback_event);
+      n++;
+    }
+  }
+  return n;
+}
+
 //
 // void  EThread::execute()
 //
@@ -179,8 +209,19 @@ EThread::execute() {
       Que(Event, link) NegativeQueue;
       ink_hrtime next_time = 0;
 
+#if TS_USE_HWLOC
+      // keep the memory this thread allocates on its own NUMA node
+      if (numa_node >= 0 && eventProcessor.numa_memory) {
+        if (ink_numa_bind_thread_memory(numa_node))
+          ink_freelist_set_numa_node(numa_node);
+        else
+          Warning("unable to bind memory of thread %d to NUMA node %d", id, numa_node);
+      }
+#endif
+
       // give priority to immediate events
       for (;;) {
+        bool idle = true;
         // execute all the available external events that have
         // already been dequeued
         cur_time = ink_get_based_hrtime_internal();
@@ -189,6 +230,7 @@ EThread::execute() {
              free_event(e);
           else if (!e->timeout_at) { // IMMEDIATE
             ink_assert(e->period == 0);
+            idle = false;
             process_event(e, e->callback_event);
           } else if (e->timeout_at > 0) // INTERVAL
             EventQueue.enqueue(e, cur_time);
@@ -217,10 +259,15 @@ EThread::execute() {
               free_event(e);
             else {
               done_one = true;
+              idle = false;
               process_event(e, e->callback_event);
             }
           }
         } while (done_one);
+        // run shared CPU bound events, as many as we can afford if we
+        // have nothing else to do, but at least one so they never starve
+        if (eventProcessor.work_stealing)
+          steal_events(idle ? MAX_STOLEN_EVENTS : 1);
         // execute any negative (poll) events
         if (NegativeQueue.head) {
           if (n_ethreads_to_be_signalled)
@@ -277,7 +324,16 @@ EThread::execute() {
           // cond_timedwait.
           if (n_ethreads_to_be_signalled)
             flush_signals(this);
-          EventQueueExternal.dequeue_timed(cur_time, next_time, true);
+          // A thread in more than one stealable group steals from all of them.
+          InkAtomicList *shared[MAX_EVENT_TYPES];
+          int n_shared = 0;
+          if (eventProcessor.work_stealing) {
+            for (int et = 0; et < eventProcessor.n_thread_groups; et++) {
+              if (eventProcessor.stealable[et] && is_event_type((EventType) et))
+                shared[n_shared++] = &eventProcessor.steal_queue[et];
+            }
+          }
+          EventQueueExternal.dequeue_timed(cur_time, next_time, true, shared, n_shared);
         }
       }
     }
@@ -124,6 +124,24 @@ EventProcessor::spawn_event_threads(int n_threads, const char* et_name)
 }
 
 
+// Wake up a thread of the group sleeping in its event queue for an event
+// just pushed onto the steal queue. Threads that are not sleeping get to
+// it on their next loop.
+void
+EventProcessor::wake_stealer(EventType et)
+{
+  int n = n_threads_for_type[et];
+  int start = next_thread_for_type[et];
+
+  for (int i = 0; i < n; i++) {
+    EThread *t = eventthread[et][(start + i) % n];
+    if (t->EventQueueExternal.sleeping) {
+      t->EventQueueExternal.signal();
+      return;
+    }
+  }
+}
+
 #define INK_NO_CLUSTER
 
 class EventProcessor eventProcessor;
@@ -159,9 +177,17 @@ EventProcessor::start(int n_event_threads)
   }
   n_threads_for_type[ET_CALL] = n_event_threads;
 
+  int stealing = 0;
+  REC_ReadConfigInteger(stealing, "proxy.config.exec_thread.work_stealing");
+  work_stealing = (stealing != 0);
+  Debug("iocore_thread", "work stealing: %s", work_stealing ? "enabled" : "disabled");
+
 #if TS_USE_HWLOC
   int affinity = 0;
+  int numa = 0;
   REC_ReadConfigInteger(affinity, "proxy.config.exec_thread.affinity");
+  REC_ReadConfigInteger(numa, "proxy.config.exec_thread.numa_memory");
+  numa_memory = (numa != 0);
   ink_cpuset_t cpuset;
   int socket = hwloc_get_nbobjs_by_type(ink_get_topology(), HWLOC_OBJ_SOCKET);
   int cu = hwloc_get_nbobjs_by_type(ink_get_topology(), HWLOC_OBJ_CORE);
@@ -172,31 +198,46 @@ EventProcessor::start(int n_event_threads)
   pu = hwloc_get_nbobjs_by_type(ink_get_topology(), HWLOC_OBJ_PU);
 #endif
 
-  Debug("iocore_thread", "socket: %d core: %d logical processor: %d affinity: %d", socket, cu, pu, affinity);
+  int logical_ratio;
+  switch(affinity) {
+  case 3:           // assign threads to logical cores
+    logical_ratio = 1;
+    break;
+  case 2:           // assign threads to real cores
+    logical_ratio = pu / cu;
+    break;
+  case 1:           // assign threads to sockets
+  default:
+    logical_ratio = pu / socket;
+  }
+
+  Debug("iocore_thread", "socket: %d core: %d logical processor: %d affinity: %d numa nodes: %d",
+        socket, cu, pu, affinity, ink_number_of_numa_nodes());
 #endif
 
   for (i = first_thread; i < n_ethreads; i++) {
+#if TS_USE_HWLOC
+    // The node must be known before the thread runs, it binds its own memory.
+    if (affinity != 0) {
+      int node = ink_numa_node_of_cpu(((i - 1) * logical_ratio) % pu);
+      if (node >= 0 && node < INK_MAX_NUMA_NODES) {
+        if (!threads_on_node[node])
+          threads_on_node[node] = (EThread **)ats_malloc(n_ethreads * sizeof(EThread *));
+        threads_on_node[node][n_threads_on_node[node]++] = all_ethreads[i];
+        all_ethreads[i]->numa_node = node;
+      }
+    }
+#endif
+
     snprintf(thr_name, MAX_THREAD_NAME_LENGTH, "[ET_NET %d]", i);
     ink_thread tid = all_ethreads[i]->start(thr_name);
     (void)tid;
 
 #if TS_USE_HWLOC
     if (affinity != 0) {
-      int logical_ratio;
-      switch(affinity) {
-      case 3:           // assign threads to logical cores
-        logical_ratio = 1;
-        break;
-      case 2:           // assign threads to real cores
-        logical_ratio = pu / cu;
-        break;
-      case 1:           // assign threads to sockets
-      default:
-        logical_ratio = pu / socket;
-      }
-
       char debug_message[256];
-      int len = snprintf(debug_message, sizeof(debug_message), "setaffinity tid: %" PTR_FMT ", net thread: %u cpu:", tid, i);
+      int len = snprintf(debug_message, sizeof(debug_message), "setaffinity tid: %" PTR_FMT ", net thread: %u node: %d cpu:",
+                         tid, i, all_ethreads[i]->numa_node);
       for (int cpu_count = 0; cpu_count < logical_ratio; cpu_count++) {
         int cpu = ((i - 1) * logical_ratio + cpu_count) % pu;
         set_cpu(&cpuset, cpu);
@@ -0,0 +1,120 @@
+/** @file
+
+  Regression test for work stealing between the threads of a group
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+// One thread of a stealable group is kept busy, the events scheduled
+// with schedule_imm_stealable must all run on the other one before the
+// busy thread is free again.
+
+#include "I_EventSystem.h"
+#include "I_Layout.h"
+
+#define TEST_EVENTS      20
+#define BUSY_SECONDS     5
+
+int count;
+EventType ET_TEST;
+Diags *diags;
+
+void syslog_thr_init(void)
+{
+}
+
+struct busy_thread:public Continuation
+{
+  busy_thread(ProxyMutex * m):Continuation(m)
+  {
+    SET_HANDLER(&busy_thread::busy_function);
+  }
+  int busy_function(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    sleep(BUSY_SECONDS);
+    return 0;
+  }
+};
+
+struct stolen_event:public Continuation
+{
+  stolen_event(ProxyMutex * m):Continuation(m)
+  {
+    SET_HANDLER(&stolen_event::run_function);
+  }
+  int run_function(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    ink_atomic_increment((int *) &count, 1);
+    return 0;
+  }
+};
+
+struct event_scheduler:public Continuation
+{
+  event_scheduler(ProxyMutex * m):Continuation(m)
+  {
+    SET_HANDLER(&event_scheduler::schedule_function);
+  }
+  int schedule_function(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    // Every other event is assigned to the busy thread.
+    for (int i = 0; i < TEST_EVENTS; i++)
+      eventProcessor.schedule_imm_stealable(new stolen_event(new_ProxyMutex()), ET_TEST);
+    return 0;
+  }
+};
+
+struct process_killer:public Continuation
+{
+  process_killer(ProxyMutex * m):Continuation(m)
+  {
+    SET_HANDLER(&process_killer::kill_function);
+  }
+  int kill_function(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    printf("Count is %d \n", count);
+    if (count != TEST_EVENTS)
+      exit(1);
+    exit(0);
+    return 0;
+  }
+};
+
+int
+main(int /* argc ATS_UNUSED */, const char */* argv ATS_UNUSED */[])
+{
+  RecModeT mode_type = RECM_STAND_ALONE;
+  count = 0;
+
+  Layout::create();
+  diags = NEW(new Diags("", NULL, NULL));
+  RecProcessInit(mode_type);
+
+  ink_event_system_init(EVENT_SYSTEM_MODULE_VERSION);
+  eventProcessor.start(1);
+  ET_TEST = eventProcessor.spawn_event_threads(2, "ET_TEST");
+  eventProcessor.work_stealing = true;
+  eventProcessor.stealable[ET_TEST] = true;
+
+  eventProcessor.eventthread[ET_TEST][0]->schedule_imm(new busy_thread(new_ProxyMutex()));
+  eventProcessor.schedule_in(new event_scheduler(new_ProxyMutex()), HRTIME_MSECONDS(100));
+  eventProcessor.schedule_in(new process_killer(new_ProxyMutex()), HRTIME_SECONDS(1));
+  this_thread()->execute();
+  return 0;
+}
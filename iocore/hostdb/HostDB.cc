@@ -25,6 +25,7 @@
 
 #include "P_HostDB.h"
 #include "I_Layout.h"
+#include "I_Tasks.h"
 
 #ifndef NON_MODULAR
 //char system_config_directory[512] = "etc/trafficserver";
@@ -56,23 +57,35 @@ int hostdb_cluster_round_robin = false;
 int hostdb_lookup_timeout = 120;
 int hostdb_insert_timeout = 160;
 int hostdb_re_dns_on_reload = false;
+int hostdb_happy_eyeballs = false;
 int hostdb_ttl_mode = TTL_OBEY;
 unsigned int hostdb_current_interval = 0;
 unsigned int hostdb_ip_stale_interval = HOST_DB_IP_STALE;
 unsigned int hostdb_ip_timeout_interval = HOST_DB_IP_TIMEOUT;
 unsigned int hostdb_ip_fail_timeout_interval = HOST_DB_IP_FAIL_TIMEOUT;
 unsigned int hostdb_serve_stale_but_revalidate = 0;
+unsigned int hostdb_prefetch_fraction = 0;
+unsigned int hostdb_prefetch_min_hits = 2;
 char hostdb_filename[PATH_NAME_MAX + 1] = DEFAULT_HOST_DB_FILENAME;
 int hostdb_size = DEFAULT_HOST_DB_SIZE;
 int hostdb_sync_frequency = 120;
 int hostdb_srv_enabled = 0;
 int hostdb_disable_reverse_lookup = 0;
+int hostdb_fast_lookup_size = 65536;
+int hostdb_negative_size = 0;
+unsigned int hostdb_negative_ttl = 30;
+unsigned int hostdb_negative_max_ttl = 300;
+unsigned int hostdb_negative_zone_max = 1000;
+int hostdb_snapshot_enabled = 1;
+static char hostdb_snapshot_path[PATH_NAME_MAX + 1];
 
 ClassAllocator<HostDBContinuation> hostDBContAllocator("hostDBContAllocator");
 
 // Static configuration information
 
 HostDBCache hostDB;
+static HostDBFastCache<HostDBInfo> hostDBFast;
+static HostDBNegativeCache hostDBNegative;
 
 #ifdef NON_MODULAR
 static  Queue <HostDBContinuation > remoteHostDBQueue[MULTI_CACHE_PARTITIONS];
@@ -335,6 +348,7 @@ struct HostDBSyncer: public Continuation
 {
   int frequency;
   ink_hrtime start_time;
+  int passes;
 
   int sync_event(int event, void *edata);
   int wait_event(int event, void *edata);
@@ -344,7 +358,7 @@ struct HostDBSyncer: public Continuation
 
 
 HostDBSyncer::HostDBSyncer():
-Continuation(new_ProxyMutex()), frequency(0), start_time(0)
+Continuation(new_ProxyMutex()), frequency(0), start_time(0), passes(0)
 {
   SET_HANDLER(&HostDBSyncer::sync_event);
 }
@@ -360,11 +374,125 @@ HostDBSyncer::sync_event(int, void *)
 }
 
 
+//
+// Write the snapshot of the forward lookups, one partition at a time
+// under its lock, on a task thread as sorting and syncing the file
+// takes a while.
+//
+struct HostDBSnapshotWriter: public Continuation
+{
+  int partition;
+  HostDBSnapshotEntry *entries;
+  uint32_t count;
+  uint32_t size;
+  HostDBSnapshotAddr *addrs;
+  uint32_t addr_count;
+  uint32_t addr_size;
+  int64_t now;
+
+  int writeEvent(int event, Event *e);
+  void add(HostDBInfo *r);
+
+  HostDBSnapshotWriter();
+  ~HostDBSnapshotWriter() {
+    ats_free(entries);
+    ats_free(addrs);
+  }
+};
+
+
+HostDBSnapshotWriter::HostDBSnapshotWriter():
+Continuation(hostDB.locks[0]), partition(0), entries(NULL), count(0), size(hostDB.totalelements),
+  addrs(NULL), addr_count(0), addr_size(size ? size : 1), now(time(NULL))
+{
+  entries = (HostDBSnapshotEntry *) ats_malloc(sizeof(HostDBSnapshotEntry) * (size ? size : 1));
+  addrs = (HostDBSnapshotAddr *) ats_malloc(sizeof(HostDBSnapshotAddr) * addr_size);
+  SET_HANDLER(&HostDBSnapshotWriter::writeEvent);
+}
+
+
+void
+HostDBSnapshotWriter::add(HostDBInfo *r)
+{
+  if (r->is_empty() || r->is_deleted() || r->reverse_dns || r->is_srv || r->failed() || r->is_ip_timeout())
+    return;
+  if (count >= size)
+    return;
+
+  // A round robin name keeps its whole set, of the family of its first member.
+  HostDBRoundRobin *rr = r->round_robin ? r->rr() : NULL;
+  HostDBInfo *info = rr ? rr->info : r;
+  int n = rr ? rr->rrcount : 1;
+
+  if (r->round_robin && !rr)
+    return;
+  if (!ats_is_ip(info->ip()))
+    return;
+
+  if (addr_count + n > addr_size) {
+    addr_size = addr_size * 2 + n;
+    addrs = (HostDBSnapshotAddr *) ats_realloc(addrs, sizeof(HostDBSnapshotAddr) * addr_size);
+  }
+
+  HostDBSnapshotEntry & s = entries[count];
+  memset(&s, 0, sizeof(s));
+  s.md5_high = r->md5_high;
+  s.expire = now + r->ip_time_remaining();
+  s.family = info->ip()->sa_family;
+  s.first_addr = addr_count;
+  for (int i = 0; i < n; ++i) {
+    sockaddr const* ip = info[i].ip();
+    if (ip->sa_family != s.family)
+      continue;
+    HostDBSnapshotAddr & a = addrs[addr_count + s.n_addrs++];
+    memset(&a, 0, sizeof(a));
+    memcpy(a.addr, ats_ip_addr8_cast(ip), ats_ip_addr_size(ip));
+  }
+  addr_count += s.n_addrs;
+  count++;
+}
+
+
+int
+HostDBSnapshotWriter::writeEvent(int, Event *e)
+{
+  if (partition < MULTI_CACHE_PARTITIONS) {
+    int first = hostDB.first_bucket_of_partition(partition);
+    int last = first + hostDB.buckets_of_partition(partition);
+
+    for (int level = 0; level < hostDB.levels; ++level) {
+      for (int b = first; b < last; ++b) {
+        HostDBInfo *block = (HostDBInfo *) (hostDB.data + hostDB.level_offset[level] + hostDB.bucketsize[level] * b);
+        for (int i = 0; i < hostDB.elements[level]; ++i)
+          add(block + i);
+      }
+    }
+    if (++partition < MULTI_CACHE_PARTITIONS) {
+      mutex = hostDB.locks[partition];
+      e->schedule_imm();
+      return EVENT_CONT;
+    }
+  }
+
+  // The partitions have warmed up by the time this run has something to write.
+  if (HostDBSnapshot::write(hostdb_snapshot_path, entries, count, addrs, addr_count) && hostDBSnapshot.is_warming()) {
+    Note("HostDB snapshot %s written, no longer answering from the previous one", hostdb_snapshot_path);
+    hostDBSnapshot.end_warmup();
+  }
+  delete this;
+  return EVENT_DONE;
+}
+
+
 int
 HostDBSyncer::wait_event(int, void *)
 {
   ink_hrtime next_sync = HRTIME_SECONDS(hostdb_sync_frequency) - (ink_get_hrtime() - start_time);
 
+  // The first pass runs at startup, before the partitions have warmed up.
+  if (hostdb_snapshot_path[0] && passes++ > 0)
+    eventProcessor.schedule_imm(NEW(new HostDBSnapshotWriter), ET_TASK);
+
   SET_HANDLER(&HostDBSyncer::sync_event);
   if (next_sync > HRTIME_MSECONDS(100))
     mutex->thread_holding->schedule_in_local(this, next_sync);
@@ -392,6 +520,9 @@ HostDBCache::start(int flags)
   REC_ReadConfigString(hostdb_filename, "proxy.config.hostdb.filename", PATH_NAME_MAX);
   REC_ReadConfigInt32(hostdb_size, "proxy.config.hostdb.size");
   REC_ReadConfigInt32(hostdb_srv_enabled, "proxy.config.srv_enabled");
+  REC_ReadConfigInt32(hostdb_fast_lookup_size, "proxy.config.hostdb.fast_lookup.size");
+  REC_ReadConfigInt32(hostdb_negative_size, "proxy.config.hostdb.negative.size");
+  REC_ReadConfigInt32(hostdb_snapshot_enabled, "proxy.config.hostdb.snapshot");
   REC_ReadConfigString(storage_path, "proxy.config.hostdb.storage_path", PATH_NAME_MAX);
   REC_ReadConfigInt32(storage_size, "proxy.config.hostdb.storage_size");
 
@@ -409,6 +540,13 @@ HostDBCache::start(int flags)
       Warning(" Please set 'proxy.config.hostdb.storage_path' or 'proxy.config.local_state_dir' ");
     }
   }
+  // The snapshot does not depend on the partition files, so it is
+  // there even if they are rebuilt below.
+  if (hostdb_snapshot_enabled && !hostDBSnapshot.is_open()) {
+    snprintf(hostdb_snapshot_path, sizeof(hostdb_snapshot_path), "%s/%s.snapshot", storage_path, hostdb_filename);
+    hostDBSnapshot.open(hostdb_snapshot_path);
+  }
+
   hostDBStore = NEW(new Store);
   hostDBSpan = NEW(new Span);
   hostDBSpan->init(storage_path, storage_size);
@@ -442,6 +580,31 @@ HostDBCache::start(int flags)
   return 0;
 }
 
+// The lookup caches hold copies of the entries, so they go with them.
+void
+HostDBCache::reset()
+{
+  hostDBFast.clear();
+  hostDBNegative.clear();
+  MultiCache<HostDBInfo>::reset();
+}
+
+void
+HostDBCache::clear()
+{
+  hostDBFast.clear();
+  hostDBNegative.clear();
+  MultiCache<HostDBInfo>::clear();
+}
+
+void
+HostDBCache::clear_but_heap()
+{
+  hostDBFast.clear();
+  hostDBNegative.clear();
+  MultiCache<HostDBInfo>::clear_but_heap();
+}
+
 
 // Start up the Host Database processor.
 // Load configuration, register configuration and statistics and
@@ -463,6 +626,11 @@ HostDBProcessor::start(int)
 
   HOSTDB_SET_DYN_COUNT(hostdb_total_entries_stat, hostDB.totalelements);
 
+  if (!hostDBFast.enabled())
+    hostDBFast.init(hostdb_fast_lookup_size);
+  if (!hostDBNegative.enabled())
+    hostDBNegative.init(hostdb_negative_size);
+
 #ifdef NON_MODULAR
   statPagesManager.register_http("hostdb", register_ShowHostDB);
 #endif
@@ -473,6 +641,7 @@ HostDBProcessor::start(int)
   REC_EstablishStaticConfigInt32(hostdb_ttl_mode, "proxy.config.hostdb.ttl_mode");
   REC_EstablishStaticConfigInt32(hostdb_disable_reverse_lookup, "proxy.config.cache.hostdb.disable_reverse_lookup");
   REC_EstablishStaticConfigInt32(hostdb_re_dns_on_reload, "proxy.config.hostdb.re_dns_on_reload");
+  REC_EstablishStaticConfigInt32(hostdb_happy_eyeballs, "proxy.config.hostdb.happy_eyeballs");
   REC_EstablishStaticConfigInt32(hostdb_migrate_on_demand, "proxy.config.hostdb.migrate_on_demand");
   REC_EstablishStaticConfigInt32(hostdb_strict_round_robin, "proxy.config.hostdb.strict_round_robin");
   REC_EstablishStaticConfigInt32(hostdb_timed_round_robin, "proxy.config.hostdb.timed_round_robin");
@@ -483,6 +652,11 @@ HostDBProcessor::start(int)
   REC_EstablishStaticConfigInt32U(hostdb_ip_stale_interval, "proxy.config.hostdb.verify_after");
   REC_EstablishStaticConfigInt32U(hostdb_ip_fail_timeout_interval, "proxy.config.hostdb.fail.timeout");
   REC_EstablishStaticConfigInt32U(hostdb_serve_stale_but_revalidate, "proxy.config.hostdb.serve_stale_for");
+  REC_EstablishStaticConfigInt32U(hostdb_prefetch_fraction, "proxy.config.hostdb.prefetch.fraction");
+  REC_EstablishStaticConfigInt32U(hostdb_prefetch_min_hits, "proxy.config.hostdb.prefetch.min_hits");
+  REC_EstablishStaticConfigInt32U(hostdb_negative_ttl, "proxy.config.hostdb.negative.ttl");
+  REC_EstablishStaticConfigInt32U(hostdb_negative_max_ttl, "proxy.config.hostdb.negative.max_ttl");
+  REC_EstablishStaticConfigInt32U(hostdb_negative_zone_max, "proxy.config.hostdb.negative.zone_max_entries");
   REC_EstablishStaticConfigInt32(hostdb_sync_frequency, "proxy.config.cache.hostdb.sync_frequency");
 
   //
@@ -646,6 +820,92 @@ db_mark_for(sockaddr const* ip) {
   return ats_is_ip6(ip) ? HOSTDB_MARK_IPV6 : HOSTDB_MARK_IPV4;
 }
 
+// Publish a copy of an entry in the lock free cache, or drop the copy if the
+// entry is of a kind that the cache does not hold. Round robin, reverse DNS
+// and SRV entries point into the partition heap, so they can't be copied out,
+// and failed entries need the retry logic of the slow path.
+static inline void
+hostdb_fast_publish(HostDBMD5 const& md5, HostDBInfo *r)
+{
+  if (!hostDBFast.enabled())
+    return;
+  if (r->round_robin || r->reverse_dns || r->is_srv || r->is_deleted() || r->failed())
+    hostDBFast.remove(md5.hash);
+  else
+    hostDBFast.put(md5.hash, *r);
+}
+
+// Look up an entry in the lock free cache. Entries that are stale, timed
+// out or due for a prefetch are left to probe(), which refreshes them and
+// counts their hits.
+static inline bool
+hostdb_fast_probe(HostDBMD5 const& md5, HostDBInfo & info)
+{
+  if (!hostDBFast.get(md5.hash, info))
+    return false;
+  return !info.is_ip_stale() && !info.is_ip_timeout() && !info.is_ip_prefetch();
+}
+
+// The zone of a name, for the per zone limit of the negative cache, is
+// the owner of the SOA record that came with the answer. Without one the
+// name is taken to be in the zone of its parent.
+static uint64_t
+hostdb_zone_hash(char const* zone, char const* name, int len)
+{
+  uint64_t h = 14695981039346656037ULL; // FNV-1a
+
+  if (zone) {
+    len = strlen(zone);
+  } else {
+    char const* dot = (char const*) memchr(name, '.', len);
+    if (dot) {
+      len -= dot + 1 - name;
+      name = dot + 1;
+    }
+    zone = name;
+  }
+  while (len > 0 && '.' == zone[len - 1])
+    --len;
+  for (int i = 0; i < len; ++i) {
+    h ^= (unsigned char) tolower((unsigned char) zone[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// Remember that a name does not exist, for the negative TTL from the
+// nameserver or the configured one if there was no SOA record with it.
+static void
+hostdb_negative_put(ProxyMutex *mutex, HostDBMD5 const& md5, HostEnt *e)
+{
+  unsigned int ttl = e->ttl;
+
+  if (!ttl)
+    ttl = hostdb_negative_ttl;
+  if (ttl > hostdb_negative_max_ttl)
+    ttl = hostdb_negative_max_ttl;
+  if (!ttl)
+    return;
+  if (!hostDBNegative.put(md5.hash, hostdb_zone_hash(e->ent.h_name, md5.host_name, md5.host_len),
+                          hostdb_current_interval, ttl, hostdb_negative_max_ttl, hostdb_negative_zone_max)) {
+    Debug("hostdb", "zone of '%.*s' is over its negative entries", md5.host_len, md5.host_name);
+    HOSTDB_INCREMENT_DYN_STAT(hostdb_negative_zone_limited_stat);
+  }
+}
+
+// Is there a DNS lookup in flight for the name?
+static bool
+hostdb_dns_pending(HostDBMD5 const& md5)
+{
+  INK_MD5 hash = md5.hash;
+
+  for (HostDBContinuation *c = hostDB.pending_dns_for_hash(hash).head; c; c = (HostDBContinuation *) c->link.next) {
+    if (c->md5.hash == md5.hash)
+      return true;
+  }
+  return false;
+}
+
 HostDBInfo *
 probe(ProxyMutex *mutex, HostDBMD5 const& md5, bool ignore_timeout)
 {
@@ -684,18 +944,31 @@ probe(ProxyMutex *mutex, HostDBMD5 const& md5, bool ignore_timeout)
         hostDB.delete_block(r);
         return NULL;
       }
-      // Check for stale (revalidate offline if we are the owner)
+      // Count the lookups answered from the lock free cache since the last probe.
+      unsigned int fast_hits = hostDBFast.take_hits(md5.hash);
+      if (fast_hits)
+        r->hits = min(r->hits + fast_hits, (unsigned int) hostDB.max_hits);
+
+      // A popular entry close to its TTL is refreshed before anyone has to wait for it. The
+      // hits are reset when the new entry is inserted, so they count the lookups of this answer.
+      bool prefetch = r->hits >= hostdb_prefetch_min_hits && !r->failed() && r->is_ip_prefetch();
+
+      // Check for stale or due for a prefetch (revalidate offline if we are the owner)
       // -or-
       // we are beyond our TTL but we choose to serve for another N seconds [hostdb_serve_stale_but_revalidate seconds]
-      if ((!ignore_timeout && r->is_ip_stale()
+      if ((!ignore_timeout && (r->is_ip_stale() || prefetch)
 #ifdef NON_MODULAR
            && !cluster_machine_at_depth(master_hash(md5.hash))
 #endif
            && !r->reverse_dns) || (r->is_ip_timeout() && r->serve_stale_but_revalidate())) {
         Debug("hostdb", "stale %u %u %u, using it and refreshing it", r->ip_interval(),
               r->ip_timestamp, r->ip_timeout_interval);
-        r->refresh_ip();
-        if (!is_dotted_form_hostname(md5.host_name)) {
+        // The entry keeps its timestamp until the refresh inserts a new one, so
+        // a failed refresh does not make the old answer last any longer. One
+        // refresh at a time, the lookups meanwhile just use the old answer.
+        if (!is_dotted_form_hostname(md5.host_name) && !hostdb_dns_pending(md5)) {
+          if (prefetch && !r->is_ip_timeout())
+            HOSTDB_INCREMENT_DYN_STAT(hostdb_prefetch_stat);
           HostDBContinuation *c = hostDBContAllocator.alloc();
           HostDBContinuation::Options copt;
           copt.host_res_style = host_res_style_for(r->ip());
@@ -707,6 +980,7 @@ probe(ProxyMutex *mutex, HostDBMD5 const& md5, bool ignore_timeout)
       r->hits++;
       if (!r->hits)
         r->hits--;
+      hostdb_fast_publish(md5, r);
       return r;
     }
   }
@@ -725,6 +999,10 @@ HostDBContinuation::insert(unsigned int attl)
   int bucket = folded_md5 % hostDB.buckets;
 
   ink_assert(this_ethread() == hostDB.lock_for_bucket(bucket)->thread_holding);
+  // The copy in the lock free cache is replaced once the new entry is probed.
+  hostDBFast.remove(md5.hash);
+  hostDBNegative.remove(md5.hash);
+
   // remove the old one to prevent buildup
   HostDBInfo *old_r = hostDB.lookup_block(folded_md5, 3);
   if (old_r)
@@ -787,6 +1065,20 @@ HostDBProcessor::getby(Continuation * cont,
   // Attempt to find the result in-line, for level 1 hits
   //
   if (!aforce_dns) {
+    HostDBInfo info;
+
+    // Hits in the lock free cache need only the lock of the caller.
+    if (hostdb_fast_probe(md5, info)) {
+      MUTEX_TRY_LOCK(lock, cont->mutex, thread);
+      if (lock) {
+        Debug("hostdb", "immediate answer for %.*s from the fast lookup cache", md5.host_len, md5.host_name);
+        HOSTDB_INCREMENT_DYN_STAT(hostdb_total_hits_stat);
+        HOSTDB_INCREMENT_DYN_STAT(hostdb_fast_hits_stat);
+        cont->handleEvent(EVENT_HOST_DB_LOOKUP, &info);
+        return ACTION_RESULT_DONE;
+      }
+    }
+
     bool loop;
     do {
       loop = false; // Only loop on explicit set for retry.
@@ -870,6 +1162,56 @@ HostDBProcessor::getbyname_re(Continuation * cont, const char *ahostname, int le
 }
 
 
+// Look up the other address family of a host without blocking
+//
+bool
+HostDBProcessor::getbyname_alternate(const char *hostname, int len, sockaddr const* addr, IpEndpoint & alternate)
+{
+  HostDBMD5 md5;
+  EThread *thread = this_ethread();
+  bool zret = false;
+
+  if (!hostdb_enable || !hostname || !*hostname)
+    return false;
+
+  md5.host_name = hostname;
+  md5.host_len = len ? len : strlen(hostname);
+  md5.port = ats_ip_port_host_order(addr);
+  md5.db_mark = ats_is_ip6(addr) ? HOSTDB_MARK_IPV4 : HOSTDB_MARK_IPV6;
+#ifdef SPLIT_DNS
+  if (SplitDNSConfig::isSplitDNSEnabled()) {
+    const char *scan = hostname;
+    for (; *scan != '\0' && (ParseRules::is_digit(*scan) || '.' == *scan); scan++);
+    if ('\0' != *scan) {
+      SplitDNS* pSD = SplitDNSConfig::acquire();
+      if (0 != pSD)
+        md5.dns_server = static_cast<DNSServer*>(pSD->getDNSRecord(md5.host_name));
+      SplitDNSConfig::release(pSD);
+    }
+  }
+#endif // SPLIT_DNS
+  md5.refresh();
+
+  ProxyMutex *bmutex = hostDB.lock_for_bucket((int) (fold_md5(md5.hash) % hostDB.buckets));
+  MUTEX_TRY_LOCK(lock, bmutex, thread);
+  if (lock) {
+    HostDBInfo *r = probe(bmutex, md5, false);
+    if (r && !r->failed()) {
+      // The good members of a round robin entry are at the front.
+      if (r->round_robin) {
+        HostDBRoundRobin *rr = r->rr();
+        r = (rr && rr->good > 0) ? &rr->info[0] : NULL;
+      }
+      if (r) {
+        ats_ip_copy(&alternate, r->ip());
+        zret = true;
+      }
+    }
+  }
+  return zret;
+}
+
+
 /* Support SRV records */
 Action *
 HostDBProcessor::getSRVbyname_imm(Continuation * cont, process_srv_info_pfn process_srv_info,
@@ -990,6 +1332,17 @@ HostDBProcessor::getbyname_imm(Continuation * cont, process_hostdb_info_pfn proc
 
   // Attempt to find the result in-line, for level 1 hits
   if (!force_dns) {
+    HostDBInfo info;
+
+    // The caller holds its own lock, so a hit in the lock free cache needs no lock at all.
+    if (hostdb_fast_probe(md5, info)) {
+      Debug("hostdb", "immediate answer for %.*s from the fast lookup cache", md5.host_len, md5.host_name);
+      HOSTDB_INCREMENT_DYN_STAT(hostdb_total_hits_stat);
+      HOSTDB_INCREMENT_DYN_STAT(hostdb_fast_hits_stat);
+      (cont->*process_hostdb_info) (&info);
+      return ACTION_RESULT_DONE;
+    }
+
     bool loop;
     do {
       loop = false; // loop only on explicit set for retry
@@ -1094,8 +1447,10 @@ HostDBProcessor::setby(const char *hostname, int len, sockaddr const* ip, HostDB
 
   if (lock) {
     HostDBInfo *r = probe(mutex, md5, false);
-    if (r)
+    if (r) {
       do_setby(r, app, hostname, md5.ip);
+      hostdb_fast_publish(md5, r);
+    }
     return;
   }
   // Create a continuation to do a deaper probe in the background
@@ -1139,8 +1494,10 @@ HostDBContinuation::setbyEvent(int event, Event * e)
   NOWARN_UNUSED(e);
   HostDBInfo *r = probe(mutex, md5, false);
 
-  if (r)
+  if (r) {
     do_setby(r, &app, md5.host_name, md5.ip, is_srv());
+    hostdb_fast_publish(md5, r);
+  }
 
   hostdb_cont_free(this);
   return EVENT_DONE;
@@ -1437,7 +1794,10 @@ HostDBContinuation::dnsEvent(int event, HostEnt * e)
     timeout = thread->schedule_in(this, HRTIME_SECONDS(hostdb_insert_timeout));
     return EVENT_DONE;
   } else {
-    bool failed = !e;
+    // The name does not exist: a failure that is kept in the negative cache
+    // only, either from this answer or from an earlier one.
+    bool negative = e ? e->negative : negative_hit;
+    bool failed = !e || negative;
 
     bool rr = false;
     pending_action = NULL;
@@ -1502,7 +1862,18 @@ HostDBContinuation::dnsEvent(int event, HostEnt * e)
     HostDBInfo *r = NULL;
     IpAddr tip; // temp storage if needed.
 
-    if (is_byname()) {
+    if (negative) {
+      // Not put in the partitions, so that a flood of bad names can't push
+      // good entries out. The old entry for the name is gone as well.
+      if (e)
+        hostdb_negative_put(mutex, md5, e);
+      if (old_r) {
+        hostDBFast.remove(md5.hash);
+        hostDB.delete_block(old_r);
+        old_r = NULL;
+        old_rr_data = NULL;
+      }
+    } else if (is_byname()) {
       if (first) ip_addr_set(tip, af, first);
       r = lookup_done(tip, md5.host_name, rr, ttl_seconds, failed ? 0 : &e->srv_hosts);
     } else if (is_srv()) {
@@ -1632,7 +2003,7 @@ HostDBContinuation::dnsEvent(int event, HostEnt * e)
     // if we are not the owner, put on the owner
     //
     ClusterMachine *m = cluster_machine_at_depth(master_hash(md5.hash));
-    if (m)
+    if (m && r)
       do_put_response(m, r, NULL);
 #endif
 
@@ -1892,11 +2263,38 @@ HostDBContinuation::probeEvent(int event, Event * e)
   }
   // If there are no remote nodes to probe, do a DNS lookup
   //
+  if (hostdb_happy_eyeballs && action.continuation && is_byname() &&
+      (HOST_RES_IPV4 == host_res_style || HOST_RES_IPV6 == host_res_style) &&
+      md5.db_mark == db_mark_for(host_res_style))
+    do_alternate_dns();
   do_dns();
   return EVENT_DONE;
 }
 
 
+//
+// Resolve the other family of a dual stack lookup at the same time, so that
+// a failover to it or a racing connect finds it in HostDB instead of waiting
+// for a second query. Nobody is called back, it only fills HostDB.
+//
+void
+HostDBContinuation::do_alternate_dns()
+{
+  HostDBMD5 alt_md5 = md5;
+  alt_md5.db_mark = HOSTDB_MARK_IPV4 == md5.db_mark ? HOSTDB_MARK_IPV6 : HOSTDB_MARK_IPV4;
+  alt_md5.refresh();
+
+  HostDBContinuation *c = hostDBContAllocator.alloc();
+  HostDBContinuation::Options copt;
+  copt.timeout = dns_lookup_timeout;
+  copt.host_res_style = host_res_style_for(alt_md5.db_mark);
+  c->init(alt_md5, copt);
+  SET_CONTINUATION_HANDLER(c, (HostDBContHandler) & HostDBContinuation::probeEvent);
+  dnsProcessor.thread->schedule_imm(c);
+  HOSTDB_INCREMENT_DYN_STAT(hostdb_alternate_lookups_stat);
+}
+
+
 int
 HostDBContinuation::set_check_pending_dns()
 {
@@ -1955,6 +2353,47 @@ HostDBContinuation::do_dns()
       return;
     }
   }
+  // Until the partitions have warmed up, a name known before the restart
+  // is answered from the snapshot, a round robin set goes in as if it
+  // came from DNS.
+  if (is_byname() && !force_dns && action.continuation && hostDBSnapshot.is_warming()) {
+    IpAddr ips[HOST_DB_MAX_ROUND_ROBIN_INFO];
+    unsigned int ttl_seconds;
+    int n = hostDBSnapshot.get(md5.hash[1], ips, HOST_DB_MAX_ROUND_ROBIN_INFO, ttl_seconds);
+    if (n == 1) {
+      Debug("hostdb", "snapshot hit for '%.*s'", md5.host_len, md5.host_name);
+      HOSTDB_INCREMENT_DYN_STAT(hostdb_snapshot_hits_stat);
+      HostDBInfo *r = lookup_done(ips[0], md5.host_name, false, ttl_seconds, NULL);
+      reply_to_cont(action.continuation, r);
+      hostdb_cont_free(this);
+      return;
+    } else if (n > 1) {
+      Debug("hostdb", "snapshot hit for '%.*s', %d addresses", md5.host_len, md5.host_name, n);
+      HOSTDB_INCREMENT_DYN_STAT(hostdb_snapshot_hits_stat);
+      HostEnt *ent = NEW(new HostEnt);
+      ent->ttl = ttl_seconds;
+      ent->ent.h_addrtype = ips[0].family();
+      ent->ent.h_length = ips[0].isIp4() ? sizeof(in_addr_t) : sizeof(in6_addr);
+      ent->ent.h_addr_list = (char **) ent->h_addr_ptrs;
+      for (int i = 0; i < n; ++i)
+        ent->h_addr_ptrs[i] = ips[i]._addr._byte;
+      dnsEvent(DNS_EVENT_LOOKUP, ent);
+      delete ent;
+      return;
+    }
+  }
+
+  // The name was not found a moment ago, so answer as the nameserver did.
+  negative_hit = !force_dns && hostDBNegative.enabled() && hostDBNegative.get(md5.hash, hostdb_current_interval);
+  if (negative_hit) {
+    Debug("hostdb", "negative cache hit for '%.*s'", md5.host_len, md5.host_name);
+    HOSTDB_INCREMENT_DYN_STAT(hostdb_negative_hits_stat);
+    // refreshes and alternate family lookups have nobody to tell
+    if (!action.continuation) {
+      hostdb_cont_free(this);
+      return;
+    }
+  }
   if (hostdb_lookup_timeout)
     timeout = mutex->thread_holding->schedule_in(this, HRTIME_SECONDS(hostdb_lookup_timeout));
   else
@@ -1964,12 +2403,16 @@ HostDBContinuation::do_dns()
     opt.timeout = dns_lookup_timeout;
     opt.host_res_style = host_res_style_for(md5.db_mark);
     SET_HANDLER((HostDBContHandler) & HostDBContinuation::dnsEvent);
-    if (is_byname()) {
+    if (negative_hit) {
+      dnsEvent(DNS_EVENT_LOOKUP, NULL);
+    } else if (is_byname()) {
       if (md5.dns_server)
         opt.handler = md5.dns_server->x_dnsH;
+      opt.report_negative = hostDBNegative.enabled();
       pending_action = dnsProcessor.gethostbyname(this, md5.host_name, opt);
     } else if (is_srv()) {
       Debug("dns_srv", "SRV lookup of %s", md5.host_name);
+      opt.report_negative = hostDBNegative.enabled();
       pending_action = dnsProcessor.getSRVbyname(this, md5.host_name, opt);
     } else {
       ip_text_buffer ipb;
@@ -2544,8 +2987,32 @@ ink_hostdb_init(ModuleVersion v)
                      "proxy.process.hostdb.re_dns_on_reload",
                      RECD_INT, RECP_NULL, (int) hostdb_re_dns_on_reload_stat, RecRawStatSyncSum);
 
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.alternate_family_lookups",
+                     RECD_INT, RECP_NULL, (int) hostdb_alternate_lookups_stat, RecRawStatSyncSum);
+
   RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
                      "proxy.process.hostdb.bytes", RECD_INT, RECP_NULL, (int) hostdb_bytes_stat, RecRawStatSyncCount);
 
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.fast_lookup_hits",
+                     RECD_INT, RECP_NULL, (int) hostdb_fast_hits_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.prefetches",
+                     RECD_INT, RECP_NULL, (int) hostdb_prefetch_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.negative_hits",
+                     RECD_INT, RECP_NULL, (int) hostdb_negative_hits_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.negative_zone_limited",
+                     RECD_INT, RECP_NULL, (int) hostdb_negative_zone_limited_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(hostdb_rsb, RECT_PROCESS,
+                     "proxy.process.hostdb.snapshot_hits",
+                     RECD_INT, RECP_NULL, (int) hostdb_snapshot_hits_stat, RecRawStatSyncSum);
+
   ts_host_res_global_init();
 }
@@ -0,0 +1,370 @@
+/** @file
+
+  A read only snapshot of the HostDB entries, for a warm restart
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "ink_config.h"
+#include "P_HostDBSnapshot.h"
+
+#include <sys/mman.h>
+
+HostDBSnapshot hostDBSnapshot;
+
+HostDBSnapshot::HostDBSnapshot()
+  : header(NULL), entries(NULL), addrs(NULL), mapped_size(0), warming(true)
+{
+}
+
+HostDBSnapshot::~HostDBSnapshot()
+{
+  if (header)
+    munmap((caddr_t) header, mapped_size);
+}
+
+static void
+snapshot_digest(uint8_t * digest, void const * entries, size_t entries_size, void const * addrs, size_t addrs_size)
+{
+  INK_DIGEST_CTX ctx;
+
+  ink_code_incr_md5_init(&ctx);
+  ink_code_incr_md5_update(&ctx, (const char *) entries, (int) entries_size);
+  ink_code_incr_md5_update(&ctx, (const char *) addrs, (int) addrs_size);
+  ink_code_incr_md5_final((char *) digest, &ctx);
+}
+
+bool
+HostDBSnapshot::open(const char * path)
+{
+  HostDBSnapshotHeader hdr;
+  struct stat st;
+  int fd;
+  void * addr;
+
+  ink_release_assert(header == NULL);
+
+  fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    Debug("hostdb", "no HostDB snapshot %s: %s", path, strerror(errno));
+    return false;
+  }
+
+  // Anything that is not exactly what this version writes is ignored.
+  if (read(fd, &hdr, sizeof(hdr)) != (ssize_t) sizeof(hdr) || hdr.magic != HOSTDB_SNAPSHOT_MAGIC ||
+      hdr.version != HOSTDB_SNAPSHOT_VERSION || hdr.entry_size != sizeof(HostDBSnapshotEntry) ||
+      hdr.addr_size != sizeof(HostDBSnapshotAddr) || fstat(fd, &st) < 0 ||
+      (size_t) st.st_size != sizeof(HostDBSnapshotHeader) + (size_t) hdr.count * sizeof(HostDBSnapshotEntry) +
+                             (size_t) hdr.addr_count * sizeof(HostDBSnapshotAddr)) {
+    Warning("ignoring HostDB snapshot %s, it is not valid", path);
+    close(fd);
+    return false;
+  }
+  if (hdr.count == 0) {
+    close(fd);
+    return false;
+  }
+
+  mapped_size = st.st_size;
+  addr = mmap(NULL, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    Error("failed to map HostDB snapshot %s: %s", path, strerror(errno));
+    return false;
+  }
+
+  HostDBSnapshotHeader * h = (HostDBSnapshotHeader *) addr;
+  HostDBSnapshotEntry * e = (HostDBSnapshotEntry *) (h + 1);
+  HostDBSnapshotAddr * a = (HostDBSnapshotAddr *) (e + h->count);
+  uint8_t digest[sizeof(h->digest)];
+  bool valid;
+
+  snapshot_digest(digest, e, h->count * sizeof(HostDBSnapshotEntry), a, h->addr_count * sizeof(HostDBSnapshotAddr));
+  valid = !memcmp(digest, h->digest, sizeof(digest));
+  for (uint32_t i = 0; valid && i < h->count; ++i) {
+    valid = e[i].n_addrs > 0 && e[i].first_addr <= h->addr_count && e[i].n_addrs <= h->addr_count - e[i].first_addr &&
+      (AF_INET == e[i].family || AF_INET6 == e[i].family);
+  }
+  if (!valid) {
+    Warning("ignoring HostDB snapshot %s, it is corrupt", path);
+    munmap((caddr_t) addr, mapped_size);
+    return false;
+  }
+
+  header = h;
+  entries = e;
+  addrs = a;
+  Note("using HostDB snapshot %s with %u entries", path, header->count);
+  return true;
+}
+
+int
+HostDBSnapshot::get(uint64_t md5_high, IpAddr * ips, int max_ips, unsigned int & ttl) const
+{
+  uint32_t lo = 0, hi;
+
+  if (!is_warming())
+    return 0;
+
+  hi = header->count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (entries[mid].md5_high < md5_high)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == header->count || entries[lo].md5_high != md5_high)
+    return 0;
+
+  HostDBSnapshotEntry const & e = entries[lo];
+  int64_t now = time(NULL);
+  int n = 0;
+
+  if (e.expire <= now)
+    return 0;
+  for (; n < e.n_addrs && n < max_ips; ++n) {
+    uint8_t const * a = addrs[e.first_addr + n].addr;
+    if (AF_INET == e.family)
+      ips[n] = *reinterpret_cast<in_addr_t const *>(a);
+    else
+      ips[n] = *reinterpret_cast<in6_addr const *>(a);
+  }
+  ttl = (unsigned int) (e.expire - now);
+  return n;
+}
+
+static int
+snapshot_entry_cmp(const void * a, const void * b)
+{
+  uint64_t x = static_cast<HostDBSnapshotEntry const *>(a)->md5_high;
+  uint64_t y = static_cast<HostDBSnapshotEntry const *>(b)->md5_high;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+bool
+HostDBSnapshot::write(const char * path, HostDBSnapshotEntry * entries, uint32_t count,
+                      HostDBSnapshotAddr const * addrs, uint32_t addr_count)
+{
+  HostDBSnapshotHeader hdr;
+  char tmp[PATH_NAME_MAX + 1];
+  size_t size, out_size;
+  HostDBSnapshotAddr * out;
+  uint32_t n;
+  int fd;
+
+  qsort(entries, count, sizeof(HostDBSnapshotEntry), snapshot_entry_cmp);
+
+  // An entry can be in more than one level of the partitions, keep the newest.
+  n = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (n && entries[n - 1].md5_high == entries[i].md5_high) {
+      if (entries[i].expire > entries[n - 1].expire)
+        entries[n - 1] = entries[i];
+    } else {
+      entries[n++] = entries[i];
+    }
+  }
+  count = n;
+  size = (size_t) count * sizeof(HostDBSnapshotEntry);
+
+  // Lay the addresses out in entry order, without those of the dropped entries.
+  out = (HostDBSnapshotAddr *) ats_malloc(sizeof(HostDBSnapshotAddr) * (addr_count ? addr_count : 1));
+  n = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    ink_assert(entries[i].first_addr + entries[i].n_addrs <= addr_count);
+    memcpy(out + n, addrs + entries[i].first_addr, entries[i].n_addrs * sizeof(HostDBSnapshotAddr));
+    entries[i].first_addr = n;
+    n += entries[i].n_addrs;
+  }
+  out_size = (size_t) n * sizeof(HostDBSnapshotAddr);
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = HOSTDB_SNAPSHOT_MAGIC;
+  hdr.version = HOSTDB_SNAPSHOT_VERSION;
+  hdr.count = count;
+  hdr.entry_size = sizeof(HostDBSnapshotEntry);
+  hdr.addr_count = n;
+  hdr.addr_size = sizeof(HostDBSnapshotAddr);
+  hdr.written = time(NULL);
+  snapshot_digest(hdr.digest, entries, size, out, out_size);
+
+  // Readers of the old file keep their mapping, the new one replaces it in one step.
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  fd = ::open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    Error("failed to open HostDB snapshot %s: %s", tmp, strerror(errno));
+    ats_free(out);
+    return false;
+  }
+  if (::write(fd, &hdr, sizeof(hdr)) != (ssize_t) sizeof(hdr) ||
+      (size && ::write(fd, entries, size) != (ssize_t) size) ||
+      (out_size && ::write(fd, out, out_size) != (ssize_t) out_size) || fsync(fd) < 0) {
+    Error("failed to write HostDB snapshot %s: %s", tmp, strerror(errno));
+    close(fd);
+    unlink(tmp);
+    ats_free(out);
+    return false;
+  }
+  close(fd);
+  ats_free(out);
+  if (rename(tmp, path) < 0) {
+    Error("failed to rename HostDB snapshot %s: %s", tmp, strerror(errno));
+    unlink(tmp);
+    return false;
+  }
+  Debug("hostdb", "wrote HostDB snapshot %s with %u entries, %u addresses", path, count, hdr.addr_count);
+  return true;
+}
+
+#if TS_HAS_TESTS
+
+static void
+snapshot_test_entry(HostDBSnapshotEntry & e, HostDBSnapshotAddr * addrs, uint32_t & addr_count,
+                    uint64_t md5_high, int64_t expire, char const ** ips, int n)
+{
+  IpEndpoint ip;
+
+  memset(&e, 0, sizeof(e));
+  e.md5_high = md5_high;
+  e.expire = expire;
+  e.first_addr = addr_count;
+  e.n_addrs = n;
+  for (int i = 0; i < n; ++i) {
+    ats_ip_pton(ips[i], &ip.sa);
+    e.family = ip.sa.sa_family;
+    memset(addrs[addr_count].addr, 0, TS_IP6_SIZE);
+    memcpy(addrs[addr_count++].addr, ats_ip_addr8_cast(&ip.sa), ats_ip_addr_size(&ip.sa));
+  }
+}
+
+// Write a snapshot with a single address, a round robin and an IPv6 name,
+// read it back, then make sure a truncated or corrupt copy is not used.
+REGRESSION_TEST(HostDBSnapshot) (RegressionTest * t, int atype, int * pstatus)
+{
+  NOWARN_UNUSED(atype);
+  char const * single[] = { "192.0.2.1" };
+  char const * rr[] = { "192.0.2.10", "192.0.2.11", "192.0.2.12" };
+  char const * v6[] = { "2001:db8::1" };
+  HostDBSnapshotEntry entries[4];
+  HostDBSnapshotAddr addrs[8];
+  uint32_t addr_count = 0;
+  int64_t now = time(NULL);
+  char path[PATH_NAME_MAX + 1];
+  int const max_ips = 4;
+  IpAddr ips[max_ips];
+  unsigned int ttl = 0;
+  bool ok = true;
+
+  // Given out of order, with an expired entry.
+  snapshot_test_entry(entries[0], addrs, addr_count, 30, now + 300, rr, 3);
+  snapshot_test_entry(entries[1], addrs, addr_count, 10, now + 300, single, 1);
+  snapshot_test_entry(entries[2], addrs, addr_count, 20, now - 1, single, 1);
+  snapshot_test_entry(entries[3], addrs, addr_count, 40, now + 300, v6, 1);
+
+  snprintf(path, sizeof(path), "/tmp/hostdb_snapshot_test.%d", (int) getpid());
+  if (!HostDBSnapshot::write(path, entries, 4, addrs, addr_count)) {
+    rprintf(t, "failed to write %s\n", path);
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+
+  {
+    HostDBSnapshot snap;
+    IpEndpoint want;
+
+    if (!snap.open(path)) {
+      rprintf(t, "failed to open the snapshot\n");
+      ok = false;
+    } else {
+      if (snap.get(10, ips, max_ips, ttl) != 1 || 0 != ats_ip_pton(single[0], &want.sa) || ips[0] != want ||
+          ttl > 300) {
+        rprintf(t, "single address entry not read back\n");
+        ok = false;
+      }
+      if (snap.get(30, ips, max_ips, ttl) != 3) {
+        rprintf(t, "round robin entry did not keep its set\n");
+        ok = false;
+      } else {
+        for (int i = 0; i < 3; ++i) {
+          ats_ip_pton(rr[i], &want.sa);
+          if (ips[i] != want) {
+            rprintf(t, "round robin address %d not read back\n", i);
+            ok = false;
+          }
+        }
+      }
+      if (snap.get(30, ips, 2, ttl) != 2) {
+        rprintf(t, "round robin entry not cut to the space given\n");
+        ok = false;
+      }
+      if (snap.get(40, ips, max_ips, ttl) != 1 || 0 != ats_ip_pton(v6[0], &want.sa) || ips[0] != want) {
+        rprintf(t, "IPv6 entry not read back\n");
+        ok = false;
+      }
+      if (snap.get(20, ips, max_ips, ttl) != 0) {
+        rprintf(t, "expired entry was returned\n");
+        ok = false;
+      }
+      if (snap.get(25, ips, max_ips, ttl) != 0) {
+        rprintf(t, "missing entry was returned\n");
+        ok = false;
+      }
+    }
+  }
+
+  // Flip a bit of the last address, the digest no longer matches.
+  struct stat st;
+  int fd = ::open(path, O_RDWR);
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    rprintf(t, "failed to reopen %s\n", path);
+    ok = false;
+  } else {
+    uint8_t c;
+    if (pread(fd, &c, 1, st.st_size - 1) != 1 || (c ^= 1, pwrite(fd, &c, 1, st.st_size - 1) != 1)) {
+      rprintf(t, "failed to corrupt %s\n", path);
+      ok = false;
+    } else {
+      HostDBSnapshot snap;
+      if (snap.open(path)) {
+        rprintf(t, "corrupt snapshot was used\n");
+        ok = false;
+      }
+    }
+    // Cut the file short, its size no longer matches the header.
+    if (ftruncate(fd, st.st_size - 1) < 0) {
+      rprintf(t, "failed to truncate %s\n", path);
+      ok = false;
+    } else {
+      HostDBSnapshot snap;
+      if (snap.open(path)) {
+        rprintf(t, "truncated snapshot was used\n");
+        ok = false;
+      }
+    }
+  }
+  if (fd >= 0)
+    close(fd);
+  unlink(path);
+
+  *pstatus = ok ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+}
+
+#endif
@@ -58,6 +58,8 @@ extern unsigned int hostdb_ip_stale_interval;
 extern unsigned int hostdb_ip_timeout_interval;
 extern unsigned int hostdb_ip_fail_timeout_interval;
 extern unsigned int hostdb_serve_stale_but_revalidate;
+extern unsigned int hostdb_prefetch_fraction;
+extern unsigned int hostdb_prefetch_min_hits;
 
 
 static inline unsigned int
@@ -216,6 +218,19 @@ struct HostDBInfo
     return false;
   }
 
+  bool is_ip_prefetch() {
+    // the option is disabled
+    if (hostdb_prefetch_fraction <= 0)
+      return false;
+
+    // hostdb_prefetch_fraction == percentage of the DNS TTL after which a popular entry is refreshed
+    // The point is moved back by up to a tenth, so that names resolved at the same time don't
+    // all go to the resolver together.
+    uint64_t when = (uint64_t) ip_timeout_interval * hostdb_prefetch_fraction / 100;
+    when -= md5_low_low % (when / 10 + 1);
+    return ip_interval() >= when;
+  }
+
 
   //
   // Private
@@ -411,6 +426,13 @@ struct HostDBProcessor: public Processor
   );
 
 
+  /** Look up the address of @a hostname in the other family than @a addr, without
+      waiting for a lock or DNS. This is used to race the connections to both families.
+
+      @return @c true and the address in @a alternate if HostDB has a good one.
+  */
+  bool getbyname_alternate(const char *hostname, int len, sockaddr const* addr, IpEndpoint & alternate);
+
   /** Lookup Hostinfo by addr */
   Action *getbyaddr_re(Continuation * cont, sockaddr const* aip)
   {
@@ -45,6 +45,9 @@
 // HostDB files
 #include "P_DNS.h"
 #include "P_MultiCache.h"
+#include "P_HostDBFastCache.h"
+#include "P_HostDBNegativeCache.h"
+#include "P_HostDBSnapshot.h"
 #include "P_HostDBProcessor.h"
 
 
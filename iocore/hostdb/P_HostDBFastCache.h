@@ -0,0 +1,192 @@
+/** @file
+
+  A lock free lookup cache in front of the HostDB partitions
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_HOSTDB_FAST_CACHE_H_
+#define _P_HOSTDB_FAST_CACHE_H_
+
+#include "libts.h"
+
+/**
+  A direct mapped table of copies of HostDB entries.
+
+  Lookups in the MultiCache need the lock of the partition, and a lookup
+  that does not get it is retried later even if the entry is there. This
+  table sits in front of the partitions for the plain hits: a reader
+  copies the entry out of its slot without taking a lock or writing to
+  shared memory, and checks the sequence number of the slot before and
+  after the copy. If a writer was active at the same time it is a miss,
+  and the lookup goes through the partition as before.
+
+  Writers copy the new value into the slot and publish it by making the
+  sequence number even again. Writers to the same slot are serialized by
+  the sequence number itself, so no entry is ever freed under a reader.
+
+  The hits are sampled: each thread counts its hits locally and adds
+  HOSTDB_FAST_HIT_SAMPLE to the slot it hits every that many hits, so
+  the read path writes to shared memory only once in a while. The count
+  is handed to the partition entry by take_hits() when it is next
+  probed, so the entry still knows roughly how popular it is.
+
+  @a T must be copyable with memcpy.
+*/
+#define HOSTDB_FAST_HIT_SAMPLE 16
+
+template <class T>
+struct HostDBFastCache
+{
+  struct Slot
+  {
+    volatile uint32_t seq;      // odd while a writer is copying into the slot
+    volatile uint32_t hits;     // sampled, since the last take_hits()
+    uint64_t key[2];
+    T value;
+  };
+
+  HostDBFastCache() : slots(NULL), mask(0) { }
+
+  ~HostDBFastCache() {
+    if (slots)
+      ats_memalign_free(slots);
+  }
+
+  /// Allocate @a n slots, rounded up to a power of 2. No slots disables the cache.
+  void init(unsigned n)
+  {
+    unsigned size = 1;
+
+    if (n == 0)
+      return;
+    while (size < n)
+      size <<= 1;
+    slots = (Slot *)ats_memalign(64, sizeof(Slot) * size);
+    memset(slots, 0, sizeof(Slot) * size);
+    mask = size - 1;
+  }
+
+  bool enabled() const { return slots != NULL; }
+
+  bool get(INK_MD5 const& md5, T& value) const
+  {
+    if (!slots)
+      return false;
+
+    Slot *s = &slots[md5.b[0] & mask];
+    uint32_t seq = s->seq;
+
+    __sync_synchronize();
+    if ((seq & 1) || s->key[0] != md5.b[0] || s->key[1] != md5.b[1])
+      return false;
+    memcpy(&value, &s->value, sizeof(T));
+    __sync_synchronize();
+
+    if (s->seq != seq)
+      return false;
+    static __thread uint32_t thread_hits = 0;
+    if (++thread_hits >= HOSTDB_FAST_HIT_SAMPLE) {
+      thread_hits = 0;
+      ink_atomic_increment(&s->hits, HOSTDB_FAST_HIT_SAMPLE);
+    }
+    return true;
+  }
+
+  /// The hits on the copy of @a md5 since the last call.
+  uint32_t take_hits(INK_MD5 const& md5)
+  {
+    uint32_t hits = 0;
+
+    if (!slots)
+      return 0;
+
+    Slot *s = acquire(md5);
+    if (s->key[0] == md5.b[0] && s->key[1] == md5.b[1])
+      hits = ink_atomic_swap(&s->hits, (uint32_t) 0);
+    release(s);
+    return hits;
+  }
+
+  void put(INK_MD5 const& md5, T const& value)
+  {
+    if (!slots)
+      return;
+
+    Slot *s = acquire(md5);
+    if (s->key[0] != md5.b[0] || s->key[1] != md5.b[1])
+      ink_atomic_swap(&s->hits, (uint32_t) 0);
+    s->key[0] = md5.b[0];
+    s->key[1] = md5.b[1];
+    memcpy(&s->value, &value, sizeof(T));
+    release(s);
+  }
+
+  void remove(INK_MD5 const& md5)
+  {
+    if (!slots)
+      return;
+
+    Slot *s = acquire(md5);
+    if (s->key[0] == md5.b[0] && s->key[1] == md5.b[1]) {
+      s->key[0] = 0;
+      s->key[1] = 0;
+      ink_atomic_swap(&s->hits, (uint32_t) 0);
+    }
+    release(s);
+  }
+
+  /// Drop all the copies, when the partitions are cleared.
+  void clear()
+  {
+    for (uint64_t i = 0; slots && i <= mask; i++) {
+      Slot *s = acquire_slot(&slots[i]);
+      s->key[0] = 0;
+      s->key[1] = 0;
+      ink_atomic_swap(&s->hits, (uint32_t) 0);
+      release(s);
+    }
+  }
+
+private:
+  Slot *acquire(INK_MD5 const& md5)
+  {
+    return acquire_slot(&slots[md5.b[0] & mask]);
+  }
+
+  Slot *acquire_slot(Slot *s)
+  {
+    for (;;) {
+      uint32_t seq = s->seq;
+      if (!(seq & 1) && ink_atomic_cas(&s->seq, seq, seq + 1))
+        return s;
+    }
+  }
+
+  void release(Slot *s)
+  {
+    __sync_synchronize();
+    ink_atomic_increment(&s->seq, 1);
+  }
+
+  Slot *slots;
+  uint64_t mask;
+};
+
+#endif /* _P_HOSTDB_FAST_CACHE_H_ */
@@ -0,0 +1,130 @@
+/** @file
+
+  A cache of the names that do not exist, kept apart from the HostDB partitions
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_HOSTDB_NEGATIVE_CACHE_H_
+#define _P_HOSTDB_NEGATIVE_CACHE_H_
+
+#include "libts.h"
+#include "P_HostDBFastCache.h"
+
+#define HOSTDB_NEGATIVE_ZONES 4096
+
+struct HostDBNegativeInfo
+{
+  unsigned int expire;          // hostdb_current_interval at which the entry goes
+};
+
+/**
+  The lookups that got an answer saying the name (or the record) does not
+  exist, so that they are not sent to the nameservers again until the
+  negative TTL of the zone has passed.
+
+  The entries have their own table, so a flood of bad names can't push
+  good entries out of the partitions, and a new entry only replaces the
+  one in its slot. On top of that the entries of each zone are counted,
+  and a zone that has had more than its share in the last window does
+  not get new ones: the window is the longest negative TTL, so by its end
+  all the counted entries have expired. Zones are counted in a fixed set
+  of counters, and two zones that hash to the same one share it.
+
+*/
+struct HostDBNegativeCache
+{
+  HostDBNegativeCache() : zones(NULL) { }
+
+  ~HostDBNegativeCache() {
+    ats_free((void *) zones);
+  }
+
+  /// Allocate @a n entries. No entries disables the cache.
+  void init(unsigned n)
+  {
+    if (n == 0)
+      return;
+    table.init(n);
+    zones = (volatile uint64_t *) ats_malloc(sizeof(uint64_t) * HOSTDB_NEGATIVE_ZONES);
+    memset((void *) zones, 0, sizeof(uint64_t) * HOSTDB_NEGATIVE_ZONES);
+  }
+
+  bool enabled() const { return table.enabled(); }
+
+  /// Is there an entry for @a md5 that has not expired at @a now?
+  bool get(INK_MD5 const& md5, unsigned int now) const
+  {
+    HostDBNegativeInfo info;
+
+    if (!table.get(md5, info))
+      return false;
+    return (int) (info.expire - now) > 0;
+  }
+
+  /**
+    Add an entry for @a md5 in @a zone for @a ttl seconds, unless the
+    zone already has @a zone_max entries in the current @a window.
+
+    @return @c false if the zone is over its limit.
+  */
+  bool put(INK_MD5 const& md5, uint64_t zone, unsigned int now, unsigned int ttl, unsigned int window,
+           unsigned int zone_max)
+  {
+    volatile uint64_t *z = &zones[zone % HOSTDB_NEGATIVE_ZONES];
+
+    for (;;) {
+      uint64_t old = *z;
+      uint32_t start = (uint32_t) (old >> 32);
+      uint32_t count = (uint32_t) old;
+
+      if (now - start >= window) {
+        start = now;
+        count = 0;
+      }
+      if (count >= zone_max)
+        return false;
+      if (ink_atomic_cas(z, old, ((uint64_t) start << 32) | (count + 1)))
+        break;
+    }
+
+    HostDBNegativeInfo info;
+    info.expire = now + ttl;
+    table.put(md5, info);
+    return true;
+  }
+
+  void remove(INK_MD5 const& md5)
+  {
+    table.remove(md5);
+  }
+
+  void clear()
+  {
+    table.clear();
+    for (int i = 0; zones && i < HOSTDB_NEGATIVE_ZONES; i++)
+      zones[i] = 0;
+  }
+
+private:
+  HostDBFastCache<HostDBNegativeInfo> table;
+  volatile uint64_t *zones;     // start of the window << 32 | entries added in it
+};
+
+#endif /* _P_HOSTDB_NEGATIVE_CACHE_H_ */
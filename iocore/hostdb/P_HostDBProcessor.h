@@ -157,7 +157,13 @@ enum HostDB_Stats
   hostdb_ttl_stat,              // D average TTL
   hostdb_ttl_expires_stat,      // D == TTL Expires
   hostdb_re_dns_on_reload_stat,
+  hostdb_alternate_lookups_stat,
   hostdb_bytes_stat,
+  hostdb_fast_hits_stat,
+  hostdb_prefetch_stat,
+  hostdb_negative_hits_stat,
+  hostdb_negative_zone_limited_stat,
+  hostdb_snapshot_hits_stat,
   HostDB_Stat_Count
 };
 
@@ -201,6 +207,10 @@ struct HostDBCache: public MultiCache<HostDBInfo>
 {
   int rebuild_callout(HostDBInfo * e, RebuildMC & r);
   int start(int flags = 0);
+  // These also drop the lookup caches in front of the partitions.
+  void reset();
+  void clear();
+  void clear_but_heap();
   MultiCacheBase *dup()
   {
     return NEW(new HostDBCache);
@@ -464,6 +474,7 @@ struct HostDBContinuation: public Continuation
   unsigned int missing:1;
   unsigned int force_dns:1;
   unsigned int round_robin:1;
+  unsigned int negative_hit:1; ///< The lookup is answered from the negative cache.
 
   int probeEvent(int event, Event * e);
   int clusterEvent(int event, Event * e);
@@ -478,6 +489,7 @@ struct HostDBContinuation: public Continuation
   /// Recompute the MD5 and update ancillary values.
   void refresh_MD5();
   void do_dns();
+  void do_alternate_dns();
   bool is_byname()
   {
     return md5.db_mark == HOSTDB_MARK_IPV4 || md5.db_mark == HOSTDB_MARK_IPV6;
@@ -524,7 +536,7 @@ HostDBContinuation():
     dns_lookup_timeout(DEFAULT_OPTIONS.timeout),
     timeout(0), from(0),
     from_cont(0), probe_depth(0), missing(false),
-    force_dns(DEFAULT_OPTIONS.force_dns), round_robin(false) {
+    force_dns(DEFAULT_OPTIONS.force_dns), round_robin(false), negative_hit(false) {
     ink_zero(md5_host_name_store);
     ink_zero(md5.hash);
     SET_HANDLER((HostDBContHandler) & HostDBContinuation::probeEvent);
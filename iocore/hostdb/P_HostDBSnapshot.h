@@ -0,0 +1,107 @@
+/** @file
+
+  A read only snapshot of the HostDB entries, for a warm restart
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_HOSTDB_SNAPSHOT_H_
+#define _P_HOSTDB_SNAPSHOT_H_
+
+#include "libts.h"
+
+#define HOSTDB_SNAPSHOT_MAGIC     0x48444253  // "HDBS"
+#define HOSTDB_SNAPSHOT_VERSION   2
+
+struct HostDBSnapshotHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t entry_size;
+  uint32_t addr_count;
+  uint32_t addr_size;
+  int64_t written;              // wall clock seconds
+  uint8_t digest[16];           // MD5 of the entries and addresses
+};
+
+struct HostDBSnapshotEntry
+{
+  uint64_t md5_high;            // second half of the HostDBMD5 hash
+  int64_t expire;               // wall clock seconds
+  uint32_t first_addr;          // index of the first address
+  uint16_t n_addrs;             // more than one for a round robin name
+  uint8_t family;
+  uint8_t pad;
+};
+
+struct HostDBSnapshotAddr
+{
+  uint8_t addr[TS_IP6_SIZE];
+};
+
+/**
+  The forward lookups of HostDB, written out every sync period as an
+  array of fixed size entries sorted on their hash, followed by the
+  addresses they point to. A round robin name keeps its whole set.
+
+  At startup the last snapshot is mapped read only and looked up with a
+  binary search whenever a name is not in the partitions yet, so the
+  hosts known before the restart don't wait for DNS, whatever the state
+  of the partition files. The entries keep their original expiry time.
+  Lookups stop once this run has written its first snapshot, by then the
+  partitions hold the names in use. A file that is short, has a bad
+  digest or points outside its addresses is not used.
+  The mapping stays for the whole run: new snapshots are written to a
+  new file that is renamed over the old one.
+
+*/
+class HostDBSnapshot
+{
+public:
+  HostDBSnapshot();
+  ~HostDBSnapshot();
+
+  bool open(const char * path);
+  bool is_open() const { return header != NULL; }
+  bool is_warming() const { return header != NULL && warming; }
+  void end_warmup() { warming = false; }
+
+  /// Find @a md5_high, set up to @a max_ips of its addresses in @a ips and
+  /// the seconds it has left in @a ttl. Returns the number of addresses set.
+  int get(uint64_t md5_high, IpAddr * ips, int max_ips, unsigned int & ttl) const;
+
+  /// Sort @a entries and write them with their @a addrs to @a path.
+  static bool write(const char * path, HostDBSnapshotEntry * entries, uint32_t count,
+                    HostDBSnapshotAddr const * addrs, uint32_t addr_count);
+
+private:
+  HostDBSnapshotHeader * header;
+  HostDBSnapshotEntry * entries;
+  HostDBSnapshotAddr * addrs;
+  size_t mapped_size;
+  volatile bool warming;
+
+  HostDBSnapshot(const HostDBSnapshot&);
+  HostDBSnapshot& operator=(const HostDBSnapshot&);
+};
+
+extern HostDBSnapshot hostDBSnapshot;
+
+#endif /* _P_HOSTDB_SNAPSHOT_H_ */
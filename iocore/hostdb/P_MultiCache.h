@@ -276,9 +276,9 @@ struct MultiCacheBase: public MultiCacheHeader
   bool verify_header();
 
   int unmap_data();
-  void reset();
-  void clear();                 // this zeros the data
-  void clear_but_heap();
+  virtual void reset();
+  virtual void clear();         // this zeros the data
+  virtual void clear_but_heap();
 
   virtual MultiCacheBase *dup()
   {
@@ -279,6 +279,34 @@ public:
     return connect_s(cont, ats_ip_sa_cast(&addr), timeout, opts);
   }
 
+  /**
+    Race the connections to two addresses of the same host, usually
+    one of each address family (RFC 6555). The connection to @a addr
+    is started first, the one to @a alternate after @a delay or as
+    soon as the first one fails. The cont is called back once with the
+    first connection that is established, the other one is closed.
+    Callbacks are the same as for connect_s(). The attempts are made
+    with this processor, so that sslNetProcessor races TLS connections.
+
+    @param cont Continuation to be called back with events.
+    @param addr Preferred address to connect to (includes port).
+    @param alternate Address to connect to if @a addr is slow or fails.
+    @param delay Time to wait for @a addr before trying @a alternate.
+    @param timeout Connect timeout of each address, in seconds.
+    @param opts @see NetVCOptions. The family is set per address.
+
+    @see connect_s()
+
+  */
+  Action *connect_race(
+    Continuation * cont,
+    sockaddr const* addr,
+    sockaddr const* alternate,
+    ink_hrtime delay,
+    int timeout = NET_CONNECT_TIMEOUT,
+    NetVCOptions * opts = NULL
+  );
+
   /**
     Starts the Netprocessor. This has to be called before doing any
     other net call.
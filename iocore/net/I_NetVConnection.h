@@ -163,6 +163,14 @@ struct NetVCOptions {
 
   EventType etype;
 
+  /** Hash of the origin server name, for outbound SSL connections.
+
+      The SSL session of the last connection to the same address, port
+      and name is resumed. The HTTP state machine uses the folded MMH of
+      the host name, the key of the server session pool.
+  */
+  uint64_t origin_name_hash;
+
   /// Reset all values to defaults.
   void reset();
 
@@ -33,12 +33,20 @@
 
 RecRawStatBlock *net_rsb = NULL;
 int net_config_poll_timeout = DEFAULT_POLL_TIMEOUT;
+int net_numa_accept_steering = 0;
+int net_zerocopy_writes = 0;
+int net_zerocopy_min_bytes = 16384;
+int net_adaptive_read_buffers = 0;
 
 static inline void
 configure_net(void)
 {
   REC_RegisterConfigUpdateFunc("proxy.config.net.connections_throttle", change_net_connections_throttle, NULL);
   REC_ReadConfigInteger(fds_throttle, "proxy.config.net.connections_throttle");
+  REC_ReadConfigInteger(net_numa_accept_steering, "proxy.config.net.numa_accept_steering");
+  REC_ReadConfigInteger(net_zerocopy_writes, "proxy.config.net.zerocopy_writes");
+  REC_ReadConfigInteger(net_zerocopy_min_bytes, "proxy.config.net.zerocopy_min_bytes");
+  REC_ReadConfigInteger(net_adaptive_read_buffers, "proxy.config.net.adaptive_read_buffers");
 }
 
 
@@ -129,6 +137,94 @@ register_net_stats()
                      RECD_INT, RECP_NULL, (int) inactivity_cop_lock_acquire_failure_stat,
                      RecRawStatSyncSum);
 
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.net.accepts_numa_local",
+                     RECD_INT, RECP_NULL, (int) net_accepts_numa_local_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.net.accepts_numa_remote",
+                     RECD_INT, RECP_NULL, (int) net_accepts_numa_remote_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.net.zerocopy_writes",
+                     RECD_INT, RECP_NULL, (int) net_zerocopy_writes_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.net.zerocopy_write_bytes",
+                     RECD_INT, RECP_NULL, (int) net_zerocopy_write_bytes_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.net.zerocopy_copied",
+                     RECD_INT, RECP_NULL, (int) net_zerocopy_copied_stat, RecRawStatSyncSum);
+
+  // Server side SSL handshakes, the resumed ones are the full handshakes saved
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.user_agent_sessions",
+                     RECD_INT, RECP_NULL, (int) net_ssl_handshakes_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.user_agent_session_reused",
+                     RECD_INT, RECP_NULL, (int) net_ssl_sessions_reused_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.session_cache_hits",
+                     RECD_INT, RECP_NULL, (int) net_ssl_session_cache_hits_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.session_cache_misses",
+                     RECD_INT, RECP_NULL, (int) net_ssl_session_cache_misses_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.session_cache_evictions",
+                     RECD_INT, RECP_NULL, (int) net_ssl_session_cache_evictions_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.session_ticket_renewed",
+                     RECD_INT, RECP_NULL, (int) net_ssl_ticket_renewed_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.session_ticket_key_not_found",
+                     RECD_INT, RECP_NULL, (int) net_ssl_ticket_key_not_found_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.origin_server_full_handshakes",
+                     RECD_INT, RECP_NULL, (int) net_ssl_origin_full_handshakes_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.origin_server_resumed_handshakes",
+                     RECD_INT, RECP_NULL, (int) net_ssl_origin_resumed_handshakes_stat, RecRawStatSyncSum);
+
+  // Offloaded handshake steps, and their time waiting for a crypto thread and to get back
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.handshake_offloads",
+                     RECD_INT, RECP_NULL, (int) net_ssl_handshake_offloads_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.handshake_offload_queue_usecs",
+                     RECD_INT, RECP_NULL, (int) net_ssl_handshake_offload_queue_usecs_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.handshake_offload_resume_usecs",
+                     RECD_INT, RECP_NULL, (int) net_ssl_handshake_offload_resume_usecs_stat, RecRawStatSyncSum);
+
+  // Certificates loaded on their first handshake, see proxy.config.ssl.server.multicert.lazy_load
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.lazy_context_loads",
+                     RECD_INT, RECP_NULL, (int) net_ssl_lazy_context_loads_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.ssl.lazy_context_load_failures",
+                     RECD_INT, RECP_NULL, (int) net_ssl_lazy_context_load_failures_stat, RecRawStatSyncSum);
+
+  // Raced connections won by each address family, see NetProcessor::connect_race
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.net.connect_race_ipv4_wins",
+                     RECD_INT, RECP_NULL, (int) net_connect_race_ipv4_wins_stat, RecRawStatSyncSum);
+
+  RecRegisterRawStat(net_rsb, RECT_PROCESS,
+                     "proxy.process.net.connect_race_ipv6_wins",
+                     RECD_INT, RECP_NULL, (int) net_connect_race_ipv6_wins_stat, RecRawStatSyncSum);
+
 }
 
 void
@@ -51,6 +51,27 @@ enum Net_Stats
   socks_connections_unsuccessful_stat,
   socks_connections_currently_open_stat,
   inactivity_cop_lock_acquire_failure_stat,
+  net_accepts_numa_local_stat,
+  net_accepts_numa_remote_stat,
+  net_zerocopy_writes_stat,
+  net_zerocopy_write_bytes_stat,
+  net_zerocopy_copied_stat,
+  net_ssl_handshakes_stat,
+  net_ssl_sessions_reused_stat,
+  net_ssl_session_cache_hits_stat,
+  net_ssl_session_cache_misses_stat,
+  net_ssl_session_cache_evictions_stat,
+  net_ssl_ticket_renewed_stat,
+  net_ssl_ticket_key_not_found_stat,
+  net_ssl_origin_full_handshakes_stat,
+  net_ssl_origin_resumed_handshakes_stat,
+  net_ssl_handshake_offloads_stat,
+  net_ssl_handshake_offload_queue_usecs_stat,
+  net_ssl_handshake_offload_resume_usecs_stat,
+  net_ssl_lazy_context_loads_stat,
+  net_ssl_lazy_context_load_failures_stat,
+  net_connect_race_ipv4_wins_stat,
+  net_connect_race_ipv6_wins_stat,
   Net_Stat_Count
 };
 
@@ -29,22 +29,82 @@
 
 struct SSLConfigParams;
 struct SSLContextStorage;
+struct SSLCertLookup;
+
+// A certificate that is indexed by its names up front, but only loaded into a SSL_CTX when one of its
+// names is first looked up. The paths are as they appear in ssl_multicert.config.
+struct SSLLazyContext
+{
+  SSLLazyContext(const char * cert, const char * ca, const char * key);
+  ~SSLLazyContext();
+
+  char *    cert;
+  char *    ca;
+  char *    key;
+  SSL_CTX * ctx;      // NULL unless the certificate is loaded
+  bool      failed;   // the certificate failed to load
+
+  // The configuration the certificate was indexed with, which is the one it is loaded with. The lookup
+  // holds the reference to it.
+  const SSLConfigParams * params;
+
+  LINK(SSLLazyContext, link);
+};
+
+typedef SSL_CTX * (*SSLLazyLoadFunction)(SSLCertLookup * lookup, const SSLLazyContext * lazy);
 
 struct SSLCertLookup : public ConfigInfo
 {
   SSLContextStorage * ssl_storage;
   SSL_CTX *           ssl_default;
 
+  // Lazily loaded certificates. At most lazy_max_contexts of them are loaded at a time (0 for no
+  // limit); the least recently used ones are unloaded to make room.
+  SSLLazyLoadFunction lazy_loader;
+  unsigned            lazy_max_contexts;
+
+  // The configuration the lookup is built with, with a reference that the lookup releases. Set it
+  // before creating lazy certificates.
+  SSLConfigParams *   lazy_params;
+
   bool insert(SSL_CTX * ctx, const char * name);
   bool insert(SSL_CTX * ctx, const IpEndpoint& address);
+  bool insert(SSLLazyContext * lazy, const char * name);
+
+  // Create a lazy certificate owned by this lookup.
+  SSLLazyContext * newLazyContext(const char * cert, const char * ca, const char * key);
+
+  // Find the context for a name or address. This does not load lazy certificates.
   SSL_CTX * findInfoInHash(const char * address) const;
   SSL_CTX * findInfoInHash(const IpEndpoint& address) const;
 
+  // Find the context for a name, loading it if the certificate is lazy. The context is returned with
+  // a reference which the caller must release with SSL_CTX_free(), since a lazy context can be
+  // unloaded at any time.
+  SSL_CTX * findContext(const char * name);
+
+  // Find the context for a name like findContext(), but without loading a lazy certificate. If the
+  // certificate is not loaded, NULL is returned and @a lazy is set to it, so that it can be loaded
+  // with load() on a thread that can wait for the disk.
+  SSL_CTX * findContext(const char * name, SSLLazyContext ** lazy);
+
+  // Return the context of a lazy certificate with a reference, loading it if needed.
+  SSL_CTX * load(SSLLazyContext * lazy);
+
+  // Build the lookup index from the inserted names. Call this before the lookup is published.
+  void compile();
+
   // Return the last-resort default TLS context if there is no name or address match.
   SSL_CTX * defaultContext() const { return ssl_default; }
 
   SSLCertLookup();
   virtual ~SSLCertLookup();
+
+private:
+  ink_mutex                 lazy_mutex;
+  Que(SSLLazyContext, link) lazy_lru;
+  unsigned                  lazy_loaded;
+  Vec<SSLLazyContext *>     lazy_contexts;
 };
 
 #endif /* __P_SSLCERTLOOKUP_H__ */
@@ -35,6 +35,16 @@
 
 struct SSLCertLookup;
 
+// A session ticket key. The first key of the key file encrypts new
+// tickets, the others are only used to decrypt the tickets issued
+// before the last rotation.
+struct ssl_ticket_key_t
+{
+  unsigned char key_name[16];
+  unsigned char hmac_secret[16];
+  unsigned char aes_key[16];
+};
+
 /////////////////////////////////////////////////////////////
 //
 // struct SSLConfigParams
@@ -49,7 +59,8 @@ struct SSLConfigParams : public ConfigInfo
   enum SSL_SESSION_CACHE_MODE
   {
     SSL_SESSION_CACHE_MODE_OFF = 0,
-    SSL_SESSION_CACHE_MODE_SERVER = 1
+    SSL_SESSION_CACHE_MODE_SERVER = 1,
+    SSL_SESSION_CACHE_MODE_SHARED = 2
   };
 
   SSLConfigParams();
@@ -66,6 +77,17 @@ struct SSLConfigParams : public ConfigInfo
   int     verify_depth;
   int     ssl_session_cache; // SSL_SESSION_CACHE_MODE
   int     ssl_session_cache_size;
+  char *  ssl_session_cache_path;
+  int     ssl_session_tickets;
+  int     ssl_origin_session_cache;
+  int     ssl_origin_session_cache_size;
+  int     handshake_offload_threads;
+  int     ssl_lazy_load;
+  int     ssl_lazy_max_contexts;
+  ssl_ticket_key_t * ticket_keys;
+  unsigned n_ticket_keys;
+  char *  ticket_key_path;
+  time_t  ticket_key_mtime;
 
   char *  clientCertPath;
   char *  clientKeyPath;
@@ -62,6 +62,10 @@ public:
 
   static EventType ET_SSL;
 
+  // Threads for the private key work of server handshakes, if any.
+  static EventType ET_SSL_CRYPTO;
+  static bool handshake_offload;
+
   //
   // Private
   //
@@ -60,6 +60,9 @@ class SSLNextProtocolSet;
 //  A VConnection for a network socket.
 //
 //////////////////////////////////////////////////////////////////
+struct SSLCertLookup;
+struct SSLLazyContext;
+
 class SSLNetVConnection:public UnixNetVConnection
 {
 public:
@@ -78,6 +81,22 @@ public:
   {
     sslHandShakeComplete = state;
   };
+  virtual bool getSSLHandShakeOffloaded()
+  {
+    return sslHandShakeOffloaded;
+  };
+  void sslHandShakeOffloadDone(int ret, int err);
+
+  // Load a lazy certificate that the server handshake needs on an ET_TASK thread. The handshake
+  // waits for it, and picks the context up with takeLoadedCertificate() when it is run again.
+  void sslLoadCertificate(SSLCertLookup * lookup, SSLLazyContext * lazy);
+  void sslCertificateLoaded(SSL_CTX * ctx);
+  SSL_CTX * takeLoadedCertificate()
+  {
+    SSL_CTX * ctx = sslLoadedCtx;
+    sslLoadedCtx = NULL;
+    return ctx;
+  };
   virtual bool getSSLClientConnection()
   {
     return sslClientConnection;
@@ -117,6 +136,19 @@ private:
 
   bool sslHandShakeComplete;
   bool sslClientConnection;
+
+  // Server handshake steps run on the ET_SSL_CRYPTO threads when enabled,
+  // the net thread leaves the VC alone while one is running, or while a
+  // certificate is loading for the handshake.
+  volatile bool sslHandShakeOffloaded;
+  bool sslHandShakeOffloadIOReady;
+  bool sslHandShakeOffloadResult;
+  int sslHandShakeOffloadRet;
+  int sslHandShakeOffloadErr;
+  SSL_CTX * sslLoadedCtx; // a lazy certificate loaded for the handshake, with a reference
+
+  void sslHandShakeResume();
+
   const SSLNextProtocolSet * npnSet;
   Continuation * npnEndpoint;
 };
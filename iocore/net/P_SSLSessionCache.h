@@ -0,0 +1,135 @@
+/** @file
+
+  Shared SSL session cache
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __P_SSLSESSIONCACHE_H__
+#define __P_SSLSESSIONCACHE_H__
+
+#include "libts.h"
+#include "P_SSLUtils.h"
+
+#define SSL_SESSION_CACHE_MAGIC     0x53534c43  // "SSLC"
+#define SSL_SESSION_CACHE_VERSION   1
+#define SSL_SESSION_CACHE_WAYS      4
+#define SSL_SESSION_CACHE_DER_MAX   2048
+#define SSL_SESSION_CACHE_LOCKS     64
+
+struct SSLSessionCacheHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nsets;
+  uint32_t slot_size;
+};
+
+struct SSLSessionSlot
+{
+  int64_t expire;               // wall clock seconds, 0 if the slot is free
+  uint32_t der_len;
+  uint32_t id_len;
+  unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+  unsigned char der[SSL_SESSION_CACHE_DER_MAX];
+};
+
+/**
+  A server session cache shared by all the server contexts.
+
+  The cache replaces the internal OpenSSL cache of every server context
+  when proxy.config.ssl.session_cache is 2. Sessions are stored in their
+  DER encoding in a set associative table. The table is in anonymous
+  memory unless a path is given; a file can be mapped again after a
+  restart and the sessions in it resumed, but it holds the session
+  master secrets unencrypted and is kept at mode 0600. Sessions larger
+  than SSL_SESSION_CACHE_DER_MAX (e.g. with large client certificates)
+  are not cached.
+
+*/
+class SSLSessionCache
+{
+public:
+  SSLSessionCache();
+
+  bool open(const char * path, int nsessions); // path NULL keeps the cache in memory
+  void attach(SSL_CTX * ctx);
+  bool is_open() const { return header != NULL; }
+
+private:
+  static int new_session(SSL * ssl, SSL_SESSION * sess);
+  static SSL_SESSION * get_session(SSL * ssl, ssl_session_id_t id, int len, int * copy);
+  static void remove_session(SSL_CTX * ctx, SSL_SESSION * sess);
+
+  SSLSessionSlot * find_set(const unsigned char * id, unsigned len, ink_mutex ** lock);
+
+  SSLSessionCacheHeader * header;
+  SSLSessionSlot * slots;
+  size_t mapped_size;
+  ink_mutex locks[SSL_SESSION_CACHE_LOCKS];
+
+  SSLSessionCache(const SSLSessionCache&);
+  SSLSessionCache& operator=(const SSLSessionCache&);
+};
+
+extern SSLSessionCache sslSessionCache;
+
+struct SSLOriginSession
+{
+  IpEndpoint addr;
+  uint64_t name_hash;
+  ink_hrtime stored;
+  SSL_SESSION * session;
+};
+
+/**
+  The last SSL session to each origin server.
+
+  Sessions are stored from the new session callback of the client
+  context and keyed on the remote address and port and the origin name
+  hash of the connection options, so that a new connection to the same
+  origin resumes instead of doing a full handshake.
+
+*/
+class SSLOriginSessionCache
+{
+public:
+  SSLOriginSessionCache();
+
+  void init(int nsessions);
+  void attach(SSL_CTX * ctx);
+  bool resume(SSL * ssl, sockaddr const * addr, uint64_t name_hash);
+  void remove(sockaddr const * addr, uint64_t name_hash);
+
+private:
+  static int new_session(SSL * ssl, SSL_SESSION * sess);
+
+  SSLOriginSession * find_set(sockaddr const * addr, uint64_t name_hash, ink_mutex ** lock);
+
+  SSLOriginSession * slots;
+  uint32_t nsets;
+  ink_mutex locks[SSL_SESSION_CACHE_LOCKS];
+
+  SSLOriginSessionCache(const SSLOriginSessionCache&);
+  SSLOriginSessionCache& operator=(const SSLOriginSessionCache&);
+};
+
+extern SSLOriginSessionCache sslOriginSessionCache;
+
+#endif /* __P_SSLSESSIONCACHE_H__ */
@@ -34,6 +34,13 @@
 
 struct SSLConfigParams;
 struct SSLCertLookup;
+struct ssl_ticket_key_t;
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+typedef const unsigned char * ssl_session_id_t;
+#else
+typedef unsigned char * ssl_session_id_t;
+#endif
 
 // Create a default SSL server context.
 SSL_CTX * SSLDefaultServerContext();
@@ -58,6 +65,9 @@ void SSLError(const char * fmt, ...) TS_PRINTFLIKE(1, 2);
 // Log a SSL network buffer.
 void SSLDebugBufferPrint(const char * tag, const char * buffer, unsigned buflen, const char * message);
 
+// Load the session ticket keys from a file of ssl_ticket_key_t records.
+ssl_ticket_key_t * SSLLoadTicketKeys(const char * path, unsigned * nkeys);
+
 // Load the SSL certificate configuration.
 bool SSLParseCertificateConfiguration(const SSLConfigParams * params, SSLCertLookup * lookup);
 
@@ -130,6 +130,10 @@ extern ink_hrtime emergency_throttle_time;
 extern int net_connections_throttle;
 extern int fds_throttle;
 extern int fds_limit;
+extern int net_numa_accept_steering;
+extern int net_zerocopy_writes;
+extern int net_zerocopy_min_bytes;
+extern int net_adaptive_read_buffers;
 extern ink_hrtime last_transient_accept_error;
 extern int http_accept_port_number;
 
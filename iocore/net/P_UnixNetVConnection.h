@@ -65,6 +65,7 @@ NetVCOptions::reset()
   packet_tos = 0;
 
   etype = ET_NET;
+  origin_name_hash = 0;
 }
 
 TS_INLINE void
@@ -96,6 +97,16 @@ struct OOB_callback:public Continuation
   }
 };
 
+// A write sent with MSG_ZEROCOPY: the kernel reads the data straight
+// from our buffers, so they are kept until it reports send number
+// seq complete on the socket error queue.
+struct ZeroCopySend
+{
+  uint32_t seq;
+  Ptr<IOBufferBlock> blocks;
+  LINK(ZeroCopySend, link);
+};
+
 class UnixNetVConnection:public NetVConnection
 {
 public:
@@ -173,6 +184,9 @@ public:
   virtual bool getSSLHandShakeComplete() {
     return (true);
   }
+  virtual bool getSSLHandShakeOffloaded() {
+    return (false);
+  }
   virtual bool getSSLClientConnection()
   {
     return (false);
@@ -233,6 +247,12 @@ public:
   ink_hrtime submit_time;
   OOB_callback *oob_ptr;
   bool from_accept_thread;
+  int64_t read_size_hint;       // bytes to offer the next read with adaptive read buffers
+
+  int zerocopy;                 // 0 not tried yet, 1 SO_ZEROCOPY set, -1 not supported
+  uint32_t zerocopy_seq;
+  Que(ZeroCopySend, link) zerocopy_sends;
+  void reap_zerocopy();
 
   int startEvent(int event, Event *e);
   int acceptEvent(int event, Event *e);
@@ -28,8 +28,7 @@
 #include "P_SSLConfig.h"
 #include "I_EventSystem.h"
 #include "I_Layout.h"
-#include "Regex.h"
-#include "Trie.h"
+#include "ParseRules.h"
 #include "ts/TestBox.h"
 
 struct SSLAddressLookupKey
@@ -68,96 +67,297 @@ private:
   unsigned char sep; // offset of address/port separator
 };
 
+// A name as it is stored in the trie: lower case, with the DNS labels in
+// reverse order (com.example.www). The sequence number makes the sort stable
+// so that the last insert of a name wins, as it did with the hash table.
+struct SSLNameEntry
+{
+  char *            name;
+  size_t            len;
+  SSL_CTX *         ctx;
+  SSLLazyContext *  lazy;     // the certificate to load if ctx is NULL
+  bool              wildcard;
+  unsigned          seq;
+};
+
+// The compiled, read only name index. The nodes, edges and labels are each
+// kept in one flat array, and the edges of a node are contiguous and sorted
+// by label, so a lookup is one binary search per label without chasing
+// pointers through the heap.
+struct SSLNameTrie
+{
+  struct Node
+  {
+    uint32_t  edges;      // index of the first edge
+    uint32_t  nedges;
+    const SSLNameEntry * exact;     // the name that ends here
+    const SSLNameEntry * wildcard;  // the wildcard for this name and every name below it
+  };
+
+  struct Edge
+  {
+    uint32_t  label;      // offset of the label in the label pool
+    uint32_t  length;
+    uint32_t  node;
+  };
+
+  SSLNameTrie() : nodes(NULL), edges(NULL), labels(NULL), nnodes(0), nedges(0), nlabels(0) {}
+  ~SSLNameTrie() {
+    ats_free(nodes);
+    ats_free(edges);
+    ats_free(labels);
+  }
+
+  static SSLNameTrie * compile(Vec<SSLNameEntry *>& entries);
+  const SSLNameEntry * lookup(const char * name, size_t len) const;
+
+private:
+  void build(SSLNameEntry ** entries, unsigned count, size_t offset, uint32_t node);
+
+  Node *    nodes;
+  Edge *    edges;
+  char *    labels;
+  uint32_t  nnodes;
+  uint32_t  nedges;
+  uint32_t  nlabels;
+};
+
 struct SSLContextStorage
 {
   SSLContextStorage();
   ~SSLContextStorage();
 
-  bool insert(SSL_CTX * ctx, const char * name);
-  SSL_CTX * lookup(const char * name) const;
+  bool insert(SSL_CTX * ctx, SSLLazyContext * lazy, const char * name);
+  const SSLNameEntry * lookup(const char * name) const;
+
+  // Build the trie from the names inserted so far. This must be done before
+  // the storage is shared with other threads; a lookup on a storage that has
+  // names which are not compiled yet compiles them first.
+  void compile();
 
 private:
-  struct SSLEntry
-  {
-    explicit SSLEntry(SSL_CTX * c) : ctx(c) {}
+  Vec<SSLNameEntry *> entries;
+  SSLNameTrie *       trie;
+  bool                dirty;
+  Vec<SSL_CTX *>      references;
+};
 
-    void Print() const { Debug("ssl", "SSLEntry=%p SSL_CTX=%p", this, ctx); }
+static void
+ssl_context_reference(SSL_CTX * ctx)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+  SSL_CTX_up_ref(ctx);
+#else
+  CRYPTO_add(&ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
+#endif
+}
 
-    SSL_CTX * ctx;
-    LINK(SSLEntry, link);
-  };
+SSLLazyContext::SSLLazyContext(const char * c, const char * a, const char * k)
+  : cert(ats_strdup(c)), ca(ats_strdup(a)), key(ats_strdup(k)), ctx(NULL), failed(false), params(NULL)
+{
+}
 
-  Trie<SSLEntry>  wildcards;
-  InkHashTable *  hostnames;
-  Vec<SSL_CTX *>  references;
-};
+SSLLazyContext::~SSLLazyContext()
+{
+  if (this->ctx) {
+    SSL_CTX_free(this->ctx);
+  }
+
+  ats_free(this->cert);
+  ats_free(this->ca);
+  ats_free(this->key);
+}
 
 SSLCertLookup::SSLCertLookup()
-  : ssl_storage(NEW(new SSLContextStorage())), ssl_default(NULL)
+  : ssl_storage(NEW(new SSLContextStorage())), ssl_default(NULL),
+    lazy_loader(NULL), lazy_max_contexts(0), lazy_params(NULL), lazy_loaded(0)
 {
+  ink_mutex_init(&this->lazy_mutex, "SSLCertLookup::lazy_mutex");
 }
 
 SSLCertLookup::~SSLCertLookup()
 {
   delete this->ssl_storage;
+
+  for (int i = 0; i < this->lazy_contexts.length(); ++i) {
+    delete this->lazy_contexts[i];
+  }
+
+  if (this->lazy_params) {
+    SSLConfig::release(this->lazy_params);
+  }
+
+  ink_mutex_destroy(&this->lazy_mutex);
 }
 
 SSL_CTX *
 SSLCertLookup::findInfoInHash(const char * address) const
 {
-  return this->ssl_storage->lookup(address);
+  const SSLNameEntry * entry = this->ssl_storage->lookup(address);
+  return entry ? entry->ctx : NULL;
 }
 
 SSL_CTX *
 SSLCertLookup::findInfoInHash(const IpEndpoint& address) const
 {
-  SSL_CTX * ctx;
+  const SSLNameEntry * entry;
   SSLAddressLookupKey key(address);
 
   // First try the full address.
-  if ((ctx = this->ssl_storage->lookup(key.get()))) {
-    return ctx;
+  if ((entry = this->ssl_storage->lookup(key.get()))) {
+    return entry->ctx;
   }
 
   // If that failed, try the address without the port.
   if (address.port()) {
     key.split();
-    return this->ssl_storage->lookup(key.get());
+    entry = this->ssl_storage->lookup(key.get());
+    return entry ? entry->ctx : NULL;
   }
 
   return NULL;
 }
 
+SSL_CTX *
+SSLCertLookup::findContext(const char * name)
+{
+  const SSLNameEntry * entry = this->ssl_storage->lookup(name);
+
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  if (entry->lazy) {
+    return this->load(entry->lazy);
+  }
+
+  ssl_context_reference(entry->ctx);
+  return entry->ctx;
+}
+
+SSL_CTX *
+SSLCertLookup::findContext(const char * name, SSLLazyContext ** lazy)
+{
+  const SSLNameEntry * entry = this->ssl_storage->lookup(name);
+  SSL_CTX * ctx;
+
+  *lazy = NULL;
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  if (entry->lazy == NULL) {
+    ssl_context_reference(entry->ctx);
+    return entry->ctx;
+  }
+
+  ink_mutex_acquire(&this->lazy_mutex);
+  if ((ctx = entry->lazy->ctx)) {
+    this->lazy_lru.remove(entry->lazy);
+    this->lazy_lru.enqueue(entry->lazy);
+    ssl_context_reference(ctx);
+  } else if (!entry->lazy->failed) {
+    *lazy = entry->lazy;
+  }
+  ink_mutex_release(&this->lazy_mutex);
+
+  return ctx;
+}
+
+// Return the context of a lazy certificate with a reference, loading it if this is the first time it
+// is used since it was last evicted. The context is built outside the lock, because it reads the
+// certificate and the key from disk; if two threads race to load the same certificate, the second
+// one throws its context away.
+SSL_CTX *
+SSLCertLookup::load(SSLLazyContext * lazy)
+{
+  SSL_CTX * ctx;
+
+  ink_mutex_acquire(&this->lazy_mutex);
+  if (lazy->ctx || lazy->failed) {
+    if ((ctx = lazy->ctx)) {
+      this->lazy_lru.remove(lazy);
+      this->lazy_lru.enqueue(lazy);
+      ssl_context_reference(ctx);
+    }
+    ink_mutex_release(&this->lazy_mutex);
+    return ctx;
+  }
+  ink_mutex_release(&this->lazy_mutex);
+
+  ctx = this->lazy_loader ? this->lazy_loader(this, lazy) : NULL;
+
+  ink_mutex_acquire(&this->lazy_mutex);
+  if (ctx == NULL) {
+    // Don't try a broken certificate again on every handshake, wait for the configuration to be reloaded.
+    lazy->failed = true;
+  } else if (lazy->ctx) {
+    SSL_CTX_free(ctx);
+    ctx = lazy->ctx;
+    ssl_context_reference(ctx);
+  } else {
+    lazy->ctx = ctx;
+    this->lazy_lru.enqueue(lazy);
+    ssl_context_reference(ctx);
+
+    // Unload the least recently used contexts. Handshakes that are using them hold their own references.
+    if (++this->lazy_loaded > this->lazy_max_contexts && this->lazy_max_contexts > 0) {
+      SSLLazyContext * victim = this->lazy_lru.dequeue();
+
+      Debug("ssl", "unloading certificate %s", victim->cert);
+      SSL_CTX_free(victim->ctx);
+      victim->ctx = NULL;
+      --this->lazy_loaded;
+    }
+  }
+  ink_mutex_release(&this->lazy_mutex);
+
+  return ctx;
+}
+
+void
+SSLCertLookup::compile()
+{
+  this->ssl_storage->compile();
+}
+
 bool
 SSLCertLookup::insert(SSL_CTX * ctx, const char * name)
 {
-  return this->ssl_storage->insert(ctx, name);
+  return this->ssl_storage->insert(ctx, NULL, name);
 }
 
 bool
 SSLCertLookup::insert(SSL_CTX * ctx, const IpEndpoint& address)
 {
   SSLAddressLookupKey key(address);
-  return this->ssl_storage->insert(ctx, key.get());
+  return this->ssl_storage->insert(ctx, NULL, key.get());
 }
 
-struct ats_wildcard_matcher
+SSLLazyContext *
+SSLCertLookup::newLazyContext(const char * cert, const char * ca, const char * key)
 {
-  ats_wildcard_matcher() {
-    if (regex.compile("^\\*\\.[^\\*.]+") != 0) {
-      Fatal("failed to compile TLS wildcard matching regex");
-    }
-  }
+  SSLLazyContext * lazy = NEW(new SSLLazyContext(cert, ca, key));
 
-  ~ats_wildcard_matcher() {
-  }
+  lazy->params = this->lazy_params;
+  this->lazy_contexts.push_back(lazy);
+  return lazy;
+}
+
+bool
+SSLCertLookup::insert(SSLLazyContext * lazy, const char * name)
+{
+  return this->ssl_storage->insert(NULL, lazy, name);
+}
 
+// Match the TLS wildcard form "*.name". This used to be the regular expression
+// "^\*\.[^\*.]+", but compiling it for every inserted name dominated the
+// time to load a large certificate configuration.
+struct ats_wildcard_matcher
+{
   bool match(const char * hostname) const {
-    return regex.match(hostname) != -1;
+    return hostname[0] == '*' && hostname[1] == '.' && hostname[2] != '\0' && hostname[2] != '*' && hostname[2] != '.';
   }
-
-private:
-  DFA regex;
 };
 
 static char *
@@ -198,90 +398,293 @@ reverse_dns_name(const char * hostname, char (&reversed)[TS_MAX_HOST_NAME_LEN+1]
   return ptr;
 }
 
+// Order names label by label: a '.' sorts before any other character, so a
+// name sorts right before the names below it and the names that share a label
+// are adjacent.
+static bool
+ssl_name_entry_lt(SSLNameEntry * a, SSLNameEntry * b)
+{
+  const unsigned char * pa = (const unsigned char *)a->name;
+  const unsigned char * pb = (const unsigned char *)b->name;
+
+  for (;; ++pa, ++pb) {
+    unsigned ca = (*pa == '.') ? 1 : *pa;
+    unsigned cb = (*pb == '.') ? 1 : *pb;
+
+    if (ca != cb) {
+      return ca < cb;
+    }
+
+    if (ca == 0) {
+      return a->seq < b->seq;
+    }
+  }
+}
+
+static int
+ssl_label_cmp(const char * a, size_t alen, const char * b, size_t blen)
+{
+  int cmp = memcmp(a, b, alen < blen ? alen : blen);
+
+  if (cmp == 0) {
+    return (alen < blen) ? -1 : (alen > blen ? 1 : 0);
+  }
+
+  return cmp;
+}
+
+SSLNameTrie *
+SSLNameTrie::compile(Vec<SSLNameEntry *>& entries)
+{
+  SSLNameTrie * trie = NEW(new SSLNameTrie());
+  size_t nlabels = 0;
+  size_t nbytes = 0;
+
+  entries.qsort(ssl_name_entry_lt);
+
+  // Every label of every name adds at most one node and one edge.
+  for (int i = 0; i < entries.length(); ++i) {
+    nbytes += entries[i]->len;
+    for (size_t j = 0; j < entries[i]->len; ++j) {
+      nlabels += (entries[i]->name[j] == '.');
+    }
+    nlabels += 1;
+  }
+
+  trie->nodes = (Node *)ats_malloc(sizeof(Node) * (nlabels + 1));
+  trie->edges = (Edge *)ats_malloc(sizeof(Edge) * (nlabels + 1));
+  trie->labels = (char *)ats_malloc(nbytes + 1);
+
+  trie->nnodes = 1;
+  memset(&trie->nodes[0], 0, sizeof(Node));
+  if (entries.length()) {
+    trie->build(&entries[0], entries.length(), 0, 0);
+  }
+
+  Debug("ssl", "compiled %d certificate names into %u nodes and %u label bytes",
+        entries.length(), trie->nnodes, trie->nlabels);
+  return trie;
+}
+
+// Return the end of the run of names in [entries, entries + count) which have
+// the same label at start as the first one.
+static unsigned
+ssl_label_group(SSLNameEntry ** entries, unsigned count, size_t start, size_t len)
+{
+  const char * label = entries[0]->name + start;
+  unsigned i = 1;
+
+  while (i < count && strncmp(entries[i]->name + start, label, len) == 0 &&
+         (entries[i]->name[start + len] == '.' || entries[i]->name[start + len] == '\0')) {
+    ++i;
+  }
+
+  return i;
+}
+
+// Fill in the node for the names in [entries, entries + count), which all
+// share the labels before offset.
+void
+SSLNameTrie::build(SSLNameEntry ** entries, unsigned count, size_t offset, uint32_t node)
+{
+  unsigned i = 0;
+  unsigned nchildren = 0;
+
+  // The names that end at this node sort first. With duplicates the last
+  // insert sorts last, so it wins.
+  for (; i < count && entries[i]->len == offset; ++i) {
+    if (entries[i]->wildcard) {
+      nodes[node].wildcard = entries[i];
+    } else {
+      nodes[node].exact = entries[i];
+    }
+  }
+
+  // The label of each child starts after the separator, except at the root.
+  size_t start = node ? offset + 1 : 0;
+
+  // Reserve the edges of all the children before building any of them, so
+  // that the edges of this node stay adjacent.
+  for (unsigned j = i; j < count; ++nchildren) {
+    j += ssl_label_group(entries + j, count - j, start, strcspn(entries[j]->name + start, "."));
+  }
+
+  nodes[node].edges = nedges;
+  nodes[node].nedges = nchildren;
+  nedges += nchildren;
+
+  for (uint32_t e = nodes[node].edges; i < count; ++e) {
+    const char * label = entries[i]->name + start;
+    size_t len = strcspn(label, ".");
+    unsigned n = ssl_label_group(entries + i, count - i, start, len);
+    uint32_t child = nnodes++;
+
+    memset(&nodes[child], 0, sizeof(Node));
+    memcpy(labels + nlabels, label, len);
+
+    edges[e].label = nlabels;
+    edges[e].length = len;
+    edges[e].node = child;
+    nlabels += len;
+
+    build(entries + i, n, start + len, child);
+    i += n;
+  }
+}
+
+const SSLNameEntry *
+SSLNameTrie::lookup(const char * name, size_t len) const
+{
+  const Node * node = &nodes[0];
+  const SSLNameEntry * wildcard = NULL;
+  const char * end = name + len;
+
+  // Walk the labels from right to left. The deepest wildcard on the way is
+  // the longest wildcard match.
+  for (;;) {
+    const char * label = end;
+    while (label > name && label[-1] != '.') {
+      --label;
+    }
+
+    uint32_t lo = node->edges;
+    uint32_t hi = node->edges + node->nedges;
+    const Node * next = NULL;
+
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      int cmp = ssl_label_cmp(label, end - label, labels + edges[mid].label, edges[mid].length);
+
+      if (cmp == 0) {
+        next = &nodes[edges[mid].node];
+        break;
+      } else if (cmp < 0) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+
+    if (next == NULL) {
+      return wildcard;
+    }
+
+    node = next;
+    if (node->wildcard) {
+      wildcard = node->wildcard;
+    }
+
+    if (label == name) {
+      return node->exact ? node->exact : wildcard;
+    }
+
+    end = label - 1;
+  }
+}
+
 SSLContextStorage::SSLContextStorage()
-  :wildcards(), hostnames(ink_hash_table_create(InkHashTableKeyType_String))
+  : trie(NULL), dirty(false)
 {
 }
 
 SSLContextStorage::~SSLContextStorage()
 {
-  for (unsigned i = 0; i < this->references.count(); ++i) {
-    SSL_CTX_free(this->references[i]);
+  // The references are a set, so skip the empty slots.
+  for (unsigned i = 0; i < this->references.n; ++i) {
+    if (this->references.v[i]) {
+      SSL_CTX_free(this->references.v[i]);
+    }
+  }
+
+  for (int i = 0; i < this->entries.length(); ++i) {
+    ats_free(this->entries[i]->name);
+    delete this->entries[i];
   }
 
-  ink_hash_table_destroy(this->hostnames);
+  delete this->trie;
 }
 
 bool
-SSLContextStorage::insert(SSL_CTX * ctx, const char * name)
+SSLContextStorage::insert(SSL_CTX * ctx, SSLLazyContext * lazy, const char * name)
 {
   ats_wildcard_matcher wildcard;
-  bool inserted = true;
-
-  if (wildcard.match(name)) {
-    // We turn wildcards into the reverse DNS form, then insert them into the trie
-    // so that we can do a longest match lookup.
-    char namebuf[TS_MAX_HOST_NAME_LEN + 1];
-    char * reversed;
-    xptr<SSLEntry> entry;
-
-    reversed = reverse_dns_name(name + 2, namebuf);
-    if (!reversed) {
-      Error("wildcard name '%s' is too long", name);
-      return false;
-    }
+  char namebuf[TS_MAX_HOST_NAME_LEN + 1];
+  char * reversed;
+  SSLNameEntry * entry;
+  bool is_wildcard = wildcard.match(name);
+
+  // We turn names into the reverse DNS form, so that a wildcard is the parent
+  // of the names it matches and we can do a longest match lookup.
+  reversed = reverse_dns_name(is_wildcard ? name + 2 : name, namebuf);
+  if (!reversed) {
+    Error("%s name '%s' is too long", is_wildcard ? "wildcard" : "host", name);
+    return false;
+  }
 
-    Debug("ssl", "indexed wildcard certificate for '%s' as '%s' with SSL_CTX %p", name, reversed, ctx);
-    entry = new SSLEntry(ctx);
-    inserted = this->wildcards.Insert(reversed, entry, 0 /* rank */, -1 /* keylen */);
-    if (inserted) {
-      entry.release();
-    }
-  } else {
-    Debug("ssl", "indexed '%s' with SSL_CTX %p", name, ctx);
-    ink_hash_table_insert(this->hostnames, name, (void *)ctx);
+  if (*reversed == '\0') {
+    return false;
   }
 
+  entry = new SSLNameEntry;
+  entry->len = strlen(reversed);
+  entry->name = ats_strndup(reversed, entry->len);
+  ParseRules::ink_tolower_buffer(entry->name, entry->len);
+  entry->ctx = ctx;
+  entry->lazy = lazy;
+  entry->wildcard = is_wildcard;
+  entry->seq = this->entries.length();
+
+  this->entries.push_back(entry);
+  this->dirty = true;
+
+  if (lazy) {
+    Debug("ssl", "indexed %s'%s' as '%s' with certificate %s", is_wildcard ? "wildcard " : "", name, entry->name, lazy->cert);
+    return true;
+  }
+
+  Debug("ssl", "indexed %s'%s' as '%s' with SSL_CTX %p", is_wildcard ? "wildcard " : "", name, entry->name, ctx);
+
   // Keep a unique reference to the SSL_CTX, so that we can free it later. Since we index by name, multiple
   // certificates can be indexed for the same name. If this happens, we will overwrite the previous pointer
-  // and leak a context. So if we insert a certificate, keep an ownership reference to it.
-  if (inserted) {
-    if (this->references.in(ctx) == NULL) {
-      this->references.push_back(ctx);
-    }
-  }
+  // and leak a context. So keep an ownership reference to every context we insert.
+  this->references.set_add(ctx);
 
-  return inserted;
+  return true;
 }
 
-SSL_CTX *
+void
+SSLContextStorage::compile()
+{
+  if (this->dirty) {
+    delete this->trie;
+    this->trie = SSLNameTrie::compile(this->entries);
+    this->dirty = false;
+  }
+}
+
+const SSLNameEntry *
 SSLContextStorage::lookup(const char * name) const
 {
-  InkHashTableValue value;
+  char namebuf[TS_MAX_HOST_NAME_LEN + 1];
+  size_t len = strlen(name);
 
-  if (ink_hash_table_lookup(const_cast<InkHashTable *>(this->hostnames), name, &value)) {
-    return (SSL_CTX *)value;
+  if (this->dirty) {
+    const_cast<SSLContextStorage *>(this)->compile();
   }
 
-  if (!this->wildcards.Empty()) {
-    char namebuf[TS_MAX_HOST_NAME_LEN + 1];
-    char * reversed;
-    SSLEntry * entry;
-
-    reversed = reverse_dns_name(name, namebuf);
-    if (!reversed) {
-      Error("failed to reverse hostname name '%s' is too long", name);
-      return NULL;
-    }
+  if (this->trie == NULL || len == 0) {
+    return NULL;
+  }
 
-    Debug("ssl", "attempting wildcard match for %s", reversed);
-    entry = this->wildcards.Search(reversed);
-    if (entry) {
-      return entry->ctx;
-    }
+  if (len > TS_MAX_HOST_NAME_LEN) {
+    Error("failed to look up hostname, name '%s' is too long", name);
+    return NULL;
   }
 
-  return NULL;
+  memcpy(namebuf, name, len);
+  ParseRules::ink_tolower_buffer(namebuf, len);
+
+  return this->trie->lookup(namebuf, len);
 }
 
 #if TS_HAS_TESTS
@@ -37,12 +37,16 @@
 #include "P_SSLConfig.h"
 #include "P_SSLUtils.h"
 #include "P_SSLCertLookup.h"
+#include "I_Tasks.h"
 #include <records/I_RecHttp.h>
 
+#define SSL_TICKET_KEY_CHECK_INTERVAL HRTIME_SECONDS(10)
+
 int SSLConfig::configid = 0;
 int SSLCertificateConfig::configid = 0;
 
 static ConfigUpdateHandler<SSLCertificateConfig> * sslCertUpdate;
+static ConfigUpdateHandler<SSLConfig> * sslConfigUpdate;
 
 SSLConfigParams::SSLConfigParams()
 {
@@ -56,6 +60,7 @@ SSLConfigParams::SSLConfigParams()
     clientCACertFilename =
     clientCACertPath =
     cipherSuite =
+    ssl_session_cache_path =
     serverKeyPathOnly = NULL;
 
   clientCertLevel = client_verify_depth = verify_depth = clientVerify = 0;
@@ -63,6 +68,16 @@ SSLConfigParams::SSLConfigParams()
   ssl_ctx_options = 0;
   ssl_session_cache = SSL_SESSION_CACHE_MODE_SERVER;
   ssl_session_cache_size = 1024*20;
+  ssl_session_tickets = 1;
+  ssl_origin_session_cache = 1;
+  ssl_origin_session_cache_size = 1024*4;
+  handshake_offload_threads = 0;
+  ssl_lazy_load = 0;
+  ssl_lazy_max_contexts = 10000;
+  ticket_keys = NULL;
+  n_ticket_keys = 0;
+  ticket_key_path = NULL;
+  ticket_key_mtime = 0;
 }
 
 SSLConfigParams::~SSLConfigParams()
@@ -84,6 +99,11 @@ SSLConfigParams::cleanup()
   ats_free_null(serverCertPathOnly);
   ats_free_null(serverKeyPathOnly);
   ats_free_null(cipherSuite);
+  ats_free_null(ssl_session_cache_path);
+  ats_free_null(ticket_keys);
+  n_ticket_keys = 0;
+  ats_free_null(ticket_key_path);
+  ticket_key_mtime = 0;
 
   clientCertLevel = client_verify_depth = verify_depth = clientVerify = 0;
 }
@@ -187,8 +207,53 @@ SSLConfigParams::initialize()
   REC_ReadConfigInteger(ssl_session_cache, "proxy.config.ssl.session_cache");
   REC_ReadConfigInteger(ssl_session_cache_size, "proxy.config.ssl.session_cache.size");
 
+  char *session_cache_filename = NULL;
+  REC_ReadConfigStringAlloc(session_cache_filename, "proxy.config.ssl.session_cache.filename");
+  if (session_cache_filename && *session_cache_filename) {
+    ssl_session_cache_path = Layout::relative_to(Layout::get()->runtimedir, session_cache_filename);
+  }
+  ats_free(session_cache_filename);
+
+  REC_ReadConfigInt32(handshake_offload_threads, "proxy.config.ssl.handshake_offload.threads");
+
+  // Index the certificates by name and load them on first use.
+  REC_ReadConfigInt32(ssl_lazy_load, "proxy.config.ssl.server.multicert.lazy_load");
+  REC_ReadConfigInt32(ssl_lazy_max_contexts, "proxy.config.ssl.server.multicert.lazy_load.max_contexts");
+
+  // Session tickets, the keys are re-read on every reconfiguration so
+  // that they can be rotated at runtime. SSLTicketKeyWatcher reconfigures
+  // when the modification time of the key file changes.
+  REC_ReadConfigInt32(ssl_session_tickets, "proxy.config.ssl.server.session_ticket.enable");
+  char *ticket_key_filename = NULL;
+  REC_ReadConfigStringAlloc(ticket_key_filename, "proxy.config.ssl.server.ticket_key.filename");
+  if (ticket_key_filename && *ticket_key_filename) {
+    struct stat sbuf;
+
+    ticket_key_path = Layout::relative_to(serverCertPathOnly, ticket_key_filename);
+    if (stat(ticket_key_path, &sbuf) == 0) {
+      ticket_key_mtime = sbuf.st_mtime;
+    }
+    ticket_keys = SSLLoadTicketKeys(ticket_key_path, &n_ticket_keys);
+    if (ticket_keys == NULL) {
+      // Don't invalidate the tickets issued so far because of a broken key file.
+      SSLConfigParams * current = SSLConfig::acquire();
+      if (current && current->ticket_keys) {
+        Error("keeping the previous %u session ticket keys", current->n_ticket_keys);
+        ticket_keys = (ssl_ticket_key_t *)ats_malloc(current->n_ticket_keys * sizeof(ssl_ticket_key_t));
+        memcpy(ticket_keys, current->ticket_keys, current->n_ticket_keys * sizeof(ssl_ticket_key_t));
+        n_ticket_keys = current->n_ticket_keys;
+      } else {
+        Error("no session ticket keys were loaded, tickets are encrypted with a key local to this process");
+      }
+      SSLConfig::release(current);
+    }
+  }
+  ats_free(ticket_key_filename);
+
   // ++++++++++++++++++++++++ Client part ++++++++++++++++++++
   client_verify_depth = 7;
+  REC_ReadConfigInt32(ssl_origin_session_cache, "proxy.config.ssl.origin_session_cache");
+  REC_ReadConfigInt32(ssl_origin_session_cache_size, "proxy.config.ssl.origin_session_cache.size");
   REC_ReadConfigInt32(clientVerify, "proxy.config.ssl.client.verify.server");
 
   ssl_client_cert_filename = NULL;
@@ -212,10 +277,38 @@ SSLConfigParams::initialize()
   ats_free(clientCACertRelativePath);
 }
 
+// Reconfigure when the session ticket key file is replaced, so that keys
+// can be rotated without touching records.config.
+struct SSLTicketKeyWatcher : public Continuation
+{
+  SSLTicketKeyWatcher() : Continuation(new_ProxyMutex())
+  {
+    SET_HANDLER(&SSLTicketKeyWatcher::check);
+  }
+
+  int check(int /* event ATS_UNUSED */, Event * /* e ATS_UNUSED */)
+  {
+    SSLConfig::scoped_config params;
+    struct stat sbuf;
+
+    if (params->ticket_key_path && stat(params->ticket_key_path, &sbuf) == 0 &&
+        sbuf.st_mtime != params->ticket_key_mtime) {
+      Note("session ticket key file %s changed, reloading", params->ticket_key_path);
+      SSLConfig::reconfigure();
+    }
+    return EVENT_CONT;
+  }
+};
+
 void
 SSLConfig::startup()
 {
+  sslConfigUpdate = NEW(new ConfigUpdateHandler<SSLConfig>());
+  sslConfigUpdate->attach("proxy.config.ssl.server.ticket_key.filename");
+
   reconfigure();
+
+  eventProcessor.schedule_every(NEW(new SSLTicketKeyWatcher()), SSL_TICKET_KEY_CHECK_INTERVAL, ET_TASK);
 }
 
 void
@@ -230,23 +323,30 @@ SSLConfig::reconfigure()
 SSLConfigParams *
 SSLConfig::acquire()
 {
-  return ((SSLConfigParams *) configProcessor.get(configid));
+  // NULL until the first configuration is set.
+  return configid ? ((SSLConfigParams *) configProcessor.get(configid)) : NULL;
 }
 
 void
 SSLConfig::release(SSLConfigParams * params)
 {
-  configProcessor.release(configid, params);
+  if (params) {
+    configProcessor.release(configid, params);
+  }
 }
 
 void
 SSLCertificateConfig::startup()
 {
-  sslCertUpdate = NEW(new ConfigUpdateHandler<SSLCertificateConfig>());
+  // Loading the certificates and compiling the name lookup can take a while with a lot of certificates,
+  // so reloads are done on the task threads and the new lookup is swapped in when it is complete.
+  sslCertUpdate = NEW(new ConfigUpdateHandler<SSLCertificateConfig>(&ET_TASK));
   sslCertUpdate->attach("proxy.config.ssl.server.multicert.filename");
   sslCertUpdate->attach("proxy.config.ssl.server.cert.path");
   sslCertUpdate->attach("proxy.config.ssl.server.private_key.path");
   sslCertUpdate->attach("proxy.config.ssl.server.cert_chain.filename");
+  sslCertUpdate->attach("proxy.config.ssl.server.multicert.lazy_load");
+  sslCertUpdate->attach("proxy.config.ssl.server.multicert.lazy_load.max_contexts");
 
   reconfigure();
 }
@@ -254,9 +354,11 @@ SSLCertificateConfig::startup()
 void
 SSLCertificateConfig::reconfigure()
 {
-  SSLConfig::scoped_config params;
+  SSLConfigParams * params = SSLConfig::acquire();
   SSLCertLookup * lookup = NEW(new SSLCertLookup());
 
+  // The lookup holds on to the configuration, lazy certificates are loaded with it later.
+  lookup->lazy_params = params;
   if (SSLParseCertificateConfiguration(params, lookup)) {
     configid = configProcessor.set(configid, lookup);
   } else {
@@ -25,6 +25,7 @@
 #include "I_Layout.h"
 #include "I_RecHttp.h"
 #include "P_SSLUtils.h"
+#include "P_SSLSessionCache.h"
 
 //
 // Global Data
@@ -33,6 +34,8 @@
 SSLNetProcessor   ssl_NetProcessor;
 NetProcessor&     sslNetProcessor = ssl_NetProcessor;
 EventType         SSLNetProcessor::ET_SSL;
+EventType         SSLNetProcessor::ET_SSL_CRYPTO;
+bool              SSLNetProcessor::handshake_offload = false;
 
 void
 SSLNetProcessor::cleanup(void)
@@ -50,6 +53,21 @@ SSLNetProcessor::start(int number_of_ssl_threads)
   SSLInitializeLibrary();
   SSLConfig::startup();
 
+  {
+    SSLConfig::scoped_config params;
+    if (params->handshake_offload_threads > 0) {
+      SSLNetProcessor::ET_SSL_CRYPTO = eventProcessor.spawn_event_threads(params->handshake_offload_threads, "ET_SSL_CRYPTO");
+      SSLNetProcessor::handshake_offload = true;
+    }
+    if (params->ssl_origin_session_cache) {
+      sslOriginSessionCache.init(params->ssl_origin_session_cache_size);
+    }
+    if (params->ssl_session_cache == SSLConfigParams::SSL_SESSION_CACHE_MODE_SHARED &&
+        !sslSessionCache.open(params->ssl_session_cache_path, params->ssl_session_cache_size)) {
+      SSLError("Can't open the shared SSL session cache, sessions will not be resumed from it");
+    }
+  }
+
   if (HttpProxyPort::hasSSL()) {
     SSLCertificateConfig::startup();
   }
@@ -24,6 +24,8 @@
 #include "P_Net.h"
 #include "P_SSLNextProtocolSet.h"
 #include "P_SSLUtils.h"
+#include "P_SSLSessionCache.h"
+#include "I_Tasks.h"
 
 #define SSL_READ_ERROR_NONE	  0
 #define SSL_READ_ERROR		  1
@@ -405,9 +407,91 @@ SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, i
   }
 }
 
+// Runs one server handshake step of a VC on an ET_SSL_CRYPTO thread and
+// hands the result back to the thread owning the VC.
+struct SSLHandShakeJob: public Continuation
+{
+  SSLNetVConnection * vc;
+  ink_hrtime queued;
+  int ret;
+  int err;
+
+  SSLHandShakeJob(SSLNetVConnection * v)
+    : Continuation(new_ProxyMutex()), vc(v), queued(ink_get_hrtime()), ret(EVENT_ERROR), err(0)
+  {
+    SET_HANDLER(&SSLHandShakeJob::handshake);
+  }
+
+  int handshake(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+  {
+    ink_hrtime now = ink_get_hrtime();
+
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_handshake_offloads_stat, 1);
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_handshake_offload_queue_usecs_stat, (now - queued) / HRTIME_USECOND);
+    ret = vc->sslServerHandShakeEvent(err);
+
+    queued = ink_get_hrtime();
+    mutex = vc->nh->mutex;
+    SET_HANDLER(&SSLHandShakeJob::resume);
+    vc->thread->schedule_imm_signal(this);
+    return EVENT_DONE;
+  }
+
+  int resume(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+  {
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_handshake_offload_resume_usecs_stat, (ink_get_hrtime() - queued) / HRTIME_USECOND);
+    vc->sslHandShakeOffloadDone(ret, err);
+    mutex.clear();
+    delete this;
+    return EVENT_DONE;
+  }
+};
+
+// Loads a lazy certificate for the server name of a handshake on an ET_TASK
+// thread, since it reads the certificate and the key from disk, and hands
+// it back to the thread owning the VC.
+struct SSLCertLoadJob: public Continuation
+{
+  SSLNetVConnection * vc;
+  SSLCertLookup * lookup;
+  SSLLazyContext * lazy;
+  SSL_CTX * ctx;
+
+  SSLCertLoadJob(SSLNetVConnection * v, SSLCertLookup * l, SSLLazyContext * z)
+    : Continuation(new_ProxyMutex()), vc(v), lookup(l), lazy(z), ctx(NULL)
+  {
+    SET_HANDLER(&SSLCertLoadJob::load);
+  }
+
+  int load(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+  {
+    ctx = lookup->load(lazy);
+    SSLCertificateConfig::release(lookup);
+
+    mutex = vc->nh->mutex;
+    SET_HANDLER(&SSLCertLoadJob::resume);
+    vc->thread->schedule_imm_signal(this);
+    return EVENT_DONE;
+  }
+
+  int resume(int /* event ATS_UNUSED */, void * /* data ATS_UNUSED */)
+  {
+    vc->sslCertificateLoaded(ctx);
+    mutex.clear();
+    delete this;
+    return EVENT_DONE;
+  }
+};
+
 SSLNetVConnection::SSLNetVConnection():
   sslHandShakeComplete(false),
   sslClientConnection(false),
+  sslHandShakeOffloaded(false),
+  sslHandShakeOffloadIOReady(false),
+  sslHandShakeOffloadResult(false),
+  sslHandShakeOffloadRet(0),
+  sslHandShakeOffloadErr(0),
+  sslLoadedCtx(NULL),
   npnSet(NULL),
   npnEndpoint(NULL)
 {
@@ -438,6 +522,13 @@ SSLNetVConnection::free(EThread * t) {
   }
   sslHandShakeComplete = false;
   sslClientConnection = false;
+  ink_assert(!sslHandShakeOffloaded);
+  sslHandShakeOffloadIOReady = false;
+  sslHandShakeOffloadResult = false;
+  if (sslLoadedCtx != NULL) {
+    SSL_CTX_free(sslLoadedCtx);
+    sslLoadedCtx = NULL;
+  }
   npnSet = NULL;
 
   if (from_accept_thread) {
@@ -447,6 +538,70 @@ SSLNetVConnection::free(EThread * t) {
   }
 }
 
+// Back on the owning thread after an offloaded handshake step.
+void
+SSLNetVConnection::sslHandShakeOffloadDone(int ret, int err)
+{
+  bool want_io = ret == SSL_HANDSHAKE_WANT_READ || ret == SSL_HANDSHAKE_WANT_WRITE ||
+    ret == SSL_HANDSHAKE_WANT_ACCEPT || ret == SSL_HANDSHAKE_WANT_CONNECT;
+
+  sslHandShakeOffloaded = false;
+  if (closed) {
+    close_UnixNetVConnection(this, thread);
+    return;
+  }
+
+  // The step is waiting for the socket. Unless the socket became ready
+  // while the step was running, the next poll event drives the handshake.
+  if (want_io && !sslHandShakeOffloadIOReady) {
+    return;
+  }
+  sslHandShakeOffloadIOReady = false;
+
+  if (!want_io) {
+    sslHandShakeOffloadResult = true;
+    sslHandShakeOffloadRet = ret;
+    sslHandShakeOffloadErr = err;
+  }
+  sslHandShakeResume();
+}
+
+void
+SSLNetVConnection::sslLoadCertificate(SSLCertLookup * lookup, SSLLazyContext * lazy)
+{
+  ink_assert(!sslHandShakeOffloaded);
+  // The job holds a reference to the lookup, a reload may replace it meanwhile.
+  ink_atomic_increment((int *) &lookup->m_refcount, 1);
+  sslHandShakeOffloaded = true;
+  eventProcessor.schedule_imm(NEW(new SSLCertLoadJob(this, lookup, lazy)), ET_TASK);
+}
+
+// Back on the owning thread with the certificate the handshake waits for.
+void
+SSLNetVConnection::sslCertificateLoaded(SSL_CTX * ctx)
+{
+  sslHandShakeOffloaded = false;
+  sslHandShakeOffloadIOReady = false;
+  sslLoadedCtx = ctx;
+  if (closed) {
+    close_UnixNetVConnection(this, thread);
+    return;
+  }
+  sslHandShakeResume();
+}
+
+// Run the handshake again from the net handler.
+void
+SSLNetVConnection::sslHandShakeResume()
+{
+  read.triggered = 1;
+  write.triggered = 1;
+  if (read.enabled)
+    nh->read_ready_list.in_or_enqueue(this);
+  if (write.enabled)
+    nh->write_ready_list.in_or_enqueue(this);
+}
+
 int
 SSLNetVConnection::sslStartHandShake(int event, int &err)
 {
@@ -465,11 +620,41 @@ SSLNetVConnection::sslStartHandShake(int event, int &err)
       }
     }
 
-    return sslServerHandShakeEvent(err);
+    // A step is running on another thread, or waits for a certificate to load.
+    if (sslHandShakeOffloaded) {
+      sslHandShakeOffloadIOReady = true;
+      return SSL_HANDSHAKE_WANT_READ;
+    }
+
+    if (SSLNetProcessor::handshake_offload) {
+      // The offloaded step is over, this is the only place its result is
+      // seen, and the SSL is not touched by another thread any more.
+      if (sslHandShakeOffloadResult) {
+        sslHandShakeOffloadResult = false;
+        err = sslHandShakeOffloadErr;
+        if (sslHandShakeOffloadRet == EVENT_DONE)
+          sslHandShakeComplete = 1;
+        return sslHandShakeOffloadRet;
+      }
+
+      sslHandShakeOffloaded = true;
+      eventProcessor.schedule_imm(NEW(new SSLHandShakeJob(this)), SSLNetProcessor::ET_SSL_CRYPTO);
+      return SSL_HANDSHAKE_WANT_READ;
+    }
+
+    int ret = sslServerHandShakeEvent(err);
+    if (ret == EVENT_DONE)
+      sslHandShakeComplete = 1;
+    else if (sslHandShakeOffloaded)
+      ret = SSL_HANDSHAKE_WANT_READ;  // the certificate callback is loading a certificate
+    return ret;
   } else {
     ink_assert(event == SSL_EVENT_CLIENT);
     if (this->ssl == NULL) {
       this->ssl = make_ssl_connection(ssl_NetProcessor.client_ctx, this);
+      if (this->ssl != NULL && sslOriginSessionCache.resume(this->ssl, get_remote_addr(), options.origin_name_hash)) {
+        Debug("ssl", "SSLNetVConnection::sslStartHandShake, offering the last session of the origin");
+      }
     }
     ink_assert(event == SSL_EVENT_CLIENT);
     return (sslClientHandShakeEvent(err));
@@ -500,7 +685,15 @@ SSLNetVConnection::sslServerHandShakeEvent(int &err)
 */
       X509_free(client_cert);
     }
-    sslHandShakeComplete = 1;
+
+    // This may run on an ET_SSL_CRYPTO thread, which does not hold the VC's mutex.
+    // sslHandShakeComplete is left to the owning thread, so that it does not
+    // SSL_read() or SSL_write() while the step is still running here.
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_handshakes_stat, 1);
+    if (SSL_session_reused(ssl)) {
+      Debug("ssl", "SSLNetVConnection::sslServerHandShakeEvent, session resumed");
+      NET_SUM_GLOBAL_DYN_STAT(net_ssl_sessions_reused_stat, 1);
+    }
 
 #if TS_USE_TLS_NPN
     {
@@ -585,6 +778,12 @@ SSLNetVConnection::sslClientHandShakeEvent(int &err)
     X509_free(server_cert);
     sslHandShakeComplete = 1;
 
+    if (SSL_session_reused(ssl)) {
+      NET_INCREMENT_DYN_STAT(net_ssl_origin_resumed_handshakes_stat);
+    } else {
+      NET_INCREMENT_DYN_STAT(net_ssl_origin_full_handshakes_stat);
+    }
+
     return EVENT_DONE;
 
   case SSL_ERROR_WANT_WRITE:
@@ -617,6 +816,8 @@ SSLNetVConnection::sslClientHandShakeEvent(int &err)
   case SSL_ERROR_SSL:
   default:
     err = errno;
+    // Do not offer the session of this origin again if it failed the handshake.
+    sslOriginSessionCache.remove(get_remote_addr(), options.origin_name_hash);
     SSLError("sslClientHandShakeEvent");
     return EVENT_ERROR;
     break;
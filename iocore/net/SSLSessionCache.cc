@@ -0,0 +1,377 @@
+/** @file
+
+  Shared SSL session cache
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "ink_config.h"
+#include "P_Net.h"
+#include "P_SSLSessionCache.h"
+
+#include <sys/mman.h>
+
+SSLSessionCache sslSessionCache;
+SSLOriginSessionCache sslOriginSessionCache;
+
+SSLSessionCache::SSLSessionCache()
+  : header(NULL), slots(NULL), mapped_size(0)
+{
+  for (int i = 0; i < SSL_SESSION_CACHE_LOCKS; ++i) {
+    ink_mutex_init(&locks[i], "SSLSessionCache");
+  }
+}
+
+bool
+SSLSessionCache::open(const char * path, int nsessions)
+{
+  SSLSessionCacheHeader hdr;
+  uint32_t nsets = nsessions / SSL_SESSION_CACHE_WAYS;
+  int fd;
+  void * addr;
+
+  ink_release_assert(header == NULL);
+
+  if (nsets == 0) {
+    nsets = 1;
+  }
+  mapped_size = sizeof(SSLSessionCacheHeader) + (size_t)nsets * SSL_SESSION_CACHE_WAYS * sizeof(SSLSessionSlot);
+
+  if (path == NULL) {
+    addr = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    if (addr == MAP_FAILED) {
+      Error("failed to allocate the SSL session cache: %s", strerror(errno));
+      return false;
+    }
+    header = (SSLSessionCacheHeader *)addr;
+    header->magic = SSL_SESSION_CACHE_MAGIC;
+    header->version = SSL_SESSION_CACHE_VERSION;
+    header->nsets = nsets;
+    header->slot_size = sizeof(SSLSessionSlot);
+    slots = (SSLSessionSlot *)(header + 1);
+    return true;
+  }
+
+  // The file holds the master secrets of the sessions in the clear, so it
+  // must only be readable by us, whatever mode it was created with.
+  fd = ::open(path, O_RDWR | O_CREAT | O_NOFOLLOW, 0600);
+  if (fd < 0) {
+    Error("failed to open SSL session cache %s: %s", path, strerror(errno));
+    return false;
+  }
+  if (fchmod(fd, 0600) < 0) {
+    Error("failed to restrict the mode of SSL session cache %s: %s", path, strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  // Reuse the sessions of the previous run if the layout is the same, start empty otherwise.
+  if (read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) || hdr.magic != SSL_SESSION_CACHE_MAGIC ||
+      hdr.version != SSL_SESSION_CACHE_VERSION || hdr.nsets != nsets || hdr.slot_size != sizeof(SSLSessionSlot)) {
+    Note("initializing SSL session cache %s for %u sessions", path, nsets * SSL_SESSION_CACHE_WAYS);
+    if (ftruncate(fd, 0) < 0 || ftruncate(fd, mapped_size) < 0) {
+      Error("failed to size SSL session cache %s: %s", path, strerror(errno));
+      close(fd);
+      return false;
+    }
+    hdr.magic = SSL_SESSION_CACHE_MAGIC;
+    hdr.version = SSL_SESSION_CACHE_VERSION;
+    hdr.nsets = nsets;
+    hdr.slot_size = sizeof(SSLSessionSlot);
+    if (pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+      Error("failed to write SSL session cache %s: %s", path, strerror(errno));
+      close(fd);
+      return false;
+    }
+  } else {
+    Note("reusing SSL session cache %s", path);
+  }
+
+  addr = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    Error("failed to map SSL session cache %s: %s", path, strerror(errno));
+    return false;
+  }
+
+  header = (SSLSessionCacheHeader *)addr;
+  slots = (SSLSessionSlot *)(header + 1);
+  return true;
+}
+
+void
+SSLSessionCache::attach(SSL_CTX * ctx)
+{
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+  SSL_CTX_sess_set_new_cb(ctx, SSLSessionCache::new_session);
+  SSL_CTX_sess_set_get_cb(ctx, SSLSessionCache::get_session);
+  SSL_CTX_sess_set_remove_cb(ctx, SSLSessionCache::remove_session);
+}
+
+// The slots of the set a session ID maps to, and the lock protecting them.
+SSLSessionSlot *
+SSLSessionCache::find_set(const unsigned char * id, unsigned len, ink_mutex ** lock)
+{
+  uint32_t hash = 2166136261U;
+
+  for (unsigned i = 0; i < len; ++i) {
+    hash = (hash ^ id[i]) * 16777619U;
+  }
+  hash %= header->nsets;
+
+  *lock = &locks[hash % SSL_SESSION_CACHE_LOCKS];
+  return slots + (size_t)hash * SSL_SESSION_CACHE_WAYS;
+}
+
+int
+SSLSessionCache::new_session(SSL * /* ssl ATS_UNUSED */, SSL_SESSION * sess)
+{
+  SSLSessionCache * cache = &sslSessionCache;
+  unsigned id_len;
+  const unsigned char * id = SSL_SESSION_get_id(sess, &id_len);
+  int len = i2d_SSL_SESSION(sess, NULL);
+  int64_t now = time(NULL);
+  SSLSessionSlot * set;
+  SSLSessionSlot * slot = NULL;
+  ink_mutex * lock;
+
+  if (!cache->is_open() || len <= 0 || len > SSL_SESSION_CACHE_DER_MAX || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+    return 0;
+  }
+
+  set = cache->find_set(id, id_len, &lock);
+  ink_mutex_acquire(lock);
+
+  // Replace the same session, else the slot expiring first, which is a
+  // free or expired one if there is any.
+  bool same = false;
+  for (int i = 0; i < SSL_SESSION_CACHE_WAYS; ++i) {
+    if (set[i].id_len == id_len && memcmp(set[i].id, id, id_len) == 0) {
+      slot = &set[i];
+      same = true;
+      break;
+    }
+    if (!slot || set[i].expire < slot->expire) {
+      slot = &set[i];
+    }
+  }
+  if (!same && slot->expire > now) {
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_session_cache_evictions_stat, 1);
+  }
+
+  unsigned char * der = slot->der;
+  slot->der_len = i2d_SSL_SESSION(sess, &der);
+  slot->id_len = id_len;
+  memcpy(slot->id, id, id_len);
+  slot->expire = (int64_t)SSL_SESSION_get_time(sess) + SSL_SESSION_get_timeout(sess);
+
+  ink_mutex_release(lock);
+  return 0;
+}
+
+SSL_SESSION *
+SSLSessionCache::get_session(SSL * /* ssl ATS_UNUSED */, ssl_session_id_t id, int len, int * copy)
+{
+  SSLSessionCache * cache = &sslSessionCache;
+  SSL_SESSION * sess = NULL;
+  int64_t now = time(NULL);
+  SSLSessionSlot * set;
+  ink_mutex * lock;
+
+  *copy = 0;
+  if (!cache->is_open() || len <= 0 || len > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+    return NULL;
+  }
+
+  set = cache->find_set(id, len, &lock);
+  ink_mutex_acquire(lock);
+  for (int i = 0; i < SSL_SESSION_CACHE_WAYS; ++i) {
+    if (set[i].expire > now && set[i].id_len == (unsigned)len && memcmp(set[i].id, id, len) == 0) {
+      const unsigned char * der = set[i].der;
+      sess = d2i_SSL_SESSION(NULL, &der, set[i].der_len);
+      break;
+    }
+  }
+  ink_mutex_release(lock);
+
+  if (sess) {
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_session_cache_hits_stat, 1);
+  } else {
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_session_cache_misses_stat, 1);
+  }
+  return sess;
+}
+
+void
+SSLSessionCache::remove_session(SSL_CTX * /* ctx ATS_UNUSED */, SSL_SESSION * sess)
+{
+  SSLSessionCache * cache = &sslSessionCache;
+  unsigned id_len;
+  const unsigned char * id = SSL_SESSION_get_id(sess, &id_len);
+  SSLSessionSlot * set;
+  ink_mutex * lock;
+
+  if (!cache->is_open() || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+    return;
+  }
+
+  set = cache->find_set(id, id_len, &lock);
+  ink_mutex_acquire(lock);
+  for (int i = 0; i < SSL_SESSION_CACHE_WAYS; ++i) {
+    if (set[i].id_len == id_len && memcmp(set[i].id, id, id_len) == 0) {
+      set[i].expire = 0;
+      set[i].id_len = 0;
+      break;
+    }
+  }
+  ink_mutex_release(lock);
+}
+
+SSLOriginSessionCache::SSLOriginSessionCache()
+  : slots(NULL), nsets(0)
+{
+  for (int i = 0; i < SSL_SESSION_CACHE_LOCKS; ++i) {
+    ink_mutex_init(&locks[i], "SSLOriginSessionCache");
+  }
+}
+
+void
+SSLOriginSessionCache::init(int nsessions)
+{
+  ink_release_assert(slots == NULL);
+
+  nsets = nsessions / SSL_SESSION_CACHE_WAYS;
+  if (nsets == 0) {
+    nsets = 1;
+  }
+  slots = (SSLOriginSession *)ats_calloc((size_t)nsets * SSL_SESSION_CACHE_WAYS, sizeof(SSLOriginSession));
+}
+
+void
+SSLOriginSessionCache::attach(SSL_CTX * ctx)
+{
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, SSLOriginSessionCache::new_session);
+}
+
+SSLOriginSession *
+SSLOriginSessionCache::find_set(sockaddr const * addr, uint64_t name_hash, ink_mutex ** lock)
+{
+  uint32_t hash = ats_ip_hash(addr) ^ ats_ip_port_cast(addr) ^ (uint32_t)(name_hash ^ (name_hash >> 32));
+
+  hash %= nsets;
+  *lock = &locks[hash % SSL_SESSION_CACHE_LOCKS];
+  return slots + (size_t)hash * SSL_SESSION_CACHE_WAYS;
+}
+
+static inline bool
+ssl_origin_session_match(const SSLOriginSession * s, sockaddr const * addr, uint64_t name_hash)
+{
+  return s->session && s->name_hash == name_hash && ats_ip_addr_eq(&s->addr.sa, addr) &&
+    ats_ip_port_cast(&s->addr.sa) == ats_ip_port_cast(addr);
+}
+
+// Offer the stored session of the origin in the next handshake of ssl.
+bool
+SSLOriginSessionCache::resume(SSL * ssl, sockaddr const * addr, uint64_t name_hash)
+{
+  SSLOriginSession * set;
+  ink_mutex * lock;
+  bool found = false;
+
+  if (!slots) {
+    return false;
+  }
+
+  set = find_set(addr, name_hash, &lock);
+  ink_mutex_acquire(lock);
+  for (int i = 0; i < SSL_SESSION_CACHE_WAYS; ++i) {
+    if (ssl_origin_session_match(&set[i], addr, name_hash)) {
+      found = SSL_set_session(ssl, set[i].session) == 1;
+      break;
+    }
+  }
+  ink_mutex_release(lock);
+  return found;
+}
+
+void
+SSLOriginSessionCache::remove(sockaddr const * addr, uint64_t name_hash)
+{
+  SSLOriginSession * set;
+  ink_mutex * lock;
+
+  if (!slots) {
+    return;
+  }
+
+  set = find_set(addr, name_hash, &lock);
+  ink_mutex_acquire(lock);
+  for (int i = 0; i < SSL_SESSION_CACHE_WAYS; ++i) {
+    if (ssl_origin_session_match(&set[i], addr, name_hash)) {
+      SSL_SESSION_free(set[i].session);
+      set[i].session = NULL;
+      break;
+    }
+  }
+  ink_mutex_release(lock);
+}
+
+int
+SSLOriginSessionCache::new_session(SSL * ssl, SSL_SESSION * sess)
+{
+  SSLOriginSessionCache * cache = &sslOriginSessionCache;
+  SSLNetVConnection * netvc = (SSLNetVConnection *)SSL_get_app_data(ssl);
+  sockaddr const * addr = netvc->get_remote_addr();
+  uint64_t name_hash = netvc->options.origin_name_hash;
+  SSLOriginSession * set;
+  SSLOriginSession * slot = NULL;
+  ink_mutex * lock;
+
+  if (!cache->slots) {
+    return 0;
+  }
+
+  set = cache->find_set(addr, name_hash, &lock);
+  ink_mutex_acquire(lock);
+
+  // Replace the session of the same origin, else a free slot, else the oldest.
+  for (int i = 0; i < SSL_SESSION_CACHE_WAYS; ++i) {
+    if (ssl_origin_session_match(&set[i], addr, name_hash)) {
+      slot = &set[i];
+      break;
+    }
+    if (!slot || (slot->session && (!set[i].session || set[i].stored < slot->stored))) {
+      slot = &set[i];
+    }
+  }
+
+  if (slot->session) {
+    SSL_SESSION_free(slot->session);
+  }
+  ats_ip_copy(&slot->addr.sa, addr);
+  slot->name_hash = name_hash;
+  slot->stored = ink_get_hrtime();
+  slot->session = sess;
+
+  ink_mutex_release(lock);
+
+  // We keep the reference to the session.
+  return 1;
+}
@@ -23,12 +23,15 @@
 #include "libts.h"
 #include "I_Layout.h"
 #include "P_Net.h"
+#include "P_SSLSessionCache.h"
 
 #include <openssl/err.h>
 #include <openssl/bio.h>
 #include <openssl/pem.h>
 #include <openssl/x509.h>
 #include <openssl/asn1.h>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
 
 #if HAVE_OPENSSL_TS_H
 #include <openssl/ts.h>
@@ -49,6 +52,10 @@ typedef SSL_METHOD * ink_ssl_method_t;
 static ProxyMutex ** sslMutexArray;
 static bool open_ssl_initialized = false;
 
+// Ticket key used when no key file is configured. Tickets are then only
+// valid in this process.
+static ssl_ticket_key_t ssl_default_ticket_key;
+
 struct ats_x509_certificate
 {
   explicit ats_x509_certificate(X509 * x) : x509(x) {}
@@ -139,6 +146,12 @@ SSL_CTX_add_extra_chain_cert_file(SSL_CTX * ctx, const char * chainfile)
 
 #if TS_USE_TLS_SNI
 
+// The certificate callback (OpenSSL 1.0.2) can pause the handshake, so the lazy certificates are
+// loaded from there, off the net threads.
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+#define SSL_LAZY_LOAD_ASYNC 1
+#endif
+
 static int
 ssl_servername_callback(SSL * ssl, int * ad, void * arg)
 {
@@ -153,7 +166,19 @@ ssl_servername_callback(SSL * ssl, int * ad, void * arg)
   // don't find a name-based match at this point, we *do not* want to mess with the context because we've
   // already made a best effort to find the best match.
   if (likely(servername)) {
-    ctx = lookup->findInfoInHash((char *)servername);
+    // This returns the context with a reference that we have to drop once the connection holds its
+    // own. A lazy certificate that is not loaded yet is left to the certificate callback, if there is
+    // one, and is loaded here otherwise.
+#if SSL_LAZY_LOAD_ASYNC
+    SSLLazyContext * lazy;
+    ctx = lookup->findContext(servername, &lazy);
+#else
+    ctx = lookup->findContext(servername);
+#endif
+    if (ctx != NULL) {
+      SSL_set_SSL_CTX(ssl, ctx);
+      SSL_CTX_free(ctx);
+    }
   }
 
   // If there's no match on the server name, try to match on the peer address.
@@ -163,10 +188,9 @@ ssl_servername_callback(SSL * ssl, int * ad, void * arg)
 
     safe_getsockname(netvc->get_socket(), &ip.sa, &namelen);
     ctx = lookup->findInfoInHash(ip);
-  }
-
-  if (ctx != NULL) {
-    SSL_set_SSL_CTX(ssl, ctx);
+    if (ctx != NULL) {
+      SSL_set_SSL_CTX(ssl, ctx);
+    }
   }
 
   ctx = SSL_get_SSL_CTX(ssl);
@@ -182,8 +206,98 @@ ssl_servername_callback(SSL * ssl, int * ad, void * arg)
   return SSL_TLSEXT_ERR_OK;
 }
 
+#if SSL_LAZY_LOAD_ASYNC
+// Switch to the lazy certificate of the server name once it is loaded. If it is not, the handshake is
+// paused (SSL_ERROR_WANT_X509_LOOKUP) while the certificate loads on an ET_TASK thread, and this is
+// called again when the handshake is resumed.
+static int
+ssl_cert_callback(SSL * ssl, void * arg)
+{
+  SSLCertLookup *     lookup = (SSLCertLookup *) arg;
+  const char *        servername = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  SSLNetVConnection * netvc = (SSLNetVConnection *)SSL_get_app_data(ssl);
+  SSLLazyContext *    lazy = NULL;
+  SSL_CTX *           ctx;
+
+  if (servername == NULL || netvc == NULL) {
+    return 1;
+  }
+
+  ctx = netvc->takeLoadedCertificate();
+  if (ctx == NULL) {
+    ctx = lookup->findContext(servername, &lazy);
+  }
+
+  if (ctx == NULL && lazy != NULL) {
+    if (!netvc->getSSLHandShakeOffloaded()) {
+      Debug("ssl", "pausing the handshake for %s while certificate %s loads", servername, lazy->cert);
+      netvc->sslLoadCertificate(lookup, lazy);
+      return -1;
+    }
+    // This handshake step runs on an ET_SSL_CRYPTO thread, which can wait for the disk.
+    ctx = lookup->load(lazy);
+  }
+
+  if (ctx != NULL) {
+    if (ctx != SSL_get_SSL_CTX(ssl)) {
+      Debug("ssl", "found SSL context %p for requested name '%s'", ctx, servername);
+      SSL_set_SSL_CTX(ssl, ctx);
+    }
+    SSL_CTX_free(ctx);
+  }
+
+  return 1;
+}
+#endif /* SSL_LAZY_LOAD_ASYNC */
+
 #endif /* TS_USE_TLS_SNI */
 
+#if defined(SSL_CTX_set_tlsext_ticket_key_cb)
+static int
+ssl_callback_session_ticket(
+    SSL * /* ssl ATS_UNUSED */,
+    unsigned char * keyname,
+    unsigned char * iv,
+    EVP_CIPHER_CTX * cipher_ctx,
+    HMAC_CTX * hctx,
+    int enc)
+{
+  SSLConfig::scoped_config params;
+  const ssl_ticket_key_t * keys = params->ticket_keys;
+  unsigned nkeys = params->n_ticket_keys;
+
+  if (nkeys == 0) {
+    keys = &ssl_default_ticket_key;
+    nkeys = 1;
+  }
+
+  if (enc == 1) {
+    memcpy(keyname, keys[0].key_name, sizeof(keys[0].key_name));
+    RAND_bytes(iv, EVP_MAX_IV_LENGTH);
+    EVP_EncryptInit_ex(cipher_ctx, EVP_aes_128_cbc(), NULL, keys[0].aes_key, iv);
+    HMAC_Init_ex(hctx, keys[0].hmac_secret, sizeof(keys[0].hmac_secret), EVP_sha256(), NULL);
+    return 1;
+  }
+
+  for (unsigned i = 0; i < nkeys; ++i) {
+    if (memcmp(keyname, keys[i].key_name, sizeof(keys[i].key_name)) == 0) {
+      EVP_DecryptInit_ex(cipher_ctx, EVP_aes_128_cbc(), NULL, keys[i].aes_key, iv);
+      HMAC_Init_ex(hctx, keys[i].hmac_secret, sizeof(keys[i].hmac_secret), EVP_sha256(), NULL);
+      if (i != 0) {
+        // Issued with a retired key, have the client renew the ticket.
+        NET_SUM_GLOBAL_DYN_STAT(net_ssl_ticket_renewed_stat, 1);
+        return 2;
+      }
+      return 1;
+    }
+  }
+
+  Debug("ssl", "no key for session ticket, doing a full handshake");
+  NET_SUM_GLOBAL_DYN_STAT(net_ssl_ticket_key_not_found_stat, 1);
+  return 0;
+}
+#endif /* SSL_CTX_set_tlsext_ticket_key_cb */
+
 static SSL_CTX *
 ssl_context_enable_sni(SSL_CTX * ctx, SSLCertLookup * lookup)
 {
@@ -192,6 +306,9 @@ ssl_context_enable_sni(SSL_CTX * ctx, SSLCertLookup * lookup)
   if (ctx) {
     SSL_CTX_set_tlsext_servername_callback(ctx, ssl_servername_callback);
     SSL_CTX_set_tlsext_servername_arg(ctx, lookup);
+#if SSL_LAZY_LOAD_ASYNC
+    SSL_CTX_set_cert_cb(ctx, ssl_cert_callback, lookup);
+#endif
   }
 #else
   NOWARN_UNUSED(ctx);
@@ -218,6 +335,8 @@ SSLInitializeLibrary()
 
     CRYPTO_set_locking_callback(SSL_locking_callback);
     CRYPTO_set_id_callback(SSL_pthreads_thread_id);
+
+    RAND_bytes((unsigned char *)&ssl_default_ticket_key, sizeof(ssl_default_ticket_key));
   }
 
   open_ssl_initialized = true;
@@ -289,8 +408,19 @@ SSLInitServerContext(
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
     SSL_CTX_sess_set_cache_size(ctx, params->ssl_session_cache_size);
     break;
+  case SSLConfigParams::SSL_SESSION_CACHE_MODE_SHARED:
+    sslSessionCache.attach(ctx);
+    break;
   }
 
+#if defined(SSL_CTX_set_tlsext_ticket_key_cb)
+  if (params->ssl_session_tickets) {
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, ssl_callback_session_ticket);
+  } else {
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+  }
+#endif
+
   SSL_CTX_set_quiet_shutdown(ctx, 1);
 
   // XXX OpenSSL recommends that we should use SSL_CTX_use_certificate_chain_file() here. That API
@@ -407,6 +537,12 @@ SSLInitClientContext(const SSLConfigParams * params)
     return NULL;
   }
 
+  if (params->ssl_origin_session_cache) {
+    sslOriginSessionCache.attach(client_ctx);
+  } else {
+    SSL_CTX_set_session_cache_mode(client_ctx, SSL_SESS_CACHE_OFF);
+  }
+
   // if no path is given for the client private key,
   // assume it is contained in the client certificate file.
   clientKeyPtr = params->clientKeyPath;
@@ -467,16 +603,36 @@ asn1_strdup(ASN1_STRING * s)
     return ats_strndup((const char *)ASN1_STRING_data(s), ASN1_STRING_length(s));
 }
 
-// Given a certificate and it's corresponding SSL_CTX context, insert hash
-// table aliases for all of the subject and subjectAltNames. Note that we don't
-// deal with wildcards (yet).
+// Insert a name for either a loaded or a lazy certificate.
+static void
+ssl_index_name(SSLCertLookup * lookup, SSL_CTX * ctx, SSLLazyContext * lazy, const char * name)
+{
+  if (lazy) {
+    lookup->insert(lazy, name);
+  } else {
+    lookup->insert(ctx, name);
+  }
+}
+
+// Given a certificate and it's corresponding SSL_CTX context (or the lazy
+// certificate that will load it), insert aliases for all of the subject and
+// subjectAltNames.
 static void
-ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, const char * certfile)
+ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, SSLLazyContext * lazy, const char * certfile)
 {
   X509_NAME * subject = NULL;
 
   ats_file_bio bio(certfile, "r");
+  if (!bio) {
+    SSLError("failed to open certificate %s", certfile);
+    return;
+  }
+
   ats_x509_certificate certificate(PEM_read_bio_X509_AUX(bio.bio, NULL, NULL, NULL));
+  if (!certificate) {
+    SSLError("failed to read certificate from %s", certfile);
+    return;
+  }
 
   // Insert a key for the subject CN.
   subject = X509_get_subject_name(certificate.x509);
@@ -493,7 +649,7 @@ ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, const char * certfi
       xptr<char> name(asn1_strdup(cn));
 
       Debug("ssl", "mapping '%s' to certificate %s", (const char *)name, certfile);
-      lookup->insert(ctx, name);
+      ssl_index_name(lookup, ctx, lazy, name);
     }
   }
 
@@ -509,7 +665,7 @@ ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, const char * certfi
       if (name->type == GEN_DNS) {
         xptr<char> dns(asn1_strdup(name->d.dNSName));
         Debug("ssl", "mapping '%s' to certificate %s", (const char *)dns, certfile);
-        lookup->insert(ctx, dns);
+        ssl_index_name(lookup, ctx, lazy, dns);
       }
     }
 
@@ -531,14 +687,22 @@ ssl_store_ssl_context(
   SSL_CTX *   ctx;
   xptr<char>  certpath;
 
+  certpath = Layout::relative_to(params->serverCertPathOnly, cert);
+
+  // Certificates for an address are needed before there is a server name to look up, so only
+  // those that are found by name are loaded lazily.
+  if (params->ssl_lazy_load && !addr) {
+    // Only the certificate is read to index its names, the key and chain are loaded on first use.
+    ssl_index_certificate(lookup, NULL, lookup->newLazyContext(cert, ca, key), certpath);
+    return;
+  }
+
   ctx = ssl_context_enable_sni(SSLInitServerContext(params, cert, ca, key), lookup);
   if (!ctx) {
     SSLError("failed to create new SSL server context");
     return;
   }
 
-  certpath = Layout::relative_to(params->serverCertPathOnly, cert);
-
   // Index this certificate by the specified IP(v6) address. If the address is "*", make it the default context.
   if (addr) {
     if (strcmp(addr, "*") == 0) {
@@ -559,7 +723,24 @@ ssl_store_ssl_context(
   // Insert additional mappings. Note that this maps multiple keys to the same value, so when
   // this code is updated to reconfigure the SSL certificates, it will need some sort of
   // refcounting or alternate way of avoiding double frees.
-  ssl_index_certificate(lookup, ctx, certpath);
+  ssl_index_certificate(lookup, ctx, NULL, certpath);
+}
+
+static SSL_CTX *
+ssl_load_lazy_context(SSLCertLookup * lookup, const SSLLazyContext * lazy)
+{
+  SSL_CTX * ctx;
+
+  Debug("ssl", "loading certificate %s on first use", lazy->cert);
+  ctx = ssl_context_enable_sni(SSLInitServerContext(lazy->params, lazy->cert, lazy->ca, lazy->key), lookup);
+  if (ctx == NULL) {
+    SSLError("failed to load certificate %s", lazy->cert);
+    NET_SUM_GLOBAL_DYN_STAT(net_ssl_lazy_context_load_failures_stat, 1);
+    return NULL;
+  }
+
+  NET_SUM_GLOBAL_DYN_STAT(net_ssl_lazy_context_loads_stat, 1);
+  return ctx;
 }
 
 static bool
@@ -606,6 +787,40 @@ ssl_extract_certificate(
   return true;
 }
 
+ssl_ticket_key_t *
+SSLLoadTicketKeys(const char * path, unsigned * nkeys)
+{
+  struct stat sbuf;
+  ssl_ticket_key_t * keys;
+  int fd;
+
+  *nkeys = 0;
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    Error("failed to open session ticket key file %s: %s", path, strerror(errno));
+    return NULL;
+  }
+
+  if (fstat(fd, &sbuf) < 0 || sbuf.st_size == 0 || sbuf.st_size % sizeof(ssl_ticket_key_t) != 0) {
+    Error("session ticket key file %s must hold a multiple of %u bytes", path, (unsigned)sizeof(ssl_ticket_key_t));
+    close(fd);
+    return NULL;
+  }
+
+  keys = (ssl_ticket_key_t *)ats_malloc(sbuf.st_size);
+  if (read(fd, keys, sbuf.st_size) != sbuf.st_size) {
+    Error("failed to read session ticket key file %s: %s", path, strerror(errno));
+    ats_free(keys);
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+
+  *nkeys = sbuf.st_size / sizeof(ssl_ticket_key_t);
+  Debug("ssl", "loaded %u session ticket keys from %s", *nkeys, path);
+  return keys;
+}
+
 bool
 SSLParseCertificateConfiguration(
     const SSLConfigParams * params,
@@ -626,6 +841,9 @@ SSLParseCertificateConfiguration(
 
   Note("loading SSL certificate configuration from %s", params->configFilePath);
 
+  lookup->lazy_loader = ssl_load_lazy_context;
+  lookup->lazy_max_contexts = params->ssl_lazy_max_contexts;
+
   if (params->configFilePath) {
     file_buf = readIntoBuffer(params->configFilePath, __func__, NULL);
   }
@@ -681,6 +899,7 @@ SSLParseCertificateConfiguration(
     lookup->insert(lookup->ssl_default, "*");
   }
 
+  lookup->compile();
   return true;
 }
 
@@ -61,6 +61,8 @@ struct InactivityCop : public Continuation {
         close_UnixNetVConnection(vc, e->ethread);
         continue;
       } 
+      // Backstop for idle connections whose completion wakeup was missed.
+      vc->reap_zerocopy();
       if (vc->next_inactivity_timeout_at && vc->next_inactivity_timeout_at < now)
         vc->handleEvent(EVENT_IMMEDIATE, e);
     }
@@ -330,6 +332,9 @@ NetHandler::mainNetEvent(int event, Event *e)
     epd = (EventIO*) get_ev_data(pd,x);
     if (epd->type == EVENTIO_READWRITE_VC) {
       vc = epd->data.vc;
+      // Zero-copy completions are queued on the socket error queue.
+      if (get_ev_events(pd,x) & EVENTIO_ERROR)
+        vc->reap_zerocopy();
       if (get_ev_events(pd,x) & (EVENTIO_READ|EVENTIO_ERROR)) {
         vc->read.triggered = 1;
         if (!read_ready_list.in(vc))
@@ -38,6 +38,25 @@ safe_delay(int msec)
   socketManager.poll(0, 0, msec);
 }
 
+//
+// NUMA node of the CPU that received the packets of the connection
+// (i.e. the one serving its NIC receive queue), -1 if unknown.
+//
+static int
+incoming_numa_node(int fd)
+{
+#if TS_USE_HWLOC && defined(SO_INCOMING_CPU)
+  int cpu = -1;
+  int len = sizeof(cpu);
+
+  if (safe_getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, (char *) &cpu, &len) == 0 && cpu >= 0)
+    return ink_numa_node_of_cpu(cpu);
+#else
+  (void) fd;
+#endif
+  return -1;
+}
+
 
 //
 // Send the throttling message to up to THROTTLE_AT_ONCE connections,
@@ -321,8 +340,24 @@ NetAccept::do_blocking_accept(EThread * t)
     vc->mutex = new_ProxyMutex();
     vc->action_ = *action_;
     SET_CONTINUATION_HANDLER(vc, (NetVConnHandler) & UnixNetVConnection::acceptEvent);
+
+    // Hand the connection to a net thread on the node which owns its NIC queue,
+    // and count whether the thread that handles it is on that node.
+    EThread *t_node = NULL;
+    if (net_numa_accept_steering && getEtype() == ET_NET) {
+      int node = incoming_numa_node(vc->con.fd);
+      if (node >= 0) {
+        t_node = eventProcessor.assign_thread_on_node(node);
+        if (!t_node)
+          t_node = eventProcessor.assign_thread(ET_NET);
+        NET_SUM_GLOBAL_DYN_STAT(t_node->numa_node == node ? net_accepts_numa_local_stat : net_accepts_numa_remote_stat, 1);
+      }
+    }
     //eventProcessor.schedule_imm(vc, getEtype());
-    eventProcessor.schedule_imm_signal(vc, getEtype());
+    if (t_node)
+      t_node->schedule_imm_signal(vc);
+    else
+      eventProcessor.schedule_imm_signal(vc, getEtype());
   } while (loop);
 
   return 1;
@@ -464,6 +499,13 @@ NetAccept::acceptFastEvent(int event, void *ep)
     }
     vc->con.fd = fd;
 
+    // The connection stays on this thread, just count where it came from.
+    if (net_numa_accept_steering && e->ethread->numa_node >= 0) {
+      int node = incoming_numa_node(fd);
+      if (node >= 0)
+        NET_SUM_GLOBAL_DYN_STAT(node == e->ethread->numa_node ? net_accepts_numa_local_stat : net_accepts_numa_remote_stat, 1);
+    }
+
     NET_SUM_GLOBAL_DYN_STAT(net_connections_currently_open_stat, 1);
     vc->id = net_next_connection_number();
 
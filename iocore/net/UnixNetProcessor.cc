@@ -361,13 +361,13 @@ struct CheckConnect:public Continuation
     return EVENT_DONE;
   }
 
-  Action *connect_s(Continuation * cont, sockaddr const* target,
+  Action *connect_s(NetProcessor * processor, Continuation * cont, sockaddr const* target,
                     int _timeout, NetVCOptions * opt)
   {
     action_ = cont;
     timeout = HRTIME_SECONDS(_timeout);
     recursion++;
-    netProcessor.connect_re(this, target, opt);
+    processor->connect_re(this, target, opt);
     recursion--;
     if (connect_status != NET_EVENT_OPEN_FAILED)
       return &action_;
@@ -396,9 +396,327 @@ NetProcessor::connect_s(Continuation * cont, sockaddr const* target,
 {
   Debug("iocore_net_connect", "NetProcessor::connect_s called");
   CheckConnect *c = NEW(new CheckConnect(cont->mutex));
-  return c->connect_s(cont, target, timeout, opt);
+  return c->connect_s(this, cont, target, timeout, opt);
 }
 
+struct RaceConnect;
+
+struct RaceAttempt:public Continuation
+{
+  RaceConnect *race;
+  int index;
+  IpEndpoint addr;
+  NetVCOptions opt;
+  Action *pending;
+  bool started;
+
+  int handle_connect(int event, void *data);
+
+  RaceAttempt():Continuation(NULL), race(NULL), index(0), pending(NULL), started(false) {
+    SET_HANDLER(&RaceAttempt::handle_connect);
+  }
+};
+
+struct RaceConnect:public Continuation
+{
+  Action action_;
+  NetProcessor *processor;
+  RaceAttempt attempts[2];
+  Event *delay_event;
+  int timeout;
+  int running;
+  int recursion;
+  void *error;
+  bool done;
+
+  void start(int i)
+  {
+    RaceAttempt & a = attempts[i];
+    Action *result;
+
+    Debug("iocore_net_connect", "racing connect %d started", i);
+    a.started = true;
+    running++;
+    // connect_s() may call back before it returns, don't let that delete us
+    recursion++;
+    result = connect_attempt(a);
+    recursion--;
+    if (result != ACTION_RESULT_DONE)
+      a.pending = result;
+  }
+
+  virtual Action *connect_attempt(RaceAttempt & a)
+  {
+    return processor->connect_s(&a, &a.addr.sa, timeout, &a.opt);
+  }
+
+  void cancel_delay()
+  {
+    if (delay_event) {
+      delay_event->cancel();
+      delay_event = NULL;
+    }
+  }
+
+  // Called back by the attempts, with the mutex of the caller held.
+  int attempt_done(int i, int event, void *data)
+  {
+    attempts[i].pending = NULL;
+    running--;
+    if (NET_EVENT_OPEN == event) {
+      NetVConnection *vc = (NetVConnection *) data;
+      if (done || action_.cancelled) {
+        vc->do_io_close();
+      } else {
+        done = true;
+        cancel_delay();
+        RaceAttempt & other = attempts[!i];
+        if (other.pending) {
+          other.pending->cancel();
+          other.pending = NULL;
+          running--;
+        }
+        Debug("iocore_net_connect", "racing connect %d won", i);
+        if (ats_is_ip6(&attempts[i].addr))
+          NET_INCREMENT_DYN_STAT(net_connect_race_ipv6_wins_stat);
+        else
+          NET_INCREMENT_DYN_STAT(net_connect_race_ipv4_wins_stat);
+        action_.continuation->handleEvent(NET_EVENT_OPEN, vc);
+      }
+    } else {
+      error = data;
+      // Don't wait out the delay once the preferred address has failed.
+      if (!done && !action_.cancelled && !attempts[1].started) {
+        cancel_delay();
+        start(1);
+      }
+    }
+    return finish();
+  }
+
+  int delay_done(int, Event *)
+  {
+    delay_event = NULL;
+    if (!done && !action_.cancelled && !attempts[1].started)
+      start(1);
+    return finish();
+  }
+
+  int finish()
+  {
+    if (running || delay_event)
+      return EVENT_CONT;
+    if (!done && !action_.cancelled) {
+      done = true;
+      action_.continuation->handleEvent(NET_EVENT_OPEN_FAILED, error);
+    }
+    if (!recursion)
+      delete this;
+    return EVENT_DONE;
+  }
+
+  Action *connect_race(NetProcessor * _processor, Continuation * cont, sockaddr const* addr,
+                       sockaddr const* alternate, ink_hrtime delay, int _timeout, NetVCOptions * opt)
+  {
+    action_ = cont;
+    processor = _processor;
+    timeout = _timeout;
+    for (int i = 0; i < 2; i++) {
+      attempts[i].race = this;
+      attempts[i].index = i;
+      attempts[i].mutex = mutex;
+      if (opt)
+        attempts[i].opt = *opt;
+    }
+    ats_ip_copy(&attempts[0].addr, addr);
+    ats_ip_copy(&attempts[1].addr, alternate);
+    attempts[0].opt.ip_family = attempts[0].addr.sa.sa_family;
+    attempts[1].opt.ip_family = attempts[1].addr.sa.sa_family;
+
+    start(0);
+    // The caller may have been called back already, then there is nothing left to wait for.
+    if (done) {
+      ink_assert(!running);
+      delete this;
+      return ACTION_RESULT_DONE;
+    }
+    if (!attempts[1].started)
+      delay_event = mutex->thread_holding->schedule_in(this, delay);
+    return &action_;
+  }
+
+  RaceConnect(ProxyMutex * m):Continuation(m), processor(NULL), delay_event(NULL), timeout(0), running(0), recursion(0),
+                              error((void *) -ENET_CONNECT_FAILED), done(false) {
+    SET_HANDLER(&RaceConnect::delay_done);
+  }
+};
+
+int
+RaceAttempt::handle_connect(int event, void *data)
+{
+  return race->attempt_done(index, event, data);
+}
+
+Action *
+NetProcessor::connect_race(Continuation * cont, sockaddr const* addr, sockaddr const* alternate,
+                           ink_hrtime delay, int timeout, NetVCOptions * opt)
+{
+  Debug("iocore_net_connect", "NetProcessor::connect_race called");
+  RaceConnect *c = NEW(new RaceConnect(cont->mutex));
+  return c->connect_race(this, cont, addr, alternate, delay, timeout, opt);
+}
+
+#if TS_HAS_TESTS
+struct RaceConnectTest;
+
+// A race whose attempts are completed by the test instead of the network.
+struct TestRaceConnect:public RaceConnect
+{
+  RaceConnectTest *test;
+
+  Action *connect_attempt(RaceAttempt & a);
+
+  TestRaceConnect(ProxyMutex * m, RaceConnectTest * t):RaceConnect(m), test(t) { }
+};
+
+static int race_test_vc[2];
+
+struct RaceConnectTest:public Continuation
+{
+  RegressionTest *t;
+  int *pstatus;
+  int step;
+  bool ok;
+  bool open_at_once;            // the preferred attempt connects before connect_s() returns
+  RaceAttempt *attempt[2];      // as started, for completing them
+  ink_hrtime started_at[2];
+  Action pending[2];            // returned for the attempts, cancelled for the loser
+  int opened;
+  int failed;
+  void *vc;                     // the connection handed to us
+
+  void check(bool c, const char *what)
+  {
+    if (!c) {
+      rprintf(t, "RaceConnect: %s\n", what);
+      ok = false;
+    }
+  }
+
+  Action *race(ink_hrtime delay)
+  {
+    IpEndpoint addr, alternate;
+
+    ats_ip4_set(&addr, htonl(INADDR_LOOPBACK), htons(80));
+    ats_ip6_set(&alternate, in6addr_loopback, htons(80));
+    for (int i = 0; i < 2; i++) {
+      attempt[i] = NULL;
+      started_at[i] = 0;
+      pending[i] = NULL;
+      pending[i].cancelled = false;
+    }
+    opened = failed = 0;
+    vc = NULL;
+    TestRaceConnect *r = NEW(new TestRaceConnect(mutex, this));
+    return r->connect_race(&netProcessor, this, &addr.sa, &alternate.sa, delay, NET_CONNECT_TIMEOUT, NULL);
+  }
+
+  void complete(int i, int event)
+  {
+    RaceAttempt *a = attempt[i];
+
+    attempt[i] = NULL;
+    a->handleEvent(event, NET_EVENT_OPEN == event ? (void *) &race_test_vc[i] : (void *) -ENET_CONNECT_FAILED);
+  }
+
+  int main_handler(int event, void *data)
+  {
+    switch (event) {
+    case NET_EVENT_OPEN:
+      opened++;
+      vc = data;
+      return EVENT_DONE;
+    case NET_EVENT_OPEN_FAILED:
+      failed++;
+      return EVENT_DONE;
+    }
+
+    switch (step++) {
+    case 0:
+      // The preferred address connects within the delay, the alternate is never tried.
+      race(HRTIME_MSECONDS(100));
+      check(attempt[0] && !attempt[1], "the alternate was tried before the delay");
+      complete(0, NET_EVENT_OPEN);
+      check(opened == 1 && vc == &race_test_vc[0], "the preferred connection was not handed over");
+      this_ethread()->schedule_in(this, HRTIME_MSECONDS(300));
+      return EVENT_CONT;
+    case 1:
+      check(opened == 1 && !started_at[1], "the alternate was tried after the preferred address won");
+
+      // The preferred address is slow, the alternate is tried after the delay and wins.
+      race(HRTIME_MSECONDS(50));
+      this_ethread()->schedule_in(this, HRTIME_MSECONDS(300));
+      return EVENT_CONT;
+    case 2:
+      check(attempt[1] && started_at[1] - started_at[0] >= HRTIME_MSECONDS(50),
+            "the alternate was not tried after the delay");
+      if (attempt[1])
+        complete(1, NET_EVENT_OPEN);
+      check(opened == 1 && vc == &race_test_vc[1], "the alternate connection was not handed over");
+      check(pending[0].cancelled, "the losing connect was not cancelled");
+
+      // The preferred address fails, the alternate is tried without waiting and fails too.
+      race(HRTIME_SECONDS(10));
+      complete(0, NET_EVENT_OPEN_FAILED);
+      check(attempt[1] != NULL, "the alternate was not tried at once after a failure");
+      if (attempt[1])
+        complete(1, NET_EVENT_OPEN_FAILED);
+      check(!opened && failed == 1, "the failure was not reported once");
+
+      // The preferred address connects before connect_s() returns.
+      open_at_once = true;
+      check(race(HRTIME_MSECONDS(50)) == ACTION_RESULT_DONE, "a race that is over was still pending");
+      open_at_once = false;
+      check(opened == 1 && vc == &race_test_vc[0], "the connection made at once was not handed over");
+      this_ethread()->schedule_in(this, HRTIME_MSECONDS(300));
+      return EVENT_CONT;
+    default:
+      check(opened == 1 && !started_at[1], "the race went on after it was over");
+      break;
+    }
+
+    *pstatus = ok ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+    delete this;
+    return EVENT_DONE;
+  }
+
+  RaceConnectTest(RegressionTest * _t, int *_pstatus)
+    : Continuation(new_ProxyMutex()), t(_t), pstatus(_pstatus), step(0), ok(true), open_at_once(false),
+      opened(0), failed(0), vc(NULL)
+  {
+    SET_HANDLER(&RaceConnectTest::main_handler);
+  }
+};
+
+Action *
+TestRaceConnect::connect_attempt(RaceAttempt & a)
+{
+  test->attempt[a.index] = &a;
+  test->started_at[a.index] = ink_get_hrtime();
+  if (test->open_at_once && a.index == 0) {
+    test->complete(0, NET_EVENT_OPEN);
+    return ACTION_RESULT_DONE;
+  }
+  return &test->pending[a.index];
+}
+
+REGRESSION_TEST(RaceConnect) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+  eventProcessor.schedule_imm(NEW(new RaceConnectTest(t, pstatus)), ET_NET);
+}
+#endif
+
 
 
 struct PollCont;
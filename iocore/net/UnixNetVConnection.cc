@@ -38,8 +38,168 @@ typedef struct iovec IOVec;
 #define NET_MAX_IOV UIO_MAXIOV
 #endif
 
+#if defined(linux) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define NET_HAS_ZEROCOPY 1
+#endif
+
+// How often and for how long a closed connection waits for the kernel
+// to finish its zero-copy sends before the socket is aborted.
+#define ZEROCOPY_DRAIN_PERIOD HRTIME_MSECONDS(10)
+#define ZEROCOPY_DRAIN_TIMEOUT HRTIME_SECONDS(30)
+
 // Global
 ClassAllocator<UnixNetVConnection> netVCAllocator("netVCAllocator");
+ClassAllocator<ZeroCopySend> zeroCopySendAllocator("zeroCopySendAllocator");
+
+//
+// Zero-copy writes
+//
+static void
+zerocopy_release(Que(ZeroCopySend, link) & sends, uint32_t hi, bool all)
+{
+  ZeroCopySend *zs;
+  while ((zs = sends.head) && (all || (int32_t) (hi - zs->seq) >= 0)) {
+    sends.dequeue();
+    zs->blocks = NULL;
+    zeroCopySendAllocator.free(zs);
+  }
+}
+
+// Pick up the completions the kernel queued on the socket error queue and
+// let go of the buffers of the sends it is done with.
+static void
+zerocopy_reap(int fd, Que(ZeroCopySend, link) & sends)
+{
+#ifdef NET_HAS_ZEROCOPY
+  char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+
+  while (sends.head) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+      break;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+        continue;
+      struct sock_extended_err *serr = (struct sock_extended_err *) CMSG_DATA(cm);
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      // the kernel had to copy after all, e.g. loopback or no scatter-gather
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        NET_SUM_GLOBAL_DYN_STAT(net_zerocopy_copied_stat, serr->ee_data - serr->ee_info + 1);
+      zerocopy_release(sends, serr->ee_data, false);
+    }
+  }
+#else
+  (void) fd;
+  zerocopy_release(sends, 0, true);
+#endif
+}
+
+// Called on EPOLLERR, which the kernel raises when it queues completions,
+// and by the inactivity cop, so buffers are let go of even if nothing more
+// is written.
+void
+UnixNetVConnection::reap_zerocopy()
+{
+  if (zerocopy_sends.head)
+    zerocopy_reap(con.fd, zerocopy_sends);
+}
+
+static int64_t
+zerocopy_write(UnixNetVConnection *vc, IOVec *iov, IOBufferBlock **blocks, int niov)
+{
+#ifdef NET_HAS_ZEROCOPY
+  if (!vc->zerocopy) {
+    int on = 1;
+    vc->zerocopy = safe_setsockopt(vc->con.fd, SOL_SOCKET, SO_ZEROCOPY, (char *) &on, sizeof(on)) < 0 ? -1 : 1;
+    Debug("iocore_net", "zero-copy writes %s on fd %d", vc->zerocopy > 0 ? "enabled" : "not supported", vc->con.fd);
+  }
+  if (vc->zerocopy > 0) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = niov;
+    int64_t r = socketManager.sendmsg(vc->con.fd, &msg, MSG_ZEROCOPY);
+    // ENOBUFS: out of socket option memory to pin more pages, copy this one
+    if (r != -ENOBUFS) {
+      if (r > 0) {
+        ZeroCopySend *zs = zeroCopySendAllocator.alloc();
+        zs->seq = vc->zerocopy_seq++;
+        for (int i = niov - 1; i >= 0; i--) {
+          IOBufferBlock *b = blocks[i]->clone();
+          b->next = zs->blocks;
+          zs->blocks = b;
+        }
+        vc->zerocopy_sends.enqueue(zs);
+        NET_SUM_GLOBAL_DYN_STAT(net_zerocopy_writes_stat, 1);
+        NET_SUM_GLOBAL_DYN_STAT(net_zerocopy_write_bytes_stat, r);
+      }
+      return r;
+    }
+  }
+#else
+  (void) blocks;
+#endif
+  return socketManager.writev(vc->con.fd, iov, niov);
+}
+
+// Keeps the socket of a closed connection open until the kernel is done
+// with the outstanding zero-copy sends, so their buffers stay untouched.
+struct ZeroCopyDrain:public Continuation
+{
+  int fd;
+  ink_hrtime deadline;
+  Que(ZeroCopySend, link) sends;
+
+  ZeroCopyDrain()
+    : Continuation(new_ProxyMutex()), fd(NO_FD), deadline(0)
+  {
+    SET_HANDLER(&ZeroCopyDrain::mainEvent);
+  }
+
+  int mainEvent(int event, Event *e)
+  {
+    NOWARN_UNUSED(event);
+    zerocopy_reap(fd, sends);
+    if (sends.head && ink_get_hrtime() < deadline)
+      return EVENT_CONT;
+    if (sends.head) {
+      // reset the connection so the kernel drops the data it still holds
+      struct linger l;
+      l.l_onoff = 1;
+      l.l_linger = 0;
+      safe_setsockopt(fd, SOL_SOCKET, SO_LINGER, (char *) &l, sizeof(l));
+      zerocopy_release(sends, 0, true);
+    }
+    e->cancel();
+    socketManager.close(fd);
+    delete this;
+    return EVENT_DONE;
+  }
+};
+
+static void
+zerocopy_close(UnixNetVConnection *vc, EThread *t)
+{
+  zerocopy_reap(vc->con.fd, vc->zerocopy_sends);
+  if (!vc->zerocopy_sends.head)
+    return;
+
+  ZeroCopyDrain *drain = new ZeroCopyDrain;
+  drain->fd = vc->con.fd;
+  drain->sends = vc->zerocopy_sends;
+  drain->deadline = ink_get_hrtime() + ZEROCOPY_DRAIN_TIMEOUT;
+  vc->zerocopy_sends.clear();
+  vc->con.fd = NO_FD;
+  // the peer sees the end of the stream as it would on close
+  shutdown(drain->fd, SHUT_WR);
+  t->schedule_every(drain, ZEROCOPY_DRAIN_PERIOD);
+}
 
 //
 // Reschedule a UnixNetVConnection by moving it
@@ -95,9 +255,15 @@ net_activity(UnixNetVConnection *vc, EThread *thread)
 void
 close_UnixNetVConnection(UnixNetVConnection *vc, EThread *t)
 {
+  // A handshake step is running on a crypto thread, it closes the VC when it is back.
+  if (vc->getSSLHandShakeOffloaded())
+    return;
+
   NetHandler *nh = vc->nh;
   vc->cancel_OOB();
   vc->ep.stop();
+  if (vc->zerocopy_sends.head)
+    zerocopy_close(vc, t);
   vc->con.close();
 #ifdef INACTIVITY_TIMEOUT
   if (vc->inactivity_timeout) {
@@ -200,6 +366,42 @@ write_signal_error(NetHandler *nh, UnixNetVConnection *vc, int lerrno)
 }
 
 // Read the data for a UnixNetVConnection.
+// Adaptive read buffers: rather than letting write_avail() append a block
+// of the buffer's full size_index, size a new block after what is waiting
+// on the socket (FIONREAD) and what the previous read brought in. Idle
+// connections then hold a small block instead of pinning a 32K one.
+static int64_t
+adaptive_write_avail(UnixNetVConnection *vc, MIOBuffer *mbuf)
+{
+  if (!BUFFER_SIZE_INDEX_IS_FAST_ALLOCATED(mbuf->size_index))
+    return mbuf->write_avail();
+  // same test as MIOBuffer::check_add_block()
+  if (mbuf->high_water() || !mbuf->current_low_water())
+    return mbuf->current_write_avail();
+
+  int pending = 0;
+  if (ioctl(vc->con.fd, FIONREAD, &pending) < 0)
+    pending = 0;
+  int64_t want = pending > vc->read_size_hint ? pending : vc->read_size_hint;
+  mbuf->append_block(buffer_size_to_index(want, mbuf->size_index));
+  return mbuf->current_write_avail();
+}
+
+static inline bool
+adaptive_has_room(MIOBuffer *mbuf)
+{
+  return mbuf->current_write_avail() > 0 || (!mbuf->high_water() && mbuf->current_low_water());
+}
+
+// Drop the blocks past the writer that nothing was read into.
+static inline void
+release_empty_tail(MIOBuffer *mbuf)
+{
+  IOBufferBlock *w = mbuf->_writer;
+  if (w && w->next && !w->next->read_avail() && !w->next->next)
+    w->next = NULL;
+}
+
 // Rescheduling the UnixNetVConnection by moving the VC
 // onto or off of the ready_list.
 // Had to wrap this function with net_read_io for SSL.
@@ -231,7 +433,7 @@ read_from_net(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
     read_disable(nh, vc);
     return;
   }
-  int64_t toread = buf.writer()->write_avail();
+  int64_t toread = net_adaptive_read_buffers ? adaptive_write_avail(vc, buf.writer()) : buf.writer()->write_avail();
   if (toread > ntodo)
     toread = ntodo;
 
@@ -280,6 +482,8 @@ read_from_net(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
 
       if (r == -EAGAIN || r == -ENOTCONN) {
         NET_DEBUG_COUNT_DYN_STAT(net_calls_to_read_nodata_stat, 1);
+        if (net_adaptive_read_buffers)
+          release_empty_tail(buf.writer());
         vc->read.triggered = 0;
         nh->read_ready_list.remove(vc);
         return;
@@ -296,6 +500,8 @@ read_from_net(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
       return;
     }
     NET_SUM_DYN_STAT(net_read_bytes_stat, r);
+    // grow while the reads keep filling what we offer, otherwise follow them down
+    vc->read_size_hint = r >= toread ? 2 * toread : r;
 
     // Add data to buffer and signal continuation.
     buf.writer()->fill(r);
@@ -327,7 +533,8 @@ read_from_net(NetHandler *nh, UnixNetVConnection *vc, EThread *thread)
     }
   }
   // If here are is no more room, or nothing to do, disable the connection
-  if (s->vio.ntodo() <= 0 || !s->enabled || !buf.writer()->write_avail()) {
+  if (s->vio.ntodo() <= 0 || !s->enabled ||
+      !(net_adaptive_read_buffers ? adaptive_has_room(buf.writer()) : buf.writer()->write_avail())) {
     read_disable(nh, vc);
     return;
   }
@@ -784,7 +991,7 @@ UnixNetVConnection::UnixNetVConnection()
 #endif
     active_timeout(NULL), nh(NULL),
     id(0), flags(0), recursion(0), submit_time(0), oob_ptr(0),
-    from_accept_thread(false)
+    from_accept_thread(false), read_size_hint(0), zerocopy(0), zerocopy_seq(0)
 {
   memset(&local_addr, 0, sizeof local_addr);
   memset(&server_addr, 0, sizeof server_addr);
@@ -828,8 +1035,12 @@ UnixNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted,
   int64_t r = 0;
   int64_t offset = buf.entry->start_offset;
   IOBufferBlock *b = buf.entry->block;
+
+  if (zerocopy_sends.head)
+    zerocopy_reap(con.fd, zerocopy_sends);
   do {
     IOVec tiovec[NET_MAX_IOV];
+    IOBufferBlock *tblock[NET_MAX_IOV];
     int niov = 0;
     int64_t total_wrote_last = total_wrote;
     while (b && niov < NET_MAX_IOV) {
@@ -851,13 +1062,16 @@ UnixNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted,
       // build an iov entry
       tiovec[niov].iov_len = l;
       tiovec[niov].iov_base = b->start() + offset;
+      tblock[niov] = b;
       niov++;
       // on to the next block
       offset = 0;
       b = b->next;
     }
     wattempted = total_wrote - total_wrote_last;
-    if (niov == 1)
+    if (net_zerocopy_writes && wattempted >= net_zerocopy_min_bytes && zerocopy >= 0)
+      r = zerocopy_write(this, tiovec, tblock, niov);
+    else if (niov == 1)
       r = socketManager.write(con.fd, tiovec[0].iov_base, tiovec[0].iov_len);
     else
       r = socketManager.writev(con.fd, &tiovec[0], niov);
@@ -1139,6 +1353,10 @@ UnixNetVConnection::free(EThread *t)
   write.triggered = 0;
   options.reset();
   closed = 0;
+  read_size_hint = 0;
+  zerocopy = 0;
+  zerocopy_seq = 0;
+  ink_assert(!zerocopy_sends.head);
   ink_assert(!read.ready_link.prev && !read.ready_link.next);
   ink_assert(!read.enable_link.next);
   ink_assert(!write.ready_link.prev && !write.ready_link.next);
@@ -22,9 +22,16 @@
  */
 
 #include "P_SSLCertLookup.h"
+#include "P_SSLConfig.h"
 #include "ts/TestBox.h"
 #include <fstream>
 
+// The lookup releases the configuration it is built with, which these tests don't set.
+void
+SSLConfig::release(SSLConfigParams * /* params ATS_UNUSED */)
+{
+}
+
 static IpEndpoint
 make_endpoint(const char * address)
 {
@@ -129,6 +136,142 @@ REGRESSION_TEST(SSLAddressLookup)(RegressionTest* t, int /* atype ATS_UNUSED */,
   box.check(lookup.findInfoInHash(endpoint.ip4p) == context.ip4p, "IPv4 longest match lookup w/ port");
 }
 
+static unsigned lazy_loads = 0;
+
+static SSL_CTX *
+load_lazy_context(SSLCertLookup * /* lookup ATS_UNUSED */, const SSLLazyContext * lazy)
+{
+  ++lazy_loads;
+  return strcmp(lazy->cert, "broken.pem") == 0 ? NULL : SSL_CTX_new(SSLv23_server_method());
+}
+
+REGRESSION_TEST(SSLLazyCertificateLookup)(RegressionTest* t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox       box(t, pstatus);
+  SSLCertLookup lookup;
+  SSL_CTX *     ctx;
+
+  box = REGRESSION_TEST_PASSED;
+
+  lookup.lazy_loader = load_lazy_context;
+  lookup.lazy_max_contexts = 2;
+
+  SSLLazyContext * a = lookup.newLazyContext("a.pem", NULL, NULL);
+  SSLLazyContext * b = lookup.newLazyContext("b.pem", NULL, NULL);
+  SSLLazyContext * c = lookup.newLazyContext("c.pem", NULL, NULL);
+  SSLLazyContext * broken = lookup.newLazyContext("broken.pem", NULL, NULL);
+
+  box.check(lookup.insert(a, "a.com"), "insert lazy context");
+  box.check(lookup.insert(a, "*.a.com"), "insert lazy wildcard context");
+  box.check(lookup.insert(b, "b.com"), "insert lazy context");
+  box.check(lookup.insert(c, "c.com"), "insert lazy context");
+  box.check(lookup.insert(broken, "broken.com"), "insert lazy context");
+
+  // Nothing is loaded until a name is looked up.
+  box.check(lazy_loads == 0, "loaded %u contexts before any lookup", lazy_loads);
+  box.check(lookup.findInfoInHash("a.com") == NULL, "findInfoInHash does not load a.com");
+
+  ctx = lookup.findContext("www.a.com");
+  box.check(ctx != NULL && ctx == a->ctx, "lazy wildcard lookup for www.a.com");
+  SSL_CTX_free(ctx);
+
+  ctx = lookup.findContext("a.com");
+  box.check(ctx == a->ctx && lazy_loads == 1, "a.com is loaded once (%u loads)", lazy_loads);
+  SSL_CTX_free(ctx);
+
+  SSL_CTX_free(lookup.findContext("b.com"));
+  SSL_CTX_free(lookup.findContext("a.com"));
+
+  // Loading c.com goes over the limit, and b.com is the least recently used.
+  SSL_CTX_free(lookup.findContext("c.com"));
+  box.check(lazy_loads == 3, "c.com is loaded (%u loads)", lazy_loads);
+  box.check(a->ctx != NULL && b->ctx == NULL && c->ctx != NULL, "b.com is unloaded");
+
+  SSL_CTX_free(lookup.findContext("b.com"));
+  box.check(lazy_loads == 4 && b->ctx != NULL && a->ctx == NULL, "b.com is loaded again, a.com is unloaded");
+
+  // The lookup that does not load hands an unloaded certificate back to the caller.
+  SSLLazyContext * pending;
+
+  ctx = lookup.findContext("a.com", &pending);
+  box.check(ctx == NULL && pending == a && lazy_loads == 4, "a.com is left to the caller to load");
+  ctx = lookup.findContext("b.com", &pending);
+  box.check(ctx == b->ctx && pending == NULL, "b.com is found loaded");
+  SSL_CTX_free(ctx);
+
+  // A certificate that fails to load is not retried.
+  box.check(lookup.findContext("broken.com") == NULL, "broken.com fails to load");
+  box.check(lookup.findContext("broken.com") == NULL && lazy_loads == 5, "broken.com is loaded once (%u loads)", lazy_loads);
+  box.check(lookup.findContext("broken.com", &pending) == NULL && pending == NULL, "broken.com is not handed back");
+
+  box.check(lookup.findContext("d.com") == NULL, "no context for d.com");
+}
+
+// Index a large certificate configuration and time building the lookup and
+// looking names up in it. Half of the names are host names and half are
+// wildcards, and every lookup is checked against the context it should find.
+#define BENCH_NAMES   100000
+#define BENCH_LOOKUPS 1000000
+
+REGRESSION_TEST(SSLCertificateLookupBench)(RegressionTest* t, int /* atype ATS_UNUSED */, int * pstatus)
+{
+  TestBox       box(t, pstatus);
+  SSLCertLookup lookup;
+  SSL_CTX *     ctx[4];
+  char          name[TS_MAX_HOST_NAME_LEN + 1];
+  unsigned      failed = 0;
+
+  box = REGRESSION_TEST_PASSED;
+
+  for (unsigned i = 0; i < countof(ctx); ++i) {
+    ctx[i] = SSL_CTX_new(SSLv23_server_method());
+    assert(ctx[i] != NULL);
+  }
+
+  ink_hrtime start = ink_get_hrtime_internal();
+
+  for (unsigned i = 0; i < BENCH_NAMES / 2; ++i) {
+    snprintf(name, sizeof(name), "www%u.host%u.com", i, i % 1000);
+    lookup.insert(ctx[i % 2], name);
+    snprintf(name, sizeof(name), "*.site%u.wild%u.net", i, i % 1000);
+    lookup.insert(ctx[2 + (i % 2)], name);
+  }
+
+  lookup.compile();
+  ink_hrtime built = ink_get_hrtime_internal();
+
+  for (unsigned n = 0; n < BENCH_LOOKUPS; ++n) {
+    unsigned i = (n * 7919) % (BENCH_NAMES / 2);
+    SSL_CTX * expect;
+
+    switch (n % 3) {
+    case 0:
+      snprintf(name, sizeof(name), "www%u.host%u.com", i, i % 1000);
+      expect = ctx[i % 2];
+      break;
+    case 1:
+      snprintf(name, sizeof(name), "a.b.site%u.wild%u.net", i, i % 1000);
+      expect = ctx[2 + (i % 2)];
+      break;
+    default:
+      snprintf(name, sizeof(name), "www%u.host%u.org", i, i % 1000);
+      expect = NULL;
+      break;
+    }
+
+    if (lookup.findInfoInHash(name) != expect) {
+      ++failed;
+    }
+  }
+
+  ink_hrtime done = ink_get_hrtime_internal();
+
+  rperf(t, "build_msec", (double)(built - start) / HRTIME_MSECOND);
+  rperf(t, "lookup_nsec", (double)(done - built) / BENCH_LOOKUPS);
+
+  box.check(failed == 0, "%u of %u lookups found the wrong context", failed, BENCH_LOOKUPS);
+}
+
 static unsigned
 load_hostnames_csv(const char * fname, SSLCertLookup& lookup)
 {
@@ -190,6 +333,8 @@ int main(int argc, const char ** argv)
       count += load_hostnames_csv(argv[i], lookup);
     }
 
+    lookup.compile();
+
     printf("loaded %u host names\n", count);
 
   } else {
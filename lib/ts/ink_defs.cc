@@ -66,6 +66,30 @@ ink_get_topology()
   return topology;
 }
 
+int
+ink_numa_node_of_cpu(int cpu)
+{
+  hwloc_obj_t pu = hwloc_get_pu_obj_by_os_index(ink_get_topology(), cpu);
+
+  if (!pu || !pu->nodeset || hwloc_bitmap_weight(pu->nodeset) != 1)
+    return -1;
+  return hwloc_bitmap_first(pu->nodeset);
+}
+
+bool
+ink_numa_bind_thread_memory(int node)
+{
+  hwloc_nodeset_t nodeset = hwloc_bitmap_alloc();
+  int res;
+
+  hwloc_bitmap_only(nodeset, node);
+  // Without HWLOC_MEMBIND_STRICT this falls back to other nodes when the
+  // local node is out of memory.
+  res = hwloc_set_membind_nodeset(ink_get_topology(), nodeset, HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_THREAD);
+  hwloc_bitmap_free(nodeset);
+  return res == 0;
+}
+
 #endif
 
 int
@@ -148,3 +172,15 @@ ink_number_of_processors()
 
 #endif
 }
+
+int
+ink_number_of_numa_nodes()
+{
+#if TS_USE_HWLOC
+  int nodes = hwloc_get_nbobjs_by_type(ink_get_topology(), HWLOC_OBJ_NODE);
+
+  return nodes > 0 ? nodes : 1;
+#else
+  return 1;
+#endif
+}
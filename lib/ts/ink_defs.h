@@ -169,10 +169,15 @@ extern int on;
 */
 int ink_sys_name_release(char *name, int namelen, char *release, int releaselen);
 int ink_number_of_processors();
+int ink_number_of_numa_nodes();
 
 #if TS_USE_HWLOC
 // Get the hardware topology
 hwloc_topology_t ink_get_topology();
+// Get the NUMA node owning the given (OS numbered) cpu, or -1 if unknown
+int ink_numa_node_of_cpu(int cpu);
+// Bind the memory allocated by the calling thread to the given NUMA node
+bool ink_numa_bind_thread_memory(int node);
 #endif
 
 /** Constants.
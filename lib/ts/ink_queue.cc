@@ -81,6 +81,117 @@ inkcoreapi volatile int64_t freelist_allocated_mem = 0;
 #define fl_memadd(_x_) \
    ink_atomic_increment(&freelist_allocated_mem, (int64_t) (_x_));
 
+#if !TS_USE_RECLAIMABLE_FREELIST
+int64_t cfg_magazine_size = INK_MAGAZINE_DEFAULT_SIZE;
+
+/*
+ * Per thread magazines
+ *
+ * Each thread keeps a small stack of free items per freelist (a
+ * magazine) so that most ink_freelist_new/free calls touch no shared
+ * memory at all. An empty magazine is refilled and a full one is
+ * drained half a magazine at a time: the batch moves as a single chain
+ * through the freelist's depot, costing one CAS for the whole batch.
+ * Items sitting in the depot are counted as free, items sitting in a
+ * magazine are counted as in use.
+ *
+ * The nr_new/nr_free accounting is kept in the magazine as well and
+ * folded into the freelist every MAGAZINE_STATS_BATCH operations, so
+ * the shared counters lag each thread by at most that much, and by
+ * ink_freelists_flush_thread_stats() for threads that went idle.
+ */
+#define MAX_NUM_MAGAZINE_FREELIST 1024
+#define NO_MAGAZINE ((uint32_t) -1)
+#define MAGAZINE_STATS_BATCH 64
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t nr_new, nr_free;
+  void *items[INK_MAGAZINE_MAX_SIZE];
+} InkMagazine;
+
+static __thread InkMagazine *thread_magazines[MAX_NUM_MAGAZINE_FREELIST];
+static InkFreeList *magazine_freelists[MAX_NUM_MAGAZINE_FREELIST];
+static volatile int nr_magazine_freelist = 0;
+static pthread_key_t magazine_key;
+static pthread_once_t magazine_key_once = PTHREAD_ONCE_INIT;
+
+// NUMA node of the calling thread, -1 when it is not bound to one.
+static __thread int freelist_numa_node = -1;
+
+static inline volatile head_p *
+freelist_head(InkFreeList * f)
+{
+  return freelist_numa_node < 0 ? &f->head : &f->numa_head[freelist_numa_node];
+}
+
+/*
+ * The chunks carved by threads bound to a NUMA node are taken from an
+ * address range reserved for that node, so that a free on any thread
+ * can tell from the address which node the item belongs to and give it
+ * back to that node's list. The ranges are reserved without backing
+ * (pages are placed by the memory policy of the thread touching them
+ * first, i.e. the carving one); when a range can't be reserved or is
+ * used up the chunk comes from the heap and its items go to the shared
+ * list when freed.
+ */
+#define NUMA_ARENA_SIZE (1ULL << 36)
+
+typedef struct
+{
+  char *volatile base;
+  volatile int64_t used;
+} InkNumaArena;
+
+static InkNumaArena numa_arenas[INK_MAX_NUMA_NODES];
+static volatile int numa_arenas_reserved = 0;
+
+static void *
+numa_chunk_alloc(int node, uint64_t size, uint32_t alignment)
+{
+  InkNumaArena *a = &numa_arenas[node];
+  uint64_t align = alignment ? alignment : sizeof(void *);
+
+  if (!a->base) {
+    void *p = mmap(NULL, NUMA_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+      return NULL;
+    if (ink_atomic_cas(&a->base, (char *) NULL, (char *) p))
+      numa_arenas_reserved = 1;
+    else
+      munmap(p, NUMA_ARENA_SIZE);
+  }
+
+  int64_t offset = ink_atomic_increment(&a->used, (int64_t) (size + align));
+  if ((uint64_t) offset + size + align > NUMA_ARENA_SIZE)
+    return NULL;
+  return (void *) (((uintptr_t) a->base + offset + align - 1) & ~(uintptr_t) (align - 1));
+}
+
+// NUMA node whose range holds item, -1 for heap chunks.
+static inline int
+numa_item_node(void *item)
+{
+  for (int i = 0; i < INK_MAX_NUMA_NODES; i++) {
+    char *base = numa_arenas[i].base;
+    if (base && (char *) item >= base && (char *) item < base + NUMA_ARENA_SIZE)
+      return i;
+  }
+  return -1;
+}
+#endif
+
+void
+ink_freelist_set_numa_node(int node)
+{
+#if !TS_USE_RECLAIMABLE_FREELIST
+  freelist_numa_node = (node >= 0 && node < INK_MAX_NUMA_NODES) ? node : -1;
+#else
+  (void) node;
+#endif
+}
+
 void
 ink_freelist_init(InkFreeList **fl, const char *name, uint32_t type_size,
                   uint32_t chunk_size, uint32_t alignment)
@@ -106,11 +217,30 @@ ink_freelist_init(InkFreeList **fl, const char *name, uint32_t type_size,
   f->chunk_size = chunk_size;
   f->type_size = type_size;
   SET_FREELIST_POINTER_VERSION(f->head, FROM_PTR(0), 0);
+  for (int i = 0; i < INK_MAX_NUMA_NODES; i++) {
+    SET_FREELIST_POINTER_VERSION(f->numa_head[i], FROM_PTR(0), 0);
+  }
+
+  // The depot links batches through the second word of their first item,
+  // smaller types go without a magazine.
+  ink_atomiclist_init(&f->depot, name, sizeof(void *));
+  for (int i = 0; i < INK_MAX_NUMA_NODES; i++)
+    ink_atomiclist_init(&f->numa_depot[i], name, sizeof(void *));
+  f->magazine_idx = NO_MAGAZINE;
+  if (type_size >= 2 * sizeof(void *)) {
+    int idx = ink_atomic_increment(&nr_magazine_freelist, 1);
+    if (idx < MAX_NUM_MAGAZINE_FREELIST) {
+      magazine_freelists[idx] = f;
+      f->magazine_idx = idx;
+    }
+  }
 
   f->count = 0;
   f->allocated = 0;
   f->allocated_base = 0;
   f->count_base = 0;
+  f->nr_new = 0;
+  f->nr_free = 0;
   *fl = f;
 #endif
 }
@@ -132,19 +262,20 @@ int fake_global_for_ink_queue = 0;
 #endif
 
 int fastmemtotal = 0;
-void *
-ink_freelist_new(InkFreeList * f)
+typedef volatile void *volatile_void_p;
+
+#if TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST
+static void freelist_push(InkFreeList * f, volatile head_p * fh, void *item);
+
+static void *
+freelist_pop(InkFreeList * f, volatile head_p * fh)
 {
-#if TS_USE_FREELIST
-#if TS_USE_RECLAIMABLE_FREELIST
-  return reclaimable_freelist_new(f);
-#else
   head_p item;
   head_p next;
   int result = 0;
 
   do {
-    INK_QUEUE_LD(item, f->head);
+    INK_QUEUE_LD(item, *fh);
     if (TO_PTR(FREELIST_POINTER(item)) == NULL) {
       uint32_t type_size = f->type_size;
       uint32_t i;
@@ -161,10 +292,14 @@ ink_freelist_new(InkFreeList * f)
 #ifdef DEBUG
       char *oldsbrk = (char *) sbrk(0), *newsbrk = NULL;
 #endif
-      if (f->alignment)
-        newp = ats_memalign(f->alignment, f->chunk_size * type_size);
-      else
-        newp = ats_malloc(f->chunk_size * type_size);
+      if (freelist_numa_node >= 0 && fh != &f->head)
+        newp = numa_chunk_alloc(freelist_numa_node, (uint64_t) f->chunk_size * type_size, f->alignment);
+      if (newp == NULL) {
+        if (f->alignment)
+          newp = ats_memalign(f->alignment, f->chunk_size * type_size);
+        else
+          newp = ats_malloc(f->chunk_size * type_size);
+      }
       fl_memadd(f->chunk_size * type_size);
 #ifdef DEBUG
       newsbrk = (char *) sbrk(0);
@@ -185,7 +320,7 @@ ink_freelist_new(InkFreeList * f)
         for (int j = 0; j < (int)type_size; j++)
           a[j] = str[j % 4];
 #endif
-        ink_freelist_free(f, a);
+        freelist_push(f, fh, a);
 #ifdef MEMPROTECT
         if (f->type_size >= MEMPROTECT_SIZE) {
           a += type_size - page_size;
@@ -202,9 +337,9 @@ ink_freelist_new(InkFreeList * f)
       SET_FREELIST_POINTER_VERSION(next, *ADDRESS_OF_NEXT(TO_PTR(FREELIST_POINTER(item)), 0),
                                    FREELIST_VERSION(item) + 1);
 #if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*)&f->head.data, item.data, next.data);
+       result = ink_atomic_cas((__int128_t*)&fh->data, item.data, next.data);
 #else
-       result = ink_atomic_cas((int64_t *) & f->head.data, item.data, next.data);
+       result = ink_atomic_cas((int64_t *) & fh->data, item.data, next.data);
 #endif
 
 #ifdef SANITY
@@ -227,26 +362,11 @@ ink_freelist_new(InkFreeList * f)
   ink_atomic_increment(&fastalloc_mem_in_use, (int64_t) f->type_size);
 
   return TO_PTR(FREELIST_POINTER(item));
-#endif /* TS_USE_RECLAIMABLE_FREELIST */
-#else // ! TS_USE_FREELIST
-  void *newp = NULL;
-
-  if (f->alignment)
-    newp = ats_memalign(f->alignment, f->chunk_size * f->type_size);
-  else
-    newp = ats_malloc(f->chunk_size * f->type_size);
-  return newp;
-#endif
 }
-typedef volatile void *volatile_void_p;
 
-void
-ink_freelist_free(InkFreeList * f, void *item)
+static void
+freelist_push(InkFreeList * f, volatile head_p * fh, void *item)
 {
-#if TS_USE_FREELIST
-#if TS_USE_RECLAIMABLE_FREELIST
-  return reclaimable_freelist_free(f, item);
-#else
   volatile_void_p *adr_of_next = (volatile_void_p *) ADDRESS_OF_NEXT(item, 0);
   head_p h;
   head_p item_pair;
@@ -266,7 +386,7 @@ ink_freelist_free(InkFreeList * f, void *item)
 
   result = 0;
   do {
-    INK_QUEUE_LD(h, f->head);
+    INK_QUEUE_LD(h, *fh);
 #ifdef SANITY
     if (TO_PTR(FREELIST_POINTER(h)) == item)
       ink_fatal(1, "ink_freelist_free: trying to free item twice");
@@ -279,9 +399,9 @@ ink_freelist_free(InkFreeList * f, void *item)
     SET_FREELIST_POINTER_VERSION(item_pair, FROM_PTR(item), FREELIST_VERSION(h));
     INK_MEMORY_BARRIER;
 #if TS_HAS_128BIT_CAS
-       result = ink_atomic_cas((__int128_t*) & f->head, h.data, item_pair.data);
+       result = ink_atomic_cas((__int128_t*) & fh->data, h.data, item_pair.data);
 #else
-       result = ink_atomic_cas((int64_t *) & f->head, h.data, item_pair.data);
+       result = ink_atomic_cas((int64_t *) & fh->data, h.data, item_pair.data);
 #endif
 
   }
@@ -289,8 +409,199 @@ ink_freelist_free(InkFreeList * f, void *item)
 
   ink_atomic_increment((int *) &f->count, -1);
   ink_atomic_increment(&fastalloc_mem_in_use, -(int64_t) f->type_size);
+}
+
+static inline InkAtomicList *
+freelist_depot(InkFreeList * f)
+{
+  return freelist_numa_node < 0 ? &f->depot : &f->numa_depot[freelist_numa_node];
+}
+
+static inline uint32_t
+magazine_capacity()
+{
+  int64_t size = cfg_magazine_size;
+
+  if (size > INK_MAGAZINE_MAX_SIZE)
+    return INK_MAGAZINE_MAX_SIZE;
+  return size < 2 ? 0 : (uint32_t) size;
+}
+
+static inline void
+magazine_flush_stats(InkFreeList * f, InkMagazine * m)
+{
+  ink_atomic_increment(&f->nr_new, (int64_t) m->nr_new);
+  ink_atomic_increment(&f->nr_free, (int64_t) m->nr_free);
+  m->nr_new = m->nr_free = 0;
+}
+
+// Give the items still held by an exiting thread back to the freelists.
+static void
+magazine_thread_exit(void *)
+{
+  for (int i = 0; i < nr_magazine_freelist && i < MAX_NUM_MAGAZINE_FREELIST; i++) {
+    InkMagazine *m = thread_magazines[i];
+    if (!m)
+      continue;
+    magazine_flush_stats(magazine_freelists[i], m);
+    while (m->count)
+      freelist_push(magazine_freelists[i], freelist_head(magazine_freelists[i]), m->items[--m->count]);
+    ats_free(m);
+    thread_magazines[i] = NULL;
+  }
+}
+
+static void
+magazine_key_init()
+{
+  ink_assert(pthread_key_create(&magazine_key, magazine_thread_exit) == 0);
+}
+
+static inline InkMagazine *
+freelist_magazine(InkFreeList * f)
+{
+  if (f->magazine_idx == NO_MAGAZINE)
+    return NULL;
+
+  InkMagazine *m = thread_magazines[f->magazine_idx];
+  if (likely(m != NULL) || !magazine_capacity())
+    return m;
+
+  pthread_once(&magazine_key_once, magazine_key_init);
+  pthread_setspecific(magazine_key, (void *) 1);  // so magazine_thread_exit runs
+  m = (InkMagazine *)ats_malloc(sizeof(InkMagazine));
+  m->count = 0;
+  m->nr_new = m->nr_free = 0;
+  thread_magazines[f->magazine_idx] = m;
+  return m;
+}
+
+static void
+magazine_refill(InkFreeList * f, InkMagazine * m, uint32_t batch)
+{
+  void *item = ink_atomiclist_pop(freelist_depot(f));
+
+  if (item) {
+    uint32_t n = 0;
+    // a batch is a chain of items linked through their first word
+    while (item && m->count < INK_MAGAZINE_MAX_SIZE) {
+      m->items[m->count++] = item;
+      item = *(void **) item;
+      n++;
+    }
+    ink_assert(!item);
+    ink_atomic_increment((int *) &f->count, n);
+    ink_atomic_increment(&fastalloc_mem_in_use, (int64_t) n * f->type_size);
+  } else {
+    volatile head_p *fh = freelist_head(f);
+    while (m->count < batch)
+      m->items[m->count++] = freelist_pop(f, fh);
+  }
+}
+
+static void
+magazine_drain(InkFreeList * f, InkMagazine * m, uint32_t batch)
+{
+  uint32_t i;
+
+  // Hand the oldest items to the depot, keep the recently used (cache hot) ones.
+  for (i = 0; i < batch - 1; i++)
+    *(void **) m->items[i] = m->items[i + 1];
+  *(void **) m->items[batch - 1] = NULL;
+  ink_atomiclist_push(freelist_depot(f), m->items[0]);
+
+  m->count -= batch;
+  memmove(m->items, m->items + batch, m->count * sizeof(void *));
+  ink_atomic_increment((int *) &f->count, -(int) batch);
+  ink_atomic_increment(&fastalloc_mem_in_use, -(int64_t) batch * f->type_size);
+}
+#endif /* TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST */
+
+void *
+ink_freelist_new(InkFreeList * f)
+{
+#if TS_USE_FREELIST
+#if TS_USE_RECLAIMABLE_FREELIST
+  ink_atomic_increment(&f->nr_new, (int64_t) 1);
+  return reclaimable_freelist_new(f);
+#else
+  InkMagazine *m = freelist_magazine(f);
+
+  if (m) {
+    if (++m->nr_new >= MAGAZINE_STATS_BATCH)
+      magazine_flush_stats(f, m);
+    if (!m->count) {
+      uint32_t capacity = magazine_capacity();
+      if (capacity)
+        magazine_refill(f, m, capacity / 2);
+    }
+    if (m->count) {
+      void *item = m->items[--m->count];
+      ink_assert(!((uintptr_t)item&(((uintptr_t)f->alignment)-1)));
+      return item;
+    }
+  } else {
+    ink_atomic_increment(&f->nr_new, (int64_t) 1);
+  }
+  return freelist_pop(f, freelist_head(f));
 #endif /* TS_USE_RECLAIMABLE_FREELIST */
+#else // ! TS_USE_FREELIST
+  void *newp = NULL;
+
+  ink_atomic_increment(&f->nr_new, (int64_t) 1);
+
+  if (f->alignment)
+    newp = ats_memalign(f->alignment, f->chunk_size * f->type_size);
+  else
+    newp = ats_malloc(f->chunk_size * f->type_size);
+  return newp;
+#endif
+}
+
+void
+ink_freelist_free(InkFreeList * f, void *item)
+{
+#if TS_USE_FREELIST
+#if TS_USE_RECLAIMABLE_FREELIST
+  ink_atomic_increment(&f->nr_free, (int64_t) 1);
+  return reclaimable_freelist_free(f, item);
 #else
+  // Items carved on another node go back to that node's list, so they
+  // are not handed out again by the threads of this one.
+  if (numa_arenas_reserved) {
+    int node = numa_item_node(item);
+    if (node != freelist_numa_node) {
+      ink_atomic_increment(&f->nr_free, (int64_t) 1);
+      freelist_push(f, node < 0 ? &f->head : &f->numa_head[node], item);
+      return;
+    }
+  }
+
+  InkMagazine *m = freelist_magazine(f);
+
+  if (m) {
+    if (++m->nr_free >= MAGAZINE_STATS_BATCH)
+      magazine_flush_stats(f, m);
+    uint32_t capacity = magazine_capacity();
+    if (m->count >= capacity && capacity)
+      magazine_drain(f, m, capacity / 2);
+    if (m->count < capacity) {
+#ifdef DEADBEEF
+      static const char str[4] = { (char) 0xde, (char) 0xad, (char) 0xbe, (char) 0xef };
+
+      for (int j = 0; j < (int)f->type_size; j++)
+        ((char*)item)[j] = str[j % 4];
+#endif /* DEADBEEF */
+      m->items[m->count++] = item;
+      return;
+    }
+  } else {
+    ink_atomic_increment(&f->nr_free, (int64_t) 1);
+  }
+  freelist_push(f, freelist_head(f), item);
+#endif /* TS_USE_RECLAIMABLE_FREELIST */
+#else
+  ink_atomic_increment(&f->nr_free, (int64_t) 1);
   if (f->alignment)
     ats_memalign_free(item);
   else
@@ -298,6 +609,20 @@ ink_freelist_free(InkFreeList * f, void *item)
 #endif
 }
 
+// Fold the object counts the magazines of the calling thread hold back
+// into the freelists, so that they don't lag behind on idle threads.
+void
+ink_freelists_flush_thread_stats()
+{
+#if TS_USE_FREELIST && !TS_USE_RECLAIMABLE_FREELIST
+  for (int i = 0; i < nr_magazine_freelist && i < MAX_NUM_MAGAZINE_FREELIST; i++) {
+    InkMagazine *m = thread_magazines[i];
+    if (m && (m->nr_new || m->nr_free))
+      magazine_flush_stats(magazine_freelists[i], m);
+  }
+#endif
+}
+
 void
 ink_freelists_snap_baseline()
 {
@@ -350,14 +675,16 @@ ink_freelists_dump(FILE * f)
   if (f == NULL)
     f = stderr;
 
-  fprintf(f, "     allocated      |        in-use      | type size  |   free list name\n");
-  fprintf(f, "--------------------|--------------------|------------|----------------------------------\n");
+  fprintf(f, "     allocated      |        in-use      |  live objects  |    new objects     |   freed objects    | type size  |   free list name\n");
+  fprintf(f, "--------------------|--------------------|----------------|--------------------|--------------------|------------|----------------------------------\n");
 
   fll = freelists;
   while (fll) {
-    fprintf(f, " %18" PRIu64 " | %18" PRIu64 " | %10u | memory/%s\n",
+    int64_t nr_new = fll->fl->nr_new, nr_free = fll->fl->nr_free;
+    fprintf(f, " %18" PRIu64 " | %18" PRIu64 " | %14" PRId64 " | %18" PRId64 " | %18" PRId64 " | %10u | memory/%s\n",
             (uint64_t)fll->fl->allocated * (uint64_t)fll->fl->type_size,
-            (uint64_t)fll->fl->count * (uint64_t)fll->fl->type_size, fll->fl->type_size, fll->fl->name ? fll->fl->name : "<unknown>");
+            (uint64_t)fll->fl->count * (uint64_t)fll->fl->type_size, nr_new - nr_free, nr_new, nr_free,
+            fll->fl->type_size, fll->fl->name ? fll->fl->name : "<unknown>");
     fll = fll->next;
   }
 #else // ! TS_USE_FREELIST
@@ -146,6 +146,33 @@ extern "C"
 
   typedef void *void_p;
 
+/*
+ * Threads bound to a NUMA node (see ink_freelist_set_numa_node) allocate
+ * from a per node list, so the chunks they carve are local. Freed items
+ * go back to the list of the node they were carved on, whichever thread
+ * frees them.
+ */
+#define INK_MAX_NUMA_NODES 8
+
+/*
+ * Per thread magazine size bounds (see cfg_magazine_size), 0 disables
+ * the magazines. traffic_server sets cfg_magazine_size from
+ * proxy.config.allocator.thread_magazine_size before it starts the
+ * event threads.
+ */
+#define INK_MAGAZINE_MAX_SIZE 128
+#define INK_MAGAZINE_DEFAULT_SIZE 32
+
+  typedef struct
+  {
+#if defined(INK_USE_MUTEX_FOR_ATOMICLISTS)
+    ink_mutex inkatomiclist_mutex;
+#endif
+    volatile head_p head;
+    const char *name;
+    uint32_t offset;
+  } InkAtomicList;
+
 #if TS_USE_RECLAIMABLE_FREELIST
   extern float cfg_reclaim_factor;
   extern int64_t cfg_max_overage;
@@ -158,8 +185,16 @@ extern "C"
     const char *name;
     uint32_t type_size, chunk_size, count, allocated, alignment;
     uint32_t allocated_base, count_base;
+    volatile head_p numa_head[INK_MAX_NUMA_NODES];
+    /* batches of items handed back by the per thread magazines */
+    uint32_t magazine_idx;
+    InkAtomicList depot;
+    InkAtomicList numa_depot[INK_MAX_NUMA_NODES];
+    /* objects handed out and given back, see ink_freelists_dump() */
+    volatile int64_t nr_new, nr_free;
   };
 
+  extern int64_t cfg_magazine_size;
   inkcoreapi extern volatile int64_t fastalloc_mem_in_use;
   inkcoreapi extern volatile int64_t fastalloc_mem_total;
   inkcoreapi extern volatile int64_t freelist_allocated_mem;
@@ -184,19 +219,12 @@ extern "C"
                                     uint32_t alignment);
   inkcoreapi void *ink_freelist_new(InkFreeList * f);
   inkcoreapi void ink_freelist_free(InkFreeList * f, void *item);
+  inkcoreapi void ink_freelist_set_numa_node(int node);
+  inkcoreapi void ink_freelists_flush_thread_stats();
   void ink_freelists_dump(FILE * f);
   void ink_freelists_dump_baselinerel(FILE * f);
   void ink_freelists_snap_baseline();
 
-  typedef struct
-  {
-#if defined(INK_USE_MUTEX_FOR_ATOMICLISTS)
-    ink_mutex inkatomiclist_mutex;
-#endif
-    volatile head_p head;
-    const char *name;
-    uint32_t offset;
-  } InkAtomicList;
 
 #if !defined(INK_QUEUE_NT)
 #define INK_ATOMICLIST_EMPTY(_x) (!(TO_PTR(FREELIST_POINTER((_x.head)))))
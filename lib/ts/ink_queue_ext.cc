@@ -467,6 +467,8 @@ reclaimable_freelist_init(InkFreeList **fl, const char *name,
   f->allocated = 0;
   f->allocated_base = 0;
   f->count_base = 0;
+  f->nr_new = 0;
+  f->nr_free = 0;
 
   memory_alignment_init(f, type_size, chunk_size, alignment);
 
@@ -116,6 +116,9 @@ extern "C"
     uint32_t count_base;
     uint32_t chunk_size_base;
 
+    volatile int64_t nr_new;
+    volatile int64_t nr_free;
+
     uint32_t nr_thread_cache;
     InkThreadCache *pThreadCache;
     InkMutex lock;
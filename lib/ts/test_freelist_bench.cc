@@ -0,0 +1,105 @@
+/** @file
+
+  Freelist contention benchmark
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ink_thread.h"
+#include "ink_queue.h"
+#include "ink_hrtime.h"
+
+// Every thread allocates BATCH objects, checks they are its own, and
+// frees them again, ITERATIONS times.  This is run with 1 up to
+// MAX_THREADS threads, with and without the per thread magazines, to
+// show how the shared freelist head becomes the bottleneck.
+
+#define MAX_THREADS 32
+#define BATCH 16
+#define ITERATIONS 20000
+#define TYPE_SIZE 128
+
+static InkFreeList *flist = NULL;
+static volatile int failed = 0;
+
+static void *
+worker(void *arg)
+{
+  int id = (int)(intptr_t) arg;
+  void *items[BATCH];
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    for (int j = 0; j < BATCH; j++) {
+      items[j] = ink_freelist_new(flist);
+      memset(items[j], id, TYPE_SIZE);
+    }
+    for (int j = 0; j < BATCH; j++) {
+      if (((unsigned char *) items[j])[TYPE_SIZE - 1] != (unsigned char) id)
+        failed = 1;
+      ink_freelist_free(flist, items[j]);
+    }
+  }
+  return NULL;
+}
+
+static double
+run(int nthreads, int64_t magazine_size)
+{
+  ink_thread threads[MAX_THREADS];
+
+  cfg_magazine_size = magazine_size;
+  flist = ink_freelist_create("bench", TYPE_SIZE, 256, 8);
+
+  ink_hrtime start = ink_get_hrtime_internal();
+  for (int i = 0; i < nthreads; i++)
+    threads[i] = ink_thread_create(worker, (void *)(intptr_t) (i + 1));
+  for (int i = 0; i < nthreads; i++)
+    ink_thread_join(threads[i]);
+  ink_hrtime elapsed = ink_get_hrtime_internal() - start;
+
+  // the threads are gone, so every magazine has folded in its accounting
+  if (flist->nr_new != (int64_t) nthreads * ITERATIONS * BATCH || flist->nr_new != flist->nr_free) {
+    printf("FAILED: accounted %" PRId64 " new and %" PRId64 " freed objects\n", flist->nr_new, flist->nr_free);
+    failed = 1;
+  }
+
+  // one new and one free per object
+  double ops = 2.0 * nthreads * ITERATIONS * BATCH;
+  return ops / ((double) elapsed / HRTIME_SECOND) / 1000000.0;
+}
+
+int
+main(int /* argc ATS_UNUSED */, char */*argv ATS_UNUSED */[])
+{
+  printf("threads | global freelist (Mops/s) | magazines (Mops/s)\n");
+  printf("--------|--------------------------|-------------------\n");
+  for (int n = 1; n <= MAX_THREADS; n *= 2) {
+    double global = run(n, 0);
+    double magazine = run(n, INK_MAGAZINE_DEFAULT_SIZE);
+    printf(" %6d | %24.2f | %18.2f\n", n, global, magazine);
+  }
+
+  if (failed) {
+    printf("FAILED: object handed out twice\n");
+    return 1;
+  }
+  return 0;
+}
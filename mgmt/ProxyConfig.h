@@ -109,15 +109,21 @@ struct ConfigUpdateContinuation : public Continuation
 };
 
 template <typename UpdateClass> int
-ConfigScheduleUpdate(ProxyMutex * mutex) {
-  eventProcessor.schedule_imm(NEW(new ConfigUpdateContinuation<UpdateClass>(mutex)), ET_CALL);
+ConfigScheduleUpdate(ProxyMutex * mutex, EventType etype = ET_CALL) {
+  eventProcessor.schedule_imm(NEW(new ConfigUpdateContinuation<UpdateClass>(mutex)), etype);
   return 0;
 }
 
 template <typename UpdateClass>
 struct ConfigUpdateHandler
 {
-  ConfigUpdateHandler() : mutex(new_ProxyMutex()) {
+  ConfigUpdateHandler() : mutex(new_ProxyMutex()), etype(NULL) {
+  }
+
+  // Run the update on the threads of the given event type, for configurations that are expensive
+  // to build. The type is read when the update is scheduled, so it can refer to threads that are
+  // spawned after the handler is attached.
+  explicit ConfigUpdateHandler(const EventType * et) : mutex(new_ProxyMutex()), etype(et) {
   }
 
   ~ConfigUpdateHandler() {
@@ -134,10 +140,11 @@ private:
     ConfigUpdateHandler * self = static_cast<ConfigUpdateHandler *>(cookie);
 
     Debug("config", "%s(%s)", __PRETTY_FUNCTION__, name);
-    return ConfigScheduleUpdate<UpdateClass>(self->mutex);
+    return ConfigScheduleUpdate<UpdateClass>(self->mutex, self->etype ? *self->etype : ET_CALL);
   }
 
   Ptr<ProxyMutex> mutex;
+  const EventType * etype;
 };
 
 extern ConfigProcessor configProcessor;
@@ -132,6 +132,12 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.exec_thread.affinity", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
   ,
+  // Let idle task threads run the continuations scheduled on other task threads
+  {RECT_CONFIG, "proxy.config.exec_thread.work_stealing", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
+  // Allocate the memory of net threads pinned by proxy.config.exec_thread.affinity from their own NUMA node
+  {RECT_CONFIG, "proxy.config.exec_thread.numa_memory", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
   {RECT_CONFIG, "proxy.config.accept_threads", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
   ,
   {RECT_CONFIG, "proxy.config.task_threads", RECD_INT, "2", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-99999]", RECA_READ_ONLY}
@@ -354,6 +360,12 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.http.congestion_control.default.max_connection", RECD_INT, "-1", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //# the highest adaptive limit of the concurrent connections to an origin server, 0 disables it
+  {RECT_CONFIG, "proxy.config.http.congestion_control.default.adaptive_limit", RECD_INT, "0", RECU_NULL, RR_NULL, RECC_INT, "[0-100000]", RECA_NULL}
+  ,
+  //# percent of the lowest response time above which the adaptive limit goes down
+  {RECT_CONFIG, "proxy.config.http.congestion_control.default.adaptive_tolerance", RECD_INT, "200", RECU_NULL, RR_NULL, RECC_INT, "[101-10000]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.http.congestion_control.default.error_page", RECD_STRING, "congestion#retryAfter", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.http.congestion_control.default.congestion_scheme", RECD_STRING, "per_ip", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
@@ -487,6 +499,21 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.http.origin_min_keep_alive_connections", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
   ,
+  // max idle sessions kept per origin in a session pool, 0 is unlimited
+  {RECT_CONFIG, "proxy.config.http.origin_max_idle_sessions", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  // keep idle sessions open to the origins in demand, sized from the recent request rate
+  {RECT_CONFIG, "proxy.config.http.prewarm.enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  // how often (ms) the demand is sampled and the idle sessions are topped up
+  {RECT_CONFIG, "proxy.config.http.prewarm.interval", RECD_INT, "1000", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[1-9][0-9]*$", RECA_NULL}
+  ,
+  // cap on the idle sessions kept open per origin by the prewarmer
+  {RECT_CONFIG, "proxy.config.http.prewarm.max_sessions_per_origin", RECD_INT, "8", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  // msecs to wait for an origin connection before racing one to the other address family, 0 to disable
+  {RECT_CONFIG, "proxy.config.http.connect_race_delay", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
 
   //       ##########################
   //       # HTTP referer filtering #
@@ -519,6 +546,17 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.http.parent_proxy.connect_attempts_timeout", RECD_INT, "30", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //# Most a parent gets of the round_robin=consistent_hash requests, in percent
+  //#  of its weighted share of the requests. 0 disables the bound.
+  {RECT_CONFIG, "proxy.config.http.parent_proxy.consistent_hash.load_bound", RECD_INT, "125", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1000]", RECA_NULL}
+  ,
+  //# Seconds between the active health checks of the parents, 0 disables them
+  {RECT_CONFIG, "proxy.config.http.parent_proxy.health_check.interval", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-86400]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.http.parent_proxy.health_check.timeout", RECD_INT, "5", RECU_DYNAMIC, RR_NULL, RECC_INT, "[1-300]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.http.parent_proxy.health_check.url", RECD_STRING, "/", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.http.forward.proxy_auth_to_parent", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
 
@@ -575,6 +613,14 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.http.negative_revalidating_lifetime", RECD_INT, "1800", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //  # Serve a stale document, instead of going to the origin server, when
+  //  # another request already holds the write lock to revalidate it.
+  {RECT_CONFIG, "proxy.config.http.cache.serve_stale_on_write_lock_fail", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  //  # Honor the stale-while-revalidate and stale-if-error Cache-Control
+  //  # extensions of RFC 5861 in the cached responses.
+  {RECT_CONFIG, "proxy.config.http.cache.rfc5861_enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.http.negative_caching_enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.http.negative_caching_lifetime", RECD_INT, "1800", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
@@ -795,6 +841,12 @@ RecordElement RecordsConfig[] = {
   //##############################################################################
   {RECT_CONFIG, "proxy.config.io.max_buffer_size", RECD_INT, "32768", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  // Largest block for tunnels of objects of known size, up to 2MB (0: same as max_buffer_size)
+  {RECT_CONFIG, "proxy.config.io.max_tunnel_buffer_size", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
+  // Collect per use site histograms of IOBuffer block fill, dumped with the freelists on SIGUSR1
+  {RECT_CONFIG, "proxy.config.io.buffer_usage_histograms", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
 
   //##############################################################################
   //#
@@ -805,6 +857,18 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.net.listen_backlog", RECD_INT, "1024", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  // Dispatch connections from the accept threads to a net thread on the NUMA node of the receiving CPU (SO_INCOMING_CPU)
+  {RECT_CONFIG, "proxy.config.net.numa_accept_steering", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
+  // Send plain TCP writes of at least zerocopy_min_bytes with MSG_ZEROCOPY (Linux 4.14+), holding the
+  // buffers until the kernel reports them sent.
+  {RECT_CONFIG, "proxy.config.net.zerocopy_writes", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
+  {RECT_CONFIG, "proxy.config.net.zerocopy_min_bytes", RECD_INT, "16384", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_READ_ONLY}
+  ,
+  // Size the blocks reads go into after the bytes pending on the socket instead of the buffer's full block size
+  {RECT_CONFIG, "proxy.config.net.adaptive_read_buffers", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
   // This option takes different defaults depending on features / platform. TODO: This should use the
   // autoconf stuff probably ?
   {RECT_CONFIG, "proxy.config.net.defer_accept", RECD_INT,
@@ -970,6 +1034,11 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.cache.enable_read_while_writer", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //  # How long, in ms, a reader waits for the header or the first fragment
+  //  # of a document that is being written before it gives up as busy.
+  //  # (0 waits for as long as the writer is there)
+  {RECT_CONFIG, "proxy.config.cache.read_while_writer.max_wait", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.cache.mutex_retry_delay", RECD_INT, "2", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
 
@@ -1003,6 +1072,12 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.dns.validate_query_name", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, "[0-1]", RECA_NULL}
   ,
+  // UDP payload size advertised with EDNS0, 0 to send plain queries
+  {RECT_CONFIG, "proxy.config.dns.edns.payload_size", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-8192]", RECA_NULL}
+  ,
+  // ask again over a TCP connection to the nameserver when a response is truncated
+  {RECT_CONFIG, "proxy.config.dns.tcp_fallback", RECD_INT, "1", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.dns.splitDNS.enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.dns.splitdns.filename", RECD_STRING, "splitdns.config", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
@@ -1041,6 +1116,13 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.hostdb.storage_size", RECD_INT, "33554432", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //       # write the forward lookups to <filename>.snapshot on every sync after the first one, and answer
+  //       # from it after a restart until this run writes its own (round robin names are left out)
+  {RECT_CONFIG, "proxy.config.hostdb.snapshot", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  //       # slots in the lock free cache of plain hits in front of the partitions, 0 to disable
+  {RECT_CONFIG, "proxy.config.hostdb.fast_lookup.size", RECD_INT, "65536", RECU_RESTART_TS, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
   //       # in minutes (all three)
   //       #  0 = obey, 1 = ignore, 2 = min(X,ttl), 3 = max(X,ttl)
   {RECT_CONFIG, "proxy.config.hostdb.ttl_mode", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
@@ -1053,10 +1135,29 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.hostdb.fail.timeout", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //       # entries for names that do not exist, kept apart from the partitions, 0 to disable
+  {RECT_CONFIG, "proxy.config.hostdb.negative.size", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  //       # in seconds, when the answer had no SOA record / upper bound of the SOA value
+  {RECT_CONFIG, "proxy.config.hostdb.negative.ttl", RECD_INT, "30", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.hostdb.negative.max_ttl", RECD_INT, "300", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  //       # new negative entries per zone (owner of the SOA record) within max_ttl
+  {RECT_CONFIG, "proxy.config.hostdb.negative.zone_max_entries", RECD_INT, "1000", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.hostdb.re_dns_on_reload", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //       # query both address families at once for hosts that allow either
+  {RECT_CONFIG, "proxy.config.hostdb.happy_eyeballs", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.hostdb.serve_stale_for", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //       # refresh entries with at least min_hits lookups once this percentage of the TTL has passed, 0 to disable
+  {RECT_CONFIG, "proxy.config.hostdb.prefetch.fraction", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-100]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.hostdb.prefetch.min_hits", RECD_INT, "2", RECU_DYNAMIC, RR_NULL, RECC_INT, "[1-7]", RECA_NULL}
+  ,
   //       # move entries to the owner on a lookup?
   {RECT_CONFIG, "proxy.config.hostdb.migrate_on_demand", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
@@ -1293,6 +1394,12 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.ssl.server.multicert.filename", RECD_STRING, "ssl_multicert.config", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  // only index the names of certificates without a dest_ip, and load them on the first handshake for one of them
+  {RECT_CONFIG, "proxy.config.ssl.server.multicert.lazy_load", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  // lazily loaded certificates kept loaded at a time, 0 for no limit
+  {RECT_CONFIG, "proxy.config.ssl.server.multicert.lazy_load.max_contexts", RECD_INT, "10000", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.ssl.server.private_key.path", RECD_STRING, NULL, RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.ssl.CA.cert.filename", RECD_STRING, NULL, RECU_RESTART_TS, RR_NULL, RECC_STR, "^[^[:space:]]*$", RECA_NULL}
@@ -1313,10 +1420,32 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.ssl.client.CA.cert.path", RECD_STRING, NULL, RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
-  {RECT_CONFIG, "proxy.config.ssl.session_cache", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  // resume the last SSL session of an origin server on new connections to it
+  {RECT_CONFIG, "proxy.config.ssl.origin_session_cache", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.ssl.origin_session_cache.size", RECD_INT, "4096", RECU_RESTART_TS, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  //       session_cache=0 no server session cache
+  //       session_cache=1 OpenSSL's internal cache, per process
+  //       session_cache=2 cache shared by all the server contexts
+  {RECT_CONFIG, "proxy.config.ssl.session_cache", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-2]", RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.ssl.session_cache.size", RECD_INT, "20480", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  // file backing the shared session cache so that it survives restarts, relative to the runtime directory.
+  // It holds the session master secrets unencrypted (mode 0600); unset, the cache is only kept in memory.
+  {RECT_CONFIG, "proxy.config.ssl.session_cache.filename", RECD_STRING, NULL, RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
+  // threads running the private key work of server handshakes, 0 runs it on the net threads
+  {RECT_CONFIG, "proxy.config.ssl.handshake_offload.threads", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  // RFC 5077 session tickets
+  {RECT_CONFIG, "proxy.config.ssl.server.session_ticket.enable", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  // 48 byte ticket keys (name, HMAC secret, AES key), the first one issues tickets; re-read when this is set
+  // or the file is modified, a key file that fails to load keeps the previous keys
+  {RECT_CONFIG, "proxy.config.ssl.server.ticket_key.filename", RECD_STRING, NULL, RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
 
   //##############################################################################
   //# ICP Configuration
@@ -1889,6 +2018,12 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.allocator.reclaim_factor", RECD_FLOAT, "0.3", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  // Number of free objects each thread caches per freelist (0 disables the per thread magazines)
+  {RECT_CONFIG, "proxy.config.allocator.thread_magazine_size", RECD_INT, "32", RECU_NULL, RR_NULL, RECC_INT, "[0-128]", RECA_NULL}
+  ,
+  // Seconds between samples of the per allocator proxy.process.allocator.* stats (0 disables them)
+  {RECT_CONFIG, "proxy.config.allocator.stats_interval", RECD_INT, "10", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-3600]", RECA_NULL}
+  ,
 
   //############
   //#
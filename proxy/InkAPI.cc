@@ -4314,7 +4314,8 @@ TSContSchedule(TSCont contp, ink_hrtime timeout, TSThreadPool tp)
   }
 
   if (timeout == 0) {
-    action = reinterpret_cast<TSAction>(eventProcessor.schedule_imm(i, etype));
+    // Plugin continuations always have a mutex; on the task threads any idle one may run them.
+    action = reinterpret_cast<TSAction>(eventProcessor.schedule_imm_stealable(i, etype));
   } else {
     action = reinterpret_cast<TSAction>(eventProcessor.schedule_in(i, HRTIME_MSECONDS(timeout), etype));
   }
@@ -1481,6 +1481,10 @@ main(int argc, char **argv)
 
   TS_ReadConfigInteger(history_info_enabled, "proxy.config.history_info_enabled");
   TS_ReadConfigInteger(res_track_memory, "proxy.config.res_track_memory");
+#if !TS_USE_RECLAIMABLE_FREELIST
+  // Before the event threads start filling their magazines.
+  TS_ReadConfigInteger(cfg_magazine_size, "proxy.config.allocator.thread_magazine_size");
+#endif
 
   init_http_header();
 
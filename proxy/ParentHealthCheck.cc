@@ -0,0 +1,423 @@
+/** @file
+
+  Active health checks of the parent proxies
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+#include "P_EventSystem.h"
+#include "P_Net.h"
+#include "P_HostDB.h"
+#include "ParentSelection.h"
+#include "ParentHealthCheck.h"
+
+// Weight of a new health check in the moving averages
+#define PARENT_HEALTH_EWMA_ALPHA 0.3
+// Room for the status line of the response
+#define PARENT_HEALTH_STATUS_LEN 64
+
+class ParentHealthChecker;
+
+// class ParentProbe
+//
+//   One health check of one parent: resolves the parent, connects,
+//     sends the request and waits for the status line of the response
+//
+class ParentProbe:public Continuation
+{
+public:
+  ParentProbe(ParentHealthChecker *c, pRecord *p, const char *url, int timeout);
+
+  int probeEvent(int event, void *data);
+  int freeEvent(int event, void *data);
+
+private:
+  void connect(sockaddr const *addr);
+  void done(bool ok);
+
+  ParentHealthChecker *checker;
+  char hostname[MAXDNAME + 1];
+  int port;
+  const char *url;
+  int timeout;
+
+  Action *pending;
+  Event *timeout_event;
+  NetVConnection *vc;
+  VIO *read_vio;
+  MIOBuffer *req_buffer;
+  IOBufferReader *req_reader;
+  MIOBuffer *resp_buffer;
+  IOBufferReader *resp_reader;
+  char status_line[PARENT_HEALTH_STATUS_LEN];
+  int status_len;
+  ink_hrtime start;
+  bool finished;
+};
+
+// class ParentHealthChecker
+//
+//   Wakes up every second and, when the interval has passed, starts a
+//     probe for each distinct parent of the current configuration.  The
+//     configuration is held until all the probes of the round are done,
+//     so the parent records they update stay valid.
+//
+class ParentHealthChecker:public Continuation
+{
+public:
+  ParentHealthChecker();
+
+  int tickEvent(int event, void *data);
+  void probeDone(const char *hostname, int port, bool ok, ink_hrtime latency);
+
+private:
+  void collect(ParentRecord *rec);
+
+  ParentConfigParams *params;
+  Vec<pRecord *> records;
+  int pending;
+  ink_hrtime next_round;
+};
+
+static ParentHealthChecker *parentHealthChecker = NULL;
+
+ParentProbe::ParentProbe(ParentHealthChecker *c, pRecord *p, const char *a_url, int a_timeout)
+  : Continuation(new_ProxyMutex()), checker(c), port(p->port), url(a_url), timeout(a_timeout),
+    pending(NULL), timeout_event(NULL), vc(NULL), read_vio(NULL), req_buffer(NULL), req_reader(NULL), resp_buffer(NULL),
+    resp_reader(NULL), status_len(0), start(0), finished(false)
+{
+  ink_strlcpy(hostname, p->hostname, sizeof(hostname));
+  SET_HANDLER(&ParentProbe::probeEvent);
+}
+
+void
+ParentProbe::connect(sockaddr const *addr)
+{
+  IpEndpoint target;
+  Action *action;
+
+  ats_ip_copy(&target, addr);
+  target.port() = htons(port);
+  start = ink_get_hrtime();
+  action = netProcessor.connect_re(this, &target.sa);
+  if (action != ACTION_RESULT_DONE && !finished) {
+    pending = action;
+  }
+}
+
+int
+ParentProbe::probeEvent(int event, void *data)
+{
+  switch (event) {
+  case EVENT_IMMEDIATE:{
+      IpEndpoint addr;
+      Action *action;
+
+      timeout_event = this_ethread()->schedule_in(this, HRTIME_SECONDS(timeout));
+      if (0 == ats_ip_pton(hostname, &addr)) {
+        connect(&addr.sa);
+      } else {
+        action = hostDBProcessor.getbyname_re(this, hostname, 0);
+        if (action != ACTION_RESULT_DONE && !finished) {
+          pending = action;
+        }
+      }
+      break;
+    }
+
+  case EVENT_HOST_DB_LOOKUP:{
+      HostDBInfo *r = (HostDBInfo *) data;
+
+      pending = NULL;
+      if (r == NULL || r->failed()) {
+        Debug("parent_health", "Health check of %s:%d failed to resolve", hostname, port);
+        done(false);
+      } else if (r->round_robin) {
+        connect(r->rr()->info[0].ip());
+      } else {
+        connect(r->ip());
+      }
+      break;
+    }
+
+  case NET_EVENT_OPEN:{
+      int len;
+
+      pending = NULL;
+      vc = (NetVConnection *) data;
+      req_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+      req_reader = req_buffer->alloc_reader();
+      resp_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+      resp_reader = resp_buffer->alloc_reader();
+
+      char request[MAXDNAME + 512];
+      len = snprintf(request, sizeof(request),
+                     "GET %s HTTP/1.0\r\nHost: %s:%d\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n",
+                     url, hostname, port);
+      if (len >= (int) sizeof(request)) {
+        len = sizeof(request) - 1;
+      }
+      req_buffer->write(request, len);
+      read_vio = vc->do_io_read(this, INT64_MAX, resp_buffer);
+      vc->do_io_write(this, len, req_reader);
+      break;
+    }
+
+  case VC_EVENT_WRITE_READY:
+  case VC_EVENT_WRITE_COMPLETE:
+    break;
+
+  case VC_EVENT_READ_READY:
+  case VC_EVENT_READ_COMPLETE:
+  case VC_EVENT_EOS:{
+      int64_t avail = resp_reader->read_avail();
+      int64_t n = MIN(avail, (int64_t) (sizeof(status_line) - 1 - status_len));
+
+      if (n > 0) {
+        resp_reader->memcpy(status_line + status_len, n);
+        status_len += n;
+        status_line[status_len] = '\0';
+      }
+      resp_reader->consume(avail);
+
+      // Only the status line matters
+      if (strchr(status_line, '\n') != NULL || status_len == (int) sizeof(status_line) - 1) {
+        int status = 0;
+
+        if (sscanf(status_line, "HTTP/%*d.%*d %d", &status) != 1) {
+          status = 0;
+        }
+        Debug("parent_health", "Health check of %s:%d returned %d", hostname, port, status);
+        done(status > 0 && status < 500);
+      } else if (event != VC_EVENT_READ_READY) {
+        Debug("parent_health", "Health check of %s:%d got no status line", hostname, port);
+        done(false);
+      } else {
+        read_vio->reenable();
+      }
+      break;
+    }
+
+  case EVENT_INTERVAL:
+    // The timeout
+    timeout_event = NULL;
+    Debug("parent_health", "Health check of %s:%d timed out", hostname, port);
+    done(false);
+    break;
+
+  default:
+    // NET_EVENT_OPEN_FAILED, VC_EVENT_ERROR and the timeouts of the connection
+    pending = NULL;
+    Debug("parent_health", "Health check of %s:%d failed with %s", hostname, port, get_vc_event_name(event));
+    done(false);
+    break;
+  }
+
+  return EVENT_DONE;
+}
+
+// void ParentProbe::done(bool ok)
+//
+//   Reports the result and frees the probe from a new event, since
+//     it can be called from within connect_re() or getbyname_re()
+//
+void
+ParentProbe::done(bool ok)
+{
+  if (finished) {
+    return;
+  }
+  finished = true;
+
+  if (timeout_event) {
+    timeout_event->cancel();
+    timeout_event = NULL;
+  }
+  if (pending) {
+    pending->cancel();
+    pending = NULL;
+  }
+  if (vc) {
+    vc->do_io_close();
+    vc = NULL;
+  }
+
+  checker->probeDone(hostname, port, ok, ok ? ink_get_hrtime() - start : HRTIME_SECONDS(timeout));
+
+  SET_HANDLER(&ParentProbe::freeEvent);
+  this_ethread()->schedule_imm(this);
+}
+
+int
+ParentProbe::freeEvent(int event, void *data)
+{
+  NOWARN_UNUSED(event);
+  NOWARN_UNUSED(data);
+
+  if (req_buffer) {
+    free_MIOBuffer(req_buffer);
+  }
+  if (resp_buffer) {
+    free_MIOBuffer(resp_buffer);
+  }
+  mutex.clear();
+  delete this;
+  return EVENT_DONE;
+}
+
+ParentHealthChecker::ParentHealthChecker()
+  : Continuation(new_ProxyMutex()), params(NULL), pending(0), next_round(0)
+{
+  SET_HANDLER(&ParentHealthChecker::tickEvent);
+}
+
+void
+ParentHealthChecker::collect(ParentRecord *rec)
+{
+  if (rec == NULL) {
+    return;
+  }
+  for (int i = 0; i < rec->num_parents; i++) {
+    records.add(rec->parents + i);
+  }
+}
+
+int
+ParentHealthChecker::tickEvent(int event, void *data)
+{
+  NOWARN_UNUSED(event);
+  NOWARN_UNUSED(data);
+  ink_hrtime now = ink_get_hrtime();
+
+  // The last round is still going
+  if (params != NULL) {
+    return EVENT_CONT;
+  }
+
+  ParentConfigParams *p = ParentConfig::acquire();
+  if (p == NULL || p->ParentEnable == 0 || p->HealthCheckInterval <= 0 || now < next_round) {
+    if (p) {
+      ParentConfig::release(p);
+    }
+    return EVENT_CONT;
+  }
+  next_round = now + HRTIME_SECONDS(p->HealthCheckInterval);
+
+  records.clear();
+  collect(p->DefaultParent);
+  if (p->ParentTable->hostMatch) {
+    for (int i = 0; i < p->ParentTable->hostMatch->getNumElements(); i++) {
+      collect(p->ParentTable->hostMatch->getDataArray() + i);
+    }
+  }
+  if (p->ParentTable->reMatch) {
+    for (int i = 0; i < p->ParentTable->reMatch->getNumElements(); i++) {
+      collect(p->ParentTable->reMatch->getDataArray() + i);
+    }
+  }
+  if (p->ParentTable->ipMatch) {
+    for (int i = 0; i < p->ParentTable->ipMatch->getNumElements(); i++) {
+      collect(p->ParentTable->ipMatch->getDataArray() + i);
+    }
+  }
+  if (p->ParentTable->hrMatch) {
+    for (int i = 0; i < p->ParentTable->hrMatch->getNumElements(); i++) {
+      collect(p->ParentTable->hrMatch->getDataArray() + i);
+    }
+  }
+
+  // One probe per parent, even if it is on more than one line
+  params = p;
+  pending = 1;
+  for (unsigned i = 0; i < records.n; i++) {
+    bool seen = false;
+
+    for (unsigned j = 0; j < i && !seen; j++) {
+      seen = records[j]->port == records[i]->port && strcasecmp(records[j]->hostname, records[i]->hostname) == 0;
+    }
+    if (!seen) {
+      const char *url = (p->HealthCheckUrl && *p->HealthCheckUrl) ? p->HealthCheckUrl : "/";
+
+      pending++;
+      eventProcessor.schedule_imm(NEW(new ParentProbe(this, records[i], url, p->HealthCheckTimeout)), ET_NET);
+    }
+  }
+  Debug("parent_health", "Started %d health checks for %d parents", pending - 1, (int) records.n);
+
+  // Drop the reference held while starting the probes
+  probeDone(NULL, 0, false, 0);
+  return EVENT_CONT;
+}
+
+// void ParentHealthChecker::probeDone(const char* hostname, int port, bool ok, ink_hrtime latency)
+//
+//   Updates the records of the parent, and ends the round with the
+//     last probe.  Called on the thread of the probe.
+//
+void
+ParentHealthChecker::probeDone(const char *hostname, int port, bool ok, ink_hrtime latency)
+{
+  EThread *ethread = this_ethread();
+  MUTEX_TAKE_LOCK(mutex, ethread);
+
+  ink_assert(params != NULL && pending > 0);
+
+  for (unsigned i = 0; hostname != NULL && i < records.n; i++) {
+    pRecord *pRec = records[i];
+    int32_t sample = (int32_t) ink_hrtime_to_usec(latency);
+
+    if (pRec->port != port || strcasecmp(pRec->hostname, hostname) != 0) {
+      continue;
+    }
+
+    if (pRec->latency == 0) {
+      pRec->latency = sample;
+    } else {
+      pRec->latency += (int32_t) (PARENT_HEALTH_EWMA_ALPHA * (sample - pRec->latency));
+    }
+    pRec->errors += PARENT_HEALTH_EWMA_ALPHA * ((ok ? 0.0 : 1.0) - pRec->errors);
+
+    if (ok && pRec->failedAt != 0) {
+      ink_atomic_swap(&pRec->failedAt, (time_t)0);
+      int old_count = ink_atomic_swap(&pRec->failCount, 0);
+
+      if (old_count >= params->FailThreshold) {
+        Note("http parent proxy %s:%d restored by health check", pRec->hostname, pRec->port);
+      }
+    }
+  }
+
+  if (--pending == 0) {
+    records.clear();
+    ParentConfig::release(params);
+    params = NULL;
+  }
+
+  MUTEX_UNTAKE_LOCK(mutex, ethread);
+}
+
+void
+ParentHealthCheck::startup()
+{
+  if (parentHealthChecker == NULL) {
+    parentHealthChecker = NEW(new ParentHealthChecker);
+    eventProcessor.schedule_every(parentHealthChecker, HRTIME_SECONDS(1), ET_CALL);
+  }
+}
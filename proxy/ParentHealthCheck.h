@@ -0,0 +1,48 @@
+/** @file
+
+  Active health checks of the parent proxies
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+/*****************************************************************************
+ *
+ *  ParentHealthCheck.h - Active health checks of the parents in parent.config
+ *
+ *
+ ****************************************************************************/
+
+#ifndef _PARENT_HEALTH_CHECK_H_
+#define _PARENT_HEALTH_CHECK_H_
+
+//
+// Every proxy.config.http.parent_proxy.health_check.interval seconds
+//   each parent of the current parent configuration is sent a request
+//   for proxy.config.http.parent_proxy.health_check.url.  A response
+//   with a status under 500 is a success.  The latency of the checks
+//   and the rate of failures are kept per parent as moving averages
+//   for round_robin=latency, and a parent that was marked down is
+//   restored by a successful check instead of waiting for a retry.
+//
+struct ParentHealthCheck
+{
+  static void startup();
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include "ProxyConfig.h"
 #include "HTTP.h"
 #include "HttpTransact.h"
+#include "ParentHealthCheck.h"
 
 #define PARENT_RegisterConfigUpdateFunc REC_RegisterConfigUpdateFunc
 #define PARENT_ReadConfigInteger REC_ReadConfigInteger
@@ -47,6 +48,16 @@ static const char *retry_var = "proxy.config.http.parent_proxy.retry_time";
 static const char *enable_var = "proxy.config.http.parent_proxy_routing_enable";
 static const char *threshold_var = "proxy.config.http.parent_proxy.fail_threshold";
 static const char *dns_parent_only_var = "proxy.config.http.no_dns_just_forward_to_parent";
+static const char *load_bound_var = "proxy.config.http.parent_proxy.consistent_hash.load_bound";
+static const char *health_interval_var = "proxy.config.http.parent_proxy.health_check.interval";
+static const char *health_timeout_var = "proxy.config.http.parent_proxy.health_check.timeout";
+static const char *health_url_var = "proxy.config.http.parent_proxy.health_check.url";
+
+// Points on the consistent hash ring for a parent of weight 1
+#define PARENT_CHASH_VNODES 160
+#define PARENT_MAX_WEIGHT 100
+// How much a health check failure rate of 1 adds to the latency of a parent
+#define PARENT_ERROR_PENALTY 4.0
 
 static const char *ParentResultStr[] = {
   "Parent_Undefined",
@@ -58,7 +69,9 @@ static const char *ParentResultStr[] = {
 static const char *ParentRRStr[] = {
   "false",
   "strict",
-  "true"
+  "true",
+  "consistent_hash",
+  "latency"
 };
 
 //
@@ -68,7 +81,8 @@ enum ParentCB_t
 {
   PARENT_FILE_CB, PARENT_DEFAULT_CB,
   PARENT_RETRY_CB, PARENT_ENABLE_CB,
-  PARENT_THRESHOLD_CB, PARENT_DNS_ONLY_CB
+  PARENT_THRESHOLD_CB, PARENT_DNS_ONLY_CB,
+  PARENT_LOAD_BOUND_CB, PARENT_HEALTH_CHECK_CB
 };
 
 // If the parent was set by the external customer api,
@@ -78,11 +92,14 @@ enum ParentCB_t
 ParentRecord *const extApiRecord = (ParentRecord *) 0xeeeeffff;
 
 ParentConfigParams::ParentConfigParams()
-  : ParentTable(NULL), DefaultParent(NULL), ParentRetryTime(30), ParentEnable(0), FailThreshold(10), DNS_ParentOnly(0)
+  : ParentTable(NULL), DefaultParent(NULL), ParentRetryTime(30), ParentEnable(0), FailThreshold(10), DNS_ParentOnly(0),
+    LoadBound(125), HealthCheckInterval(0), HealthCheckTimeout(5), HealthCheckUrl(NULL)
 { }
 
 ParentConfigParams::~ParentConfigParams()
 {
+  ats_free(HealthCheckUrl);
+
   if (ParentTable) {
     delete ParentTable;
   }
@@ -120,6 +137,16 @@ ParentConfig::startup()
 
   //   DNS Parent Only
   parentConfigUpdate->attach(dns_parent_only_var);
+
+  //   Consistent hash load bound
+  parentConfigUpdate->attach(load_bound_var);
+
+  //   Health checks
+  parentConfigUpdate->attach(health_interval_var);
+  parentConfigUpdate->attach(health_timeout_var);
+  parentConfigUpdate->attach(health_url_var);
+
+  ParentHealthCheck::startup();
 }
 
 void
@@ -130,6 +157,9 @@ ParentConfig::reconfigure()
   int enable = 0;
   int fail_threshold;
   int dns_parent_only;
+  int load_bound = 125;
+  int health_interval = 0;
+  int health_timeout = 5;
 
   ParentConfigParams *params;
   params = NEW(new ParentConfigParams);
@@ -158,6 +188,21 @@ ParentConfig::reconfigure()
   PARENT_ReadConfigInteger(dns_parent_only, dns_parent_only_var);
   params->DNS_ParentOnly = dns_parent_only;
 
+  // Handle the consistent hash load bound, a parent can't be
+  //   bound below the average load
+  PARENT_ReadConfigInteger(load_bound, load_bound_var);
+  if (load_bound > 0 && load_bound < 100) {
+    load_bound = 100;
+  }
+  params->LoadBound = load_bound;
+
+  // Handle the health checks
+  PARENT_ReadConfigInteger(health_interval, health_interval_var);
+  params->HealthCheckInterval = health_interval;
+  PARENT_ReadConfigInteger(health_timeout, health_timeout_var);
+  params->HealthCheckTimeout = health_timeout > 0 ? health_timeout : 1;
+  PARENT_ReadConfigStringAlloc(params->HealthCheckUrl, health_url_var);
+
   m_id = configProcessor.set(m_id, params);
 
   if (is_debug_tag_set("parent_config")) {
@@ -475,6 +520,21 @@ ParentConfigParams::nextParent(HttpRequestData * rdata, ParentResult * result)
 //   End API functions
 //
 
+// Returns the parent after @a cur in @a order, or in the array if
+//   @a order is NULL
+static inline int
+next_parent(const int *order, int num_parents, int cur)
+{
+  if (order != NULL) {
+    for (int i = 0; i < num_parents; i++) {
+      if (order[i] == cur) {
+        return order[(i + 1) % num_parents];
+      }
+    }
+  }
+  return (cur + 1) % num_parents;
+}
+
 void
 ParentRecord::FindParent(bool first_call, ParentResult * result, RD * rdata, ParentConfigParams * config)
 {
@@ -483,6 +543,8 @@ ParentRecord::FindParent(bool first_call, ParentResult * result, RD * rdata, Par
   bool parentUp = false;
   bool parentRetry = false;
   bool bypass_ok = (go_direct == true && config->DNS_ParentOnly == 0);
+  // The order the parents are tried in when one fails, NULL for the array order
+  xptr<int> order;
 
   HttpRequestData *request_info = (HttpRequestData *) rdata;
 
@@ -515,6 +577,12 @@ ParentRecord::FindParent(bool first_call, ParentResult * result, RD * rdata, Par
             cur_index = 0;
         }
         break;
+      case P_CONSISTENT_HASH:
+        cur_index = result->start_parent = FindHashParent(rdata, config);
+        break;
+      case P_LEAST_LATENCY:
+        cur_index = result->start_parent = FindFastParent(rdata, config);
+        break;
       case P_NO_ROUND_ROBIN:
         cur_index = result->start_parent = 0;
         break;
@@ -523,8 +591,13 @@ ParentRecord::FindParent(bool first_call, ParentResult * result, RD * rdata, Par
       }
     }
   } else {
-    // Move to next parent due to failure
-    cur_index = (result->last_parent + 1) % num_parents;
+    // Move to next parent due to failure.  In the consistent hash mode
+    //   that is the next parent on the ring, so that a URL always fails
+    //   over to the same parent.
+    if (round_robin == P_CONSISTENT_HASH) {
+      order = HashOrder(rdata);
+    }
+    cur_index = next_parent(order, num_parents, result->last_parent);
 
     // Check to see if we have wrapped around
     if ((unsigned int) cur_index == result->start_parent) {
@@ -575,7 +648,10 @@ ParentRecord::FindParent(bool first_call, ParentResult * result, RD * rdata, Par
       return;
     }
 
-    cur_index = (cur_index + 1) % num_parents;
+    if (round_robin == P_CONSISTENT_HASH && !order) {
+      order = HashOrder(rdata);
+    }
+    cur_index = next_parent(order, num_parents, cur_index);
 
   } while ((unsigned int) cur_index != result->start_parent);
 
@@ -597,12 +673,279 @@ NO_PARENTS:
   result->port = 0;
 }
 
+// Can the parent be used by a new request, either because it is up or
+//   because it is time to retry it
+static inline bool
+parent_available(pRecord * p, ParentConfigParams * config, time_t now)
+{
+  return p->failedAt == 0 || p->failCount < config->FailThreshold || (p->failedAt + config->ParentRetryTime) < now;
+}
+
+// int ParentRecord::FindHashParent(RD* rdata, ParentConfigParams* config)
+//
+//    Returns the index of the parent for the request on the consistent
+//      hash ring.  The request is keyed on the MD5 of its URL and goes
+//      to the first parent after the key on the ring that can be used,
+//      so when a parent goes down only the URLs it had are moved.
+//
+//    With a load bound, a parent that already had its share of the
+//      requests of the current second, scaled by the bound and its
+//      weight, is passed over for the next one on the ring.  The share
+//      is based on the busier of this second and the previous one.  The
+//      counters are reset without a lock when the second changes, so
+//      the bound is approximate.
+//
+//    If no parent can be used, returns the owner of the key and leaves
+//      it to FindParent to bypass or retry.
+//
+int
+ParentRecord::FindHashParent(RD * rdata, ParentConfigParams * config)
+{
+  HttpRequestData *request_info = (HttpRequestData *) rdata;
+  time_t now = request_info->xact_start;
+  uint64_t key;
+  int start = FindHashStart(rdata, &key);
+  int chosen = -1, first_up = -1;
+
+  if (config->LoadBound > 0) {
+    int32_t window = (int32_t) now;
+    int32_t cur = chash_window;
+
+    if (window > cur && ink_atomic_cas(&chash_window, cur, window)) {
+      chash_last_total = (window == cur + 1) ? chash_total : 0;
+      chash_total = 0;
+      for (int i = 0; i < num_parents; i++) {
+        parents[i].load = 0;
+      }
+    }
+  }
+
+  float up_weight = 0;
+  for (int i = 0; i < num_parents; i++) {
+    if (parent_available(&parents[i], config, now)) {
+      up_weight += parents[i].weight;
+    }
+  }
+  int32_t total = MAX(chash_last_total, chash_total + 1);
+
+  for (int n = 0; n < chash_points; n++) {
+    int idx = chash_ring[(start + n) % chash_points].parent;
+    pRecord *p = parents + idx;
+
+    if (!parent_available(p, config, now)) {
+      continue;
+    }
+    if (first_up < 0) {
+      first_up = idx;
+    }
+    if (config->LoadBound <= 0 ||
+        p->load < (int32_t) ceil(config->LoadBound / 100.0 * total * p->weight / up_weight)) {
+      chosen = idx;
+      break;
+    }
+  }
+
+  if (chosen < 0) {
+    chosen = (first_up < 0) ? chash_ring[start].parent : first_up;
+  }
+  if (config->LoadBound > 0 && first_up >= 0) {
+    ink_atomic_increment(&parents[chosen].load, 1);
+    ink_atomic_increment(&chash_total, 1);
+  }
+
+  Debug("parent_select", "Consistent hash key %" PRIx64 " goes to %s:%d (owner %s:%d)", key,
+        parents[chosen].hostname, parents[chosen].port,
+        parents[chash_ring[start].parent].hostname, parents[chash_ring[start].parent].port);
+  return chosen;
+}
+
+// int ParentRecord::FindHashStart(RD* rdata, uint64_t* key)
+//
+//    Returns the first point on the consistent hash ring at or after
+//      the key of the request, the MD5 of its URL, wrapping around
+//      the ring.  Sets the key if @a key is not NULL.
+//
+int
+ParentRecord::FindHashStart(RD * rdata, uint64_t * key)
+{
+  HttpRequestData *request_info = (HttpRequestData *) rdata;
+  INK_MD5 md5;
+  uint64_t k;
+  int lo, hi;
+
+  ink_assert(chash_ring != NULL && chash_points > 0);
+
+  if (request_info->hdr != NULL && request_info->hdr->url_get()->valid()) {
+    request_info->hdr->url_get()->MD5_get(&md5);
+  } else {
+    const char *host = rdata->get_host();
+    md5.encodeBuffer(host ? host : "", host ? strlen(host) : 0);
+  }
+  k = md5.fold();
+  if (key != NULL) {
+    *key = k;
+  }
+
+  lo = 0;
+  hi = chash_points;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (chash_ring[mid].point < k) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return (lo == chash_points) ? 0 : lo;
+}
+
+// int* ParentRecord::HashOrder(RD* rdata)
+//
+//    Returns the parents in the order they are met walking the
+//      consistent hash ring clockwise from the key of the request,
+//      which is the order they are tried in when one fails.  The
+//      array is allocated and has num_parents entries.
+//
+int *
+ParentRecord::HashOrder(RD * rdata)
+{
+  int start = FindHashStart(rdata, NULL);
+  int *order = (int *)ats_malloc(sizeof(int) * num_parents);
+  char *seen = (char *)ats_calloc(num_parents, 1);
+  int n = 0;
+
+  for (int i = 0; i < chash_points && n < num_parents; i++) {
+    int idx = chash_ring[(start + i) % chash_points].parent;
+
+    if (!seen[idx]) {
+      seen[idx] = 1;
+      order[n++] = idx;
+    }
+  }
+  ink_assert(n == num_parents);
+  ats_free(seen);
+  return order;
+}
+
+// The cost of a parent for the latency mode, its health check latency
+//   made worse by its health check failures
+static inline double
+parent_cost(pRecord * p)
+{
+  return p->latency * (1.0 + PARENT_ERROR_PENALTY * p->errors);
+}
+
+// int ParentRecord::FindFastParent(RD* rdata, ParentConfigParams* config)
+//
+//    Returns the index of the parent for the request in the latency
+//      mode.  Two of the parents that can be used are picked at random
+//      and the one with the lower cost wins, so a slow parent gets less
+//      traffic but is not left out, and the parents don't all go to the
+//      one that was the fastest at the last health check.  A parent
+//      that was not checked yet has no cost.
+//
+//    If no parent can be used, returns 0 and leaves it to FindParent
+//      to bypass or retry.
+//
+int
+ParentRecord::FindFastParent(RD * rdata, ParentConfigParams * config)
+{
+  HttpRequestData *request_info = (HttpRequestData *) rdata;
+  time_t now = request_info->xact_start;
+  int n_up = 0, a, b, first = -1, second = -1;
+
+  for (int i = 0; i < num_parents; i++) {
+    if (parent_available(&parents[i], config, now)) {
+      n_up++;
+    }
+  }
+  if (n_up == 0) {
+    return 0;
+  }
+
+  a = this_ethread()->generator.random() % n_up;
+  b = a;
+  if (n_up > 1) {
+    b = this_ethread()->generator.random() % (n_up - 1);
+    if (b >= a) {
+      b++;
+    }
+  }
+  for (int i = 0, k = 0; i < num_parents; i++) {
+    if (!parent_available(&parents[i], config, now)) {
+      continue;
+    }
+    if (k == a) {
+      first = i;
+    }
+    if (k == b) {
+      second = i;
+    }
+    k++;
+  }
+
+  int chosen = (parent_cost(parents + second) < parent_cost(parents + first)) ? second : first;
+  Debug("parent_select", "Latency choice between %s:%d (%d usec, %.2f errors) and %s:%d (%d usec, %.2f errors) is %s:%d",
+        parents[first].hostname, parents[first].port, parents[first].latency, parents[first].errors,
+        parents[second].hostname, parents[second].port, parents[second].latency, parents[second].errors,
+        parents[chosen].hostname, parents[chosen].port);
+  return chosen;
+}
+
+static int
+chash_point_cmp(const void *a, const void *b)
+{
+  uint64_t x = static_cast<pChashPoint const *>(a)->point;
+  uint64_t y = static_cast<pChashPoint const *>(b)->point;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// void ParentRecord::BuildHashRing()
+//
+//    Places PARENT_CHASH_VNODES points on the consistent hash ring
+//      for each parent, times its weight, and sorts them.  The points
+//      only depend on the parent name and port, so the other parents
+//      keep their points when one is added or removed.
+//
+void
+ParentRecord::BuildHashRing()
+{
+  char buf[MAXDNAME + 32];
+  INK_MD5 md5;
+  int n = 0;
+
+  ats_free(chash_ring);
+  for (int i = 0; i < num_parents; i++) {
+    n += MAX(1, (int) (PARENT_CHASH_VNODES * parents[i].weight + 0.5));
+  }
+  chash_ring = (pChashPoint *)ats_malloc(sizeof(pChashPoint) * n);
+  chash_points = 0;
+
+  for (int i = 0; i < num_parents; i++) {
+    int vnodes = MAX(1, (int) (PARENT_CHASH_VNODES * parents[i].weight + 0.5));
+
+    for (int v = 0; v < vnodes; v++) {
+      int len = snprintf(buf, sizeof(buf), "%s:%d-%d", parents[i].hostname, parents[i].port, v);
+
+      md5.encodeBuffer(buf, len);
+      chash_ring[chash_points].point = md5.fold();
+      chash_ring[chash_points].parent = i;
+      chash_points++;
+    }
+  }
+  qsort(chash_ring, chash_points, sizeof(pChashPoint), chash_point_cmp);
+}
+
 // const char* ParentRecord::ProcessParents(char* val)
 //
 //   Reads in the value of a "round-robin" or "order"
 //     directive and parses out the individual parents
 //     allocates and builds the this->parents array
 //
+//   Each parent is "host:port", optionally followed by
+//     "|weight" for the consistent hash ring
+//
 //   Returns NULL on success and a static error string
 //     on failure
 //
@@ -613,6 +956,7 @@ ParentRecord::ProcessParents(char *val)
   int numTok;
   const char *current;
   int port;
+  float weight;
   char *tmp;
   const char *errPtr;
 
@@ -651,6 +995,17 @@ ParentRecord::ProcessParents(char *val)
     char *scan = tmp + 1;
     for (; *scan != '\0' && ParseRules::is_digit(*scan); scan++);
     for (; *scan != '\0' && ParseRules::is_wslfcr(*scan); scan++);
+    // Read the optional weight
+    weight = 1.0;
+    if (*scan == '|') {
+      char *end;
+      weight = strtof(scan + 1, &end);
+      if (end == scan + 1 || !(weight > 0) || weight > PARENT_MAX_WEIGHT) {
+        errPtr = "Malformed parent weight";
+        goto MERROR;
+      }
+      for (scan = end; *scan != '\0' && ParseRules::is_wslfcr(*scan); scan++);
+    }
     if (*scan != '\0') {
       errPtr = "Garbage trailing entry or invalid separator";
       goto MERROR;
@@ -670,6 +1025,10 @@ ParentRecord::ProcessParents(char *val)
     this->parents[i].port = port;
     this->parents[i].failedAt = 0;
     this->parents[i].scheme = scheme;
+    this->parents[i].weight = weight;
+    this->parents[i].load = 0;
+    this->parents[i].latency = 0;
+    this->parents[i].errors = 0;
   }
 
   num_parents = numTok;
@@ -755,6 +1114,10 @@ ParentRecord::Init(matcher_line * line_info)
         round_robin = P_STRICT_ROUND_ROBIN;
       } else if (strcasecmp(val, "false") == 0) {
         round_robin = P_NO_ROUND_ROBIN;
+      } else if (strcasecmp(val, "consistent_hash") == 0) {
+        round_robin = P_CONSISTENT_HASH;
+      } else if (strcasecmp(val, "latency") == 0) {
+        round_robin = P_LEAST_LATENCY;
       } else {
         round_robin = P_NO_ROUND_ROBIN;
         errPtr = "invalid argument to round_robin directive";
@@ -792,6 +1155,10 @@ ParentRecord::Init(matcher_line * line_info)
     snprintf(errBuf, errBufLen, "%s No parent specified in parent.config at line %d", modulePrefix, line_num);
     return errBuf;
   }
+
+  if (this->parents != NULL && round_robin == P_CONSISTENT_HASH) {
+    BuildHashRing();
+  }
   // Process any modifiers to the directive, if they exist
   if (line_info->num_el > 0) {
     tmp = ProcessModifiers(line_info);
@@ -834,6 +1201,7 @@ ParentRecord::UpdateMatch(ParentResult * result, RD * rdata)
 ParentRecord::~ParentRecord()
 {
   ats_free(parents);
+  ats_free(chash_ring);
 }
 
 void
@@ -841,7 +1209,11 @@ ParentRecord::Print()
 {
   printf("\t\t");
   for (int i = 0; i < num_parents; i++) {
-    printf(" %s:%d ", parents[i].hostname, parents[i].port);
+    if (round_robin == P_CONSISTENT_HASH) {
+      printf(" %s:%d|%g ", parents[i].hostname, parents[i].port, parents[i].weight);
+    } else {
+      printf(" %s:%d ", parents[i].hostname, parents[i].port);
+    }
   }
   printf(" rr=%s direct=%s\n", ParentRRStr[round_robin], (go_direct == true) ? "true" : "false");
 }
@@ -1220,6 +1592,169 @@ EXCLUSIVE_REGRESSION_TEST(PARENTSELECTION) (RegressionTest * t, int intensity_le
       ink_assert(0);
     }
   }
+
+  // Test 173 - 177 Consistent hash
+  //   Map a set of URLs on five parents, take one down and count
+  //   the URLs that moved.  Only the URLs of the down parent should
+  //   move, where hashing modulo the number of parents moves most.
+  tbl[0] = '\0';
+  T("dest_domain=. parent=p0:80,p1:80,p2:80,p3:80,p4:80 round_robin=consistent_hash\n")
+  REBUILD
+  params->LoadBound = 0;
+#define CHASH_URLS 1000
+  int chash_map[CHASH_URLS], chash_count[5] = { 0, 0, 0, 0, 0 };
+  char url_buf[64];
+  ParentRecord *chash_rec = NULL;
+  for (c = 0; c < CHASH_URLS; c++) {
+    REINIT br(request, "www.example.com");
+    snprintf(url_buf, sizeof(url_buf), "http://www.example.com/object/%d", c);
+    request->hdr->url_set(url_buf, strlen(url_buf));
+    FP chash_map[c] = (result->r == PARENT_SPECIFIED) ? (int) result->last_parent : -1;
+    chash_rec = result->rec;
+    if (chash_map[c] >= 0)
+      chash_count[chash_map[c]]++;
+  }
+  // Test 173 - every parent gets its share of the URLs
+  ST(173)
+  int chash_even = 1;
+  for (i = 0; i < 5; i++) {
+    printf("parent p%d has %d of %d URLs\n", i, chash_count[i], CHASH_URLS);
+    if (chash_count[i] < CHASH_URLS / 10 || chash_count[i] > CHASH_URLS * 3 / 10)
+      chash_even = 0;
+  }
+  RE(chash_even, 173)
+
+  chash_rec->parents[2].failedAt = time(NULL);
+  chash_rec->parents[2].failCount = params->FailThreshold;
+  int chash_moved = 0, chash_lost = 0, mod_moved = 0;
+  for (c = 0; c < CHASH_URLS; c++) {
+    REINIT br(request, "www.example.com");
+    snprintf(url_buf, sizeof(url_buf), "http://www.example.com/object/%d", c);
+    request->hdr->url_set(url_buf, strlen(url_buf));
+    FP if (result->r != PARENT_SPECIFIED || (int) result->last_parent == 2) {
+      chash_lost++;
+    } else if ((int) result->last_parent != chash_map[c]) {
+      chash_moved++;
+    }
+    // The same URL hashed modulo the number of parents that are up
+    INK_MD5 md5;
+    request->hdr->url_get()->MD5_get(&md5);
+    if (md5.fold() % 5 != md5.fold() % 4)
+      mod_moved++;
+  }
+  printf("parent p2 down: consistent hash moved %d of %d URLs (%d had p2), modulo moved %d\n",
+         chash_moved, CHASH_URLS, chash_count[2], mod_moved);
+  // Test 174 - nothing goes to the down parent
+  ST(174) RE(chash_lost == 0, 174)
+  // Test 175 - only the URLs of the down parent moved
+  ST(175) RE(chash_moved == chash_count[2] && chash_moved < mod_moved, 175)
+  chash_rec->parents[2].failedAt = 0;
+  chash_rec->parents[2].failCount = 0;
+
+  // Test 176 - a parent with three times the weight gets about three
+  //   times the URLs
+  tbl[0] = '\0';
+  T("dest_domain=. parent=heavy:80|3,light:80 round_robin=consistent_hash\n")
+  REBUILD
+  int heavy = 0;
+  for (c = 0; c < CHASH_URLS; c++) {
+    REINIT br(request, "www.example.com");
+    snprintf(url_buf, sizeof(url_buf), "http://www.example.com/object/%d", c);
+    request->hdr->url_set(url_buf, strlen(url_buf));
+    FP heavy += verify(result, PARENT_SPECIFIED, "heavy", 80);
+  }
+  printf("heavy parent has %d of %d URLs\n", heavy, CHASH_URLS);
+  ST(176) RE(heavy > CHASH_URLS * 65 / 100 && heavy < CHASH_URLS * 85 / 100, 176)
+
+  // Test 177 - with a load bound of 125%, a hot URL is spread over the
+  //   parents instead of all going to its owner
+  tbl[0] = '\0';
+  T("dest_domain=. parent=p0:80,p1:80,p2:80,p3:80,p4:80 round_robin=consistent_hash\n")
+  REBUILD
+  params->LoadBound = 125;
+  for (i = 0; i < 5; i++)
+    chash_count[i] = 0;
+  for (c = 0; c < CHASH_URLS; c++) {
+    REINIT br(request, "www.example.com");
+    snprintf(url_buf, sizeof(url_buf), "http://www.example.com/hot");
+    request->hdr->url_set(url_buf, strlen(url_buf));
+    FP if (result->r == PARENT_SPECIFIED)
+      chash_count[result->last_parent]++;
+  }
+  int chash_max = 0;
+  for (i = 0; i < 5; i++) {
+    printf("parent p%d has %d of %d requests for the hot URL\n", i, chash_count[i], CHASH_URLS);
+    chash_max = MAX(chash_max, chash_count[i]);
+  }
+  ST(177) RE(chash_max <= CHASH_URLS * 3 / 10, 177)
+
+  // Test 178 - on failure a URL goes to the next parent on the ring,
+  //   the one it goes to when its parent is down, and each retry
+  //   tries a parent that was not tried yet
+  tbl[0] = '\0';
+  T("dest_domain=. parent=p0:80,p1:80,p2:80,p3:80,p4:80 round_robin=consistent_hash\n")
+  REBUILD
+  params->LoadBound = 0;
+  int chash_failover_ok = 1;
+  for (c = 0; c < 100; c++) {
+    int tried[5] = { 0, 0, 0, 0, 0 };
+    int first, second;
+
+    snprintf(url_buf, sizeof(url_buf), "http://www.example.com/object/%d", c);
+    REINIT br(request, "www.example.com");
+    request->hdr->url_set(url_buf, strlen(url_buf));
+    FP first = result->last_parent;
+    tried[first] = 1;
+    params->nextParent(request, result);
+    second = result->last_parent;
+    for (i = 0; i < 4; i++) {
+      if (result->r != PARENT_SPECIFIED || tried[result->last_parent])
+        chash_failover_ok = 0;
+      tried[result->last_parent] = 1;
+      if (i < 3)
+        params->nextParent(request, result);
+    }
+
+    chash_rec = result->rec;
+    chash_rec->parents[first].failedAt = time(NULL);
+    chash_rec->parents[first].failCount = params->FailThreshold;
+    REINIT br(request, "www.example.com");
+    request->hdr->url_set(url_buf, strlen(url_buf));
+    FP if (result->r != PARENT_SPECIFIED || (int) result->last_parent != second)
+      chash_failover_ok = 0;
+    chash_rec->parents[first].failedAt = 0;
+    chash_rec->parents[first].failCount = 0;
+  }
+  ST(178) RE(chash_failover_ok, 178)
+
+  // Test 179 - in the latency mode a parent with a much higher health
+  //   check latency loses every choice, and a down parent is left out
+  tbl[0] = '\0';
+  T("dest_domain=. parent=quick:80,brisk:80,slow:80,gone:80 round_robin=latency\n")
+  REBUILD
+  int quick = 0, brisk = 0, slow = 0, gone = 0;
+  ParentRecord *latency_rec = NULL;
+  for (c = 0; c < 100; c++) {
+    REINIT br(request, "www.example.com");
+    if (latency_rec == NULL) {
+      FP latency_rec = result->rec;
+      latency_rec->parents[0].latency = 1000;
+      latency_rec->parents[1].latency = 1500;
+      latency_rec->parents[1].errors = 0.1;
+      latency_rec->parents[2].latency = 900;
+      latency_rec->parents[2].errors = 0.9;
+      latency_rec->parents[3].failedAt = time(NULL);
+      latency_rec->parents[3].failCount = params->FailThreshold;
+      REINIT br(request, "www.example.com");
+    }
+    FP quick += verify(result, PARENT_SPECIFIED, "quick", 80);
+    brisk += verify(result, PARENT_SPECIFIED, "brisk", 80);
+    slow += verify(result, PARENT_SPECIFIED, "slow", 80);
+    gone += verify(result, PARENT_SPECIFIED, "gone", 80);
+  }
+  printf("latency mode: quick %d brisk %d slow %d gone %d\n", quick, brisk, slow, gone);
+  ST(179) RE(quick > brisk && brisk > 0 && slow == 0 && gone == 0, 179)
+
   delete request;
   delete result;
 
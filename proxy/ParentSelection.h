@@ -131,6 +131,10 @@ struct ParentConfigParams:public ConfigInfo
   int32_t ParentEnable;
   int32_t FailThreshold;
   int32_t DNS_ParentOnly;
+  int32_t LoadBound;            // consistent hash load bound, in percent of the average
+  int32_t HealthCheckInterval;  // seconds between health checks, 0 for none
+  int32_t HealthCheckTimeout;
+  char *HealthCheckUrl;
 };
 
 struct ParentConfig
@@ -163,13 +167,29 @@ struct pRecord
   int failCount;
   int32_t upAt;
   const char *scheme;           // for which parent matches (if any)
+  float weight;                 // share of the consistent hash ring
+  volatile int32_t load;        // consistent hash requests in the current window
+  int32_t latency;              // moving average of the health check latency, in usec
+  float errors;                 // moving average of the health check failures, 0 to 1
 };
 
 enum ParentRR_t
 {
   P_NO_ROUND_ROBIN = 0,
   P_STRICT_ROUND_ROBIN,
-  P_HASH_ROUND_ROBIN
+  P_HASH_ROUND_ROBIN,
+  P_CONSISTENT_HASH,
+  P_LEAST_LATENCY
+};
+
+// struct pChashPoint
+//
+//    A virtual node of a parent on the consistent hash ring
+//
+struct pChashPoint
+{
+  uint64_t point;
+  int parent;
 };
 
 // class ParentRecord : public ControlBase
@@ -181,7 +201,8 @@ class ParentRecord: public ControlBase
 {
 public:
   ParentRecord()
-    : parents(NULL), num_parents(0), round_robin(P_NO_ROUND_ROBIN), rr_next(0), go_direct(true)
+    : parents(NULL), num_parents(0), round_robin(P_NO_ROUND_ROBIN), rr_next(0), go_direct(true),
+      chash_ring(NULL), chash_points(0), chash_window(0), chash_total(0), chash_last_total(0)
   { }
 
   ~ParentRecord();
@@ -199,9 +220,22 @@ public:
   const char *scheme;
   //private:
   const char *ProcessParents(char *val);
+  void BuildHashRing();
+  int FindHashParent(RD *rdata, ParentConfigParams *config);
+  int FindHashStart(RD *rdata, uint64_t *key);
+  int *HashOrder(RD *rdata);
+  int FindFastParent(RD *rdata, ParentConfigParams *config);
   ParentRR_t round_robin;
   volatile uint32_t rr_next;
   bool go_direct;
+
+  // Consistent hash ring, sorted on the points
+  pChashPoint *chash_ring;
+  int chash_points;
+  // Requests of the current and the previous one second window, for the load bound
+  volatile int32_t chash_window;
+  volatile int32_t chash_total;
+  volatile int32_t chash_last_total;
 };
 
 // Helper Functions
@@ -62,6 +62,8 @@ int DEFAULT_live_os_conn_retries = 2;
 int DEFAULT_dead_os_conn_timeout = 15;
 int DEFAULT_dead_os_conn_retries = 1;
 int DEFAULT_max_connection = -1;
+int DEFAULT_adaptive_limit = 0;
+int DEFAULT_adaptive_tolerance = 200;
 char *DEFAULT_congestion_scheme_str = NULL;
 int DEFAULT_congestion_scheme = PER_IP;
 
@@ -109,6 +111,8 @@ CongestionControlRecord::CongestionControlRecord(const CongestionControlRecord &
   dead_os_conn_timeout = rec.dead_os_conn_timeout;
   dead_os_conn_retries = rec.dead_os_conn_retries;
   max_connection = rec.max_connection;
+  adaptive_limit = rec.adaptive_limit;
+  adaptive_tolerance = rec.adaptive_tolerance;
   pRecord = NULL;
   ref_count = 1;
   line_num = rec.line_num;
@@ -133,6 +137,8 @@ CongestionControlRecord::setdefault()
   dead_os_conn_timeout = DEFAULT_dead_os_conn_timeout;
   dead_os_conn_retries = DEFAULT_dead_os_conn_retries;
   max_connection = DEFAULT_max_connection;
+  adaptive_limit = DEFAULT_adaptive_limit;
+  adaptive_tolerance = DEFAULT_adaptive_tolerance;
 }
 
 char *
@@ -170,6 +176,22 @@ CongestionControlRecord::validate()
   IsGt0(live_os_conn_retries);
   IsGt0(dead_os_conn_timeout);
   IsGt0(dead_os_conn_retries);
+  if (adaptive_limit > 0) {
+    if (adaptive_limit < CONG_ADAPTIVE_MIN_LIMIT) {
+      error_buf = (char *)ats_malloc(error_len);
+      snprintf(error_buf, error_len, "line %d: invalid %s = %d, %s must >= %d",
+               line_num, "adaptive_limit", adaptive_limit, "adaptive_limit", CONG_ADAPTIVE_MIN_LIMIT);
+      cleanup();
+      return error_buf;
+    }
+    if (adaptive_tolerance <= 100) {
+      error_buf = (char *)ats_malloc(error_len);
+      snprintf(error_buf, error_len, "line %d: invalid %s = %d, %s must > 100",
+               line_num, "adaptive_tolerance", adaptive_tolerance, "adaptive_tolerance");
+      cleanup();
+      return error_buf;
+    }
+  }
   // max_connection_failures <= 0  no failure num control
   // max_connection == -1 no max_connection control
   // max_connection_failures <= 0 && max_connection == -1 no congestion control for the rule
@@ -218,6 +240,10 @@ CongestionControlRecord::Init(matcher_line * line_info)
       dead_os_conn_retries = atoi(val);
     } else if (strcasecmp(label, "max_connection") == 0) {
       max_connection = atoi(val);
+    } else if (strcasecmp(label, "adaptive_limit") == 0) {
+      adaptive_limit = atoi(val);
+    } else if (strcasecmp(label, "adaptive_tolerance") == 0) {
+      adaptive_tolerance = atoi(val);
     } else if (strcasecmp(label, "congestion_scheme") == 0) {
       if (!strcasecmp(val, "per_ip")) {
         congestion_scheme = PER_IP;
@@ -316,6 +342,8 @@ CongestionControlRecord::Print()
   PrintNUM(dead_os_conn_timeout);
   PrintNUM(dead_os_conn_retries);
   PrintNUM(max_connection);
+  PrintNUM(adaptive_limit);
+  PrintNUM(adaptive_tolerance);
 #undef PrintNUM
 #undef PrintSTR
 }
@@ -382,6 +410,8 @@ initCongestionControl()
   REC_EstablishStaticConfigInt32(DEFAULT_dead_os_conn_timeout, "proxy.config.http.congestion_control.default.dead_os_conn_timeout");
   REC_EstablishStaticConfigInt32(DEFAULT_dead_os_conn_retries, "proxy.config.http.congestion_control.default.dead_os_conn_retries");
   REC_EstablishStaticConfigInt32(DEFAULT_max_connection, "proxy.config.http.congestion_control.default.max_connection");
+  REC_EstablishStaticConfigInt32(DEFAULT_adaptive_limit, "proxy.config.http.congestion_control.default.adaptive_limit");
+  REC_EstablishStaticConfigInt32(DEFAULT_adaptive_tolerance, "proxy.config.http.congestion_control.default.adaptive_tolerance");
   REC_EstablishStaticConfigStringAlloc(DEFAULT_congestion_scheme_str, "proxy.config.http.congestion_control.default.congestion_scheme");
   REC_EstablishStaticConfigStringAlloc(DEFAULT_error_page, "proxy.config.http.congestion_control.default.error_page");
   REC_EstablishStaticConfigInt32(congestionControlLocalTime, "proxy.config.http.congestion_control.localtime");
@@ -593,7 +623,10 @@ CongestionEntry::CongestionEntry(const char *hostname, sockaddr const* ip, Conge
 m_last_congested(0),
 m_congested(0),
 m_stat_congested_conn_failures(0),
-m_M_congested(0), m_last_M_congested(0), m_num_connections(0), m_stat_congested_max_conn(0), m_ref_count(1)
+m_M_congested(0), m_last_M_congested(0), m_num_connections(0), m_stat_congested_max_conn(0),
+m_limit(CONG_ADAPTIVE_INITIAL_LIMIT), m_adaptive_limit(CONG_ADAPTIVE_INITIAL_LIMIT),
+m_min_rtt(0), m_min_rtt_at(0), m_rtt(0), m_last_decrease(0), m_ref_count(1),
+m_next(NULL), m_retired_next(NULL), m_retired_at(0)
 {
   memset(&m_ip, 0, sizeof(m_ip));
   if (ip != NULL) {
@@ -616,7 +649,7 @@ CongestionEntry::init(CongestionControlRecord * rule)
   clearFailHistory();
 
   // TODO: This used to signal via SNMP
-  if ((pRecord->max_connection > m_num_connections)
+  if ((conn_limit() > m_num_connections)
       && ink_atomic_swap(&m_M_congested, 0)) {
     // action not congested?
   }
@@ -652,8 +685,8 @@ CongestionEntry::applyNewRule(CongestionControlRecord * rule)
   rule->get();
   pRecord = rule;
   // TODO: This used to signal via SNMP
-  if (((pRecord->max_connection < 0)
-       || (pRecord->max_connection > m_num_connections))
+  if (((conn_limit() < 0)
+       || (conn_limit() > m_num_connections))
       && ink_atomic_swap(&m_M_congested, 0)) {
     // action not congested ?
   }
@@ -684,7 +717,8 @@ CongestionEntry::sprint(char *buf, int buflen, int format)
   int len = 0;
   ink_hrtime timestamp = 0;
   char state;
-  if (pRecord->max_connection >= 0 && m_num_connections >= pRecord->max_connection) {
+  int limit = conn_limit();
+  if (limit >= 0 && m_num_connections >= limit) {
     timestamp = ink_hrtime_to_sec(ink_get_hrtime());
     state = 'M';
   } else {
@@ -724,6 +758,11 @@ CongestionEntry::sprint(char *buf, int buflen, int format)
 
         if (format > 3) {
           len += snprintf(buf + len, buflen - len, "|%d|%d|%d", m_history.events, m_ref_count, m_num_connections);
+
+          if (format > 4 && pRecord->adaptive_limit > 0) {
+            len += snprintf(buf + len, buflen - len, "|%d|%" PRId64 "|%" PRId64 "", limit,
+                            (int64_t) ink_hrtime_to_msec(m_rtt), (int64_t) ink_hrtime_to_msec(m_min_rtt));
+          }
         }
       }
     }
@@ -740,6 +779,11 @@ CongestionEntry::sprint(char *buf, int buflen, int format)
 void
 CongestionEntry::failed_at(ink_hrtime t)
 {
+  if (pRecord->adaptive_limit > 0) {
+    MUTEX_TRY_LOCK(lock, m_hist_lock, this_ethread());
+    if (lock)
+      decrease_limit(ink_get_hrtime());
+  }
   if (pRecord->max_connection_failures == -1)
     return;
   // long time = ink_hrtime_to_sec(t);
@@ -761,6 +805,60 @@ CongestionEntry::failed_at(ink_hrtime t)
   }
 }
 
+// m_hist_lock is held
+void
+CongestionEntry::decrease_limit(ink_hrtime now)
+{
+  // one cut per round trip, the responses already on their way are
+  //  from before the last one
+  if (now - m_last_decrease < m_rtt)
+    return;
+  m_limit *= CONG_ADAPTIVE_BACKOFF;
+  if (m_limit < CONG_ADAPTIVE_MIN_LIMIT)
+    m_limit = CONG_ADAPTIVE_MIN_LIMIT;
+  m_last_decrease = now;
+  m_adaptive_limit = (int) m_limit;
+  Debug("congestion_control", "adaptive limit of %s down to %d (rtt %" PRId64 " min %" PRId64 " ms)",
+        m_hostname ? m_hostname : "-", m_adaptive_limit,
+        (int64_t) ink_hrtime_to_msec(m_rtt), (int64_t) ink_hrtime_to_msec(m_min_rtt));
+}
+
+//-------------------------------------------------------------
+// The time from the request to the response header of a
+//  transaction, as the samples of the adaptive limit. Like the
+//  failures, a sample is discarded on lock contention.
+//-------------------------------------------------------------
+void
+CongestionEntry::response_time(ink_hrtime rtt)
+{
+  if (pRecord->adaptive_limit <= 0 || rtt <= 0)
+    return;
+  MUTEX_TRY_LOCK(lock, m_hist_lock, this_ethread());
+  if (!lock)
+    return;
+
+  ink_hrtime now = ink_get_hrtime();
+  if (m_min_rtt == 0 || rtt < m_min_rtt || now - m_min_rtt_at > CONG_ADAPTIVE_MIN_RTT_WINDOW) {
+    m_min_rtt = rtt;
+    m_min_rtt_at = now;
+  }
+  if (m_rtt == 0)
+    m_rtt = rtt;
+  else
+    m_rtt += (ink_hrtime) ((rtt - m_rtt) * CONG_ADAPTIVE_RTT_WEIGHT);
+
+  if (m_rtt * 100 > m_min_rtt * pRecord->adaptive_tolerance) {
+    // the requests queue up at the server
+    decrease_limit(now);
+  } else if (m_num_connections * 2 >= m_adaptive_limit) {
+    // only a limit that is in use is known to be good enough
+    m_limit += 1.0 / m_limit;
+    if (m_limit > pRecord->adaptive_limit)
+      m_limit = pRecord->adaptive_limit;
+    m_adaptive_limit = (int) m_limit;
+  }
+}
+
 void
 CongestionEntry::go_alive()
 {
@@ -99,6 +99,8 @@ public:
   int dead_os_conn_timeout;
   int dead_os_conn_retries;
   int max_connection;
+  int adaptive_limit;
+  int adaptive_tolerance;
 
   CongestionControlRecord *pRecord;
   int32_t ref_count;
@@ -147,6 +149,8 @@ live_os_conn_retries(2),
 dead_os_conn_timeout(15),
 dead_os_conn_retries(1),
 max_connection(-1),
+adaptive_limit(0),
+adaptive_tolerance(200),
 pRecord(NULL),
 ref_count(0)
 {
@@ -169,6 +173,23 @@ CongestionControlRecord::cleanup()
   ats_free(error_page), error_page = NULL;
 }
 
+/*
+ * The adaptive limit of the concurrent connections to an origin server,
+ * when the rule has adaptive_limit > 0. The limit grows by one for
+ * every limit responses (additive increase) while the time to the
+ * response header stays within adaptive_tolerance percent of the lowest
+ * time seen recently, and is cut by CONG_ADAPTIVE_BACKOFF (at most once
+ * per round trip) when it does not, or when a connection fails. Requests
+ * over the limit are refused as M congested.
+ */
+#define CONG_ADAPTIVE_MIN_LIMIT      2
+#define CONG_ADAPTIVE_INITIAL_LIMIT  16
+#define CONG_ADAPTIVE_BACKOFF        0.9
+#define CONG_ADAPTIVE_RTT_WEIGHT     0.2
+// the lowest response time is forgotten after this, so a lasting change
+// of the base latency of the server does not keep the limit down
+#define CONG_ADAPTIVE_MIN_RTT_WINDOW HRTIME_SECONDS(30)
+
 typedef unsigned short cong_hist_t;
 #define CONG_HIST_ENTRIES 17
 
@@ -223,9 +244,22 @@ struct CongestionEntry: public RequestData
   int m_num_connections;
   int m_stat_congested_max_conn;
 
+  // State -- adaptive limit, updated under m_hist_lock
+  double m_limit;
+  volatile int m_adaptive_limit;        // (int) m_limit, for the readers
+  ink_hrtime m_min_rtt;
+  ink_hrtime m_min_rtt_at;
+  ink_hrtime m_rtt;
+  ink_hrtime m_last_decrease;
+
   // Reference count
   int m_ref_count;
 
+  // CongestionDB links, see CongestionDB.h
+  CongestionEntry * volatile m_next;
+  CongestionEntry *m_retired_next;
+  ink_hrtime m_retired_at;
+
     CongestionEntry(const char *hostname, sockaddr const* ip, CongestionControlRecord * rule, uint64_t key);
     CongestionEntry();
     virtual ~ CongestionEntry();
@@ -268,6 +302,7 @@ struct CongestionEntry: public RequestData
   // Update state info
   void go_alive();
   void failed_at(ink_hrtime t);
+  void response_time(ink_hrtime rtt);
   void connection_opened();
   void connection_closed();
 
@@ -288,6 +323,8 @@ struct CongestionEntry: public RequestData
   // fail history operations
   void clearFailHistory();
   bool compCongested();
+  int conn_limit();
+  void decrease_limit(ink_hrtime now);
 
   // CongestionEntry and CongestionControl rules interaction helper functions
   bool usefulInfo(ink_hrtime t);
@@ -326,9 +363,23 @@ inline bool CongestionEntry::F_congested()
   return m_congested == 1;
 }
 
+// the limit of the concurrent connections, -1 for none
+inline int
+CongestionEntry::conn_limit()
+{
+  int limit = pRecord->max_connection;
+  if (pRecord->adaptive_limit > 0) {
+    int adaptive = m_adaptive_limit < pRecord->adaptive_limit ? m_adaptive_limit : pRecord->adaptive_limit;
+    if (limit < 0 || adaptive < limit)
+      limit = adaptive;
+  }
+  return limit;
+}
+
 inline bool CongestionEntry::M_congested(ink_hrtime t)
 {
-  if (pRecord->max_connection >= 0 && m_num_connections >= pRecord->max_connection) {
+  int limit = conn_limit();
+  if (limit >= 0 && m_num_connections >= limit) {
     if (ink_atomic_swap(&m_M_congested, 1) == 0) {
       m_last_M_congested = t;
       // TODO: Used to signal congestions
@@ -413,7 +464,10 @@ inline CongestionEntry::CongestionEntry()
 :m_key(0), m_hostname(NULL), pRecord(NULL),
 m_last_congested(0), m_congested(0),
 m_stat_congested_conn_failures(0),
-m_M_congested(0), m_last_M_congested(0), m_num_connections(0), m_stat_congested_max_conn(0), m_ref_count(1)
+m_M_congested(0), m_last_M_congested(0), m_num_connections(0), m_stat_congested_max_conn(0),
+m_limit(CONG_ADAPTIVE_INITIAL_LIMIT), m_adaptive_limit(CONG_ADAPTIVE_INITIAL_LIMIT),
+m_min_rtt(0), m_min_rtt_at(0), m_rtt(0), m_last_decrease(0), m_ref_count(1),
+m_next(NULL), m_retired_next(NULL), m_retired_at(0)
 {
   memset(&m_ip, 0, sizeof(m_ip));
   m_hist_lock = new_ProxyMutex();
@@ -35,16 +35,18 @@
 #include "Congestion.h"
 #include "ProcessManager.h"
 
-#define SCHEDULE_CONGEST_CONT_INTERVAL HRTIME_MSECONDS(5)
-int CONGESTION_DB_SIZE = 1024;
+#define CONGESTION_DB_GC_INTERVAL HRTIME_SECONDS(10)
+// longer than any lookup can walk over a removed entry
+#define CONGESTION_DB_GRACE HRTIME_SECONDS(60)
+int CONGESTION_DB_SIZE = 64 * 1024;
 
 CongestionDB *theCongestionDB = NULL;
 
 
 /*
- * the CongestionDBCont is the continuation to do the congestion db related work
- * when the CongestionDB's corresponding function does not get the lock in the
- * first try
+ * the CongestionDBCont runs the to do list of the db when nobody else
+ * got the writer lock for it, removes the entries without useful info
+ * and releases the retired entries
  */
 
 class CongestionDBCont:public Continuation
@@ -52,63 +54,12 @@ class CongestionDBCont:public Continuation
 public:
   CongestionDBCont();
   int GC(int event, Event * e);
-
-  int get_congest_list(int event, Event * e);
-
-  int get_congest_entry(int event, Event * e);
-
-
-  Action m_action;
-
-  // To save momery, use a union here
-  union
-  {
-    struct
-    {
-      MIOBuffer *m_iobuf;
-      int m_CurPartitionID;
-      int m_list_format;        // format of list
-    } list_info;
-    struct
-    {
-      uint64_t m_key;
-      char *m_hostname;
-      IpEndpoint m_ip;
-      CongestionControlRecord *m_rule;
-      CongestionEntry **m_ppEntry;
-    } entry_info;
-  } data;
 };
 
-// MACRO's to save typing
-#define CDBC_buf  data.list_info.m_iobuf
-#define CDBC_pid  data.list_info.m_CurPartitionID
-#define CDBC_lf   data.list_info.m_list_format
-#define CDBC_key  data.entry_info.m_key
-#define CDBC_host data.entry_info.m_hostname
-#define CDBC_ip   data.entry_info.m_ip
-#define CDBC_rule data.entry_info.m_rule
-#define CDBC_ppE  data.entry_info.m_ppEntry
-
 inline CongestionDBCont::CongestionDBCont()
-:Continuation(NULL)
+:Continuation(new_ProxyMutex())
 {
-  memset(&data, 0, sizeof(data));
-}
-
-//--------------------------------------------------------------
-// class allocators
-static
-  ClassAllocator <
-  CongestionDBCont >
-CongestionDBContAllocator("CongestionDBContAllocator");
-
-inline void
-Free_CongestionDBCont(CongestionDBCont * cont)
-{
-  cont->m_action = NULL;
-  cont->mutex = NULL;
-  CongestionDBContAllocator.free(cont);
+  SET_HANDLER(&CongestionDBCont::GC);
 }
 
 ClassAllocator<CongestRequestParam> CongestRequestParamAllocator("CongestRequestParamAllocator");
@@ -124,50 +75,133 @@ Free_CongestRequestParam(CongestRequestParam * param)
 //-----------------------------------------------------------------
 /*
  * CongestionDB(int tablesize)
- *  tablesize is the initial hashtable bucket number
+ *  tablesize is the bucket number, rounded up to a power of 2
  */
-static long
-  congestEntryGCTime = 0;
+CongestionDB::CongestionDB(int tablesize)
+:m_lock(new_ProxyMutex()), m_buckets(NULL), m_size(1), m_retired(NULL)
+{
+  ink_assert(tablesize > 0);
+  while (m_size < tablesize)
+    m_size <<= 1;
+  m_buckets = (CongestionEntry * volatile *)ats_malloc(sizeof(CongestionEntry *) * m_size);
+  memset((void *) m_buckets, 0, sizeof(CongestionEntry *) * m_size);
+  ink_atomiclist_init(&todo_list, "cong_todo_list", (uintptr_t) &((CongestRequestParam *) 0)->link);
+}
 
-// Before the garbage collection of the congestion db, set the
-//  current GC time, CongestionEntry::usefulInfo(t) will use the
-//  timestamp to determine if the entry contains useful infomation
+/*
+ * Nobody may be looking up the DB when you call the destructor
+ */
 
-void
-preCongestEntryGC(void)
+CongestionDB::~CongestionDB()
 {
-  congestEntryGCTime = (long) ink_hrtime_to_sec(ink_get_hrtime());
+  CongestRequestParam *param = (CongestRequestParam *) ink_atomiclist_popall(&todo_list);
+  while (param) {
+    CongestRequestParam *next = param->link.next;
+    if (param->m_op == CongestRequestParam::ADD_RECORD)
+      param->m_pEntry->put();
+    Free_CongestRequestParam(param);
+    param = next;
+  }
+  for (int i = 0; i < m_size; i++) {
+    CongestionEntry *pEntry = m_buckets[i];
+    while (pEntry) {
+      CongestionEntry *next = pEntry->m_next;
+      pEntry->put();
+      pEntry = next;
+    }
+  }
+  ats_free((void *) m_buckets);
+  reclaim(HRTIME_FOREVER);
 }
 
-// if the entry contains useful info, return false -- keep it
-// else return true -- delete it
-bool
-congestEntryGC(CongestionEntry * p)
+CongestionEntry *
+CongestionDB::lookup_entry(uint64_t key)
 {
-  if (!p->usefulInfo(congestEntryGCTime)) {
-    p->put();
-    return true;
+  for (CongestionEntry * pEntry = m_buckets[bucket_of(key)]; pEntry; pEntry = pEntry->m_next) {
+    if (pEntry->m_key == key)
+      return pEntry;
   }
-  return false;
+  return NULL;
 }
 
-CongestionDB::CongestionDB(int tablesize)
-:CongestionTable(tablesize, &congestEntryGC, &preCongestEntryGC)
+CongestionEntry *
+CongestionDB::insert_entry(uint64_t key, CongestionEntry * pEntry)
 {
-  ink_assert(tablesize > 0);
-  todo_lists = new InkAtomicList[MT_HASHTABLE_PARTITIONS];
-  for (int i = 0; i < MT_HASHTABLE_PARTITIONS; i++) {
-    ink_atomiclist_init(&todo_lists[i], "cong_todo_list", (uintptr_t) &((CongestRequestParam *) 0)->link);
+  int bucket = bucket_of(key);
+  for (;;) {
+    CongestionEntry *head = m_buckets[bucket];
+    // look again every time, whoever changed the head may have added key
+    for (CongestionEntry * cur = head; cur; cur = cur->m_next) {
+      if (cur->m_key == key)
+        return cur;
+    }
+    pEntry->m_next = head;
+    if (ink_atomic_cas(&m_buckets[bucket], head, pEntry))
+      return pEntry;
   }
 }
 
-/*
- * There should be no entry in the DB, before you call the destructor
- */
+CongestionEntry *
+CongestionDB::next_entry(CongestionEntry * pEntry)
+{
+  return pEntry->m_next;
+}
 
-CongestionDB::~CongestionDB()
+// m_lock is held: the only concurrent change to the bucket is a new head
+void
+CongestionDB::unlink_entry(int bucket, CongestionEntry * pEntry)
 {
-  delete[]todo_lists;
+  for (;;) {
+    CongestionEntry *prev = m_buckets[bucket];
+    if (prev == pEntry) {
+      if (ink_atomic_cas(&m_buckets[bucket], pEntry, pEntry->m_next))
+        return;
+      // an entry was pushed in front of it, it is in the middle now
+      continue;
+    }
+    while (prev->m_next != pEntry)
+      prev = prev->m_next;
+    prev->m_next = pEntry->m_next;
+    return;
+  }
+}
+
+// m_lock is held, the reference of the table goes with the entry
+void
+CongestionDB::retire(CongestionEntry * pEntry)
+{
+  pEntry->m_retired_at = ink_get_hrtime();
+  pEntry->m_retired_next = m_retired;
+  m_retired = pEntry;
+}
+
+// m_lock is held, the retired list is in the order of the removals
+void
+CongestionDB::reclaim(ink_hrtime t)
+{
+  CongestionEntry **pp = &m_retired;
+  while (*pp && (*pp)->m_retired_at > t)
+    pp = &(*pp)->m_retired_next;
+  CongestionEntry *pEntry = *pp;
+  *pp = NULL;
+  while (pEntry) {
+    CongestionEntry *next = pEntry->m_retired_next;
+    pEntry->put();
+    pEntry = next;
+  }
+}
+
+CongestionEntry *
+CongestionDB::remove_entry(uint64_t key)
+{
+  int bucket = bucket_of(key);
+  for (CongestionEntry * pEntry = m_buckets[bucket]; pEntry; pEntry = pEntry->m_next) {
+    if (pEntry->m_key == key) {
+      unlink_entry(bucket, pEntry);
+      return pEntry;
+    }
+  }
+  return NULL;
 }
 
 void
@@ -175,97 +209,88 @@ CongestionDB::addRecord(uint64_t key, CongestionEntry * pEntry)
 {
   ink_assert(key == pEntry->m_key);
   pEntry->get();
-  ProxyMutex *bucket_mutex = lock_for_key(key);
-  MUTEX_TRY_LOCK(lock, bucket_mutex, this_ethread());
+  MUTEX_TRY_LOCK(lock, m_lock, this_ethread());
   if (lock) {
-    RunTodoList(part_num(key));
-    CongestionEntry *tmp = insert_entry(key, pEntry);
-    if (tmp)
-      tmp->put();
+    RunTodoList();
+    CongestRequestParam param;
+    param.m_op = CongestRequestParam::ADD_RECORD;
+    param.m_key = key;
+    param.m_pEntry = pEntry;
+    process(&param);
   } else {
     CongestRequestParam *param = CongestRequestParamAllocator.alloc();
     param->m_op = CongestRequestParam::ADD_RECORD;
     param->m_key = key;
     param->m_pEntry = pEntry;
-    ink_atomiclist_push(&todo_lists[part_num(key)], param);
+    ink_atomiclist_push(&todo_list, param);
   }
 }
 
 void
 CongestionDB::removeAllRecords()
 {
-  CongestionEntry *tmp;
-  Iter it;
-  for (int part = 0; part < MT_HASHTABLE_PARTITIONS; part++) {
-    ProxyMutex *bucket_mutex = lock_for_key(part);
-    MUTEX_TRY_LOCK(lock, bucket_mutex, this_ethread());
-    if (lock) {
-      RunTodoList(part);
-      tmp = first_entry(part, &it);
-      while (tmp) {
-        remove_entry(part, &it);
-        tmp->put();
-        tmp = cur_entry(part, &it);
-      }
-    } else {
-      CongestRequestParam *param = CongestRequestParamAllocator.alloc();
-      param->m_op = CongestRequestParam::REMOVE_ALL_RECORDS;
-      param->m_key = part;
-      ink_atomiclist_push(&todo_lists[part], param);
-    }
+  MUTEX_TRY_LOCK(lock, m_lock, this_ethread());
+  if (lock) {
+    RunTodoList();
+    CongestRequestParam param;
+    param.m_op = CongestRequestParam::REMOVE_ALL_RECORDS;
+    process(&param);
+  } else {
+    CongestRequestParam *param = CongestRequestParamAllocator.alloc();
+    param->m_op = CongestRequestParam::REMOVE_ALL_RECORDS;
+    ink_atomiclist_push(&todo_list, param);
   }
 }
 
 void
 CongestionDB::removeRecord(uint64_t key)
 {
-  CongestionEntry *tmp;
-  ProxyMutex *bucket_mutex = lock_for_key(key);
-  MUTEX_TRY_LOCK(lock, bucket_mutex, this_ethread());
+  MUTEX_TRY_LOCK(lock, m_lock, this_ethread());
   if (lock) {
-    RunTodoList(part_num(key));
-    tmp = remove_entry(key);
-    if (tmp)
-      tmp->put();
+    RunTodoList();
+    CongestRequestParam param;
+    param.m_op = CongestRequestParam::REMOVE_RECORD;
+    param.m_key = key;
+    process(&param);
   } else {
     CongestRequestParam *param = CongestRequestParamAllocator.alloc();
     param->m_op = CongestRequestParam::REMOVE_RECORD;
     param->m_key = key;
-    ink_atomiclist_push(&todo_lists[part_num(key)], param);
+    ink_atomiclist_push(&todo_list, param);
   }
 }
 
-// process one item in the to do list
+// process one item in the to do list, m_lock is held
 void
-CongestionDB::process(int buckId, CongestRequestParam * param)
+CongestionDB::process(CongestRequestParam * param)
 {
   CongestionEntry *pEntry = NULL;
   switch (param->m_op) {
   case CongestRequestParam::ADD_RECORD:
-    pEntry = insert_entry(param->m_key, param->m_pEntry);
-    if (pEntry) {
-      pEntry->put();
-    }
+    pEntry = remove_entry(param->m_key);
+    if (pEntry)
+      retire(pEntry);
+    // a lookup may have added the key again in the meantime
+    if (insert_entry(param->m_key, param->m_pEntry) != param->m_pEntry)
+      param->m_pEntry->put();
     break;
   case CongestRequestParam::REMOVE_ALL_RECORDS:
-    {
-      CongestionEntry *tmp;
-      Iter it;
-      tmp = first_entry(param->m_key, &it);
-      while (tmp) {
-        remove_entry(param->m_key, &it);
-        tmp->put();
-        tmp = cur_entry(param->m_key, &it);
+    for (int i = 0; i < m_size; i++) {
+      pEntry = ink_atomic_swap(&m_buckets[i], (CongestionEntry *) NULL);
+      while (pEntry) {
+        CongestionEntry *next = pEntry->m_next;
+        retire(pEntry);
+        pEntry = next;
       }
-      break;
     }
+    break;
   case CongestRequestParam::REMOVE_RECORD:
     pEntry = remove_entry(param->m_key);
     if (pEntry)
-      pEntry->put();
+      retire(pEntry);
     break;
-  case CongestRequestParam::REVALIDATE_BUCKET:
-    revalidateBucket(buckId);
+  case CongestRequestParam::REVALIDATE:
+    revalidate();
     break;
   default:
     ink_assert(!"CongestionDB::process unrecognized op");
@@ -273,11 +298,11 @@ CongestionDB::process(int buckId, CongestRequestParam * param)
 }
 
 void
-CongestionDB::RunTodoList(int buckId)
+CongestionDB::RunTodoList()
 {
   CongestRequestParam *param = NULL, *cur = NULL;
   if ((param = (CongestRequestParam *)
-       ink_atomiclist_popall(&todo_lists[buckId])) != NULL) {
+       ink_atomiclist_popall(&todo_list)) != NULL) {
     /* start the work at the end of the list */
     param->link.prev = NULL;
     while (param->link.next) {
@@ -285,7 +310,7 @@ CongestionDB::RunTodoList(int buckId)
       param = param->link.next;
     };
     while (param) {
-      process(buckId, param);
+      process(param);
       cur = param;
       param = param->link.prev;
       Free_CongestRequestParam(cur);
@@ -293,144 +318,65 @@ CongestionDB::RunTodoList(int buckId)
   }
 }
 
+// m_lock is held
 void
-CongestionDB::revalidateBucket(int buckId)
+CongestionDB::revalidate()
 {
-  Iter it;
-  CongestionEntry *cur = NULL;
-  cur = first_entry(buckId, &it);
-  while (cur != NULL) {
-    if (!cur->validate()) {
-      remove_entry(buckId, &it);
-      cur->put();
-      // the next entry has been moved to the current pos
-      //because of the remove_entry
-      cur = cur_entry(buckId, &it);
-    } else
-      cur = next_entry(buckId, &it);
-  }
-}
-
-//-----------------------------------------------------------------
-//  CongestionDBCont implementation
-//-----------------------------------------------------------------
-
-int
-CongestionDBCont::GC(int event, Event * e)
-{
-  NOWARN_UNUSED(event);
-  NOWARN_UNUSED(e);
-  if (congestionControlEnabled == 1 || congestionControlEnabled == 2) {
-    if (theCongestionDB == NULL)
-      goto Ldone;
-    for (; CDBC_pid < theCongestionDB->getSize(); CDBC_pid++) {
-      ProxyMutex *bucket_mutex = theCongestionDB->lock_for_key(CDBC_pid);
-      {
-        MUTEX_TRY_LOCK(lock, bucket_mutex, this_ethread());
-        if (lock) {
-          ink_hrtime now = ink_get_hrtime();
-          now = ink_hrtime_to_sec(now);
-          theCongestionDB->RunTodoList(CDBC_pid);
-          Iter it;
-          CongestionEntry *pEntry = theCongestionDB->first_entry(CDBC_pid, &it);
-          while (pEntry) {
-            if (!pEntry->usefulInfo(now)) {
-              theCongestionDB->remove_entry(CDBC_pid, &it);
-              pEntry->put();
-              pEntry = theCongestionDB->cur_entry(CDBC_pid, &it);
-            }
-          }
-        } else {
-          Debug("congestion_db", "flush gc missed the lock [%d], retry", CDBC_pid);
-          return EVENT_CONT;
-        }
+  for (int i = 0; i < m_size; i++) {
+    CongestionEntry *cur = m_buckets[i];
+    while (cur != NULL) {
+      CongestionEntry *next = cur->m_next;
+      if (!cur->validate()) {
+        unlink_entry(i, cur);
+        retire(cur);
       }
+      cur = next;
     }
   }
-Ldone:
-  CDBC_pid = 0;
-  return EVENT_DONE;
 }
 
-int
-CongestionDBCont::get_congest_list(int event, Event * e)
+// m_lock is held
+void
+CongestionDB::GC(ink_hrtime t)
 {
-  NOWARN_UNUSED(event);
-  NOWARN_UNUSED(e);
-
-  if (m_action.cancelled) {
-    Free_CongestionDBCont(this);
-    return EVENT_DONE;
-  }
-  for (; CDBC_pid < theCongestionDB->getSize(); CDBC_pid++) {
-    ProxyMutex *bucket_mutex = theCongestionDB->lock_for_key(CDBC_pid);
-    {
-      MUTEX_TRY_LOCK(lock_bucket, bucket_mutex, this_ethread());
-      if (!lock_bucket) {
-        e->schedule_in(SCHEDULE_CONGEST_CONT_INTERVAL);
-        return EVENT_CONT;
-      } else {
-        theCongestionDB->RunTodoList(CDBC_pid);
-        char buf[1024];
-        Iter it;
-        int len;
-        CongestionEntry *pEntry = theCongestionDB->first_entry(CDBC_pid, &it);
-        while (pEntry) {
-          if ((pEntry->congested() && pEntry->pRecord->max_connection != 0) || CDBC_lf > 10) {
-            len = pEntry->sprint(buf, 1024, CDBC_lf);
-            CDBC_buf->write(buf, len);
-          }
-          pEntry = theCongestionDB->next_entry(CDBC_pid, &it);
-        }
+  long now = (long) ink_hrtime_to_sec(t);
+  int removed = 0;
+  for (int i = 0; i < m_size; i++) {
+    CongestionEntry *cur = m_buckets[i];
+    while (cur != NULL) {
+      CongestionEntry *next = cur->m_next;
+      if (!cur->usefulInfo(now)) {
+        unlink_entry(i, cur);
+        retire(cur);
+        removed++;
       }
+      cur = next;
     }
   }
-
-  /* handle event done */
-  m_action.continuation->handleEvent(CONGESTION_EVENT_CONGESTED_LIST_DONE, NULL);
-  Free_CongestionDBCont(this);
-  return EVENT_DONE;
+  reclaim(t - CONGESTION_DB_GRACE);
+  if (removed)
+    Debug("congestion_db", "gc removed %d entries", removed);
 }
 
+//-----------------------------------------------------------------
+//  CongestionDBCont implementation
+//-----------------------------------------------------------------
+
 int
-CongestionDBCont::get_congest_entry(int event, Event * e)
+CongestionDBCont::GC(int event, Event * e)
 {
-  Debug("congestion_control", "cont::get_congest_entry started");
   NOWARN_UNUSED(event);
   NOWARN_UNUSED(e);
-
-  if (m_action.cancelled) {
-    Debug("congestion_cont", "action cancelled for %p", this);
-    Free_CongestionDBCont(this);
-    Debug("congestion_control", "cont::get_congest_entry state machine canceled");
-    return EVENT_DONE;
-  }
-  ProxyMutex *bucket_mutex = theCongestionDB->lock_for_key(CDBC_key);
-  MUTEX_TRY_LOCK(lock_bucket, bucket_mutex, this_ethread());
-  if (lock_bucket) {
-    theCongestionDB->RunTodoList(theCongestionDB->part_num(CDBC_key));
-    *CDBC_ppE = theCongestionDB->lookup_entry(CDBC_key);
-    if (*CDBC_ppE != NULL) {
-      CDBC_rule->put();
-      (*CDBC_ppE)->get();
-      Debug("congestion_control", "cont::get_congest_entry entry found");
-      m_action.continuation->handleEvent(CONGESTION_EVENT_CONTROL_LOOKUP_DONE, NULL);
-    } else {
-      /* create a new entry and add it to the congestDB */
-      *CDBC_ppE = new CongestionEntry(CDBC_host, &CDBC_ip.sa, CDBC_rule, CDBC_key);
-      CDBC_rule->put();
-      (*CDBC_ppE)->get();
-      theCongestionDB->insert_entry(CDBC_key, *CDBC_ppE);
-      Debug("congestion_control", "cont::get_congest_entry new entry created");
-      m_action.continuation->handleEvent(CONGESTION_EVENT_CONTROL_LOOKUP_DONE, NULL);
-    }
-    Free_CongestionDBCont(this);
-    return EVENT_DONE;
-  } else {
-    Debug("congestion_control", "cont::get_congest_entry MUTEX_TRY_LOCK failed");
-    e->schedule_in(SCHEDULE_CONGEST_CONT_INTERVAL);
+  if (theCongestionDB == NULL)
     return EVENT_CONT;
+  MUTEX_TRY_LOCK(lock, theCongestionDB->m_lock, this_ethread());
+  if (lock) {
+    theCongestionDB->RunTodoList();
+    theCongestionDB->GC(ink_get_hrtime());
+  } else {
+    Debug("congestion_db", "gc missed the lock, retry");
   }
+  return EVENT_CONT;
 }
 
 //-----------------------------------------------------------------
@@ -441,32 +387,27 @@ void
 initCongestionDB()
 {
   if (theCongestionDB == NULL) {
-    theCongestionDB = new CongestionDB(CONGESTION_DB_SIZE / MT_HASHTABLE_PARTITIONS);
+    theCongestionDB = new CongestionDB(CONGESTION_DB_SIZE);
+    eventProcessor.schedule_every(NEW(new CongestionDBCont), CONGESTION_DB_GC_INTERVAL);
   }
 }
 
 void
 revalidateCongestionDB()
 {
-  ProxyMutex *bucket_mutex;
   if (theCongestionDB == NULL) {
-    theCongestionDB = new CongestionDB(CONGESTION_DB_SIZE / MT_HASHTABLE_PARTITIONS);
+    initCongestionDB();
     return;
   }
   Debug("congestion_config", "congestion control revalidating CongestionDB");
-  for (int i = 0; i < theCongestionDB->getSize(); i++) {
-    bucket_mutex = theCongestionDB->lock_for_key(i);
-    {
-      MUTEX_TRY_LOCK(lock_bucket, bucket_mutex, this_ethread());
-      if (lock_bucket) {
-        theCongestionDB->RunTodoList(i);
-        theCongestionDB->revalidateBucket(i);
-      } else {
-        CongestRequestParam *param = CongestRequestParamAllocator.alloc();
-        param->m_op = CongestRequestParam::REVALIDATE_BUCKET;
-        ink_atomiclist_push(&theCongestionDB->todo_lists[i], param);
-      }
-    }
+  MUTEX_TRY_LOCK(lock, theCongestionDB->m_lock, this_ethread());
+  if (lock) {
+    theCongestionDB->RunTodoList();
+    theCongestionDB->revalidate();
+  } else {
+    CongestRequestParam *param = CongestRequestParamAllocator.alloc();
+    param->m_op = CongestRequestParam::REVALIDATE;
+    ink_atomiclist_push(&theCongestionDB->todo_list, param);
   }
   Debug("congestion_config", "congestion control revalidating CongestionDB Done");
 }
@@ -474,6 +415,7 @@ revalidateCongestionDB()
 Action *
 get_congest_entry(Continuation * cont, HttpRequestData * data, CongestionEntry ** ppEntry)
 {
+  NOWARN_UNUSED(cont);
   if (congestionControlEnabled != 1 && congestionControlEnabled != 2)
     return ACTION_RESULT_DONE;
   Debug("congestion_control", "congestion control get_congest_entry start");
@@ -482,82 +424,47 @@ get_congest_entry(Continuation * cont, HttpRequestData * data, CongestionEntry *
   Debug("congestion_control", "Control Matcher matched rule_num %d", p == NULL ? -1 : p->line_num);
   if (p == NULL)
     return ACTION_RESULT_DONE;
-// if the fail_window <= 0 and the max_connection == -1, then no congestion control
-  if (p->max_connection_failures <= 0 && p->max_connection < 0) {
+// if the fail_window <= 0 and the max_connection == -1 and there is no
+//  adaptive limit, then no congestion control
+  if (p->max_connection_failures <= 0 && p->max_connection < 0 && p->adaptive_limit <= 0) {
     return ACTION_RESULT_DONE;
   }
   uint64_t key = make_key((char *) data->get_host(), data->get_ip(), p);
   Debug("congestion_control", "Key = %" PRIu64 "", key);
 
-  ProxyMutex *bucket_mutex = theCongestionDB->lock_for_key(key);
-  MUTEX_TRY_LOCK(lock_bucket, bucket_mutex, this_ethread());
-  if (lock_bucket) {
-    theCongestionDB->RunTodoList(theCongestionDB->part_num(key));
-    *ppEntry = theCongestionDB->lookup_entry(key);
-    if (*ppEntry != NULL) {
-      (*ppEntry)->get();
-      Debug("congestion_control", "get_congest_entry, found entry %p done", (void *) *ppEntry);
-      return ACTION_RESULT_DONE;
-    } else {
-      // create a new entry and add it to the congestDB
-      *ppEntry = new CongestionEntry(data->get_host(), data->get_ip(), p, key);
-      (*ppEntry)->get();
-      theCongestionDB->insert_entry(key, *ppEntry);
-      Debug("congestion_control", "get_congest_entry, new entry %p done", (void *) *ppEntry);
-      return ACTION_RESULT_DONE;
-    }
+  CongestionEntry *pEntry = theCongestionDB->lookup_entry(key);
+  if (pEntry == NULL) {
+    // create a new entry and add it to the congestDB
+    CongestionEntry *pNew = new CongestionEntry(data->get_host(), data->get_ip(), p, key);
+    pEntry = theCongestionDB->insert_entry(key, pNew);
+    if (pEntry != pNew)
+      pNew->put();
+    Debug("congestion_control", "get_congest_entry, new entry %p done", (void *) pEntry);
   } else {
-    Debug("congestion_control", "get_congest_entry, trylock failed, schedule cont");
-    CongestionDBCont *Ccont = CongestionDBContAllocator.alloc();
-    Ccont->m_action = cont;
-    Ccont->mutex = cont->mutex;
-    Ccont->CDBC_key = key;
-    Ccont->CDBC_host = (char *) data->get_host();
-    ats_ip_copy(&Ccont->CDBC_ip.sa, data->get_ip());
-    p->get();
-    Ccont->CDBC_rule = p;
-    Ccont->CDBC_ppE = ppEntry;
-
-    SET_CONTINUATION_HANDLER(Ccont, &CongestionDBCont::get_congest_entry);
-    eventProcessor.schedule_in(Ccont, SCHEDULE_CONGEST_CONT_INTERVAL, ET_NET);
-    return &Ccont->m_action;
+    Debug("congestion_control", "get_congest_entry, found entry %p done", (void *) pEntry);
   }
+  // a removed entry is only released after the grace period, it is safe to get() it here
+  pEntry->get();
+  *ppEntry = pEntry;
+  return ACTION_RESULT_DONE;
 }
 
 Action *
 get_congest_list(Continuation * cont, MIOBuffer * buffer, int format)
 {
+  NOWARN_UNUSED(cont);
   if (theCongestionDB == NULL || (congestionControlEnabled != 1 && congestionControlEnabled != 2))
     return ACTION_RESULT_DONE;
+  char buf[1024];
+  int len;
   for (int i = 0; i < theCongestionDB->getSize(); i++) {
-    ProxyMutex *bucket_mutex = theCongestionDB->lock_for_key(i);
-    {
-      MUTEX_TRY_LOCK(lock_bucket, bucket_mutex, this_ethread());
-      if (lock_bucket) {
-        theCongestionDB->RunTodoList(i);
-        char buf[1024];
-        Iter it;
-        int len;
-        CongestionEntry *pEntry = theCongestionDB->first_entry(i, &it);
-        while (pEntry) {
-          if ((pEntry->congested() && pEntry->pRecord->max_connection != 0) || format > 10) {
-            len = pEntry->sprint(buf, 1024, format);
-            buffer->write(buf, len);
-          }
-          pEntry = theCongestionDB->next_entry(i, &it);
-        }
-      } else {
-        /* we did not get the lock, schedule it */
-        CongestionDBCont *CCcont = CongestionDBContAllocator.alloc();
-        CCcont->CDBC_pid = i;
-        CCcont->CDBC_buf = buffer;
-        CCcont->m_action = cont;
-        CCcont->mutex = cont->mutex;
-        CCcont->CDBC_lf = format;
-        SET_CONTINUATION_HANDLER(CCcont, &CongestionDBCont::get_congest_list);
-        eventProcessor.schedule_in(CCcont, SCHEDULE_CONGEST_CONT_INTERVAL, ET_NET);
-        return &CCcont->m_action;
+    CongestionEntry *pEntry = theCongestionDB->first_entry(i);
+    while (pEntry) {
+      if ((pEntry->congested() && pEntry->pRecord->max_connection != 0) || format > 10) {
+        len = pEntry->sprint(buf, 1024, format);
+        buffer->write(buf, len);
       }
+      pEntry = theCongestionDB->next_entry(pEntry);
     }
   }
   return ACTION_RESULT_DONE;
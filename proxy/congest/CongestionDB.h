@@ -29,23 +29,20 @@
  ****************************************************************************/
 
 /*
- * CongestionDB is implemented in a Multithread-Safe hash table
- * the Data will be wrote to a disk file for recovery purpose.
+ * CongestionDB is a hash table of the CongestionEntry, keyed on the
+ * make_key() of the origin server. It is looked up on every connection
+ * to an origin server, so the lookups do not take any lock.
  */
 #ifndef CongestionDB_H_
 #define CongestionDB_H_
 
 #include "P_EventSystem.h"
-#include "MT_hashtable.h"
 #include "ControlMatcher.h"
 
 
 class CongestionControlRecord;
 struct CongestionEntry;
 
-typedef MTHashTable<uint64_t, CongestionEntry *>CongestionTable;
-typedef HashTableIteratorState<uint64_t, CongestionEntry *>Iter;
-
 /* API to the outside world */
 // check whether key was congested, store the found entry into pEntry
 Action *get_congest_entry(Continuation * cont, HttpRequestData * data, CongestionEntry ** ppEntry);
@@ -59,11 +56,11 @@ void initCongestionDB();
 /*
  * CongestRequestParam is the data structure passed to the request
  * to update the congestion db with the appropriate info
- * It is used when the TS missed a try_lock, the request info will be
- * stored in the CongestRequestParam and insert in the to-do list of the
- * approperiate DB partition.
- * The first operation after the TS get the lock for a partition is
- * to run the to do list
+ * It is used when the TS missed a try_lock on the writer lock, the
+ * request info will be stored in the CongestRequestParam and inserted
+ * in the to-do list of the DB.
+ * The first operation after the TS gets the writer lock is to run the
+ * to do list
  */
 
 struct CongestRequestParam
@@ -73,10 +70,10 @@ struct CongestRequestParam
     ADD_RECORD,
     REMOVE_RECORD,
     REMOVE_ALL_RECORDS,
-    REVALIDATE_BUCKET
+    REVALIDATE
   };
 
-    CongestRequestParam():m_key(0), m_op(REVALIDATE_BUCKET), m_pEntry(NULL)
+    CongestRequestParam():m_key(0), m_op(REVALIDATE), m_pEntry(NULL)
   {
   }
 
@@ -91,23 +88,67 @@ struct CongestRequestParam
   LINK(CongestRequestParam, link);
 };
 
-/* struct declaration and definitions */
-class CongestionDB:public CongestionTable
+/*
+ * The buckets are lists linked through CongestionEntry::m_next. A new
+ * entry is pushed on the head of its bucket with a compare and swap,
+ * everything else (removals, the GC, revalidation after a rule change)
+ * is done by one thread at a time under m_lock. Readers walk the lists
+ * without any lock, so a removed entry may still be in use by one of
+ * them: it is kept on the retired list, with the reference of the table,
+ * until CONGESTION_DB_GRACE has passed.
+ *
+ * The number of buckets is fixed, entries beyond it make the lists
+ * longer.
+ */
+class CongestionDB
 {
 public:
   CongestionDB(int tablesize);
    ~CongestionDB();
-  bool congested(uint64_t key);
 
-// add an entry to the db
+  // lock free, the entry is only safe to use until the caller get()s it
+  CongestionEntry *lookup_entry(uint64_t key);
+  // lock free, returns the entry already in the table for key if there is one
+  CongestionEntry *insert_entry(uint64_t key, CongestionEntry * pEntry);
+
+  int getSize()
+  {
+    return m_size;
+  }
+  CongestionEntry *first_entry(int bucket)
+  {
+    return m_buckets[bucket];
+  }
+  CongestionEntry *next_entry(CongestionEntry * pEntry);
+
+// add an entry to the db, replacing the one with the same key
   void addRecord(uint64_t key, CongestionEntry * pEntry);
 // remove an entry from the db
   void removeRecord(uint64_t key);
   void removeAllRecords(void);
-  InkAtomicList *todo_lists;
-  void RunTodoList(int buckId);
-  void process(int buckId, CongestRequestParam * param);
-  void revalidateBucket(int buckId);
+  void revalidate(void);
+  void GC(ink_hrtime t);
+// release the retired entries removed before t
+  void reclaim(ink_hrtime t);
+
+  InkAtomicList todo_list;
+  void RunTodoList();
+  void process(CongestRequestParam * param);
+
+  Ptr<ProxyMutex> m_lock;
+
+private:
+  int bucket_of(uint64_t key)
+  {
+    return (int) (key & (uint64_t) (m_size - 1));
+  }
+  CongestionEntry *remove_entry(uint64_t key);
+  void unlink_entry(int bucket, CongestionEntry * pEntry);
+  void retire(CongestionEntry * pEntry);
+
+  CongestionEntry * volatile *m_buckets;
+  int m_size;
+  CongestionEntry *m_retired;
 };
 
 extern CongestionDB *theCongestionDB;
@@ -39,16 +39,23 @@
 //-------------------------------------------------------------
 /* all of the elements inserted into the HashTable should be in the
  * table and can be easily retrived
- * also exercise the resizing of the table
+ * also exercise the removals and the duplicated inserts
  */
 EXCLUSIVE_REGRESSION_TEST(Congestion_HashTable) (RegressionTest * t, int atype, int *pstatus) {
   NOWARN_UNUSED(atype);
-  MTHashTable<long, long>*htable = new MTHashTable<long, long>(4);
+  CongestionDB *htable = new CongestionDB(1024);
+  CongestionControlRecord *rule = new CongestionControlRecord;
+  rule->pRecord = new CongestionControlRecord(*rule);
   // add elements to the table;
-  long i, count = 1 * 1024 * 1024;
+  long i, count = 256 * 1024;
   rprintf(t, "adding data into the hash table .", count);
   for (i = 1; i <= count; i++) {
-    htable->insert_entry(i, i);
+    CongestionEntry *pEntry = new CongestionEntry("localhost", NULL, rule->pRecord, i);
+    if (htable->insert_entry(i, pEntry) != pEntry) {
+      rprintf(t, "insert failed: key(%d)\n", i);
+      *pstatus = REGRESSION_TEST_FAILED;
+      return;
+    }
     if (i % (count / 50) == 0)
       fprintf(stderr, ".");
   }
@@ -56,21 +63,31 @@ EXCLUSIVE_REGRESSION_TEST(Congestion_HashTable) (RegressionTest * t, int atype,
   rprintf(t, "%d data added into the hash table\n", count);
   rprintf(t, "verifying the content");
   for (i = 1; i <= count; i++) {
-    long data = htable->lookup_entry(i);
+    CongestionEntry *pEntry = htable->lookup_entry(i);
     if (i % (count / 50) == 0)
       fprintf(stderr, ".");
-    if (data != i) {
-      rprintf(t, "verify content failed: key(%d) data(%d)\n", i, data);
+    if (pEntry == NULL || pEntry->m_key != (uint64_t) i) {
+      rprintf(t, "verify content failed: key(%d)\n", i);
       *pstatus = REGRESSION_TEST_FAILED;
       return;
     }
   }
   fprintf(stderr, "done\n");
+
+  rprintf(t, "insert a duplicated key");
+  CongestionEntry *dup = new CongestionEntry("localhost", NULL, rule->pRecord, 1);
+  if (htable->insert_entry(1, dup) != htable->lookup_entry(1) || htable->lookup_entry(1) == dup) {
+    rprintf(t, "duplicated key(1) inserted\n");
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+  dup->put();
+
   long removed_count = 0;
   // delete some data
   rprintf(t, "removing data.");
-  for (i = 1; i < count / 2; i++) {
-    htable->remove_entry(i * 2);
+  for (i = 1; i <= count / 2; i++) {
+    htable->removeRecord(i * 2);
     if (i % (count / 50) == 0)
       fprintf(stderr, ".");
     removed_count++;
@@ -80,14 +97,14 @@ EXCLUSIVE_REGRESSION_TEST(Congestion_HashTable) (RegressionTest * t, int atype,
   rprintf(t, "%d data entries are removed\n", removed_count);
   rprintf(t, "verify the content again");
   for (i = 1; i <= count; i++) {
-    long data = htable->lookup_entry(i);
-    if (i % 2 == 1 && data == 0) {
+    CongestionEntry *pEntry = htable->lookup_entry(i);
+    if (i % 2 == 1 && pEntry == NULL) {
       rprintf(t, "verify content failed: key(%d) deleted\n", i);
       *pstatus = REGRESSION_TEST_FAILED;
       return;
     }
-    if (data != 0 && data != i) {
-      rprintf(t, "verify content failed: key(%d) data(%d)\n", i, data);
+    if (i % 2 == 0 && pEntry != NULL) {
+      rprintf(t, "verify content failed: key(%d) not deleted\n", i);
       *pstatus = REGRESSION_TEST_FAILED;
       return;
     }
@@ -96,71 +113,38 @@ EXCLUSIVE_REGRESSION_TEST(Congestion_HashTable) (RegressionTest * t, int atype,
   }
   fprintf(stderr, "done\n");
 
-  rprintf(t, "use iterator to list all the elements and delete half of them");
-  HashTableIteratorState<long, long>it;
-  int j, new_count = 0;
-  for (j = 0; j < MT_HASHTABLE_PARTITIONS; j++) {
-    int data = htable->first_entry(j, &it);
-    while (data > 0) {
-      new_count++;
-      if (new_count % (count / 25) == 0)
-        fprintf(stderr, ".");
-
-      if (new_count % 2 == 0) {
-        htable->remove_entry(j, &it);
-        data = htable->cur_entry(j, &it);
-        removed_count++;
-      } else
-        data = htable->next_entry(j, &it);
-    }
-  }
-  fprintf(stderr, "done\n");
-
-  rprintf(t, "verify the content once again");
-  new_count = count - removed_count;
-  for (j = 0; j < MT_HASHTABLE_PARTITIONS; j++) {
-    int data = htable->first_entry(j, &it);
-    while (data > 0) {
+  rprintf(t, "use iterator to list all the elements");
+  long new_count = count - removed_count;
+  for (int j = 0; j < htable->getSize(); j++) {
+    CongestionEntry *pEntry = htable->first_entry(j);
+    while (pEntry) {
       new_count--;
-      if (new_count % (count / 25) == 0)
-        fprintf(stderr, ".");
-      data = htable->next_entry(j, &it);
-      if (data != htable->lookup_entry(data)) {
-        rprintf(t, "verify content failed: key(%d) data(%d)\n", data, htable->lookup_entry(data));
+      if (pEntry != htable->lookup_entry(pEntry->m_key)) {
+        rprintf(t, "verify content failed: key(%d)\n", (long) pEntry->m_key);
         *pstatus = REGRESSION_TEST_FAILED;
         return;
       }
+      pEntry = htable->next_entry(pEntry);
     }
   }
-
-  fprintf(stderr, "done\n");
   if (new_count != 0) {
     rprintf(t, "there are %d extra entries in the table\n", new_count);
     *pstatus = REGRESSION_TEST_FAILED;
     return;
   }
 
-  rprintf(t, "remove everything using iterator");
-  new_count = count - removed_count;
-  for (j = 0; j < MT_HASHTABLE_PARTITIONS; j++) {
-    int data = htable->first_entry(j, &it);
-    while (data > 0) {
-      new_count--;
-      if (new_count % (count / 25) == 0)
-        fprintf(stderr, ".");
-      htable->remove_entry(j, &it);
-      data = htable->cur_entry(j, &it);
+  rprintf(t, "remove everything");
+  htable->removeAllRecords();
+  for (int j = 0; j < htable->getSize(); j++) {
+    if (htable->first_entry(j) != NULL) {
+      rprintf(t, "bucket %d is not empty\n", j);
+      *pstatus = REGRESSION_TEST_FAILED;
+      return;
     }
   }
 
-  fprintf(stderr, "done\n");
-  if (new_count != 0) {
-    rprintf(t, "there are %d extra entries in the table\n", new_count);
-    *pstatus = REGRESSION_TEST_FAILED;
-    return;
-  }
-
   delete htable;
+  delete rule;
   *pstatus = REGRESSION_TEST_PASSED;
 }
 
@@ -423,7 +407,7 @@ CCCongestionDBTestCont::init()
 {
 // create/clear db
   if (!db)
-    db = new CongestionDB(dbsize / MT_HASHTABLE_PARTITIONS);
+    db = new CongestionDB(64 * 1024);
   else
     db->removeAllRecords();
   if (!rule) {
@@ -442,18 +426,16 @@ CCCongestionDBTestCont::get_congest_list()
   if (db == NULL)
     return 0;
   for (int i = 0; i < db->getSize(); i++) {
-    db->RunTodoList(i);
     char buf[1024];
-    Iter it;
 
-    CongestionEntry *pEntry = db->first_entry(i, &it);
+    CongestionEntry *pEntry = db->first_entry(i);
     while (pEntry) {
       cnt++;
       if (cnt % 100 == 0) {
         pEntry->sprint(buf, 1024, 100);
         fprintf(stderr, "%s", buf);
       }
-      pEntry = db->next_entry(i, &it);
+      pEntry = db->next_entry(pEntry);
     }
   }
   return cnt;
@@ -485,6 +467,7 @@ CCCongestionDBTestCont::mainEvent(int event, Event * e)
   items[0] = get_congest_list();
 
   db->removeAllRecords();
+  db->reclaim(HRTIME_FOREVER);
 
   rprintf(test, "There are %d records in the db\n", items[0]);
 
@@ -503,6 +486,7 @@ CCCongestionDBTestCont::mainEvent(int event, Event * e)
   items[1] = get_congest_list();
 
   db->removeAllRecords();
+  db->reclaim(HRTIME_FOREVER);
 
   rprintf(test, "There are %d records in the db\n", items[1]);
 
@@ -522,6 +506,7 @@ CCCongestionDBTestCont::mainEvent(int event, Event * e)
   rprintf(test, "There are %d records in the db\n", items[2]);
 
   db->removeAllRecords();
+  db->reclaim(HRTIME_FOREVER);
 
   for (i = 0; i < 3; i++) {
     rprintf(test, "After test [%d] there are %d records in the db\n", i + 1, items[i]);
@@ -543,6 +528,66 @@ EXCLUSIVE_REGRESSION_TEST(Congestion_CongestionDB) (RegressionTest * t, int atyp
   *pstatus = REGRESSION_TEST_INPROGRESS;
 }
 
+//-------------------------------------------------------------
+// Test the adaptive limit
+//-------------------------------------------------------------
+/* the limit grows while the response time stays low, goes down to
+ * the minimum when it does not, at most once per round trip, and
+ * limits the concurrent connections
+ */
+EXCLUSIVE_REGRESSION_TEST(Congestion_AdaptiveLimit) (RegressionTest * t, int atype, int *pstatus) {
+  NOWARN_UNUSED(atype);
+  CongestionControlRecord *rule = new CongestionControlRecord;
+  rule->adaptive_limit = 100;
+  rule->adaptive_tolerance = 200;
+  rule->pRecord = new CongestionControlRecord(*rule);
+  CongestionEntry *pEntry = new CongestionEntry("localhost", NULL, rule->pRecord, 1);
+  int i, limit;
+
+  *pstatus = REGRESSION_TEST_PASSED;
+  // keep the limit in use, so that it may grow
+  pEntry->m_num_connections = 100;
+  for (i = 0; i < 1000; i++)
+    pEntry->response_time(HRTIME_MSECONDS(10));
+  limit = pEntry->conn_limit();
+  rprintf(t, "limit %d after 1000 fast responses\n", limit);
+  if (limit <= CONG_ADAPTIVE_INITIAL_LIMIT || limit > rule->adaptive_limit) {
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+
+  pEntry->m_last_decrease = 0;
+  for (i = 0; i < 20; i++)
+    pEntry->response_time(HRTIME_MSECONDS(100));
+  rprintf(t, "limit %d after 20 slow responses in one round trip\n", pEntry->conn_limit());
+  if (pEntry->conn_limit() < limit * CONG_ADAPTIVE_BACKOFF - 1 || pEntry->conn_limit() >= limit) {
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+
+  for (i = 0; i < 100; i++) {
+    pEntry->m_last_decrease = 0;
+    pEntry->response_time(HRTIME_MSECONDS(100));
+  }
+  rprintf(t, "limit %d after 100 slow round trips\n", pEntry->conn_limit());
+  if (pEntry->conn_limit() != CONG_ADAPTIVE_MIN_LIMIT) {
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+
+  pEntry->m_num_connections = CONG_ADAPTIVE_MIN_LIMIT - 1;
+  if (pEntry->M_congested(0)) {
+    rprintf(t, "congested under the limit\n");
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+  pEntry->connection_opened();
+  if (!pEntry->M_congested(0)) {
+    rprintf(t, "not congested at the limit\n");
+    *pstatus = REGRESSION_TEST_FAILED;
+  }
+  pEntry->connection_closed();
+
+  pEntry->put();
+  delete rule;
+}
+
 //-------------------------------------------------------------
 // Test the CongestionControl implementation
 //-------------------------------------------------------------
@@ -556,4 +601,5 @@ init_CongestionRegressionTest()
   (void) regressionTest_Congestion_HashTable;
   (void) regressionTest_Congestion_FailHistory;
   (void) regressionTest_Congestion_CongestionDB;
+  (void) regressionTest_Congestion_AdaptiveLimit;
 }
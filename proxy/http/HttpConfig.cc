@@ -25,6 +25,7 @@
 #include <ctype.h>
 #include <string.h>
 #include "HttpConfig.h"
+#include "HttpSessionManager.h"
 #include "HTTP.h"
 #include "ProcessManager.h"
 #include "ProxyConfig.h"
@@ -645,6 +646,27 @@ register_stat_callbacks()
                      "proxy.process.http.cache_hit_stale_served",
                      RECD_COUNTER, RECP_NULL, (int) http_cache_hit_stale_served_stat, RecRawStatSyncCount);
 
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.cache_hit_stale_write_lock",
+                     RECD_COUNTER, RECP_NULL, (int) http_cache_hit_stale_write_lock_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.cache_hit_stale_while_revalidate",
+                     RECD_COUNTER, RECP_NULL, (int) http_cache_hit_stale_while_revalidate_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.cache_hit_stale_if_error",
+                     RECD_COUNTER, RECP_NULL, (int) http_cache_hit_stale_if_error_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.background_revalidations",
+                     RECD_COUNTER, RECP_NULL, (int) http_background_revalidations_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.current_background_revalidations",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) http_current_background_revalidations_stat, RecRawStatSyncSum);
+  HTTP_CLEAR_DYN_STAT(http_current_background_revalidations_stat);
+
   RecRegisterRawStat(http_rsb, RECT_PROCESS,
                      "proxy.process.http.cache_miss_cold",
                      RECD_COUNTER, RECP_NULL, (int) http_cache_miss_cold_stat, RecRawStatSyncCount);
@@ -1108,6 +1130,22 @@ register_stat_callbacks()
                      RECD_COUNTER, RECP_NULL,
                      (int) http_total_x_redirect_stat, RecRawStatSyncCount);
 
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_pool.hits",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_pool_hits_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_pool.misses",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_pool_misses_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_pool.evictions",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_pool_evictions_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_pool.prewarm_opens",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_pool_prewarm_opens_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_pool.prewarm_failures",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_pool_prewarm_failures_stat, RecRawStatSyncCount);
+
 }
 
 
@@ -1150,6 +1188,11 @@ HttpConfig::startup()
   HttpEstablishStaticConfigLongLong(c.oride.server_tcp_init_cwnd, "proxy.config.http.server_tcp_init_cwnd");
   HttpEstablishStaticConfigLongLong(c.oride.origin_max_connections, "proxy.config.http.origin_max_connections");
   HttpEstablishStaticConfigLongLong(c.origin_min_keep_alive_connections, "proxy.config.http.origin_min_keep_alive_connections");
+  HttpEstablishStaticConfigLongLong(c.origin_max_idle_sessions, "proxy.config.http.origin_max_idle_sessions");
+  HttpEstablishStaticConfigByte(c.prewarm_enabled, "proxy.config.http.prewarm.enabled");
+  HttpEstablishStaticConfigLongLong(c.prewarm_interval, "proxy.config.http.prewarm.interval");
+  HttpEstablishStaticConfigLongLong(c.prewarm_max_sessions_per_origin, "proxy.config.http.prewarm.max_sessions_per_origin");
+  HttpEstablishStaticConfigLongLong(c.connect_race_delay, "proxy.config.http.connect_race_delay");
 
   HttpEstablishStaticConfigByte(c.parent_proxy_routing_enable, "proxy.config.http.parent_proxy_routing_enable");
 
@@ -1338,6 +1381,10 @@ HttpConfig::startup()
   HttpEstablishStaticConfigByte(c.negative_revalidating_enabled, "proxy.config.http.negative_revalidating_enabled");
   HttpEstablishStaticConfigLongLong(c.negative_revalidating_lifetime, "proxy.config.http.negative_revalidating_lifetime");
 
+  HttpEstablishStaticConfigByte(c.cache_serve_stale_on_write_lock_fail,
+                                "proxy.config.http.cache.serve_stale_on_write_lock_fail");
+  HttpEstablishStaticConfigByte(c.cache_rfc5861_enabled, "proxy.config.http.cache.rfc5861_enabled");
+
   // Negative response caching
   HttpEstablishStaticConfigByte(c.oride.negative_caching_enabled, "proxy.config.http.negative_caching_enabled");
   HttpEstablishStaticConfigLongLong(c.oride.negative_caching_lifetime, "proxy.config.http.negative_caching_lifetime");
@@ -1436,6 +1483,11 @@ HttpConfig::reconfigure()
     Warning("origin_max_connections < origin_min_keep_alive_connections, setting min=max , please correct your records.config");
     params->origin_min_keep_alive_connections = params->oride.origin_max_connections;
   }
+  params->origin_max_idle_sessions = m_master.origin_max_idle_sessions;
+  params->prewarm_enabled = INT_TO_BOOL(m_master.prewarm_enabled);
+  params->prewarm_interval = m_master.prewarm_interval;
+  params->prewarm_max_sessions_per_origin = m_master.prewarm_max_sessions_per_origin;
+  params->connect_race_delay = m_master.connect_race_delay;
 
   params->parent_proxy_routing_enable = INT_TO_BOOL(m_master.parent_proxy_routing_enable);
   params->enable_url_expandomatic = INT_TO_BOOL(m_master.enable_url_expandomatic);
@@ -1594,6 +1646,9 @@ HttpConfig::reconfigure()
   params->negative_revalidating_enabled = INT_TO_BOOL(m_master.negative_revalidating_enabled);
   params->negative_revalidating_lifetime = m_master.negative_revalidating_lifetime;
 
+  params->cache_serve_stale_on_write_lock_fail = INT_TO_BOOL(m_master.cache_serve_stale_on_write_lock_fail);
+  params->cache_rfc5861_enabled = INT_TO_BOOL(m_master.cache_rfc5861_enabled);
+
   params->oride.negative_caching_enabled = INT_TO_BOOL(m_master.oride.negative_caching_enabled);
   params->oride.negative_caching_lifetime = m_master.oride.negative_caching_lifetime;
 
@@ -1613,6 +1668,9 @@ HttpConfig::reconfigure()
 
   m_id = configProcessor.set(m_id, params);
 
+  if (params->prewarm_enabled)
+    httpSessionManager.start_prewarmer();
+
 #undef INT_TO_BOOL
 
 // Redirection debug statements
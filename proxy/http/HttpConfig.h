@@ -216,6 +216,11 @@ enum
   http_cache_hit_reval_stat,
   http_cache_hit_ims_stat,
   http_cache_hit_stale_served_stat,
+  http_cache_hit_stale_write_lock_stat,
+  http_cache_hit_stale_while_revalidate_stat,
+  http_cache_hit_stale_if_error_stat,
+  http_background_revalidations_stat,
+  http_current_background_revalidations_stat,
   http_cache_miss_cold_stat,
   http_cache_miss_changed_stat,
   http_cache_miss_client_no_cache_stat,
@@ -344,6 +349,13 @@ enum
   http_response_status_505_count_stat,
   http_response_status_5xx_count_stat,
 
+  // Shared origin session pool
+  http_origin_pool_hits_stat,
+  http_origin_pool_misses_stat,
+  http_origin_pool_evictions_stat,
+  http_origin_pool_prewarm_opens_stat,
+  http_origin_pool_prewarm_failures_stat,
+
   http_stat_count
 };
 
@@ -619,6 +631,11 @@ public:
 
   MgmtInt server_max_connections;
   MgmtInt origin_min_keep_alive_connections; // TODO: This one really ought to be overridable, but difficult right now.
+  MgmtInt origin_max_idle_sessions;
+  MgmtByte prewarm_enabled;
+  MgmtInt prewarm_interval;
+  MgmtInt prewarm_max_sessions_per_origin;
+  MgmtInt connect_race_delay;
 
   MgmtByte parent_proxy_routing_enable;
   MgmtByte disable_ssl_parenting;
@@ -747,6 +764,12 @@ public:
   MgmtByte negative_revalidating_enabled;
   MgmtInt negative_revalidating_lifetime;
 
+  // serve the stale copy when another request is already revalidating it
+  MgmtByte cache_serve_stale_on_write_lock_fail;
+
+  // honor the stale-while-revalidate and stale-if-error directives (RFC 5861)
+  MgmtByte cache_rfc5861_enabled;
+
   ///////////////////
   // cop access    //
   ///////////////////
@@ -894,6 +917,11 @@ HttpConfigParams::HttpConfigParams()
     proxy_hostname_len(0),
     server_max_connections(0),
     origin_min_keep_alive_connections(0),
+    origin_max_idle_sessions(0),
+    prewarm_enabled(0),
+    prewarm_interval(1000),
+    prewarm_max_sessions_per_origin(8),
+    connect_race_delay(0),
     parent_proxy_routing_enable(0),
     disable_ssl_parenting(0),
     enable_url_expandomatic(0),
@@ -946,6 +974,8 @@ HttpConfigParams::HttpConfigParams()
     url_remap_required(0),
     negative_revalidating_enabled(0),
     negative_revalidating_lifetime(0),
+    cache_serve_stale_on_write_lock_fail(0),
+    cache_rfc5861_enabled(0),
     record_cop_page(0),
     record_tcp_mem_hit(0),
     errors_log_error_pages(0),
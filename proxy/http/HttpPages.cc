@@ -34,6 +34,7 @@
 #include "HttpPages.h"
 #include "HttpSM.h"
 #include "HttpDebugNames.h"
+#include "HttpSessionManager.h"
 
 HttpSMListBucket HttpSMList[HTTP_LIST_BUCKETS];
 
@@ -55,6 +56,9 @@ HttpPagesHandler::HttpPagesHandler(Continuation * cont, HTTPHdr * header)
     request = arena.str_store(request, length);
     SET_HANDLER(&HttpPagesHandler::handle_smdetails);
 
+  } else if (strncmp(request, "origin_pools", sizeof("origin_pools")) == 0) {
+    SET_HANDLER(&HttpPagesHandler::handle_origin_pools);
+
   } else {
     SET_HANDLER(&HttpPagesHandler::handle_smlist);
   }
@@ -430,6 +434,54 @@ HttpPagesHandler::handle_smlist(int event, void *data)
   return EVENT_DONE;
 }
 
+void
+HttpPagesHandler::dump_origin(OriginCounts *o, int idle, int thread_index, void *data)
+{
+  HttpPagesHandler *self = (HttpPagesHandler *) data;
+  ip_port_text_buffer ipb;
+
+  self->resp_begin_row();
+  self->resp_begin_column();
+  if (thread_index < 0)
+    self->resp_add("global");
+  else
+    self->resp_add("%d", thread_index);
+  self->resp_end_column();
+  self->resp_begin_column();
+  self->resp_add("%s", ats_ip_nptop(&o->addr.sa, ipb, sizeof(ipb)));
+  self->resp_end_column();
+  self->resp_begin_column();
+  self->resp_add("%d", idle);
+  self->resp_end_column();
+  self->resp_begin_column();
+  self->resp_add("%" PRId64, o->hits);
+  self->resp_end_column();
+  self->resp_begin_column();
+  self->resp_add("%" PRId64, o->misses);
+  self->resp_end_column();
+  self->resp_end_row();
+}
+
+// The idle sessions and pool hits / misses of each origin in the session pools.
+int
+HttpPagesHandler::handle_origin_pools(int event, void *edata)
+{
+  NOWARN_UNUSED(event);
+  NOWARN_UNUSED(edata);
+
+  resp_begin("Http:Origin Session Pools");
+  resp_begin_table(1, 5, 60);
+  resp_add("<tr><th>thread</th><th>origin</th><th>idle</th><th>hits</th><th>misses</th></tr>\n");
+  int skipped = httpSessionManager.for_each_origin(&HttpPagesHandler::dump_origin, this, this_ethread());
+  resp_end_table();
+  if (skipped)
+    resp_add("<p>%d busy pools not shown</p>\n", skipped);
+  resp_end();
+  handle_callback(EVENT_NONE, NULL);
+
+  return EVENT_DONE;
+}
+
 int
 HttpPagesHandler::handle_callback(int event, void *edata)
 {
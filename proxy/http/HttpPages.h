@@ -43,6 +43,7 @@
 #include "HttpSM.h"
 
 class HttpSM;
+struct OriginCounts;
 
 const int HTTP_LIST_BUCKETS = 63;
 const int HTTP_LIST_RETRY = HRTIME_MSECONDS(10);
@@ -63,6 +64,7 @@ public:
 
   int handle_smlist(int event, void *edata);
   int handle_smdetails(int event, void *edata);
+  int handle_origin_pools(int event, void *edata);
   int handle_callback(int event, void *edata);
   Action action;
 
@@ -73,6 +75,7 @@ private:
   void dump_tunnel_info(HttpSM * sm);
   void dump_history(HttpSM * sm);
   int dump_sm(HttpSM * sm);
+  static void dump_origin(OriginCounts *o, int idle, int thread_index, void *data);
 
 
   Arena arena;
@@ -317,7 +317,7 @@ HttpSM::HttpSM()
     history_pos(0), tunnel(), ua_entry(NULL),
     ua_session(NULL), background_fill(BACKGROUND_FILL_NONE),
     ua_raw_buffer_reader(NULL),
-    server_entry(NULL), server_session(NULL), shared_session_retries(0),
+    server_entry(NULL), server_session(NULL), shared_session_retries(0), server_connect_raced(false),
     server_buffer_reader(NULL),
     transform_info(), post_transform_info(), second_cache_sm(NULL),
     default_handler(NULL), pending_action(NULL), historical_action(NULL),
@@ -1664,6 +1664,11 @@ HttpSM::state_http_server_open(int event, void *data)
        UnixNetVConnection *server_vc = (UnixNetVConnection*)data;
        printf("client fd is :%d , server fd is %d\n",vc->con.fd,
        server_vc->con.fd); */
+    // A raced connect may have been won by the other address family.
+    if (server_connect_raced) {
+      server_connect_raced = false;
+      ats_ip_copy(&t_state.current.server->addr, ((NetVConnection *) data)->get_remote_addr());
+    }
     ats_ip_copy(&session->server_ip, &t_state.current.server->addr);
     session->new_connection((NetVConnection *) data);
     ats_ip_port_cast(&session->server_ip) = htons(t_state.current.server->port);
@@ -1685,6 +1690,7 @@ HttpSM::state_http_server_open(int event, void *data)
     break;
   case VC_EVENT_ERROR:
   case NET_EVENT_OPEN_FAILED:
+    server_connect_raced = false;
     t_state.current.state = HttpTransact::CONNECTION_ERROR;
     call_transact_and_set_next_state(HttpTransact::HandleResponse);
     return 0;
@@ -1852,6 +1858,11 @@ HttpSM::state_read_server_response_header(int event, void *data)
        }
      */
 
+    // the sample of the adaptive limit of the origin server
+    if (t_state.pCongestionEntry != NULL && milestones.server_begin_write != 0) {
+      t_state.pCongestionEntry->response_time(milestones.server_read_header_done - milestones.server_begin_write);
+    }
+
     t_state.current.state = HttpTransact::CONNECTION_ALIVE;
     t_state.transact_return_point = HttpTransact::HandleResponse;
     t_state.api_next_action = HttpTransact::HTTP_API_READ_REPONSE_HDR;
@@ -4581,6 +4592,34 @@ HttpSM::do_http_server_open(bool raw)
   }
 
   if (t_state.scheme == URL_WKSIDX_HTTPS) {
+    // Resume the SSL session of the last connection to this origin, keyed like the server session pool.
+    INK_MD5 name_hash;
+    ink_code_MMH((unsigned char *) t_state.current.server->name, strlen(t_state.current.server->name), (unsigned char *) &name_hash);
+    opt.origin_name_hash = name_hash.fold();
+  }
+
+  IpEndpoint alternate;
+
+  // Race a connection to the other address family of the origin if HostDB has it (RFC 6555).
+  if (t_state.method != HTTP_WKSIDX_CONNECT && t_state.http_config_param->connect_race_delay > 0 &&
+      t_state.current.server == &t_state.server_info && !t_state.api_server_addr_set &&
+      !t_state.dns_info.srv_lookup_success && opt.addr_binding == NetVCOptions::ANY_ADDR &&
+      t_state.dns_info.lookup_name &&
+      hostDBProcessor.getbyname_alternate(t_state.dns_info.lookup_name, 0, &t_state.current.server->addr.sa, alternate)) {
+    NetProcessor *processor = &netProcessor;
+
+    // A TLS attempt wins once its handshake is done.
+    if (t_state.scheme == URL_WKSIDX_HTTPS)
+      processor = &sslNetProcessor;
+    alternate.port() = t_state.current.server->addr.port();
+    server_connect_raced = true;
+    DebugSM("http", "calling connect_race");
+    connect_action_handle = processor->connect_race(this,     // state machine
+                                                    &t_state.current.server->addr.sa,  // addr + port
+                                                    &alternate.sa,
+                                                    HRTIME_MSECONDS(t_state.http_config_param->connect_race_delay),
+                                                    t_state.txn_conf->connect_attempts_timeout, &opt);
+  } else if (t_state.scheme == URL_WKSIDX_HTTPS) {
     DebugSM("http", "calling sslNetProcessor.connect_re");
     connect_action_handle = sslNetProcessor.connect_re(this,    // state machine
                                                        &t_state.current.server->addr.sa,    // addr + port
@@ -5608,7 +5647,7 @@ HttpSM::setup_cache_read_transfer()
   ink_assert(cache_sm.cache_read_vc != NULL);
 
   doc_size = t_state.cache_info.object_read->object_size_get();
-  alloc_index = buffer_size_to_index(doc_size + HTTP_HEADER_BUFFER_SIZE);
+  alloc_index = tunnel_buffer_size_to_index(doc_size + HTTP_HEADER_BUFFER_SIZE);
 
 #ifndef USE_NEW_EMPTY_MIOBUFFER
   MIOBuffer *buf = new_MIOBuffer(alloc_index);
@@ -5661,7 +5700,7 @@ HttpSM::setup_cache_transfer_to_transform()
   cache_response_hdr_bytes = t_state.hdr_info.cache_response.length_get();
 
   doc_size = t_state.cache_info.object_read->object_size_get();
-  alloc_index = buffer_size_to_index(doc_size);
+  alloc_index = tunnel_buffer_size_to_index(doc_size);
   MIOBuffer *buf = new_MIOBuffer(alloc_index);
   IOBufferReader *buf_start = buf->alloc_reader();
 
@@ -5872,7 +5911,7 @@ HttpSM::find_http_resp_buffer_size(int64_t content_length)
 #else
     buf_size = HTTP_HEADER_BUFFER_SIZE + content_length;
 #endif
-    alloc_index = buffer_size_to_index(buf_size);
+    alloc_index = tunnel_buffer_size_to_index(buf_size);
   }
 
   return alloc_index;
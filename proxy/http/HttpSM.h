@@ -317,6 +317,7 @@ protected:
   HttpVCTableEntry *server_entry;
   HttpServerSession *server_session;
   int shared_session_retries;
+  bool server_connect_raced;
   IOBufferReader *server_buffer_reader;
   void remove_server_entry();
 
@@ -37,7 +37,10 @@
 #include "HttpDebugNames.h"
 
 #define FIRST_LEVEL_HASH(x)   ats_ip_hash(x) % HSM_LEVEL1_BUCKETS
-#define SECOND_LEVEL_HASH(x)  ats_ip_hash(x) % HSM_LEVEL2_BUCKETS
+#define ORIGIN_HASH(x)        ats_ip_hash(x) % HSM_ORIGIN_BUCKETS
+
+ClassAllocator<OriginSessions> originSessionsAllocator("originSessionsAllocator");
+ClassAllocator<OriginCounts> originCountsAllocator("originCountsAllocator");
 
 // Initialize a thread to handle HTTP session management
 void
@@ -55,11 +58,153 @@ initialize_thread_for_http_sessions(EThread *thread, int thread_index)
 HttpSessionManager httpSessionManager;
 
 SessionBucket::SessionBucket()
-  : Continuation(NULL)
+  : Continuation(NULL), n_empty_origins(0), n_retired(0)
 {
   SET_HANDLER(&SessionBucket::session_handler);
 }
 
+OriginSessions *
+SessionBucket::find_origin(sockaddr const *addr, INK_MD5 &hostname_hash, bool create)
+{
+  int index = ORIGIN_HASH(addr);
+  OriginSessions *o;
+
+  for (o = origins[index].head; o; o = o->hash_link.next) {
+    if (ats_ip_addr_eq(&o->addr.sa, addr) && ats_ip_port_cast(&o->addr.sa) == ats_ip_port_cast(addr) &&
+        o->hostname_hash == hostname_hash)
+      return o;
+  }
+  if (!create)
+    return NULL;
+
+  o = originSessionsAllocator.alloc();
+  ats_ip_copy(&o->addr.sa, addr);
+  o->hostname_hash = hostname_hash;
+  o->count = 0;
+  o->hits = o->misses = 0;
+  for (OriginCounts *c = retired[index].head; c; c = c->link.next) {
+    if (ats_ip_addr_eq(&c->addr.sa, addr) && ats_ip_port_cast(&c->addr.sa) == ats_ip_port_cast(addr) &&
+        c->hostname_hash == hostname_hash) {
+      o->hits = c->hits;
+      o->misses = c->misses;
+      retired[index].remove(c);
+      retired_lru.remove(c);
+      n_retired--;
+      originCountsAllocator.free(c);
+      break;
+    }
+  }
+  origins[index].push(o);
+  origin_emptied(o);
+  return o;
+}
+
+// The session the NetVConnection of a keep-alive notification belongs to.
+HttpServerSession *
+SessionBucket::find_session(NetVConnection *net_vc)
+{
+  sockaddr const *addr = net_vc->get_remote_addr();
+
+  for (OriginSessions *o = origins[ORIGIN_HASH(addr)].head; o; o = o->hash_link.next) {
+    if (!ats_ip_addr_eq(&o->addr.sa, addr))
+      continue;
+    for (HttpServerSession *s = o->sessions.head; s; s = s->hash_link.next) {
+      if (s->get_netvc() == net_vc)
+        return s;
+    }
+  }
+  return NULL;
+}
+
+HttpServerSession *
+SessionBucket::take_session(OriginSessions *o)
+{
+  HttpServerSession *s = o->sessions.head;
+
+  if (s)
+    remove_session(s);
+  return s;
+}
+
+void
+SessionBucket::add_session(HttpServerSession *s, int64_t max_idle_per_origin)
+{
+  OriginSessions *o = find_origin(&s->server_ip.sa, s->hostname_hash, true);
+
+  if (!o->count) {
+    empty_origins.remove(o);
+    n_empty_origins--;
+  }
+  o->sessions.push(s);
+  o->count++;
+  lru_list.enqueue(s);
+
+  if (max_idle_per_origin > 0 && o->count > max_idle_per_origin) {
+    HttpServerSession *victim = o->sessions.tail;
+    Debug("http_ss", "[%" PRId64 "] [session_bucket] closing idle session, origin has %d idle sessions",
+          victim->con_id, o->count);
+    remove_session(victim);
+    victim->do_io_close();
+    ProxyMutex *mutex = this_ethread()->mutex;
+    HTTP_INCREMENT_DYN_STAT(http_origin_pool_evictions_stat);
+  }
+}
+
+void
+SessionBucket::remove_session(HttpServerSession *s)
+{
+  OriginSessions *o = find_origin(&s->server_ip.sa, s->hostname_hash, false);
+
+  ink_assert(o && o->count > 0);
+  lru_list.remove(s);
+  o->sessions.remove(s);
+  if (!--o->count)
+    origin_emptied(o);
+}
+
+// Keep the records of the most recently emptied origins around, free the oldest.
+void
+SessionBucket::origin_emptied(OriginSessions *o)
+{
+  empty_origins.enqueue(o);
+  n_empty_origins++;
+  while (n_empty_origins > HSM_MAX_EMPTY_ORIGINS) {
+    OriginSessions *e = empty_origins.dequeue();
+    n_empty_origins--;
+    origins[ORIGIN_HASH(&e->addr.sa)].remove(e);
+    retire_counts(e);
+    originSessionsAllocator.free(e);
+  }
+}
+
+// Keep the counts of a freed origin record, drop the least recently retired.
+void
+SessionBucket::retire_counts(OriginSessions *o)
+{
+  if (!o->hits && !o->misses)
+    return;
+
+  OriginCounts *c = originCountsAllocator.alloc();
+  ats_ip_copy(&c->addr.sa, &o->addr.sa);
+  c->hostname_hash = o->hostname_hash;
+  c->hits = o->hits;
+  c->misses = o->misses;
+  retired[ORIGIN_HASH(&c->addr.sa)].push(c);
+  retired_lru.enqueue(c);
+  n_retired++;
+  while (n_retired > HSM_MAX_RETIRED_ORIGINS) {
+    OriginCounts *e = retired_lru.dequeue();
+    n_retired--;
+    retired[ORIGIN_HASH(&e->addr.sa)].remove(e);
+    if (is_debug_tag_set("http_ss")) {
+      ip_port_text_buffer ipb;
+      Debug("http_ss", "[session_bucket] origin %s: %" PRId64 " pool hits, %" PRId64 " misses",
+            ats_ip_nptop(&e->addr.sa, ipb, sizeof(ipb)), e->hits, e->misses);
+    }
+    originCountsAllocator.free(e);
+  }
+}
+
 // int SessionBucket::session_handler(int event, void* data)
 //
 //   Called from the NetProcessor to left us know that a
@@ -92,59 +237,43 @@ SessionBucket::session_handler(int event, void *data)
     return 0;
   }
 
-  // Search the 2nd level bucket for appropriate netvc
-  int l2_index = SECOND_LEVEL_HASH(net_vc->get_remote_addr());
-  HttpConfigParams *http_config_params = HttpConfig::acquire();
-  bool found = false;
-
-  ink_assert(l2_index < HSM_LEVEL2_BUCKETS);
-  s = l2_hash[l2_index].head;
-
-  while (s != NULL) {
-    if (s->get_netvc() == net_vc) {
-      // if there was a timeout of some kind on a keep alive connection, and
-      // keeping the connection alive will not keep us above the # of max connections
-      // to the origin and we are below the min number of keep alive connections to this
-      // origin, then reset the timeouts on our end and do not close the connection
-      if ((event == VC_EVENT_INACTIVITY_TIMEOUT || event == VC_EVENT_ACTIVE_TIMEOUT) &&
-          s->state == HSS_KA_SHARED &&
-          s->enable_origin_connection_limiting) {
-        bool connection_count_below_min = s->connection_count->getCount(s->server_ip) <= http_config_params->origin_min_keep_alive_connections;
-
-        if (connection_count_below_min) {
-          Debug("http_ss", "[%" PRId64 "] [session_bucket] session received io notice [%s], "
-                "reseting timeout to maintain minimum number of connections", s->con_id,
-                HttpDebugNames::get_event_name(event));
-          s->get_netvc()->set_inactivity_timeout(s->get_netvc()->get_inactivity_timeout());
-          s->get_netvc()->set_active_timeout(s->get_netvc()->get_active_timeout());
-          found = true;
-          break;
-        }
-      }
+  s = find_session(net_vc);
+  if (s == NULL) {
+    // We failed to find our session.  This can only be the result
+    //  of a programming flaw
+    Warning("Connection leak from http keep-alive system");
+    ink_assert(0);
+    return 0;
+  }
 
-      // We've found our server session. Remove it from
-      //   our lists and close it down
-      Debug("http_ss", "[%" PRId64 "] [session_bucket] session received io notice [%s]",
-            s->con_id, HttpDebugNames::get_event_name(event));
-      ink_assert(s->state == HSS_KA_SHARED);
-      lru_list.remove(s);
-      l2_hash[l2_index].remove(s);
-      s->do_io_close();
-      found = true;
-      break;
-    } else {
-      s = s->hash_link.next;
+  // if there was a timeout of some kind on a keep alive connection, and
+  // keeping the connection alive will not keep us above the # of max connections
+  // to the origin and we are below the min number of keep alive connections to this
+  // origin, then reset the timeouts on our end and do not close the connection
+  if ((event == VC_EVENT_INACTIVITY_TIMEOUT || event == VC_EVENT_ACTIVE_TIMEOUT) &&
+      s->state == HSS_KA_SHARED &&
+      s->enable_origin_connection_limiting) {
+    HttpConfigParams *http_config_params = HttpConfig::acquire();
+    bool connection_count_below_min = s->connection_count->getCount(s->server_ip) <= http_config_params->origin_min_keep_alive_connections;
+    HttpConfig::release(http_config_params);
+
+    if (connection_count_below_min) {
+      Debug("http_ss", "[%" PRId64 "] [session_bucket] session received io notice [%s], "
+            "reseting timeout to maintain minimum number of connections", s->con_id,
+            HttpDebugNames::get_event_name(event));
+      s->get_netvc()->set_inactivity_timeout(s->get_netvc()->get_inactivity_timeout());
+      s->get_netvc()->set_active_timeout(s->get_netvc()->get_active_timeout());
+      return 0;
     }
   }
 
-  HttpConfig::release(http_config_params);
-  if (found)
-    return 0;
-
-  // We failed to find our session.  This can only be the result
-  //  of a programming flaw
-  Warning("Connection leak from http keep-alive system");
-  ink_assert(0);
+  // We've found our server session. Remove it from
+  //   our lists and close it down
+  Debug("http_ss", "[%" PRId64 "] [session_bucket] session received io notice [%s]",
+        s->con_id, HttpDebugNames::get_event_name(event));
+  ink_assert(s->state == HSS_KA_SHARED);
+  remove_session(s);
+  s->do_io_close();
   return 0;
 }
 
@@ -156,6 +285,258 @@ HttpSessionManager::init()
   for (int i = 0; i < HSM_LEVEL1_BUCKETS; i++) {
     g_l1_hash[i].mutex = new_ProxyMutex();
   }
+
+  prewarmer = NEW(new SessionPrewarmer);
+  HttpConfigParams *params = HttpConfig::acquire();
+  if (params->prewarm_enabled)
+    prewarmer->start();
+  HttpConfig::release(params);
+}
+
+// Called when proxy.config.http.prewarm.enabled is turned on.
+void
+HttpSessionManager::start_prewarmer()
+{
+  if (prewarmer)
+    prewarmer->start();
+}
+
+// The number of idle sessions to an origin in the pools, -1 if a pool
+// could not be locked.
+int
+HttpSessionManager::idle_sessions(sockaddr const *addr, INK_MD5 &hostname_hash, int share_session, EThread *ethread)
+{
+  int l1_index = FIRST_LEVEL_HASH(addr);
+  int count = 0;
+
+  if (2 != share_session) {
+    SessionBucket *bucket = g_l1_hash + l1_index;
+    MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+    if (!lock)
+      return -1;
+    OriginSessions *o = bucket->find_origin(addr, hostname_hash, false);
+    return o ? o->count : 0;
+  }
+
+  for (int i = 0; i < eventProcessor.n_threads_for_type[ET_NET]; i++) {
+    EThread *t = eventProcessor.eventthread[ET_NET][i];
+    if (!t->l1_hash)
+      continue;
+    SessionBucket *bucket = t->l1_hash + l1_index;
+    MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+    if (!lock)
+      return -1;
+    OriginSessions *o = bucket->find_origin(addr, hostname_hash, false);
+    if (o)
+      count += o->count;
+  }
+  return count;
+}
+
+#define PREWARM_AVG_WEIGHT    4       // new demand counts for 1/4 of the average
+#define PREWARM_MIN_DEMAND    0.1
+
+// Opens one connection for the prewarmer and hands the session to the pools.
+struct PrewarmConnect: public Continuation
+{
+  PrewarmOrigin *origin;
+  bool limit_connections;
+  MgmtInt keep_alive_timeout;
+
+  int handle_connect(int event, void *data)
+  {
+    HttpServerSession *s;
+
+    switch (event) {
+    case NET_EVENT_OPEN:
+      s = (2 == origin->share_session) ?
+        THREAD_ALLOC_INIT(httpServerSessionAllocator, this_ethread()) :
+        httpServerSessionAllocator.alloc();
+      s->share_session = origin->share_session;
+      s->enable_origin_connection_limiting = limit_connections;
+      ats_ip_copy(&s->server_ip, &origin->addr);
+      s->new_connection((NetVConnection *) data);
+      s->hostname_hash = origin->hostname_hash;
+      s->host_hash_computed = true;
+      s->get_netvc()->set_inactivity_timeout(HRTIME_SECONDS(keep_alive_timeout));
+      Debug("http_ss", "[%" PRId64 "] [prewarm] session opened", s->con_id);
+      HTTP_INCREMENT_DYN_STAT(http_origin_pool_prewarm_opens_stat);
+      s->release();
+      break;
+    case NET_EVENT_OPEN_FAILED:
+      HTTP_INCREMENT_DYN_STAT(http_origin_pool_prewarm_failures_stat);
+      break;
+    default:
+      ink_release_assert(0);
+    }
+
+    ink_atomic_increment(&origin->pending, -1);
+    mutex.clear();
+    delete this;
+    return 0;
+  }
+
+  PrewarmConnect(PrewarmOrigin *o, HttpConfigParams *params)
+    : Continuation(new_ProxyMutex()), origin(o),
+      limit_connections(params->oride.origin_max_connections > 0 || params->origin_min_keep_alive_connections > 0),
+      keep_alive_timeout(params->oride.keep_alive_no_activity_timeout_out)
+  {
+    SET_HANDLER(&PrewarmConnect::handle_connect);
+  }
+};
+
+SessionPrewarmer::SessionPrewarmer()
+  : Continuation(new_ProxyMutex()), n_origins(0), scheduled(0)
+{
+  SET_HANDLER(&SessionPrewarmer::tick);
+}
+
+void
+SessionPrewarmer::start()
+{
+  if (ink_atomic_cas(&scheduled, 0, 1))
+    eventProcessor.schedule_imm(this, ET_CALL);
+}
+
+void
+SessionPrewarmer::note_demand(sockaddr const *addr, INK_MD5 &hostname_hash, int share_session, bool tls,
+                              EThread *ethread)
+{
+  MUTEX_TRY_LOCK(lock, mutex, ethread);
+  if (!lock)
+    return;
+
+  DList(PrewarmOrigin, link) &chain = origins[ORIGIN_HASH(addr)];
+  PrewarmOrigin *o;
+
+  for (o = chain.head; o; o = o->link.next) {
+    if (ats_ip_addr_eq(&o->addr.sa, addr) && ats_ip_port_cast(&o->addr.sa) == ats_ip_port_cast(addr) &&
+        o->hostname_hash == hostname_hash && o->tls == tls)
+      break;
+  }
+  if (!o) {
+    if (n_origins >= HSM_MAX_PREWARM_ORIGINS)
+      return;
+    o = NEW(new PrewarmOrigin);
+    ats_ip_copy(&o->addr.sa, addr);
+    o->hostname_hash = hostname_hash;
+    o->tls = tls;
+    o->demand = 0;
+    o->avg = 0;
+    o->pending = 0;
+    chain.push(o);
+    n_origins++;
+  }
+  o->share_session = share_session;
+  o->demand++;
+  // Demand is only noted while enabled, catch a tick that stopped racing the enable.
+  if (!scheduled)
+    start();
+}
+
+void
+SessionPrewarmer::open_session(PrewarmOrigin *o, HttpConfigParams *params)
+{
+  PrewarmConnect *c = NEW(new PrewarmConnect(o, params));
+  NetVCOptions opt;
+
+  opt.f_blocking_connect = false;
+  opt.set_sock_param(params->oride.sock_recv_buffer_size_out,
+                     params->oride.sock_send_buffer_size_out,
+                     params->oride.sock_option_flag_out,
+                     params->oride.sock_packet_mark_out,
+                     params->oride.sock_packet_tos_out);
+  opt.ip_family = o->addr.sa.sa_family;
+
+  opt.origin_name_hash = o->hostname_hash.fold();
+
+  ink_atomic_increment(&o->pending, 1);
+  if (o->tls)
+    sslNetProcessor.connect_re(c, &o->addr.sa, &opt);
+  else
+    netProcessor.connect_re(c, &o->addr.sa, &opt);
+}
+
+int
+SessionPrewarmer::tick(int event, void *data)
+{
+  NOWARN_UNUSED(event);
+  NOWARN_UNUSED(data);
+  HttpConfigParams *params = HttpConfig::acquire();
+  EThread *ethread = this_ethread();
+  ConnectionCount *connections = ConnectionCount::getInstance();
+
+  for (int i = 0; i < HSM_ORIGIN_BUCKETS; i++) {
+    PrewarmOrigin *next;
+    for (PrewarmOrigin *o = origins[i].head; o; o = next) {
+      next = o->link.next;
+
+      o->avg += (o->demand - o->avg) / PREWARM_AVG_WEIGHT;
+      o->demand = 0;
+      if (o->avg < PREWARM_MIN_DEMAND && !o->pending) {
+        origins[i].remove(o);
+        n_origins--;
+        delete o;
+        continue;
+      }
+      if (!params->prewarm_enabled)
+        continue;
+
+      int target = (int) ceil(o->avg);
+      if (target > params->prewarm_max_sessions_per_origin)
+        target = params->prewarm_max_sessions_per_origin;
+      int idle = httpSessionManager.idle_sessions(&o->addr.sa, o->hostname_hash, o->share_session, ethread);
+      if (idle < 0)
+        continue;
+
+      for (int n = target - idle - o->pending; n > 0; n--) {
+        if (params->oride.origin_max_connections > 0 &&
+            connections->getCount(o->addr) + o->pending >= params->oride.origin_max_connections)
+          break;
+        open_session(o, params);
+      }
+    }
+  }
+
+  if (params->prewarm_enabled || n_origins)
+    eventProcessor.schedule_in(this, HRTIME_MSECONDS(params->prewarm_interval), ET_CALL);
+  else
+    scheduled = 0;
+  HttpConfig::release(params);
+  return EVENT_DONE;
+}
+
+// Calls @a f on the origin records and the retired origin counts of every
+// pool that can be locked, thread_index is -1 for the global pool. Returns
+// the pools skipped.
+int
+HttpSessionManager::for_each_origin(OriginSessionsFunc f, void *data, EThread *ethread)
+{
+  int skipped = 0;
+
+  for (int t = -1; t < eventProcessor.n_threads_for_type[ET_NET]; t++) {
+    SessionBucket *buckets = g_l1_hash;
+
+    if (t >= 0) {
+      buckets = eventProcessor.eventthread[ET_NET][t]->l1_hash;
+      if (!buckets)
+        continue;
+    }
+    for (int i = 0; i < HSM_LEVEL1_BUCKETS; i++) {
+      MUTEX_TRY_LOCK(lock, buckets[i].mutex, ethread);
+      if (!lock) {
+        skipped++;
+        continue;
+      }
+      for (int j = 0; j < HSM_ORIGIN_BUCKETS; j++) {
+        for (OriginSessions *o = buckets[i].origins[j].head; o; o = o->hash_link.next)
+          f(o, o->count, t, data);
+        for (OriginCounts *c = buckets[i].retired[j].head; c; c = c->link.next)
+          f(c, 0, t, data);
+      }
+    }
+  }
+  return skipped;
 }
 
 // TODO: Should this really purge all keep-alive sessions?
@@ -170,9 +551,7 @@ HttpSessionManager::purge_keepalives()
     if (lock) {
       while (b->lru_list.head) {
         HttpServerSession *sess = b->lru_list.head;
-        b->lru_list.remove(sess);
-        int l2_index = SECOND_LEVEL_HASH(&sess->server_ip.sa);
-        b->l2_hash[l2_index].remove(sess);
+        b->remove_session(sess);
         sess->do_io_close();
       }
     } else {
@@ -181,36 +560,26 @@ HttpSessionManager::purge_keepalives()
   }
 }
 
+static HSMresult_t
+_attach_session(HttpServerSession *s, HttpSM *sm, const char *from)
+{
+  s->state = HSS_ACTIVE;
+  Debug("http_ss", "[%" PRId64 "] [acquire session] " "return session from %s", s->con_id, from);
+  sm->attach_server_session(s);
+  return HSM_DONE;
+}
+
 HSMresult_t
 _acquire_session(SessionBucket *bucket, sockaddr const* ip, INK_MD5 &hostname_hash, HttpSM *sm)
 {
-  HttpServerSession *b;
-  HttpServerSession *to_return = NULL;
-  int l2_index = SECOND_LEVEL_HASH(ip);
-
-  ink_assert(l2_index < HSM_LEVEL2_BUCKETS);
-
-  // Check to see if an appropriate connection is in
-  //  the 2nd level bucket
-  b = bucket->l2_hash[l2_index].head;
-  while (b != NULL) {
-    if (ats_ip_addr_eq(&b->server_ip.sa, ip) &&
-      ats_ip_port_cast(ip) == ats_ip_port_cast(&b->server_ip)
-    ) {
-      if (hostname_hash == b->hostname_hash) {
-        bucket->lru_list.remove(b);
-        bucket->l2_hash[l2_index].remove(b);
-        b->state = HSS_ACTIVE;
-        to_return = b;
-        Debug("http_ss", "[%" PRId64 "] [acquire session] " "return session from shared pool", to_return->con_id);
-        sm->attach_server_session(to_return);
-        return HSM_DONE;
-      }
-    }
+  OriginSessions *o = bucket->find_origin(ip, hostname_hash, true);
+  HttpServerSession *s = bucket->take_session(o);
 
-    b = b->hash_link.next;
+  if (s) {
+    o->hits++;
+    return _attach_session(s, sm, "shared pool");
   }
-
+  o->misses++;
   return HSM_NOT_FOUND;
 }
 
@@ -266,6 +635,9 @@ HttpSessionManager::acquire_session(Continuation *cont, sockaddr const* ip,
   //  shared connection pool
   int l1_index = FIRST_LEVEL_HASH(ip);
   EThread *ethread = this_ethread();
+  ProxyMutex *mutex = ethread->mutex;
+  SessionBucket *bucket;
+  HSMresult_t result;
 
   ink_assert(l1_index < HSM_LEVEL1_BUCKETS);
 
@@ -275,19 +647,29 @@ HttpSessionManager::acquire_session(Continuation *cont, sockaddr const* ip,
 
   if (2 == sm->t_state.txn_conf->share_server_sessions) {
     ink_assert(ethread->l1_hash);
-    return _acquire_session(ethread->l1_hash + l1_index, ip, hostname_hash, sm);
+    bucket = ethread->l1_hash + l1_index;
   } else {
-    SessionBucket *bucket = g_l1_hash + l1_index;
+    bucket = g_l1_hash + l1_index;
+  }
 
-    MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
-    if (lock) {
-      return _acquire_session(bucket, ip, hostname_hash, sm);
-    } else {
-      Debug("http_ss", "[acquire session] could not acquire session due to lock contention");
-    }
+  MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+  if (!lock) {
+    Debug("http_ss", "[acquire session] could not acquire session due to lock contention");
+    return HSM_RETRY;
   }
 
-  return HSM_RETRY;
+  if (sm->t_state.http_config_param->prewarm_enabled)
+    prewarmer->note_demand(ip, hostname_hash, sm->t_state.txn_conf->share_server_sessions,
+                           sm->t_state.scheme == URL_WKSIDX_HTTPS, ethread);
+
+  result = _acquire_session(bucket, ip, hostname_hash, sm);
+  if (result == HSM_DONE) {
+    HTTP_INCREMENT_DYN_STAT(http_origin_pool_hits_stat);
+    return result;
+  }
+
+  HTTP_INCREMENT_DYN_STAT(http_origin_pool_misses_stat);
+  return HSM_NOT_FOUND;
 }
 
 HSMresult_t
@@ -311,14 +693,12 @@ HttpSessionManager::release_session(HttpServerSession *to_release)
 
   MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
   if (lock) {
-    int l2_index = SECOND_LEVEL_HASH(&to_release->server_ip.sa);
-
-    ink_assert(l2_index < HSM_LEVEL2_BUCKETS);
+    HttpConfigParams *http_config_params = HttpConfig::acquire();
 
     // First insert the session on to our lists
-    bucket->lru_list.enqueue(to_release);
-    bucket->l2_hash[l2_index].push(to_release);
     to_release->state = HSS_KA_SHARED;
+    bucket->add_session(to_release, http_config_params->origin_max_idle_sessions);
+    HttpConfig::release(http_config_params);
 
     // Now we need to issue a read on the connection to detect
     //  if it closes on us.  We will get called back in the
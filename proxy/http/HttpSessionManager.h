@@ -39,34 +39,148 @@
 
 class HttpClientSession;
 class HttpSM;
+struct HttpConfigParams;
 
 void
 initialize_thread_for_http_sessions(EThread *thread, int thread_index);
 
 #ifndef TS_MICRO
 #define  HSM_LEVEL1_BUCKETS   127
-#define  HSM_LEVEL2_BUCKETS   63
+#define  HSM_ORIGIN_BUCKETS   63
+#define  HSM_MAX_EMPTY_ORIGINS 64
+#define  HSM_MAX_RETIRED_ORIGINS 128
+#define  HSM_MAX_PREWARM_ORIGINS 256
 #else
 #define  HSM_LEVEL1_BUCKETS   7
-#define  HSM_LEVEL2_BUCKETS   3
+#define  HSM_ORIGIN_BUCKETS   3
+#define  HSM_MAX_EMPTY_ORIGINS 4
+#define  HSM_MAX_RETIRED_ORIGINS 8
+#define  HSM_MAX_PREWARM_ORIGINS 16
 #endif
 
+/**
+  The pool hit / miss counts of one origin, keyed on (IP, port, hostname).
+
+  When the session record of an origin is freed its counts are kept on
+  their own (up to HSM_MAX_RETIRED_ORIGINS per bucket, least recently
+  retired dropped first) and handed back if the origin is pooled again.
+
+*/
+struct OriginCounts
+{
+  IpEndpoint addr;
+  INK_MD5 hostname_hash;
+  int64_t hits;
+  int64_t misses;
+  LINK(OriginCounts, link);
+  LINK(OriginCounts, retired_link);
+};
+
+/**
+  The idle sessions to one origin.
+
+  Sessions are kept most recently released first, so acquiring hands
+  out the warmest connection and the per origin idle limit closes the
+  least recently used one. The record outlives its last session for a
+  while (up to HSM_MAX_EMPTY_ORIGINS per bucket) before it is freed and
+  only its counts are kept. Both are listed on the http/origin_pools
+  stat page.
+
+*/
+struct OriginSessions: public OriginCounts
+{
+  int count;
+  Que(HttpServerSession, hash_link) sessions;
+  LINK(OriginSessions, hash_link);
+  LINK(OriginSessions, empty_link);
+};
+
 class SessionBucket: public Continuation
 {
 public:
   SessionBucket();
   int session_handler(int event, void *data);
+
+  OriginSessions *find_origin(sockaddr const *addr, INK_MD5 &hostname_hash, bool create);
+  HttpServerSession *find_session(NetVConnection *net_vc);
+  HttpServerSession *take_session(OriginSessions *o);
+  void add_session(HttpServerSession *s, int64_t max_idle_per_origin);
+  void remove_session(HttpServerSession *s);
+
   Que(HttpServerSession, lru_link) lru_list;
-  DList(HttpServerSession, hash_link) l2_hash[HSM_LEVEL2_BUCKETS];
+  DList(OriginSessions, hash_link) origins[HSM_ORIGIN_BUCKETS];
+
+  DList(OriginCounts, link) retired[HSM_ORIGIN_BUCKETS];
+
+private:
+  void origin_emptied(OriginSessions *o);
+  void retire_counts(OriginSessions *o);
+
+  Que(OriginSessions, empty_link) empty_origins;
+  int n_empty_origins;
+  Que(OriginCounts, retired_link) retired_lru;
+  int n_retired;
 };
 
 enum HSMresult_t
 { HSM_DONE, HSM_RETRY, HSM_NOT_FOUND };
 
+typedef void (*OriginSessionsFunc) (OriginCounts *o, int idle, int thread_index, void *data);
+
+/**
+  An origin the session pools are kept warm for.
+
+  demand counts the pool lookups for the origin since the last tick
+  and avg is its moving average, which is the number of idle sessions
+  the prewarmer keeps open. pending counts the connects in flight, it
+  is decremented by the connect callbacks without holding the lock.
+
+*/
+struct PrewarmOrigin
+{
+  IpEndpoint addr;
+  INK_MD5 hostname_hash;
+  int share_session;
+  bool tls;
+  int demand;
+  double avg;
+  volatile int pending;
+  LINK(PrewarmOrigin, link);
+};
+
+/**
+  Keeps idle sessions open to the origins that are in demand.
+
+  Origins are learned from the pool lookups of the state machines, every
+  proxy.config.http.prewarm.interval the idle sessions to each of them
+  are counted and topped up to the moving average of its demand with
+  asynchronous connects. The connections are released into the same
+  pools the state machines acquire from. The tick only runs while the
+  prewarmer is enabled or still has origins to let go of, start() sets
+  it going again.
+
+*/
+class SessionPrewarmer: public Continuation
+{
+public:
+  SessionPrewarmer();
+  void note_demand(sockaddr const *addr, INK_MD5 &hostname_hash, int share_session, bool tls, EThread *ethread);
+  int tick(int event, void *data);
+  void start();
+
+private:
+  void open_session(PrewarmOrigin *o, HttpConfigParams *params);
+
+  DList(PrewarmOrigin, link) origins[HSM_ORIGIN_BUCKETS];
+  int n_origins;
+  volatile int scheduled;
+};
+
 class HttpSessionManager
 {
 public:
   HttpSessionManager()
+    : prewarmer(NULL)
     { }
 
   ~HttpSessionManager()
@@ -76,6 +190,9 @@ public:
                               sockaddr const* addr,
                               const char *hostname, HttpClientSession *ua_session, HttpSM *sm);
   HSMresult_t release_session(HttpServerSession *to_release);
+  int idle_sessions(sockaddr const *addr, INK_MD5 &hostname_hash, int share_session, EThread *ethread);
+  int for_each_origin(OriginSessionsFunc f, void *data, EThread *ethread);
+  void start_prewarmer();
   void purge_keepalives();
   void init();
   int main_handler(int event, void *data);
@@ -83,6 +200,7 @@ public:
 private:
   //    Global l1 hash, used when there is no per-thread buckets
   SessionBucket g_l1_hash[HSM_LEVEL1_BUCKETS];
+  SessionPrewarmer *prewarmer;
 };
 
 extern HttpSessionManager httpSessionManager;
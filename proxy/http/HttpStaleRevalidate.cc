@@ -0,0 +1,232 @@
+/** @file
+
+  Background revalidation of documents served under stale-while-revalidate
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "HttpStaleRevalidate.h"
+#include "HttpSM.h"
+#include "HttpAccept.h"
+#include "PluginVC.h"
+
+extern HttpAccept *plugin_http_accept;
+
+ink_mutex HttpStaleRevalidate::keys_mutex = INK_MUTEX_INIT;
+DLL<HttpStaleRevalidate> HttpStaleRevalidate::keys[STALE_REVALIDATE_BUCKETS];
+
+static int64_t
+write_request(HTTPHdr *h, MIOBuffer *b)
+{
+  int bufindex, dumpoffset = 0, done, tmp;
+
+  do {
+    bufindex = 0;
+    tmp = dumpoffset;
+    IOBufferBlock *block = b->get_current_block();
+    done = h->print(block->start(), block->write_avail(), &bufindex, &tmp);
+    dumpoffset += bufindex;
+    b->fill(bufindex);
+    if (!done)
+      b->add_block();
+  } while (!done);
+
+  return dumpoffset;
+}
+
+HttpStaleRevalidate::HttpStaleRevalidate()
+  : Continuation(new_ProxyMutex()), vc(NULL), req_buffer(NULL), resp_buffer(NULL), resp_reader(NULL),
+    read_vio(NULL), write_vio(NULL)
+{
+  SET_HANDLER(&HttpStaleRevalidate::main_handler);
+}
+
+bool
+HttpStaleRevalidate::add_key(HttpStaleRevalidate *r)
+{
+  DLL<HttpStaleRevalidate> &b = keys[r->key.word(0) % STALE_REVALIDATE_BUCKETS];
+
+  ink_mutex_acquire(&keys_mutex);
+  for (HttpStaleRevalidate *e = b.head; e; e = e->link.next) {
+    if (e->key == r->key) {
+      ink_mutex_release(&keys_mutex);
+      return false;
+    }
+  }
+  b.push(r);
+  ink_mutex_release(&keys_mutex);
+  return true;
+}
+
+void
+HttpStaleRevalidate::remove_key(HttpStaleRevalidate *r)
+{
+  ink_mutex_acquire(&keys_mutex);
+  keys[r->key.word(0) % STALE_REVALIDATE_BUCKETS].remove(r);
+  ink_mutex_release(&keys_mutex);
+}
+
+void
+HttpStaleRevalidate::start(HttpTransact::State *s)
+{
+  if (!plugin_http_accept || s->method != HTTP_WKSIDX_GET || !s->pristine_url.valid())
+    return;
+
+  HttpStaleRevalidate *r = NEW(new HttpStaleRevalidate);
+
+  s->cache_info.lookup_url->MD5_get(&r->key);
+  if (!add_key(r)) {
+    Debug("http_revalidate", "[%" PRId64 "] already being revalidated", s->state_machine->sm_id);
+    delete r;
+    return;
+  }
+
+  // The request as the client sent it, before remap, without anything
+  // that would make the answer depend on this client.
+  HTTPHdr request;
+  request.create(HTTP_TYPE_REQUEST);
+  request.copy(&s->hdr_info.client_request);
+  request.url_set(&s->pristine_url);
+  request.field_delete(MIME_FIELD_IF_MODIFIED_SINCE, MIME_LEN_IF_MODIFIED_SINCE);
+  request.field_delete(MIME_FIELD_IF_UNMODIFIED_SINCE, MIME_LEN_IF_UNMODIFIED_SINCE);
+  request.field_delete(MIME_FIELD_IF_NONE_MATCH, MIME_LEN_IF_NONE_MATCH);
+  request.field_delete(MIME_FIELD_IF_MATCH, MIME_LEN_IF_MATCH);
+  request.field_delete(MIME_FIELD_IF_RANGE, MIME_LEN_IF_RANGE);
+  request.field_delete(MIME_FIELD_RANGE, MIME_LEN_RANGE);
+  request.field_delete(MIME_FIELD_COOKIE, MIME_LEN_COOKIE);
+  request.field_delete(MIME_FIELD_AUTHORIZATION, MIME_LEN_AUTHORIZATION);
+  request.field_delete(MIME_FIELD_PROXY_AUTHORIZATION, MIME_LEN_PROXY_AUTHORIZATION);
+  // The internal session must not linger in keep-alive after the response,
+  // the revalidation is only done when it closes.
+  request.field_delete(MIME_FIELD_PROXY_CONNECTION, MIME_LEN_PROXY_CONNECTION);
+  request.field_delete(MIME_FIELD_KEEP_ALIVE, MIME_LEN_KEEP_ALIVE);
+  request.value_set(MIME_FIELD_CONNECTION, MIME_LEN_CONNECTION, "close", 5);
+
+  MUTEX_LOCK(lock, r->mutex, this_ethread());
+  if (!r->connect(&request)) {
+    request.destroy();
+    r->done();
+    return;
+  }
+  request.destroy();
+  Debug("http_revalidate", "[%" PRId64 "] revalidating in the background", s->state_machine->sm_id);
+}
+
+bool
+HttpStaleRevalidate::connect(HTTPHdr *request)
+{
+  PluginVCCore *core = PluginVCCore::alloc();
+
+  core->set_active_addr(INADDR_LOOPBACK, 0);
+  core->set_accept_cont(plugin_http_accept);
+  vc = core->connect();
+  if (!vc)
+    return false;
+  vc->get_other_side()->set_is_internal_request(true);
+
+  req_buffer = new_MIOBuffer(HTTP_HEADER_BUFFER_SIZE_INDEX);
+  IOBufferReader *req_reader = req_buffer->alloc_reader();
+  int64_t len = write_request(request, req_buffer);
+
+  resp_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_32K);
+  resp_reader = resp_buffer->alloc_reader();
+
+  read_vio = vc->do_io_read(this, INT64_MAX, resp_buffer);
+  write_vio = vc->do_io_write(this, len, req_reader);
+
+  HTTP_INCREMENT_DYN_STAT(http_background_revalidations_stat);
+  HTTP_INCREMENT_DYN_STAT(http_current_background_revalidations_stat);
+  return true;
+}
+
+int
+HttpStaleRevalidate::main_handler(int event, void *data)
+{
+  NOWARN_UNUSED(data);
+
+  switch (event) {
+  case VC_EVENT_READ_READY:
+    // Only the cache update matters, drop the response.
+    resp_reader->consume(resp_reader->read_avail());
+    read_vio->reenable();
+    break;
+  case VC_EVENT_WRITE_READY:
+    write_vio->reenable();
+    break;
+  case VC_EVENT_WRITE_COMPLETE:
+    break;
+  case VC_EVENT_READ_COMPLETE:
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  default:
+    Debug("http_revalidate", "revalidation done, event %d", event);
+    HTTP_DECREMENT_DYN_STAT(http_current_background_revalidations_stat);
+    done();
+    break;
+  }
+  return EVENT_DONE;
+}
+
+void
+HttpStaleRevalidate::done()
+{
+  remove_key(this);
+  if (vc)
+    vc->do_io_close();
+  if (req_buffer)
+    free_MIOBuffer(req_buffer);
+  if (resp_buffer)
+    free_MIOBuffer(resp_buffer);
+  mutex.clear();
+  delete this;
+}
+
+#if TS_HAS_TESTS
+REGRESSION_TEST(HttpStaleRevalidate_dedup) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  static const char *urls[] = { "http://example.com/a", "http://example.com/a", "http://example.com/b" };
+  HttpStaleRevalidate *r[countof(urls)];
+  bool ok = true;
+
+  for (unsigned i = 0; i < countof(urls); i++) {
+    r[i] = NEW(new HttpStaleRevalidate);
+    r[i]->key.encodeBuffer(urls[i], strlen(urls[i]));
+  }
+
+  // One revalidation per URL at a time, a URL is free again when its revalidation is done.
+  if (!HttpStaleRevalidate::add_key(r[0]) || HttpStaleRevalidate::add_key(r[1]) ||
+      !HttpStaleRevalidate::add_key(r[2])) {
+    rprintf(t, "a second revalidation of the same URL was started, or of another URL was not\n");
+    ok = false;
+  }
+  HttpStaleRevalidate::remove_key(r[0]);
+  if (!HttpStaleRevalidate::add_key(r[1])) {
+    rprintf(t, "the URL was still taken after its revalidation was done\n");
+    ok = false;
+  }
+  HttpStaleRevalidate::remove_key(r[1]);
+  HttpStaleRevalidate::remove_key(r[2]);
+
+  for (unsigned i = 0; i < countof(urls); i++)
+    delete r[i];
+  *pstatus = ok ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+}
+#endif
@@ -0,0 +1,81 @@
+/** @file
+
+  Background revalidation of documents served under stale-while-revalidate
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _HTTP_STALE_REVALIDATE_H_
+#define _HTTP_STALE_REVALIDATE_H_
+
+#include "libts.h"
+#include "P_EventSystem.h"
+#include "HttpTransact.h"
+
+#define STALE_REVALIDATE_BUCKETS 256
+
+class PluginVC;
+
+/**
+  Revalidates a document in the background after a client has been
+  served the stale copy.
+
+  The request is sent back into the proxy over a PluginVC, the same way
+  as TSHttpConnect() does, and is marked as internal so it is not itself
+  answered with the stale copy. Its HttpSM revalidates and updates the
+  cache as for any other request, the response is read and dropped.
+
+  There is at most one revalidation per cache key at a time, the others
+  are just served stale until it is done.
+
+*/
+class HttpStaleRevalidate: public Continuation
+{
+public:
+  /// Start revalidating the document of @a s unless it is already being revalidated.
+  static void start(HttpTransact::State *s);
+
+  int main_handler(int event, void *data);
+
+  LINK(HttpStaleRevalidate, link);
+
+private:
+  friend void RegressionTest_HttpStaleRevalidate_dedup(RegressionTest *t, int atype, int *pstatus);
+
+  HttpStaleRevalidate();
+
+  bool connect(HTTPHdr *request);
+  void done();
+
+  static bool add_key(HttpStaleRevalidate *r);
+  static void remove_key(HttpStaleRevalidate *r);
+
+  INK_MD5 key;
+  PluginVC *vc;
+  MIOBuffer *req_buffer;
+  MIOBuffer *resp_buffer;
+  IOBufferReader *resp_reader;
+  VIO *read_vio;
+  VIO *write_vio;
+
+  static ink_mutex keys_mutex;
+  static DLL<HttpStaleRevalidate> keys[STALE_REVALIDATE_BUCKETS];
+};
+
+#endif /* _HTTP_STALE_REVALIDATE_H_ */
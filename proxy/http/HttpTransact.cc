@@ -47,6 +47,7 @@
 #include "HttpClientSession.h"
 #include "I_Machine.h"
 #include "IPAllow.h"
+#include "HttpStaleRevalidate.h"
 
 static const char *URL_MSG = "Unable to process requested URL.\n";
 static char range_type[] = "multipart/byteranges; boundary=RANGE_SEPARATOR";
@@ -72,6 +73,51 @@ extern int cache_config_vary_on_user_agent;
 
 static const char local_host_ip_str[] = "127.0.0.1";
 
+// The value of a directive that starts at @a val, after @a prefix_len
+// characters of name. A missing or non numeric value is taken as no
+// directive at all.
+static inline int
+rfc5861_directive_value(const char *val, int len, int prefix_len)
+{
+  if (len <= prefix_len || !ParseRules::is_digit(val[prefix_len]))
+    return -1;
+  return max(0, mime_parse_int(val + prefix_len, val + len));
+}
+
+// The stale-while-revalidate and stale-if-error extensions (RFC 5861)
+// are not part of the cooked cache-control, which is stored in the
+// cache, so they are parsed from the header when needed. -1 if absent.
+static void
+get_rfc5861_directives(HTTPHdr *response, int *swr, int *sie)
+{
+  MIMEField *field = response->field_find(MIME_FIELD_CACHE_CONTROL, MIME_LEN_CACHE_CONTROL);
+
+  *swr = *sie = -1;
+  if (!field)
+    return;
+
+  HdrCsvIter iter;
+  int len;
+  const char *val = iter.get_first(field, &len);
+
+  while (val) {
+    if (len >= 23 && strncasecmp(val, "stale-while-revalidate=", 23) == 0)
+      *swr = rfc5861_directive_value(val, len, 23);
+    else if (len >= 15 && strncasecmp(val, "stale-if-error=", 15) == 0)
+      *sie = rfc5861_directive_value(val, len, 15);
+    val = iter.get_next(&len);
+  }
+}
+
+// Requests sent back into the proxy, such as the background revalidations.
+inline static bool
+is_internal_request(HttpTransact::State *s)
+{
+  HttpClientSession *ua_session = s->state_machine ? s->state_machine->ua_session : NULL;
+
+  return ua_session && ua_session->get_netvc() && ua_session->get_netvc()->get_is_internal_request();
+}
+
 
 // someday, reduce the amount of duplicate code between this
 // function and _process_xxx_connection_field_in_outgoing_header
@@ -2652,7 +2698,11 @@ HttpTransact::HandleCacheOpenReadHit(State* s)
     SET_VIA_STRING(VIA_CACHE_RESULT, VIA_IN_CACHE_FRESH);
   }
 
-  if (s->cache_lookup_result == CACHE_LOOKUP_HIT_WARNING) {
+  if (s->cache_lookup_result == CACHE_LOOKUP_HIT_WARNING && s->revalidate_in_background) {
+    HTTP_INCREMENT_TRANS_STAT(http_cache_hit_stale_while_revalidate_stat);
+    HttpStaleRevalidate::start(s);
+    build_response_from_cache(s, HTTP_WARNING_CODE_RESPONSE_STALE);
+  } else if (s->cache_lookup_result == CACHE_LOOKUP_HIT_WARNING) {
     build_response_from_cache(s, HTTP_WARNING_CODE_HERUISTIC_EXPIRATION);
   } else if (s->cache_lookup_result == CACHE_LOOKUP_HIT_STALE) {
     ink_assert(server_up == false);
@@ -2829,8 +2879,17 @@ HttpTransact::handle_cache_write_lock(State* s)
     SET_UNPREPARE_CACHE_ACTION(s->cache_info);
     break;
   case CACHE_WL_FAIL:
+    // Somebody else is revalidating this document, so serve the
+    // stale copy rather than send one more request to the origin.
+    if (s->cache_info.action == CACHE_PREPARE_TO_UPDATE && s->cache_info.object_read != NULL &&
+        s->http_config_param->cache_serve_stale_on_write_lock_fail && is_stale_cache_response_returnable(s)) {
+      DebugTxn("http_trans", "[handle_cache_write_lock] write lock held by another request, serving stale");
+      HTTP_INCREMENT_TRANS_STAT(http_cache_hit_stale_write_lock_stat);
+      s->hdr_info.server_request.destroy();
+      build_response_from_cache(s, HTTP_WARNING_CODE_RESPONSE_STALE);
+      return;
+    }
     // No write lock, ignore the cache and proxy only;
-    // FIX: Should just serve from cache if this is a revalidate
     s->cache_info.action = CACHE_DO_NO_ACTION;
     s->cache_info.write_status = CACHE_WRITE_LOCK_MISS;
     remove_ims = true;
@@ -4095,6 +4154,26 @@ HttpTransact::handle_cache_operation_on_forward_server_response(State* s)
     SET_VIA_STRING(VIA_PROXY_RESULT, VIA_PROXY_SERVED);
 
 
+    // stale-if-error: serve the cached copy instead of the error, as long
+    // as the document allows it, without touching the cached copy.
+    if ((server_response_code == HTTP_STATUS_INTERNAL_SERVER_ERROR ||
+         server_response_code == HTTP_STATUS_GATEWAY_TIMEOUT ||
+         server_response_code == HTTP_STATUS_BAD_GATEWAY ||
+         server_response_code == HTTP_STATUS_SERVICE_UNAVAILABLE) &&
+        s->cache_info.action == CACHE_DO_UPDATE && !s->http_config_param->negative_revalidating_enabled &&
+        s->http_config_param->cache_rfc5861_enabled) {
+      int swr, sie;
+
+      get_rfc5861_directives(s->cache_info.object_read->response_get(), &swr, &sie);
+      if (sie >= 0 && is_stale_cache_response_returnable(s)) {
+        DebugTxn("http_trans", "[hcoofsr] stale-if-error: serving stale object from cache instead of %d",
+                 server_response_code);
+        HTTP_INCREMENT_TRANS_STAT(http_cache_hit_stale_if_error_stat);
+        build_response_from_cache(s, HTTP_WARNING_CODE_REVALIDATION_FAILED);
+        return;
+      }
+    }
+
     /* if we receive a 500, 502, 503 or 504 while revalidating
        a document, treat the response as a 304 and in effect revalidate the document for
        negative_revalidating_lifetime. (negative revalidating)
@@ -5765,8 +5844,20 @@ HttpTransact::is_stale_cache_response_returnable(State* s)
                                                                    cached_response,
                                                                    cached_response->get_date(),
                                                                    s->current.now);
+  // stale-if-error says for how long past its freshness it can be served
+  MgmtInt max_stale_age = s->txn_conf->cache_max_stale_age;
+
+  if (s->http_config_param->cache_rfc5861_enabled) {
+    int swr, sie;
+
+    get_rfc5861_directives(cached_response, &swr, &sie);
+    if (sie >= 0) {
+      bool heuristic;
+      max_stale_age = calculate_document_freshness_limit(s, cached_response, cached_response->get_date(), &heuristic) + sie;
+    }
+  }
   // Negative age is overflow
-  if ((current_age < 0) || (current_age > s->txn_conf->cache_max_stale_age)) {
+  if ((current_age < 0) || (current_age > max_stale_age)) {
     DebugTxn("http_trans", "[is_stale_cache_response_returnable] " "document age is too large %" PRId64,
              (int64_t)current_age);
     return false;
@@ -7337,6 +7428,20 @@ HttpTransact::what_is_document_freshness(State *s, HTTPHdr* client_request, HTTP
   ///////////////////////////////////////////
 
   if (do_revalidate || current_age > age_limit) { // client-modified limit
+    // Within its stale-while-revalidate window, serve the document and
+    // revalidate it in the background, unless this is that revalidation.
+    if (!do_revalidate && !os_specifies_revalidate && age_limit >= fresh_limit &&
+        s->http_config_param->cache_rfc5861_enabled && !is_internal_request(s)) {
+      int swr, sie;
+
+      get_rfc5861_directives(cached_obj_response, &swr, &sie);
+      if (swr > 0 && current_age <= age_limit + swr) {
+        DebugTxn("http_match", "[..._document_freshness] document is within stale-while-revalidate %d; "
+                 "returning FRESHNESS_WARNING", swr);
+        s->revalidate_in_background = true;
+        return (FRESHNESS_WARNING);
+      }
+    }
     DebugTxn("http_match", "[..._document_freshness] document needs revalidate/too old; "
             "returning FRESHNESS_STALE");
     return (FRESHNESS_STALE);
@@ -8756,3 +8861,176 @@ HttpTransact::change_response_header_because_of_range_request(State *s, HTTPHdr
     header->set_content_length(s->range_output_cl);
   }
 }
+
+
+/*************************************************************
+ *
+ *   REGRESSION TEST STUFF
+ *
+ **************************************************************/
+
+#if TS_HAS_TESTS
+static void
+rfc5861_parse_response(HTTPHdr *h, const char *cache_control, time_t date)
+{
+  HTTPParser parser;
+  char text[256];
+  const char *start = text;
+
+  snprintf(text, sizeof(text), "HTTP/1.1 200 OK\r\nCache-Control: %s\r\n\r\n", cache_control);
+  h->create(HTTP_TYPE_RESPONSE);
+  http_parser_init(&parser);
+  h->parse_resp(&parser, &start, text + strlen(text), true);
+  http_parser_clear(&parser);
+  h->set_date(date);
+}
+
+REGRESSION_TEST(HttpTransact_rfc5861_directives) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  static const struct
+  {
+    const char *cache_control;
+    int swr;
+    int sie;
+  } cases[] = {
+    { "max-age=10, stale-while-revalidate=30, stale-if-error=60", 30, 60 },
+    { "STALE-IF-ERROR=5", -1, 5 },
+    { "max-age=10", -1, -1 },
+    { "stale-while-revalidate=0", 0, -1 },
+    { "stale-while-revalidate", -1, -1 },
+    { "stale-while-revalidate=, stale-if-error=", -1, -1 },
+    { "stale-while-revalidate=abc, stale-if-error=-5", -1, -1 },
+    { "stale-while-revalidate=\"30\"", -1, -1 },
+  };
+  HTTPHdr h;
+  int swr, sie;
+
+  *pstatus = REGRESSION_TEST_PASSED;
+  for (unsigned i = 0; i < countof(cases); i++) {
+    rfc5861_parse_response(&h, cases[i].cache_control, 0);
+    get_rfc5861_directives(&h, &swr, &sie);
+    if (swr != cases[i].swr || sie != cases[i].sie) {
+      rprintf(t, "'%s': stale-while-revalidate %d stale-if-error %d, expected %d %d\n",
+              cases[i].cache_control, swr, sie, cases[i].swr, cases[i].sie);
+      *pstatus = REGRESSION_TEST_FAILED;
+    }
+    h.destroy();
+  }
+}
+
+// A transaction for a cached response that is @a age seconds old, with
+// the RFC 5861 extensions enabled and without freshness fuzz.
+struct RFC5861TestTransaction
+{
+  HttpConfigParams config;
+  HttpTransact::State *s;
+  HTTPInfo object;
+
+  RFC5861TestTransaction(const char *cache_control, int age)
+  {
+    HTTPParser parser;
+    const char *request = "GET http://example.com/ HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    const char *start = request;
+    HTTPHdr response;
+
+    config.cache_rfc5861_enabled = 1;
+    config.oride.freshness_fuzz_time = -1;
+    s = NEW(new HttpTransact::State);
+    s->http_config_param = &config;
+    s->txn_conf = &config.oride;
+    s->current.now = ink_cluster_time();
+    s->request_sent_time = s->response_received_time = s->current.now - age;
+
+    s->hdr_info.client_request.create(HTTP_TYPE_REQUEST);
+    http_parser_init(&parser);
+    s->hdr_info.client_request.parse_req(&parser, &start, request + strlen(request), true);
+    http_parser_clear(&parser);
+
+    rfc5861_parse_response(&response, cache_control, s->current.now - age);
+    object.create();
+    object.response_set(&response);
+    object.request_sent_time_set(s->request_sent_time);
+    object.response_received_time_set(s->response_received_time);
+    s->cache_info.object_read = &object;
+    response.destroy();
+  }
+
+  ~RFC5861TestTransaction()
+  {
+    object.destroy();
+    s->hdr_info.client_request.destroy();
+    delete s;
+  }
+
+  HttpTransact::Freshness_t freshness()
+  {
+    return HttpTransact::what_is_document_freshness(s, &s->hdr_info.client_request, NULL, object.response_get());
+  }
+};
+
+REGRESSION_TEST(HttpTransact_stale_while_revalidate) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  static const struct
+  {
+    const char *cache_control;
+    int age;
+    bool enabled;
+    HttpTransact::Freshness_t freshness;
+    bool in_background;
+  } cases[] = {
+    { "max-age=10, stale-while-revalidate=30", 5, true, HttpTransact::FRESHNESS_FRESH, false },
+    { "max-age=10, stale-while-revalidate=30", 20, true, HttpTransact::FRESHNESS_WARNING, true },
+    { "max-age=10, stale-while-revalidate=30", 60, true, HttpTransact::FRESHNESS_STALE, false },
+    { "max-age=10, stale-while-revalidate=30", 20, false, HttpTransact::FRESHNESS_STALE, false },
+    { "max-age=10, must-revalidate, stale-while-revalidate=30", 20, true, HttpTransact::FRESHNESS_STALE, false },
+    { "max-age=10, stale-while-revalidate=0", 20, true, HttpTransact::FRESHNESS_STALE, false },
+  };
+
+  *pstatus = REGRESSION_TEST_PASSED;
+  for (unsigned i = 0; i < countof(cases); i++) {
+    RFC5861TestTransaction txn(cases[i].cache_control, cases[i].age);
+
+    txn.config.cache_rfc5861_enabled = cases[i].enabled;
+    HttpTransact::Freshness_t freshness = txn.freshness();
+    if (freshness != cases[i].freshness || txn.s->revalidate_in_background != cases[i].in_background) {
+      rprintf(t, "'%s' at age %d: freshness %d, in background %d, expected %d %d\n",
+              cases[i].cache_control, cases[i].age, freshness, txn.s->revalidate_in_background,
+              cases[i].freshness, cases[i].in_background);
+      *pstatus = REGRESSION_TEST_FAILED;
+    }
+  }
+}
+
+REGRESSION_TEST(HttpTransact_stale_if_error) (RegressionTest * t, int /* atype ATS_UNUSED */, int *pstatus)
+{
+  static const struct
+  {
+    const char *cache_control;
+    int age;
+    bool enabled;
+    bool returnable;
+  } cases[] = {
+    // stale-if-error allows max-age plus its value, instead of max_stale_age
+    { "max-age=10, stale-if-error=60", 30, true, true },
+    { "max-age=10, stale-if-error=60", 100, true, false },
+    { "max-age=10, stale-if-error=60", 100, false, true },
+    { "max-age=10", 100, true, true },
+    { "max-age=10", 400, true, false },
+    { "max-age=10, must-revalidate, stale-if-error=60", 30, true, false },
+  };
+
+  *pstatus = REGRESSION_TEST_PASSED;
+  for (unsigned i = 0; i < countof(cases); i++) {
+    RFC5861TestTransaction txn(cases[i].cache_control, cases[i].age);
+
+    txn.config.cache_rfc5861_enabled = cases[i].enabled;
+    txn.config.oride.cache_max_stale_age = 300;
+    bool returnable = HttpTransact::is_stale_cache_response_returnable(txn.s);
+    if (returnable != cases[i].returnable) {
+      rprintf(t, "'%s' at age %d: returnable %d, expected %d\n",
+              cases[i].cache_control, cases[i].age, returnable, cases[i].returnable);
+      *pstatus = REGRESSION_TEST_FAILED;
+    }
+  }
+}
+#endif
@@ -850,6 +850,7 @@ public:
     RedirectInfo redirect_info;
     unsigned int updated_server_version;
     bool is_revalidation_necessary;     //Added to check if revalidation is necessary - YTS Team, yamsat
+    bool revalidate_in_background;      // served stale under stale-while-revalidate
     bool request_will_not_selfloop;     // To determine if process done - YTS Team, yamsat
     ConnectionAttributes client_info;
     ConnectionAttributes icp_info;
@@ -1009,7 +1010,7 @@ public:
     State()
       : m_magic(HTTP_TRANSACT_MAGIC_ALIVE), state_machine(NULL), http_config_param(NULL), force_dns(false),
         updated_server_version(HostDBApplicationInfo::HTTP_VERSION_UNDEFINED), is_revalidation_necessary(false),
-        request_will_not_selfloop(false),       //YTS Team, yamsat
+        revalidate_in_background(false), request_will_not_selfloop(false),       //YTS Team, yamsat
         source(SOURCE_NONE),
         pre_transform_source(SOURCE_NONE),
         req_flavor(REQ_FLAVOR_FWDPROXY),
@@ -73,6 +73,8 @@ public:
       sigusr1_received = 0;
       // TODO: TS-567 Integrate with debugging allocators "dump" features?
       ink_freelists_dump(stderr);
+      if (iobuffer_usage_histograms)
+        iobuffer_usage_dump(stderr);
       if (!end)
         end = (char *) sbrk(0);
       if (!snap)
@@ -138,6 +140,139 @@ public:
   }
 };
 
+// Folds the object counts held back by the magazines of one event thread
+// into the freelists, see ink_freelists_flush_thread_stats().
+class AllocatorStatsFlush:public Continuation
+{
+public:
+  AllocatorStatsFlush(EThread *t)
+    : Continuation(t->mutex)
+  {
+    SET_HANDLER(&AllocatorStatsFlush::periodic);
+  }
+
+  int periodic(int event, Event * e)
+  {
+    NOWARN_UNUSED(event);
+    NOWARN_UNUSED(e);
+    ink_freelists_flush_thread_stats();
+    return EVENT_CONT;
+  }
+};
+
+// Publishes the per freelist object accounting (every ClassAllocator and
+// every ioBufAllocator size class) as proxy.process.allocator.<name>.*
+// stats.  Freelists created since the last sample are registered as they
+// show up at the head of the freelists list; freelists sharing a name get
+// a .1, .2, ... suffix in the order they are registered.
+class AllocatorStatsContinuation:public Continuation
+{
+public:
+  struct StatNames
+  {
+    InkFreeList *fl;
+    char base[200];
+    StatNames *next;
+  };
+
+  ink_freelist_list *registered;
+  StatNames *names;
+  ink_hrtime interval;
+  AllocatorStatsFlush *flushers[MAX_EVENT_THREADS];
+
+  AllocatorStatsContinuation(ink_hrtime aninterval)
+    : Continuation(new_ProxyMutex()), registered(NULL), names(NULL), interval(aninterval)
+  {
+    memset(flushers, 0, sizeof(flushers));
+    SET_HANDLER(&AllocatorStatsContinuation::periodic);
+  }
+
+  static void base_name(char *buf, int len, const char *fl_name)
+  {
+    int n = snprintf(buf, len, "proxy.process.allocator.");
+
+    // ioBufAllocator[3] -> ioBufAllocator.3
+    for (const char *p = fl_name ? fl_name : "unknown"; *p && n < len - 1; p++) {
+      if (ParseRules::is_alnum(*p) || *p == '_')
+        buf[n++] = *p;
+      else if (*p == '[' || *p == '/' || *p == '.')
+        buf[n++] = '.';
+    }
+    buf[n] = '\0';
+  }
+
+  bool name_taken(const char *base)
+  {
+    for (StatNames *sn = names; sn; sn = sn->next) {
+      if (strcmp(sn->base, base) == 0)
+        return true;
+    }
+    return false;
+  }
+
+  void register_freelist(InkFreeList *fl)
+  {
+    StatNames *sn = (StatNames *)ats_malloc(sizeof(StatNames));
+    char base[sizeof(sn->base) - 8];
+    char name[256];
+
+    base_name(base, sizeof(base), fl->name);
+    ink_strlcpy(sn->base, base, sizeof(sn->base));
+    for (int i = 1; name_taken(sn->base); i++)
+      snprintf(sn->base, sizeof(sn->base), "%s.%d", base, i);
+    sn->fl = fl;
+    sn->next = names;
+    names = sn;
+
+    snprintf(name, sizeof(name), "%s.live_objects", sn->base);
+    RecRegisterStatInt(RECT_PROCESS, name, 0, RECP_NON_PERSISTENT);
+    snprintf(name, sizeof(name), "%s.new_objects", sn->base);
+    RecRegisterStatInt(RECT_PROCESS, name, 0, RECP_NON_PERSISTENT);
+    snprintf(name, sizeof(name), "%s.freed_objects", sn->base);
+    RecRegisterStatInt(RECT_PROCESS, name, 0, RECP_NON_PERSISTENT);
+    snprintf(name, sizeof(name), "%s.allocated_bytes", sn->base);
+    RecRegisterStatInt(RECT_PROCESS, name, 0, RECP_NON_PERSISTENT);
+  }
+
+  int periodic(int event, Event * e)
+  {
+    NOWARN_UNUSED(event);
+    NOWARN_UNUSED(e);
+    char name[256];
+    ink_freelist_list *fll;
+
+    // The freelists list grows at its head, register the new ones oldest first
+    // so that the suffixes stay the same from one run to the next.
+    while (registered != freelists) {
+      for (fll = freelists; fll->next != registered; fll = fll->next)
+        ;
+      register_freelist(fll->fl);
+      registered = fll;
+    }
+
+    // Threads that stopped allocating keep part of their counts in their
+    // magazines, have every event thread flush them on the same period.
+    for (int i = 0; i < eventProcessor.n_ethreads; i++) {
+      if (!flushers[i]) {
+        flushers[i] = new AllocatorStatsFlush(eventProcessor.all_ethreads[i]);
+        eventProcessor.all_ethreads[i]->schedule_every(flushers[i], interval);
+      }
+    }
+
+    for (StatNames *sn = names; sn; sn = sn->next) {
+      int64_t nr_new = sn->fl->nr_new, nr_free = sn->fl->nr_free;
+      snprintf(name, sizeof(name), "%s.live_objects", sn->base);
+      RecSetRecordInt(name, nr_new - nr_free);
+      snprintf(name, sizeof(name), "%s.new_objects", sn->base);
+      RecSetRecordInt(name, nr_new);
+      snprintf(name, sizeof(name), "%s.freed_objects", sn->base);
+      RecSetRecordInt(name, nr_free);
+      snprintf(name, sizeof(name), "%s.allocated_bytes", sn->base);
+      RecSetRecordInt(name, (int64_t) sn->fl->allocated * sn->fl->type_size);
+    }
+    return EVENT_CONT;
+  }
+};
 
 static void
 interrupt_handler(int sig)
@@ -402,6 +537,11 @@ init_signals2()
   RecData data;
   data.rec_int = 0; // Shouldn't be used now anyways
   init_tracker(NULL, RECD_INT, data, NULL);
+
+  int allocator_stats_interval = REC_ConfigReadInteger("proxy.config.allocator.stats_interval");
+  if (allocator_stats_interval > 0)
+    eventProcessor.schedule_every(new AllocatorStatsContinuation(HRTIME_SECONDS(allocator_stats_interval)),
+                                  HRTIME_SECONDS(allocator_stats_interval), ET_CALL);
 }
 
 